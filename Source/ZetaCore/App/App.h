@@ -111,6 +111,19 @@ namespace ZetaRay::App
         BACKGROUND
     };
 
+    enum class SCHEDULING_MODE
+    {
+        // Tasks are enqueued as soon as they're submitted, workers block until 
+        // dependencies of the dequeued task are finished
+        BLOCKING,
+        // Tasks are enqueued once all their dependencies are finished, workers never 
+        // block on a dependency
+        DEPENDENCY_READY
+    };
+
+    // Processes the subrange [begin, end) with the given context
+    using ParallelForFn = void(*)(void* ctx, size_t begin, size_t end);
+
     CpuInfo GetProcessorInfo();
     void SetThreadPriority(void* handle, THREAD_PRIORITY priority);
     void SetThreadDesc(void* handle, wchar_t* buffer);
@@ -124,11 +137,18 @@ namespace ZetaRay::App
 
     void* AllocateFrameAllocator(size_t size, 
         size_t alignment = alignof(std::max_align_t));
+    // Thread-safe pool shared by all threads (see Support::ThreadCachingPool)
+    void* AllocateMemoryPool(size_t size, size_t alignment = alignof(std::max_align_t));
+    void FreeMemoryPool(void* mem, size_t size, size_t alignment = alignof(std::max_align_t));
 
     int RegisterTask();
+    // Releases all the task signals. Must only be called when there are no unfinished tasks.
+    void ResetTaskSignals();
     void TaskFinalizedCallback(int handle, int indegree);
     void WaitForAdjacentHeadNodes(int handle);
     void SignalAdjacentTailNodes(Util::Span<int> taskIDs);
+    // Removes one dependency from the given task. Returns true if it was the last one.
+    bool SignalTailNode(int handle);
 
     // Submits task to priority thread pool
     void Submit(Support::Task&& t);
@@ -136,6 +156,25 @@ namespace ZetaRay::App
     void SubmitBackground(Support::Task&& t);
     void FlushWorkerThreadPool();
     void FlushAllThreadPools();
+    void SetWorkerSchedulingMode(SCHEDULING_MODE mode);
+
+    // Splits [begin, end) into subranges of roughly "grain" elements and processes them on
+    // the worker thread pool. Subranges are distributed through work stealing. Calling thread 
+    // participates and blocks until all the subranges are processed.
+    void ParallelFor(size_t begin, size_t end, size_t grain, ParallelForFn fn, void* ctx);
+
+    // fn is called as fn(size_t subrangeBegin, size_t subrangeEnd)
+    template<typename F>
+    ZetaInline void ParallelFor(size_t begin, size_t end, size_t grain, F&& fn)
+    {
+        using Fn = std::remove_reference_t<F>;
+
+        ParallelFor(begin, end, grain, [](void* ctx, size_t b, size_t e)
+            {
+                (*reinterpret_cast<Fn*>(ctx))(b, e);
+            }, 
+            const_cast<void*>(reinterpret_cast<const void*>(&fn)));
+    }
 
     Core::RendererCore& GetRenderer();
     Scene::SceneCore& GetScene();
@@ -196,6 +235,21 @@ namespace ZetaRay::App
             size_t alignment) {}
     };
 
+    // For small allocations that outlive a frame. Can be used from any thread, including 
+    // from tasks.
+    struct PoolAllocator
+    {
+        ZetaInline void* AllocateAligned(size_t size, size_t alignment)
+        {
+            return App::AllocateMemoryPool(size, alignment);
+        }
+
+        ZetaInline void FreeAligned(void* mem, size_t size, size_t alignment)
+        {
+            App::FreeMemoryPool(mem, size, alignment);
+        }
+    };
+
     struct OneTimeFrameAllocatorWithFallback
     {
         ZetaInline void* AllocateAligned(size_t size, size_t alignment = alignof(std::max_align_t))
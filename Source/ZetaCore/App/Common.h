@@ -19,4 +19,14 @@ namespace ZetaRay::App::Common
     int CharToWideStr(const char* str, Util::MutableSpan<wchar_t> wideStr);
 
     uint32_t CheckIntrinsicSupport();
+
+    // Virtual memory
+    size_t GetPageSize();
+    // Reserves a range of address space without allocating any physical memory for it
+    void* ReserveVirtualMemory(size_t size);
+    // Commits the given page-aligned range of a previously reserved region
+    void CommitVirtualMemory(void* mem, size_t size);
+    // Returns physical memory for the given page-aligned range, which remains reserved
+    void DecommitVirtualMemory(void* mem, size_t size);
+    void ReleaseVirtualMemory(void* mem);
 }
\ No newline at end of file
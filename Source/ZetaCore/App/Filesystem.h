@@ -10,10 +10,48 @@ namespace ZetaRay::App::Filesystem
     void LoadFromFile(const char* path, Util::Vector<uint8_t, Support::SystemAllocator>& fileData);
     void LoadFromFile(const char* path, Util::Vector<uint8_t, Support::ArenaAllocator>& fileData);
     void WriteToFile(const char* path, uint8_t* data, uint32_t sizeInBytes);
+    // Writes the given regions to file one after the other. Returns false if the file couldn't 
+    // be created (e.g. directory is read-only) or fully written (e.g. disk is full), in which 
+    // case the partially written file is deleted.
+    bool WriteToFile(const char* path, Util::Span<Util::MemoryRegion> regions);
     void RemoveFile(const char* path);
     bool Exists(const char* path);
     size_t GetFileSize(const char* path);
     void CreateDirectoryIfNotExists(const char* path);
     bool Copy(const char* srcPath, const char* dstPath, bool overwrite = false);
+    // Atomically replaces dstPath (if it exists) with srcPath. Returns false on failure, 
+    // e.g. when dstPath is open in another process.
+    bool Rename(const char* srcPath, const char* dstPath);
     bool IsDirectory(const char* path);
+    // Returns 0 if file doesn't exist
+    uint64_t GetLastWriteTime(const char* path);
+
+    // Maps the whole file into memory. Pages are copy-on-write, so contents can be 
+    // modified in place without affecting the file on disk.
+    struct MemoryMappedFile
+    {
+        MemoryMappedFile() = default;
+        ~MemoryMappedFile();
+
+        MemoryMappedFile(const MemoryMappedFile&) = delete;
+        MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+        MemoryMappedFile(MemoryMappedFile&& other);
+        MemoryMappedFile& operator=(MemoryMappedFile&& other);
+
+        // Returns false if file doesn't exist or is empty
+        bool Open(const char* path);
+        void Close();
+        // Hints the OS to start reading the whole file into memory in the background. Doesn't 
+        // block -- pages that aren't resident yet are still faulted in on first access.
+        void Prefetch();
+        ZetaInline uint8_t* Data() { return m_data; }
+        ZetaInline size_t Size() const { return m_size; }
+        ZetaInline bool IsOpen() const { return m_data != nullptr; }
+
+    private:
+        void* m_file = nullptr;
+        void* m_mapping = nullptr;
+        uint8_t* m_data = nullptr;
+        size_t m_size = 0;
+    };
 }
\ No newline at end of file
@@ -184,6 +184,37 @@ namespace
             m_hasWorkThisFrame = true;
         }
 
+        // Same as above, except that the upload buffer has already been filled by the 
+        // caller, so only the copies are recorded
+        void UploadBuffer(ID3D12Resource* buffer, UploadHeapBuffer&& uploadBuffer, 
+            Span<BufferCopyRegion> regions)
+        {
+            Assert(m_inBeginEndBlock, "Not in begin-end block.");
+            Assert(buffer, "Buffer was NULL.");
+
+            if (!m_directCmdList)
+            {
+                m_directCmdList = App::GetRenderer().GetGraphicsCmdList();
+#ifndef NDEBUG
+                m_directCmdList->SetName("ResourceUploadBatch");
+#endif
+            }
+
+            for (auto& r : regions)
+            {
+                m_directCmdList->CopyBufferRegion(buffer,
+                    r.DestOffsetInBytes,
+                    uploadBuffer.Resource(),
+                    uploadBuffer.Offset() + r.SrcOffsetInBytes,
+                    r.SizeInBytes);
+            }
+
+            // Preserve the upload buffer for as long as GPU is using it 
+            m_scratchResources.push_back(ZetaMove(uploadBuffer));
+
+            m_hasWorkThisFrame = true;
+        }
+
         void UploadTexture(ID3D12Resource* dstResource, uint8_t* pixels, 
             D3D12_RESOURCE_STATES postCopyState)
         {
@@ -1160,6 +1191,16 @@ void GpuMemory::UploadToDefaultHeapBuffer(Buffer& buffer, uint32_t sizeInBytes,
         destOffsetInBytes);
 }
 
+void GpuMemory::UploadToDefaultHeapBuffer(Buffer& buffer, UploadHeapBuffer&& uploadBuffer,
+    Span<BufferCopyRegion> regions)
+{
+    if (regions.empty())
+        return;
+
+    g_data->m_uploaders[g_threadIdx].UploadBuffer(buffer.Resource(), ZetaMove(uploadBuffer), 
+        regions);
+}
+
 ResourceHeap GpuMemory::GetResourceHeap(uint64_t sizeInBytes, uint64_t alignment, 
     bool createZeroed)
 {
@@ -95,6 +95,13 @@ namespace ZetaRay::Core::GpuMemory
         Support::OffsetAllocator::Allocation m_allocation = Support::OffsetAllocator::Allocation::Empty();
     };
 
+    struct BufferCopyRegion
+    {
+        uint32_t SrcOffsetInBytes;
+        uint32_t DestOffsetInBytes;
+        uint32_t SizeInBytes;
+    };
+
     struct UploadHeapArena
     {
         struct Allocation
@@ -306,6 +313,10 @@ namespace ZetaRay::Core::GpuMemory
         bool forceSeparateUploadBuffer = false);
     void UploadToDefaultHeapBuffer(Buffer& buffer, uint32_t sizeInBytes, 
         Util::MemoryRegion sourceData, uint32_t destOffsetInBytes = 0);
+    // For when data is written directly to the mapped memory of an upload buffer (avoids 
+    // the intermediate copy). Regions are relative to the start of the upload buffer.
+    void UploadToDefaultHeapBuffer(Buffer& buffer, UploadHeapBuffer&& uploadBuffer, 
+        Util::Span<BufferCopyRegion> regions);
     ResourceHeap GetResourceHeap(uint64_t sizeInBytes, 
         uint64_t alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT,
         bool createZeroed = false);
@@ -12,4 +12,15 @@ namespace ZetaRay::Core
         Math::oct32 Normal;
         Math::oct32 Tangent;
     };
-}
\ No newline at end of file
+
+    // 20 bytes. Position is quantized to 16-bit unorm relative to its mesh's AABB (fourth 
+    // component is unused and zero) and texture coordinates are stored in half precision. 
+    // See Model/VertexQuantizer.h for encoding and decoding.
+    struct CompactVertex
+    {
+        uint16_t Position[4];
+        Math::half2 TexUV;
+        Math::oct32 Normal;
+        Math::oct32 Tangent;
+    };
+}
@@ -1,12 +1,16 @@
 #include "BVH.h"
+#include "SIMDLanes.h"
 #include "../Math/CollisionFuncs.h"
 #include "../Utility/Error.h"
 #include "../App/Log.h"
 #include "../Scene/SceneCommon.h"
+#include "../Support/Task.h"
 #include <algorithm>
+#include <atomic>
 
 using namespace ZetaRay::Util;
 using namespace ZetaRay::Math;
+using namespace ZetaRay::Support;
 
 namespace
 {
@@ -33,9 +37,17 @@ namespace
 // Node
 //--------------------------------------------------------------------------------------
 
-void BVH::Node::InitAsLeaf(int base, int count, int parent)
+void BVH::Node::InitAsLeaf(Span<BVH::BVHInput> instances, int base, int count, int parent)
 {
     Assert(count, "Invalid count");
+    Assert(base + count <= instances.size(), "Invalid base/count.");
+
+    v_AABB vBox(instances[base].BoundingBox);
+
+    for (int i = base + 1; i < base + count; i++)
+        vBox = unionAABB(vBox, v_AABB(instances[i].BoundingBox));
+
+    BoundingBox = store(vBox);
     Base = base;
     Count = count;
 //    AABB.Extents = float3(0.0f, 0.0f, 0.0f);
@@ -59,6 +71,536 @@ void BVH::Node::InitAsInternal(Span<BVH::BVHInput> instances, int base, int coun
     Parent = parent;
 }
 
+//--------------------------------------------------------------------------------------
+// BinnedSAHBuilder
+//--------------------------------------------------------------------------------------
+
+// Nodes are first built into a temporary array with explicit child indices, so that 
+// subtrees can be built concurrently. Afterwards, tree is flattened into the depth-first 
+// layout expected by the traversal code (left child immediately follows its parent).
+struct BVH::BinnedSAHBuilder
+{
+    // Subtrees with at least this many instances are built on the worker threads
+    static constexpr int PARALLEL_BUILD_THRESHOLD = 1024;
+    // Nodes with at least this many instances are binned on the worker threads
+    static constexpr int PARALLEL_BINNING_THRESHOLD = 16 * 1024;
+    static constexpr int BINNING_CHUNK_SIZE = 4096;
+    static constexpr int MAX_NUM_BINNING_CHUNKS = 32;
+
+    // Union of instance boxes and union of instance centroids
+    struct alignas(16) Bounds
+    {
+        ZetaInline void Init()
+        {
+            vBoxMin = _mm_set1_ps(FLT_MAX);
+            vBoxMax = _mm_set1_ps(-FLT_MAX);
+            vCentMin = vBoxMin;
+            vCentMax = vBoxMax;
+        }
+
+        ZetaInline void __vectorcall Extend(__m128 vMin, __m128 vMax, __m128 vCenter)
+        {
+            vBoxMin = _mm_min_ps(vBoxMin, vMin);
+            vBoxMax = _mm_max_ps(vBoxMax, vMax);
+            vCentMin = _mm_min_ps(vCentMin, vCenter);
+            vCentMax = _mm_max_ps(vCentMax, vCenter);
+        }
+
+        ZetaInline void Extend(const Bounds& other)
+        {
+            vBoxMin = _mm_min_ps(vBoxMin, other.vBoxMin);
+            vBoxMax = _mm_max_ps(vBoxMax, other.vBoxMax);
+            vCentMin = _mm_min_ps(vCentMin, other.vCentMin);
+            vCentMax = _mm_max_ps(vCentMax, other.vCentMax);
+        }
+
+        __m128 vBoxMin;
+        __m128 vBoxMax;
+        __m128 vCentMin;
+        __m128 vCentMax;
+    };
+
+    struct Bin
+    {
+        Bounds B;
+        int Count;
+    };
+
+    // One set of bins per axis
+    struct BinSet
+    {
+        void Init(int numBins)
+        {
+            for (int axis = 0; axis < 3; axis++)
+            {
+                for (int b = 0; b < numBins; b++)
+                {
+                    Bins[axis][b].B.Init();
+                    Bins[axis][b].Count = 0;
+                }
+            }
+        }
+
+        void Merge(const BinSet& other, int numBins)
+        {
+            for (int axis = 0; axis < 3; axis++)
+            {
+                for (int b = 0; b < numBins; b++)
+                {
+                    Bins[axis][b].B.Extend(other.Bins[axis][b].B);
+                    Bins[axis][b].Count += other.Bins[axis][b].Count;
+                }
+            }
+        }
+
+        Bin Bins[3][MAX_NUM_SAH_BINS];
+    };
+
+    // Maps centroid coordinates to bin indices
+    struct BinMapping
+    {
+        // Vectorized code in BinRange() must match this exactly, otherwise partitioning 
+        // wouldn't agree with the bin counts
+        ZetaInline int Index(float c, int axis) const
+        {
+            const int idx = (int)((c - Min[axis]) * Scale[axis]);
+            return Math::Min(Math::Max(idx, 0), NumBins - 1);
+        }
+
+        float Min[3];
+        float Scale[3];
+        int NumBins;
+    };
+
+    struct Split
+    {
+        int Axis = -1;
+        // Bins [0, Bin) go to the left child
+        int Bin;
+        int LeftCount;
+        float Cost = FLT_MAX;
+    };
+
+    struct BuildNode
+    {
+        Math::AABB Box;
+        // -1 for leaves
+        int Left;
+        int Right;
+        int Base;
+        int Count;
+    };
+
+    BinnedSAHBuilder(MutableSpan<BVHInput> instances, int numBins, bool parallel)
+        : m_instances(instances),
+        m_numBins(numBins),
+        m_parallel(parallel)
+    {
+        // Every leaf contains at least one instance
+        m_nodes.resize(2 * instances.size() - 1);
+    }
+
+    ZetaInline static void __vectorcall LoadInstance(const BVHInput& instance, __m128& vMin, 
+        __m128& vMax, __m128& vCenter)
+    {
+        // Last lanes are garbage and ignored
+        vCenter = _mm_loadu_ps(&instance.BoundingBox.Center.x);
+        const __m128 vExtents = _mm_loadu_ps(&instance.BoundingBox.Extents.x);
+        vMin = _mm_sub_ps(vCenter, vExtents);
+        vMax = _mm_add_ps(vCenter, vExtents);
+    }
+
+    // Returns half the surface area
+    ZetaInline static float __vectorcall HalfArea(__m128 vMin, __m128 vMax)
+    {
+        const __m128 vD = _mm_sub_ps(vMax, vMin);
+        const __m128 vYZX = _mm_shuffle_ps(vD, vD, V_SHUFFLE_XYZW(1, 2, 0, 0));
+        alignas(16) float prod[4];
+        _mm_store_ps(prod, _mm_mul_ps(vD, vYZX));
+
+        return prod[0] + prod[1] + prod[2];
+    }
+
+    ZetaInline static Math::AABB __vectorcall ToAABB(__m128 vMin, __m128 vMax)
+    {
+        v_AABB vBox;
+        vBox.Reset(vMin, vMax);
+
+        return store(vBox);
+    }
+
+    // Splits [base, base + count) into chunks that are processed on the worker threads. fn 
+    // is called as fn(chunkIdx, chunkBase, chunkCount). Returns number of chunks.
+    template<typename F>
+    static int ForEachChunk(int base, int count, F&& fn)
+    {
+        const int numChunks = Math::Min(CeilUnsignedIntDiv(count, BINNING_CHUNK_SIZE), 
+            MAX_NUM_BINNING_CHUNKS);
+        const int chunkSize = CeilUnsignedIntDiv(count, numChunks);
+
+        App::ParallelFor(0, numChunks, 1, [base, count, chunkSize, &fn](size_t b, size_t e)
+            {
+                for (size_t c = b; c < e; c++)
+                {
+                    const int chunkBase = base + (int)c * chunkSize;
+                    const int chunkCount = Math::Min(chunkSize, base + count - chunkBase);
+
+                    if (chunkCount > 0)
+                        fn((int)c, chunkBase, chunkCount);
+                }
+            });
+
+        return numChunks;
+    }
+
+    void ComputeBounds(int base, int count, Bounds& bounds)
+    {
+        bounds.Init();
+
+        for (int i = base; i < base + count; i++)
+        {
+            __m128 vMin, vMax, vCenter;
+            LoadInstance(m_instances[i], vMin, vMax, vCenter);
+            bounds.Extend(vMin, vMax, vCenter);
+        }
+    }
+
+    void ComputeRootBounds(Bounds& bounds)
+    {
+        const int count = (int)m_instances.size();
+
+        if (!m_parallel || count < PARALLEL_BINNING_THRESHOLD)
+        {
+            ComputeBounds(0, count, bounds);
+            return;
+        }
+
+        Bounds chunkBounds[MAX_NUM_BINNING_CHUNKS];
+        const int numChunks = ForEachChunk(0, count, [this, &chunkBounds](int c, int b, int n)
+            {
+                ComputeBounds(b, n, chunkBounds[c]);
+            });
+
+        bounds.Init();
+
+        for (int c = 0; c < numChunks; c++)
+            bounds.Extend(chunkBounds[c]);
+    }
+
+    void BinRange(const BinMapping& mapping, int base, int count, BinSet& bins)
+    {
+        const int end = base + count;
+        int i = base;
+
+        // Compute bin indices of 8 instances at a time. Instances are 8 floats apart.
+        static_assert(sizeof(BVHInput) == 8 * sizeof(float), "Gather offsets assume BVHInput is 32 bytes.");
+        const __m256i vOffsets = _mm256_setr_epi32(0, 8, 16, 24, 32, 40, 48, 56);
+        const __m256i vMaxBinIdx = _mm256_set1_epi32(mapping.NumBins - 1);
+        const __m256i vZero = _mm256_setzero_si256();
+        __m256 vMinCoord[3];
+        __m256 vScale[3];
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            vMinCoord[axis] = _mm256_set1_ps(mapping.Min[axis]);
+            vScale[axis] = _mm256_set1_ps(mapping.Scale[axis]);
+        }
+
+        alignas(32) int binIdx[3][8];
+
+        for (; i + 8 <= end; i += 8)
+        {
+            const float* center = &m_instances[i].BoundingBox.Center.x;
+
+            for (int axis = 0; axis < 3; axis++)
+            {
+                const __m256 vC = _mm256_i32gather_ps(center + axis, vOffsets, sizeof(float));
+                __m256i vIdx = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_sub_ps(vC, vMinCoord[axis]), 
+                    vScale[axis]));
+                vIdx = _mm256_min_epi32(_mm256_max_epi32(vIdx, vZero), vMaxBinIdx);
+                _mm256_store_si256(reinterpret_cast<__m256i*>(binIdx[axis]), vIdx);
+            }
+
+            for (int j = 0; j < 8; j++)
+            {
+                __m128 vMin, vMax, vCenter;
+                LoadInstance(m_instances[i + j], vMin, vMax, vCenter);
+
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    Bin& bin = bins.Bins[axis][binIdx[axis][j]];
+                    bin.B.Extend(vMin, vMax, vCenter);
+                    bin.Count++;
+                }
+            }
+        }
+
+        for (; i < end; i++)
+        {
+            __m128 vMin, vMax, vCenter;
+            LoadInstance(m_instances[i], vMin, vMax, vCenter);
+            const float* center = &m_instances[i].BoundingBox.Center.x;
+
+            for (int axis = 0; axis < 3; axis++)
+            {
+                Bin& bin = bins.Bins[axis][mapping.Index(center[axis], axis)];
+                bin.B.Extend(vMin, vMax, vCenter);
+                bin.Count++;
+            }
+        }
+    }
+
+    Split FindBestSplit(const BinSet& bins)
+    {
+        Split best;
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            const Bin* axisBins = bins.Bins[axis];
+
+            // Area and count of everything to the right of each split plane. Plane p 
+            // separates bins p - 1 and p.
+            float rightArea[MAX_NUM_SAH_BINS];
+            int rightCount[MAX_NUM_SAH_BINS];
+            Bounds acc;
+            acc.Init();
+            int count = 0;
+
+            for (int p = m_numBins - 1; p > 0; p--)
+            {
+                acc.Extend(axisBins[p].B);
+                count += axisBins[p].Count;
+                rightArea[p] = count > 0 ? HalfArea(acc.vBoxMin, acc.vBoxMax) : 0.0f;
+                rightCount[p] = count;
+            }
+
+            acc.Init();
+            count = 0;
+
+            for (int p = 1; p < m_numBins; p++)
+            {
+                acc.Extend(axisBins[p - 1].B);
+                count += axisBins[p - 1].Count;
+
+                if (count == 0 || rightCount[p] == 0)
+                    continue;
+
+                const float cost = count * HalfArea(acc.vBoxMin, acc.vBoxMax) + 
+                    rightCount[p] * rightArea[p];
+
+                if (cost < best.Cost)
+                {
+                    best.Axis = axis;
+                    best.Bin = p;
+                    best.LeftCount = count;
+                    best.Cost = cost;
+                }
+            }
+        }
+
+        return best;
+    }
+
+    int BuildSubtree(int base, int count, const Bounds& bounds)
+    {
+        const int nodeIdx = m_numNodes.fetch_add(1, std::memory_order_relaxed);
+        Assert(nodeIdx < (int)m_nodes.size(), "Out-of-bound access in node array.");
+
+        BuildNode& node = m_nodes[nodeIdx];
+        node.Box = ToAABB(bounds.vBoxMin, bounds.vBoxMax);
+        node.Left = -1;
+        node.Right = -1;
+        node.Base = base;
+        node.Count = count;
+
+        if (count <= (int)MAX_NUM_INSTANCES_PER_LEAF)
+            return nodeIdx;
+
+        alignas(16) float centExtents[4];
+        _mm_store_ps(centExtents, _mm_sub_ps(bounds.vCentMax, bounds.vCentMin));
+
+        // All centroids are (almost) the same point, no point in splitting further
+        if (centExtents[0] + centExtents[1] + centExtents[2] <= 2e-5f)
+            return nodeIdx;
+
+        int splitCount;
+        Bounds leftBounds;
+        Bounds rightBounds;
+
+        if (count < (int)MIN_NUM_INSTANCES_SPLIT_SAH)
+        {
+            // Split along the longest axis such that each subtree has an equal number of 
+            // instances
+            int splitAxis = 0;
+            splitAxis = centExtents[1] > centExtents[splitAxis] ? 1 : splitAxis;
+            splitAxis = centExtents[2] > centExtents[splitAxis] ? 2 : splitAxis;
+            splitCount = count >> 1;
+
+            std::nth_element(m_instances.begin() + base, m_instances.begin() + base + splitCount,
+                m_instances.begin() + base + count,
+                [splitAxis](const BVHInput& b1, const BVHInput& b2)
+                {
+                    return (&b1.BoundingBox.Center.x)[splitAxis] < (&b2.BoundingBox.Center.x)[splitAxis];
+                });
+
+            ComputeBounds(base, splitCount, leftBounds);
+            ComputeBounds(base + splitCount, count - splitCount, rightBounds);
+        }
+        else
+        {
+            alignas(16) float centMin[4];
+            _mm_store_ps(centMin, bounds.vCentMin);
+
+            BinMapping mapping;
+            mapping.NumBins = m_numBins;
+
+            for (int axis = 0; axis < 3; axis++)
+            {
+                mapping.Min[axis] = centMin[axis];
+                // Degenerate axes map everything to the first bin and are never split
+                mapping.Scale[axis] = centExtents[axis] > 1e-7f ? 
+                    (m_numBins * (1.0f - 1e-6f)) / centExtents[axis] : 0.0f;
+            }
+
+            BinSet bins;
+            bins.Init(m_numBins);
+
+            if (m_parallel && count >= PARALLEL_BINNING_THRESHOLD)
+            {
+                SmallVector<BinSet> chunkBins;
+                chunkBins.resize(MAX_NUM_BINNING_CHUNKS);
+
+                const int numChunks = ForEachChunk(base, count, 
+                    [this, &mapping, &chunkBins](int c, int b, int n)
+                    {
+                        chunkBins[c].Init(m_numBins);
+                        BinRange(mapping, b, n, chunkBins[c]);
+                    });
+
+                for (int c = 0; c < numChunks; c++)
+                    bins.Merge(chunkBins[c], m_numBins);
+            }
+            else
+                BinRange(mapping, base, count, bins);
+
+            const Split split = FindBestSplit(bins);
+            Assert(split.Axis != -1, "Centroid bounds aren't degenerate, a valid split must exist.");
+
+            // Compare against the cost of intersecting every instance
+            const float leafCost = count * HalfArea(bounds.vBoxMin, bounds.vBoxMax);
+            if (split.Cost >= leafCost)
+                return nodeIdx;
+
+            auto it = std::partition(m_instances.begin() + base, m_instances.begin() + base + count,
+                [&mapping, &split](const BVHInput& instance)
+                {
+                    const float c = (&instance.BoundingBox.Center.x)[split.Axis];
+                    return mapping.Index(c, split.Axis) < split.Bin;
+                });
+
+            splitCount = (int)(it - m_instances.begin() - base);
+            Assert(splitCount == split.LeftCount, "Partitioning and binning disagree.");
+
+            // Child bounds are known from the bins, no need to iterate over instances again
+            leftBounds.Init();
+            rightBounds.Init();
+
+            for (int b = 0; b < split.Bin; b++)
+                leftBounds.Extend(bins.Bins[split.Axis][b].B);
+
+            for (int b = split.Bin; b < m_numBins; b++)
+                rightBounds.Extend(bins.Bins[split.Axis][b].B);
+        }
+
+        Assert(splitCount > 0 && splitCount < count, "bug");
+        int children[2];
+
+        if (m_parallel && count >= PARALLEL_BUILD_THRESHOLD)
+        {
+            App::ParallelFor(0, 2, 1, [&](size_t b, size_t e)
+                {
+                    for (size_t c = b; c < e; c++)
+                    {
+                        children[c] = c == 0 ? BuildSubtree(base, splitCount, leftBounds) :
+                            BuildSubtree(base + splitCount, count - splitCount, rightBounds);
+                    }
+                });
+        }
+        else
+        {
+            children[0] = BuildSubtree(base, splitCount, leftBounds);
+            children[1] = BuildSubtree(base + splitCount, count - splitCount, rightBounds);
+        }
+
+        // Node array is never resized during build, so "node" is still valid
+        node.Left = children[0];
+        node.Right = children[1];
+
+        return nodeIdx;
+    }
+
+    int Build()
+    {
+        Bounds rootBounds;
+        ComputeRootBounds(rootBounds);
+
+        return BuildSubtree(0, (int)m_instances.size(), rootBounds);
+    }
+
+    int Flatten(BVH& bvh, int buildNodeIdx, int parent)
+    {
+        const BuildNode& buildNode = m_nodes[buildNodeIdx];
+        const int nodeIdx = (int)bvh.m_numNodes++;
+        Node& node = bvh.m_nodes[nodeIdx];
+        node.BoundingBox = buildNode.Box;
+        node.Parent = parent;
+
+        if (buildNode.Left == -1)
+        {
+            node.Base = buildNode.Base;
+            node.Count = buildNode.Count;
+            node.RightChild = -1;
+
+            return nodeIdx;
+        }
+
+        // Left child is placed right after its parent
+        Flatten(bvh, buildNode.Left, nodeIdx);
+        node.RightChild = Flatten(bvh, buildNode.Right, nodeIdx);
+
+        return nodeIdx;
+    }
+
+    MutableSpan<BVHInput> m_instances;
+    SmallVector<BuildNode> m_nodes;
+    std::atomic_int32_t m_numNodes = 0;
+    const int m_numBins;
+    const bool m_parallel;
+};
+
+//--------------------------------------------------------------------------------------
+// RebuildJob
+//--------------------------------------------------------------------------------------
+
+struct BVH::RebuildJob
+{
+    struct LoggedChange
+    {
+        BVHUpdateInput Update;
+        bool IsRemoval;
+    };
+
+    // Copy of instances at the time rebuild was started
+    SmallVector<BVHInput> Snapshot;
+    BVH Tree;
+    // Updates and removals that happened after the snapshot was taken. Replayed on 
+    // the new tree before it replaces the old one.
+    SmallVector<LoggedChange> Log;
+    std::atomic_bool Done = false;
+    // Build is done in FinishRebuild() rather than in a background task
+    bool Deferred = false;
+};
+
 //--------------------------------------------------------------------------------------
 // BVH
 //--------------------------------------------------------------------------------------
@@ -69,14 +611,36 @@ BVH::BVH()
     m_nodes(m_arena)
 {}
 
-void BVH::Build(Span<BVHInput> instances)
+BVH::~BVH()
+{
+    CancelRebuild();
+}
+
+void BVH::Build(Span<BVHInput> instances, BUILD_METHOD method, uint32_t numBins)
 {
+    CancelRebuild();
+    BuildInternal(instances, method, numBins, true);
+}
+
+void BVH::BuildInternal(Span<BVHInput> instances, BUILD_METHOD method, uint32_t numBins, 
+    bool parallel)
+{
+    // Release the previous tree (if any)
+    m_nodes.free_memory();
+    m_instances.free_memory();
+    m_arena.Reset();
+    m_numNodes = 0;
+    m_sahSum = 0.0f;
+    m_builtSAHCost = 0.0f;
+    m_buildMethod = method;
+    m_numBins = numBins;
+
     if (instances.size() == 0)
         return;
 
     //m_instances.swap(instances);
     m_instances.append_range(instances.begin(), instances.end(), true);
-    Check(m_instances.size() < UINT32_MAX, "#Instances can't exceed UINT32_MAX.");
+    Check(m_instances.size() < INT32_MAX, "#Instances can't exceed INT32_MAX.");
     const uint32_t numInstances = (uint32_t)m_instances.size();
 
     // Special case when there's less than MAX_NUM_MODELS_PER_LEAF instances
@@ -93,15 +657,37 @@ void BVH::Build(Span<BVHInput> instances)
         m_nodes[0].Base = 0;
         m_nodes[0].Count = (int)m_instances.size();
         m_nodes[0].RightChild = -1;
+        m_numNodes = 1;
+        m_sahSum = ComputeSAHSum();
+        m_builtSAHCost = SAHCost();
 
         return;
     }
 
-    // TODO check this computation
-    const uint32_t MAX_NUM_NODES = Math::CeilUnsignedIntDiv(4 * numInstances, MAX_NUM_INSTANCES_PER_LEAF) + 1;
-    m_nodes.resize(MAX_NUM_NODES);
+    if (method == BUILD_METHOD::ALL_AXES_PARALLEL)
+    {
+        Assert(numBins >= MIN_NUM_SAH_BINS && numBins <= MAX_NUM_SAH_BINS, "Invalid number of bins.");
+        numBins = Math::Min(Math::Max(numBins, MIN_NUM_SAH_BINS), MAX_NUM_SAH_BINS);
+
+        BinnedSAHBuilder builder(m_instances, (int)numBins, parallel);
+        const int root = builder.Build();
+        const int numNodes = builder.m_numNodes.load(std::memory_order_relaxed);
+
+        m_nodes.resize(numNodes);
+        builder.Flatten(*this, root, -1);
+        Assert(m_numNodes == (uint32_t)numNodes, "bug");
+    }
+    else
+    {
+        // TODO check this computation
+        const uint32_t MAX_NUM_NODES = Math::CeilUnsignedIntDiv(4 * numInstances, MAX_NUM_INSTANCES_PER_LEAF) + 1;
+        m_nodes.resize(MAX_NUM_NODES);
+
+        BuildSubtree(0, numInstances, -1);
+    }
 
-    BuildSubtree(0, numInstances, -1);
+    m_sahSum = ComputeSAHSum();
+    m_builtSAHCost = SAHCost();
 }
 
 int BVH::BuildSubtree(int base, int count, int parent)
@@ -113,7 +699,7 @@ int BVH::BuildSubtree(int base, int count, int parent)
     // Create a leaf node and return
     if (count <= MAX_NUM_INSTANCES_PER_LEAF)
     {
-        m_nodes[currNodeIdx].InitAsLeaf(base, count, parent);
+        m_nodes[currNodeIdx].InitAsLeaf(m_instances, base, count, parent);
         return currNodeIdx;
     }
 
@@ -141,7 +727,7 @@ int BVH::BuildSubtree(int base, int count, int parent)
     // All centroids are (almost) the same point, no point in splitting further
     if (centroidAABB.Extents.x + centroidAABB.Extents.y + centroidAABB.Extents.z <= 1e-5f)
     {
-        m_nodes[currNodeIdx].InitAsLeaf(base, count, parent);
+        m_nodes[currNodeIdx].InitAsLeaf(m_instances, base, count, parent);
         return currNodeIdx;
     }
 
@@ -232,7 +818,7 @@ int BVH::BuildSubtree(int base, int count, int parent)
         const float noSplitCost = (float)count;
         if (noSplitCost <= lowestCost)
         {
-            m_nodes[currNodeIdx].InitAsLeaf(base, count, parent);
+            m_nodes[currNodeIdx].InitAsLeaf(m_instances, base, count, parent);
             return currNodeIdx;
         }
 
@@ -352,11 +938,17 @@ int BVH::Find(uint64_t instanceID, const Math::AABB& queryBox, int& nodeIdx)
         }
     }
 
-    return currNodeIdx;
+    return -1;
 }
 
 void BVH::Update(Span<BVHUpdateInput> instances)
 {
+    if (m_rebuildJob && m_rebuildJob->Done.load(std::memory_order_acquire))
+        FinishRebuild();
+
+    SmallVector<int> dirtyLeaves;
+    dirtyLeaves.reserve(instances.size());
+
     for (auto& [oldBox, newBox, id] : instances)
     {
         // Find the leaf node that contains it
@@ -364,40 +956,72 @@ void BVH::Update(Span<BVHUpdateInput> instances)
         int instanceIdx = Find(id, oldBox, nodeIdx);
         Assert(instanceIdx != -1, "Instance with ID %u was not found.", id);
 
-        // Update the bounding box
-        Node& node = m_nodes[nodeIdx];
         m_instances[instanceIdx].BoundingBox = newBox;
+        dirtyLeaves.push_back(nodeIdx);
+    }
 
-        const v_AABB vOldBox(oldBox);
-        const v_AABB vNewBox(newBox);
+    Refit(dirtyLeaves);
 
-        Math::COLLISION_TYPE res = Math::intersectAABBvsAABB(vOldBox, vNewBox);
+    if (m_rebuildJob)
+    {
+        for (auto& u : instances)
+            m_rebuildJob->Log.push_back(RebuildJob::LoggedChange{ .Update = u, .IsRemoval = false });
+    }
+    else if (SAHGrowth() > REBUILD_SAH_GROWTH_THRESHOLD)
+        StartRebuild();
+}
 
-        // If the old AABB contains the new one, keep using the old one
-        if (res != COLLISION_TYPE::CONTAINS)
+void BVH::Refit(Span<int> dirtyLeaves)
+{
+    SmallVector<int> toRefit;
+
+    // Mark the leaves and their ancestors. Going up the tree stops at the first node that 
+    // has already been marked, so shared ancestors are only added once.
+    for (int leaf : dirtyLeaves)
+    {
+        int curr = leaf;
+
+        while (curr != -1 && !m_nodes[curr].Dirty)
         {
-            int currParent = node.Parent;
+            m_nodes[curr].Dirty = true;
+            toRefit.push_back(curr);
+            curr = m_nodes[curr].Parent;
+        }
+    }
 
-            // Following the parent indices, keep going up the tree and merge the AABBs. Break once a parent node's
-            // AABB contains the new one
-            while (currParent != -1)
-            {
-                Node& parentNode = m_nodes[currParent];
+    // Children always come after their parent in the node array, so going in decreasing
+    // index order refits every node after its children
+    std::sort(toRefit.begin(), toRefit.end(), [](int a, int b) { return a > b; });
 
-                v_AABB vParentBox(parentNode.BoundingBox);
-                if (Math::intersectAABBvsAABB(vParentBox, vNewBox) == COLLISION_TYPE::CONTAINS)
-                    break;
+    for (int nodeIdx : toRefit)
+    {
+        Node& node = m_nodes[nodeIdx];
+        const float oldArea = AABBSurfaceArea(v_AABB(node.BoundingBox));
+        v_AABB vBox = v_AABB::Init();
 
-                vParentBox = Math::unionAABB(vParentBox, vNewBox);
-                parentNode.BoundingBox = Math::store(vParentBox);
+        if (node.IsLeaf())
+        {
+            if (node.Count > 0)
+            {
+                vBox.Reset(m_instances[node.Base].BoundingBox);
 
-                currParent = m_nodes[currParent].Parent;
+                for (int i = node.Base + 1; i < node.Base + node.Count; i++)
+                    vBox = unionAABB(vBox, v_AABB(m_instances[i].BoundingBox));
             }
+
+            node.BoundingBox = store(vBox);
+            m_sahSum += node.Count * (AABBSurfaceArea(vBox) - oldArea);
+        }
+        else
+        {
+            vBox = unionAABB(v_AABB(m_nodes[nodeIdx + 1].BoundingBox), 
+                v_AABB(m_nodes[node.RightChild].BoundingBox));
+
+            node.BoundingBox = store(vBox);
+            m_sahSum += AABBSurfaceArea(vBox) - oldArea;
         }
 
-        // Note: when the new AABB and the old AABB are disjoint, it'd be better to
-        // remove and then reinsert the update Node. That requires modifying the range of
-        // all the leaves, which is expensive
+        node.Dirty = false;
     }
 }
 
@@ -416,6 +1040,130 @@ void BVH::Remove(uint64_t ID, const Math::AABB& box)
     const uint32_t swapIdx = m_nodes[nodeIdx].Base + m_nodes[nodeIdx].Count - 1;
     std::swap(m_instances[instanceIdx], m_instances[swapIdx]);
     m_nodes[nodeIdx].Count--;
+
+    // Leaf bounds are left as is until the next refit
+    m_sahSum -= AABBSurfaceArea(v_AABB(m_nodes[nodeIdx].BoundingBox));
+
+    if (m_rebuildJob)
+    {
+        m_rebuildJob->Log.push_back(RebuildJob::LoggedChange{
+            .Update = BVHUpdateInput{ .OldBox = box, .NewBox = box, .InstanceID = ID },
+            .IsRemoval = true });
+    }
+}
+
+void BVH::StartRebuild(bool inBackground)
+{
+    Assert(!m_rebuildJob, "Rebuild is already in progress.");
+
+    m_rebuildJob = new RebuildJob;
+    m_rebuildJob->Deferred = !inBackground;
+    m_rebuildJob->Snapshot.reserve(m_instances.size());
+
+    for (auto& instance : m_instances)
+    {
+        // Skip the leftovers from BVH::Remove()
+        if (instance.InstanceID != Scene::INVALID_INSTANCE)
+            m_rebuildJob->Snapshot.push_back(instance);
+    }
+
+    if (!inBackground)
+        return;
+
+    Task t("BVH::Rebuild", TASK_PRIORITY::BACKGROUND, [job = m_rebuildJob, 
+        method = m_buildMethod, numBins = m_numBins]()
+        {
+            // Serial build, so that worker threads aren't taken away from the frame tasks
+            job->Tree.BuildInternal(job->Snapshot, method, numBins, false);
+            
+            job->Done.store(true, std::memory_order_release);
+            job->Done.notify_all();
+        });
+
+    App::SubmitBackground(ZetaMove(t));
+}
+
+void BVH::FinishRebuild()
+{
+    Assert(m_rebuildJob, "Rebuild hasn't been started.");
+    RebuildJob* job = m_rebuildJob;
+    m_rebuildJob = nullptr;
+
+    if (job->Deferred)
+        job->Tree.BuildInternal(job->Snapshot, m_buildMethod, m_numBins, false);
+    else
+        job->Done.wait(false, std::memory_order_acquire);
+
+    BVH& tree = job->Tree;
+    m_nodes.free_memory();
+    m_instances.free_memory();
+    m_arena.Reset();
+
+    m_nodes.append_range(tree.m_nodes.begin(), tree.m_nodes.end(), true);
+    m_instances.append_range(tree.m_instances.begin(), tree.m_instances.end(), true);
+    m_numNodes = tree.m_numNodes;
+    m_sahSum = tree.m_sahSum;
+    m_builtSAHCost = tree.m_builtSAHCost;
+
+    // Replay the changes that were made to the old tree after snapshot was taken. Only 
+    // the net change per instance matters, so the log is collapsed per instance ID. Each
+    // instance is then looked up by its box in the snapshot, which is what the new tree
+    // was built from -- node bounds stay valid for lookups until the final refit.
+    SmallVector<RebuildJob::LoggedChange> changes;
+    changes.append_range(job->Log.begin(), job->Log.end(), true);
+
+    // Stable, so that changes to the same instance remain in the order they were made
+    std::stable_sort(changes.begin(), changes.end(),
+        [](const RebuildJob::LoggedChange& a, const RebuildJob::LoggedChange& b)
+        {
+            return a.Update.InstanceID < b.Update.InstanceID;
+        });
+
+    SmallVector<int> dirtyLeaves;
+    size_t curr = 0;
+
+    while (curr < changes.size())
+    {
+        const uint64_t id = changes[curr].Update.InstanceID;
+        const AABB snapshotBox = changes[curr].Update.OldBox;
+        AABB lastBox = changes[curr].Update.NewBox;
+        bool removed = false;
+
+        for (; curr < changes.size() && changes[curr].Update.InstanceID == id; curr++)
+        {
+            lastBox = changes[curr].Update.NewBox;
+            removed = removed || changes[curr].IsRemoval;
+        }
+
+        if (removed)
+        {
+            Remove(id, snapshotBox);
+            continue;
+        }
+
+        int nodeIdx;
+        const int instanceIdx = Find(id, snapshotBox, nodeIdx);
+        Assert(instanceIdx != -1, "Instance with ID %u was not found.", id);
+
+        m_instances[instanceIdx].BoundingBox = lastBox;
+        dirtyLeaves.push_back(nodeIdx);
+    }
+
+    Refit(dirtyLeaves);
+
+    delete job;
+}
+
+void BVH::CancelRebuild()
+{
+    if (!m_rebuildJob)
+        return;
+
+    if (!m_rebuildJob->Deferred)
+        m_rebuildJob->Done.wait(false, std::memory_order_acquire);
+
+    delete m_rebuildJob;
+    m_rebuildJob = nullptr;
 }
 
 void BVH::DoFrustumCulling(const Math::ViewFrustum& viewFrustum, 
@@ -543,13 +1291,27 @@ uint64_t BVH::CastRay(v_Ray& vRay)
     if (!Math::intersectRayVsAABB(vRay, vDirRcp, vDirIsPos, vIsParallel, vBox, t))
         return Scene::INVALID_INSTANCE;
 
+    // Lower bound on distance to any hit inside the box. intersectRayVsAABB() returns the
+    // exit distance when ray origin is inside the box, in which case it's zero.
+    auto distLowerBound = [&vRay](const v_AABB& vBox, float t)
+        {
+            const __m128 vInside = _mm_cmple_ps(abs(_mm_sub_ps(vRay.vOrigin, vBox.vCenter)), vBox.vExtents);
+            return (_mm_movemask_ps(vInside) & 0x7) == 0x7 ? 0.0f : t;
+        };
+
+    struct StackEntry
+    {
+        int Node;
+        float T;
+    };
+
     // Manual stack
     constexpr int STACK_SIZE = 64;
-    int stack[STACK_SIZE];
+    StackEntry stack[STACK_SIZE];
     int currStackIdx = 0;
 
     // Insert root
-    stack[currStackIdx] = 0;
+    stack[currStackIdx] = StackEntry{ .Node = 0, .T = 0.0f };
     int currNode = -1;
     float minT = FLT_MAX;
     uint64_t closestID = Scene::INVALID_INSTANCE;
@@ -558,7 +1320,13 @@ uint64_t BVH::CastRay(v_Ray& vRay)
     {
         Assert(currStackIdx < STACK_SIZE, "Stack size exceeded 64.");
 
-        currNode = stack[currStackIdx--];
+        const StackEntry curr = stack[currStackIdx--];
+
+        // No need to search this subtree as earlier hits are necessarily closer to camera
+        if (curr.T >= minT)
+            continue;
+
+        currNode = curr.Node;
         const Node& node = m_nodes[currNode];
 
         if (node.IsLeaf())
@@ -587,17 +1355,23 @@ uint64_t BVH::CastRay(v_Ray& vRay)
             const bool hitLeftChild = Math::intersectRayVsAABB(vRay, vDirRcp, vDirIsPos, vIsParallel, vLeftBox, leftT);
             const bool hitRightChild = Math::intersectRayVsAABB(vRay, vDirRcp, vDirIsPos, vIsParallel, vRightBox, rightT);
 
-            int sortedByT[2] = { currNode + 1, node.RightChild };
-            const int numChildren = hitLeftChild + hitRightChild;
+            StackEntry sortedByT[2];
+            int numChildren = 0;
+
+            if (hitLeftChild)
+                sortedByT[numChildren++] = StackEntry{ .Node = currNode + 1, .T = distLowerBound(vLeftBox, leftT) };
+
+            if (hitRightChild)
+                sortedByT[numChildren++] = StackEntry{ .Node = node.RightChild, .T = distLowerBound(vRightBox, rightT) };
 
-            // Make sure subtree closer to camera is searched first
-            if (numChildren == 2 && leftT < rightT)
+            // Make sure subtree closer to camera is searched first. Stack is LIFO, so 
+            // the farther child is pushed first.
+            if (numChildren == 2 && sortedByT[0].T < sortedByT[1].T)
                 std::swap(sortedByT[0], sortedByT[1]);
 
             for (int c = 0; c < numChildren; c++)
             {
-                // No need to search this subtree as earlier hits are necessarily closer to camera
-                if(sortedByT[c] < minT)
+                if (sortedByT[c].T < minT)
                     stack[++currStackIdx] = sortedByT[c];
             }
         }
@@ -611,3 +1385,227 @@ uint64_t BVH::CastRay(Math::Ray& r)
     v_Ray vRay(r);
     return CastRay(vRay);
 }
+
+namespace
+{
+    ZetaInline bool IsCoherent(const Ray* rays, int n, float minCosAngle)
+    {
+        const float3 d0 = rays[0].Dir;
+        const float d0Len = d0.length();
+
+        for (int i = 1; i < n; i++)
+        {
+            const float3 d = rays[i].Dir;
+
+            if (((d.x >= 0.0f) != (d0.x >= 0.0f)) ||
+                ((d.y >= 0.0f) != (d0.y >= 0.0f)) ||
+                ((d.z >= 0.0f) != (d0.z >= 0.0f)))
+            {
+                return false;
+            }
+
+            if (d0.dot(d) < minCosAngle * d0Len * d.length())
+                return false;
+        }
+
+        return true;
+    }
+}
+
+template<int WIDTH>
+void BVH::CastPacket(const Ray* rays, uint64_t* hits)
+{
+    using L = SIMDLanes<WIDTH>;
+    using V = typename L::V;
+
+    alignas(32) float origin[3][WIDTH];
+    alignas(32) float dirRcp[3][WIDTH];
+    alignas(32) float minT[WIDTH];
+    alignas(32) float tEntry[WIDTH];
+    alignas(32) float tExit[WIDTH];
+
+    for (int i = 0; i < WIDTH; i++)
+    {
+        origin[0][i] = rays[i].Origin.x;
+        origin[1][i] = rays[i].Origin.y;
+        origin[2][i] = rays[i].Origin.z;
+        dirRcp[0][i] = 1.0f / rays[i].Dir.x;
+        dirRcp[1][i] = 1.0f / rays[i].Dir.y;
+        dirRcp[2][i] = 1.0f / rays[i].Dir.z;
+        minT[i] = FLT_MAX;
+        hits[i] = Scene::INVALID_INSTANCE;
+    }
+
+    const V vOrigX = L::Load(origin[0]);
+    const V vOrigY = L::Load(origin[1]);
+    const V vOrigZ = L::Load(origin[2]);
+    const V vRcpX = L::Load(dirRcp[0]);
+    const V vRcpY = L::Load(dirRcp[1]);
+    const V vRcpZ = L::Load(dirRcp[2]);
+    const V vZero = L::Zero();
+
+    // All the rays have the same direction signs, so the slab planes that are entered 
+    // first are the same for the whole packet
+    const float3 dir0 = rays[0].Dir;
+    const bool dirPosX = dir0.x >= 0.0f;
+    const bool dirPosY = dir0.y >= 0.0f;
+    const bool dirPosZ = dir0.z >= 0.0f;
+
+    // Returns mask of rays that hit the box before their closest hit so far
+    auto intersect = [&](const AABB& box, V& vEntry, V& vExit)
+        {
+            const float3 boxMin = box.Center - box.Extents;
+            const float3 boxMax = box.Center + box.Extents;
+
+            const V vNearX = L::Mul(L::Sub(L::Set1(dirPosX ? boxMin.x : boxMax.x), vOrigX), vRcpX);
+            const V vNearY = L::Mul(L::Sub(L::Set1(dirPosY ? boxMin.y : boxMax.y), vOrigY), vRcpY);
+            const V vNearZ = L::Mul(L::Sub(L::Set1(dirPosZ ? boxMin.z : boxMax.z), vOrigZ), vRcpZ);
+            const V vFarX = L::Mul(L::Sub(L::Set1(dirPosX ? boxMax.x : boxMin.x), vOrigX), vRcpX);
+            const V vFarY = L::Mul(L::Sub(L::Set1(dirPosY ? boxMax.y : boxMin.y), vOrigY), vRcpY);
+            const V vFarZ = L::Mul(L::Sub(L::Set1(dirPosZ ? boxMax.z : boxMin.z), vOrigZ), vRcpZ);
+
+            vEntry = L::Max(L::Max(vNearX, vNearY), vNearZ);
+            vExit = L::Min(L::Min(vFarX, vFarY), vFarZ);
+            const V vEntryClamped = L::Max(vEntry, vZero);
+
+            return L::GreaterEqual(vExit, vEntryClamped) & L::Less(vEntryClamped, L::Load(minT));
+        };
+
+    // Manual stack
+    constexpr int STACK_SIZE = 64;
+    int stack[STACK_SIZE];
+    int currStackIdx = 0;
+
+    // Insert root
+    stack[currStackIdx] = 0;
+
+    while (currStackIdx >= 0)
+    {
+        Assert(currStackIdx < STACK_SIZE, "Stack size exceeded maximum allowed.");
+
+        const int currNode = stack[currStackIdx--];
+        const Node& node = m_nodes[currNode];
+        V vEntry;
+        V vExit;
+
+        // Skip the subtree if none of the rays hit it
+        if (!intersect(node.BoundingBox, vEntry, vExit))
+            continue;
+
+        if (node.IsLeaf())
+        {
+            for (int i = node.Base; i < node.Base + node.Count; i++)
+            {
+                int hitMask = intersect(m_instances[i].BoundingBox, vEntry, vExit);
+                if (!hitMask)
+                    continue;
+
+                L::Store(tEntry, vEntry);
+                L::Store(tExit, vExit);
+
+                while (hitMask)
+                {
+                    const int r = _tzcnt_u32(hitMask);
+                    hitMask &= hitMask - 1;
+
+                    // Same as intersectRayVsAABB() -- when ray origin is inside the box, 
+                    // the exit point is reported
+                    const float t = tEntry[r] >= 0.0f ? tEntry[r] : tExit[r];
+
+                    if (t < minT[r])
+                    {
+                        minT[r] = t;
+                        hits[r] = m_instances[i].InstanceID;
+                    }
+                }
+            }
+        }
+        else
+        {
+            // Child whose center is farther along the (shared) ray direction is visited 
+            // last. Stack is LIFO, so it's pushed first.
+            const float3 d = m_nodes[node.RightChild].BoundingBox.Center - 
+                m_nodes[currNode + 1].BoundingBox.Center;
+            const bool leftIsCloser = d.dot(dir0) >= 0.0f;
+
+            stack[++currStackIdx] = leftIsCloser ? node.RightChild : currNode + 1;
+            stack[++currStackIdx] = leftIsCloser ? currNode + 1 : node.RightChild;
+        }
+    }
+}
+
+void BVH::CastRays(Span<Ray> rays, MutableSpan<uint64_t> hits, bool parallel)
+{
+    Assert(hits.size() >= rays.size(), "Output buffer is too small.");
+
+    if (m_nodes.empty())
+    {
+        for (size_t i = 0; i < rays.size(); i++)
+            hits[i] = Scene::INVALID_INSTANCE;
+
+        return;
+    }
+
+    auto castRange = [this, rays, hits](size_t begin, size_t end)
+        {
+            const Ray* r = rays.data();
+            uint64_t* h = hits.data();
+            size_t i = begin;
+
+            while (i < end)
+            {
+                if (end - i >= 8 && IsCoherent(r + i, 8, PACKET_MIN_COS_ANGLE))
+                {
+                    CastPacket<8>(r + i, h + i);
+                    i += 8;
+                }
+                else if (end - i >= 4 && IsCoherent(r + i, 4, PACKET_MIN_COS_ANGLE))
+                {
+                    CastPacket<4>(r + i, h + i);
+                    i += 4;
+                }
+                // Incoherent -- fall back to one ray at a time
+                else
+                {
+                    Ray ray = r[i];
+                    v_Ray vRay(ray);
+                    h[i] = CastRay(vRay);
+                    i++;
+                }
+            }
+        };
+
+    if (parallel && rays.size() >= MIN_NUM_RAYS_PARALLEL)
+        App::ParallelFor(0, rays.size(), NUM_RAYS_PER_PARALLEL_TASK, castRange);
+    else
+        castRange(0, rays.size());
+}
+
+float BVH::ComputeSAHSum()
+{
+    float sum = 0.0f;
+
+    for (uint32_t i = 0; i < m_numNodes; i++)
+    {
+        const Node& node = m_nodes[i];
+        const float area = AABBSurfaceArea(v_AABB(node.BoundingBox));
+        sum += node.IsLeaf() ? node.Count * area : area;
+    }
+
+    return sum;
+}
+
+float BVH::SAHCost()
+{
+    if (m_numNodes == 0)
+        return 0.0f;
+
+    const float rootArea = AABBSurfaceArea(v_AABB(m_nodes[0].BoundingBox));
+
+    return rootArea > 0.0f ? m_sahSum / rootArea : 0.0f;
+}
+
+float BVH::SAHGrowth()
+{
+    return m_builtSAHCost > 0.0f ? SAHCost() / m_builtSAHCost : 1.0f;
+}
@@ -13,8 +13,14 @@ namespace ZetaRay::Math
 {
     struct alignas(16) float4x4a;
 
+    template<int WIDTH>
+    class WideBVH;
+
     class BVH
     {
+        template<int WIDTH>
+        friend class WideBVH;
+
     public:
         struct alignas(16) BVHInput
         {
@@ -29,14 +35,38 @@ namespace ZetaRay::Math
             uint64_t InstanceID;
         };
 
+        enum class BUILD_METHOD
+        {
+            // Binned SAH along the longest axis of centroid bounds with NUM_SAH_BINS bins.
+            // Single-threaded.
+            LONGEST_AXIS,
+            // Binned SAH along all three axes with a configurable number of bins. Bin 
+            // assignment is vectorized and large subtrees are built on the worker threads.
+            ALL_AXES_PARALLEL
+        };
+
+        static constexpr uint32_t MIN_NUM_SAH_BINS = 4;
+        static constexpr uint32_t MAX_NUM_SAH_BINS = 32;
+        static constexpr uint32_t DEFAULT_NUM_SAH_BINS = 16;
+        // Once SAH cost of the refitted tree exceeds the cost right after the build by this 
+        // factor, a rebuild is started in the background
+        static constexpr float REBUILD_SAH_GROWTH_THRESHOLD = 1.5f;
+
         BVH();
-        ~BVH() = default;
+        ~BVH();
 
         BVH(BVH&&) = delete;
         BVH& operator=(BVH&&) = delete;
 
         bool IsBuilt() { return m_nodes.size() != 0; }
-        void Build(Util::Span<BVHInput> instances);
+        // Builds the BVH from scratch. Previous tree (if any) is discarded.
+        void Build(Util::Span<BVHInput> instances, 
+            BUILD_METHOD method = BUILD_METHOD::ALL_AXES_PARALLEL,
+            uint32_t numBins = DEFAULT_NUM_SAH_BINS);
+        // Updates the given instances and refits the affected nodes bottom-up. Cost is linear
+        // in the number of updated instances (times tree depth). When the SAH cost has grown 
+        // past REBUILD_SAH_GROWTH_THRESHOLD, a rebuild is started in the background and 
+        // swapped in during a later call once it's finished.
         void Update(Util::Span<BVHUpdateInput> instances);
         void Remove(uint64_t ID, const Math::AABB& AABB);
 
@@ -57,6 +87,30 @@ namespace ZetaRay::Math
         uint64_t CastRay(Math::Ray& r);
         uint64_t CastRay(Math::v_Ray& r);
 
+        // Casts a batch of rays and writes ID of the closest intersection of each ray to 
+        // the corresponding element of hits. Runs of consecutive rays with similar directions
+        // (e.g. neighboring camera pixels) are traversed together as 8- or 4-wide packets,
+        // the remaining rays one at a time. Large batches are split among worker threads
+        // when parallel is true.
+        void CastRays(Util::Span<Math::Ray> rays, Util::MutableSpan<uint64_t> hits, 
+            bool parallel = true);
+
+        // Returns the SAH cost of the tree, normalized by surface area of the root, with 
+        // traversal and intersection costs of 1. Lower is better.
+        float SAHCost();
+        // Ratio of current SAH cost to SAH cost right after the last build
+        float SAHGrowth();
+        bool IsRebuilding() { return m_rebuildJob != nullptr; }
+
+        // Snapshots the current instances and rebuilds the tree from them. Updates and 
+        // removals made in the meantime are logged and replayed on the new tree once it's 
+        // swapped in. With inBackground = true, build runs as a background task and the 
+        // swap happens in the first Update() after it's finished. Otherwise, build is 
+        // deferred until FinishRebuild() is called.
+        void StartRebuild(bool inBackground = true);
+        // Swaps in the rebuilt tree. Blocks until the background build (if any) is finished.
+        void FinishRebuild();
+
         // Returns AABB that contains the scene
         Math::AABB GetWorldAABB() 
         {
@@ -69,11 +123,16 @@ namespace ZetaRay::Math
         static constexpr uint32_t MAX_NUM_INSTANCES_PER_LEAF = 8;
         static constexpr uint32_t MIN_NUM_INSTANCES_SPLIT_SAH = 10;
         static constexpr uint32_t NUM_SAH_BINS = 6;
+        // Rays of a packet must have the same direction signs and the angle between 
+        // direction of the first ray and every other ray can't exceed acos() of this
+        static constexpr float PACKET_MIN_COS_ANGLE = 0.9f;
+        static constexpr size_t MIN_NUM_RAYS_PARALLEL = 1024;
+        static constexpr size_t NUM_RAYS_PER_PARALLEL_TASK = 256;
 
         struct alignas(64) Node
         {
             bool IsInitialized() { return Parent != -1; }
-            void InitAsLeaf(int base, int count, int parent);
+            void InitAsLeaf(Util::Span<BVH::BVHInput> instances, int base, int count, int parent);
             void InitAsInternal(Util::Span<BVH::BVHInput> instances, int base, int count,
                 int right, int parent);
             bool IsLeaf() const { return RightChild == -1; }
@@ -103,11 +162,34 @@ namespace ZetaRay::Math
             int RightChild;
 
             int Parent = -1;
+
+            // Used during refit to visit every node once
+            bool Dirty = false;
         };
 
+        // Builder for BUILD_METHOD::ALL_AXES_PARALLEL
+        struct BinnedSAHBuilder;
+        // State of a background rebuild
+        struct RebuildJob;
+
+        void BuildInternal(Util::Span<BVHInput> instances, BUILD_METHOD method, 
+            uint32_t numBins, bool parallel);
+        // Recomputes bounds of the given leaves and their ancestors. Every node is 
+        // refit at most once.
+        void Refit(Util::Span<int> dirtyLeaves);
+        // Sum of surface areas of internal nodes plus leaf surface areas times 
+        // number of instances in them
+        float ComputeSAHSum();
+        // Blocks until the background rebuild (if any) is finished and discards it
+        void CancelRebuild();
+
         // Recursively builds a BVH (subtree) for the given range
         int BuildSubtree(int base, int count, int parent);
 
+        // Traverses the tree once for WIDTH rays that share direction signs
+        template<int WIDTH>
+        void CastPacket(const Math::Ray* rays, uint64_t* hits);
+
         // Finds the leaf node that contains the given instance. Returns -1 otherwise.
         int Find(uint64_t instanceID, const Math::AABB& AABB, int& modelIdx);
 
@@ -120,5 +202,13 @@ namespace ZetaRay::Math
         Util::SmallVector<BVHInput, Support::ArenaAllocator> m_instances;
 
         uint32_t m_numNodes = 0;
+
+        // Unnormalized SAH cost (see ComputeSAHSum()), kept up to date during refit
+        float m_sahSum = 0.0f;
+        float m_builtSAHCost = 0.0f;
+        BUILD_METHOD m_buildMethod = BUILD_METHOD::ALL_AXES_PARALLEL;
+        uint32_t m_numBins = DEFAULT_NUM_SAH_BINS;
+
+        RebuildJob* m_rebuildJob = nullptr;
     };
 }
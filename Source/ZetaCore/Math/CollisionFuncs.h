@@ -26,6 +26,7 @@ namespace ZetaRay::Math
         __m128 vPos = _mm_loadu_ps(reinterpret_cast<float*>(currPos));
         __m128 vMin = vPos;
         __m128 vMax = vPos;
+        dataPtr += vtxStride;
 
         for (int i = 1; i < (int)numVertices; i++)
         {
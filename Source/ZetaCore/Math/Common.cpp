@@ -77,7 +77,7 @@ float Math::KahanSum(Span<float> data)
 
     // align to 32-byte boundary
     const float* curr = data.data();
-    while ((reinterpret_cast<uintptr_t>(curr) & 31) != 0)
+    while ((reinterpret_cast<uintptr_t>(curr) & 31) != 0 && curr != data.data() + N)
     {
         float corrected = *curr - compensation;
         float newSum = sum + corrected;
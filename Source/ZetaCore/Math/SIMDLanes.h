@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Vector.h"
+
+namespace ZetaRay::Math
+{
+    // Maps WIDTH to the matching SIMD register type so that kernels can be written once 
+    // for both SSE (4 lanes) and AVX (8 lanes). Comparisons return a bitmask of lanes.
+    template<int WIDTH>
+    struct SIMDLanes;
+
+    template<>
+    struct SIMDLanes<4>
+    {
+        using V = __m128;
+        static constexpr int ALL = 0xf;
+
+        static ZetaInline V Load(const float* p) { return _mm_load_ps(p); }
+        static ZetaInline void Store(float* p, V v) { _mm_store_ps(p, v); }
+        static ZetaInline V Set1(float f) { return _mm_set1_ps(f); }
+        static ZetaInline V Zero() { return _mm_setzero_ps(); }
+        static ZetaInline V __vectorcall Sub(V a, V b) { return _mm_sub_ps(a, b); }
+        static ZetaInline V __vectorcall Mul(V a, V b) { return _mm_mul_ps(a, b); }
+        static ZetaInline V __vectorcall Fmadd(V a, V b, V c) { return _mm_fmadd_ps(a, b, c); }
+        static ZetaInline V __vectorcall Min(V a, V b) { return _mm_min_ps(a, b); }
+        static ZetaInline V __vectorcall Max(V a, V b) { return _mm_max_ps(a, b); }
+        // Returns bitmask of lanes where a >= b
+        static ZetaInline int __vectorcall GreaterEqual(V a, V b) { return _mm_movemask_ps(_mm_cmpge_ps(a, b)); }
+        // Returns bitmask of lanes where a < b
+        static ZetaInline int __vectorcall Less(V a, V b) { return _mm_movemask_ps(_mm_cmplt_ps(a, b)); }
+    };
+
+    template<>
+    struct SIMDLanes<8>
+    {
+        using V = __m256;
+        static constexpr int ALL = 0xff;
+
+        static ZetaInline V Load(const float* p) { return _mm256_load_ps(p); }
+        static ZetaInline void Store(float* p, V v) { _mm256_store_ps(p, v); }
+        static ZetaInline V Set1(float f) { return _mm256_set1_ps(f); }
+        static ZetaInline V Zero() { return _mm256_setzero_ps(); }
+        static ZetaInline V __vectorcall Sub(V a, V b) { return _mm256_sub_ps(a, b); }
+        static ZetaInline V __vectorcall Mul(V a, V b) { return _mm256_mul_ps(a, b); }
+        static ZetaInline V __vectorcall Fmadd(V a, V b, V c) { return _mm256_fmadd_ps(a, b, c); }
+        static ZetaInline V __vectorcall Min(V a, V b) { return _mm256_min_ps(a, b); }
+        static ZetaInline V __vectorcall Max(V a, V b) { return _mm256_max_ps(a, b); }
+        static ZetaInline int __vectorcall GreaterEqual(V a, V b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GE_OQ)); }
+        static ZetaInline int __vectorcall Less(V a, V b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LT_OQ)); }
+    };
+}
@@ -1,11 +1,50 @@
 #include "Sampling.h"
+#include <App/App.h>
 #include <Utility/RNG.h>
+#include <algorithm>
 #include <cmath>
 
 using namespace ZetaRay;
 using namespace ZetaRay::Util;
 using namespace ZetaRay::Math;
 
+namespace
+{
+    static constexpr size_t ALIAS_TABLE_BLOCK_SIZE = 16 * 1024;
+
+    struct AliasTableBlock
+    {
+        double Sum;
+        // Offset of block's first light/heavy item in the light/heavy arrays
+        uint32_t LightBase;
+        uint32_t HeavyBase;
+        // Total deficit (1 - p) of light items and excess (p - 1) of heavy items before 
+        // this block
+        double DeficitBase;
+        double ExcessBase;
+    };
+
+    // Calls fn(blockIdx, begin, end) for every block of [0, n)
+    template<typename F>
+    void ForEachBlock(size_t n, bool useWorkers, F&& fn)
+    {
+        if (n == 0)
+            return;
+
+        const size_t numBlocks = CeilUnsignedIntDiv(n, ALIAS_TABLE_BLOCK_SIZE);
+        auto processRange = [n, &fn](size_t begin, size_t end)
+            {
+                for (size_t b = begin; b < end; b++)
+                    fn(b, b * ALIAS_TABLE_BLOCK_SIZE, Math::Min((b + 1) * ALIAS_TABLE_BLOCK_SIZE, n));
+            };
+
+        if (useWorkers && numBlocks > 1)
+            App::ParallelFor(0, numBlocks, 1, processRange);
+        else
+            processRange(0, numBlocks);
+    }
+}
+
 //--------------------------------------------------------------------------------------
 // Sampling
 //--------------------------------------------------------------------------------------
@@ -22,7 +61,7 @@ void Math::AliasTable_Normalize(MutableSpan<float> weights)
 
     // Align to 32 bytes
     float* curr = weights.data();
-    while ((reinterpret_cast<uintptr_t>(curr) & 31) != 0)
+    while ((reinterpret_cast<uintptr_t>(curr) & 31) != 0 && curr != weights.data() + N)
     {
         *curr *= sumRcp;
         curr++;
@@ -142,6 +181,190 @@ void Math::AliasTable_Build(MutableSpan<float> probs, MutableSpan<AliasTableEntr
     Assert(numInsertions == N, "Some elements were not inserted.");
 }
 
+// Same outcome as the "sweeping" construction, where light items are visited in index order
+// and filled from heavy items, also in index order. Laying out the deficits (1 - p) of light 
+// items and excesses (p - 1) of heavy items on two number lines, with D[k] and E[j] denoting
+// the inclusive prefix sums, the sweep does the following:
+//  - Light item k is paired with the first heavy item j that had excess left when k was 
+//    visited, i.e. the first j with E[j] >= D[k - 1].
+//  - Heavy item j runs out of excess once the first light item k with D[k] > E[j] is paired 
+//    with it. What remains (1 - (D[k] - E[j])) becomes its own probability and the next heavy
+//    item (which now covers the overdrawn part) becomes its alias.
+// Both are independent of the other items once the prefix sums are known.
+void Math::AliasTable_BuildPartitioned(Span<float> weights, MutableSpan<AliasTableEntry> table, 
+    bool useWorkers)
+{
+    const size_t N = weights.size();
+    Assert(N > 0 && N < UINT32_MAX, "Invalid number of weights.");
+    Assert(table.size() >= N, "Table is too small.");
+
+    const size_t numBlocks = CeilUnsignedIntDiv(N, ALIAS_TABLE_BLOCK_SIZE);
+    SmallVector<AliasTableBlock> blocks;
+    blocks.resize(numBlocks);
+
+    ForEachBlock(N, useWorkers, [&weights, &blocks](size_t b, size_t begin, size_t end)
+        {
+            double sum = 0.0;
+
+            for (size_t i = begin; i < end; i++)
+                sum += weights[i];
+
+            blocks[b].Sum = sum;
+        });
+
+    double sum = 0.0;
+
+    for (auto& block : blocks)
+        sum += block.Sum;
+
+    Assert(sum > 0.0 && !IsNaN((float)sum), "Invalid sum of weights.");
+
+    // Normalized so that mean becomes 1. P_Curr temporarily holds the normalized weight.
+    const double scale = N / sum;
+    const double rcpSum = 1.0 / sum;
+
+    ForEachBlock(N, useWorkers, [&weights, &table, &blocks, scale, rcpSum](size_t b, size_t begin, size_t end)
+        {
+            uint32_t numLight = 0;
+            double deficit = 0.0;
+            double excess = 0.0;
+
+            for (size_t i = begin; i < end; i++)
+            {
+                const float p = (float)(weights[i] * scale);
+                table[i].P_Curr = p;
+                table[i].P_Orig = (float)(weights[i] * rcpSum);
+
+                if (p < 1.0f)
+                {
+                    numLight++;
+                    deficit += 1.0 - p;
+                }
+                else
+                    excess += p - 1.0;
+            }
+
+            // Stored as counts and totals for now, converted to prefix sums below
+            blocks[b].LightBase = numLight;
+            blocks[b].HeavyBase = (uint32_t)(end - begin) - numLight;
+            blocks[b].DeficitBase = deficit;
+            blocks[b].ExcessBase = excess;
+        });
+
+    uint32_t numLight = 0;
+    uint32_t numHeavy = 0;
+    double deficit = 0.0;
+    double excess = 0.0;
+
+    for (auto& block : blocks)
+    {
+        const uint32_t blockNumLight = block.LightBase;
+        const uint32_t blockNumHeavy = block.HeavyBase;
+        const double blockDeficit = block.DeficitBase;
+        const double blockExcess = block.ExcessBase;
+
+        block.LightBase = numLight;
+        block.HeavyBase = numHeavy;
+        block.DeficitBase = deficit;
+        block.ExcessBase = excess;
+
+        numLight += blockNumLight;
+        numHeavy += blockNumHeavy;
+        deficit += blockDeficit;
+        excess += blockExcess;
+    }
+
+    // Partition into light and heavy items (preserving order) along with their prefix sums
+    SmallVector<uint32_t> lights;
+    SmallVector<uint32_t> heavies;
+    SmallVector<double> D;
+    SmallVector<double> E;
+    lights.resize(numLight);
+    heavies.resize(numHeavy);
+    D.resize(numLight);
+    E.resize(numHeavy);
+
+    ForEachBlock(N, useWorkers, [&table, &blocks, &lights, &heavies, &D, &E](size_t b, size_t begin, size_t end)
+        {
+            uint32_t currLight = blocks[b].LightBase;
+            uint32_t currHeavy = blocks[b].HeavyBase;
+            double deficit = blocks[b].DeficitBase;
+            double excess = blocks[b].ExcessBase;
+
+            for (size_t i = begin; i < end; i++)
+            {
+                const float p = table[i].P_Curr;
+
+                if (p < 1.0f)
+                {
+                    deficit += 1.0 - p;
+                    lights[currLight] = (uint32_t)i;
+                    D[currLight++] = deficit;
+                }
+                else
+                {
+                    excess += p - 1.0;
+                    heavies[currHeavy] = (uint32_t)i;
+                    E[currHeavy++] = excess;
+                }
+            }
+        });
+
+    // Light items keep their probability. Due to round-off, there might not be any heavy 
+    // item left for the last few, which then become their own alias (same as AliasTable_Build()).
+    ForEachBlock(numLight, useWorkers, [&table, &lights, &heavies, &D, &E](size_t b, size_t begin, size_t end)
+        {
+            const double* firstE = E.begin();
+            const double* lastE = E.end();
+            const double* currE = std::lower_bound(firstE, lastE, begin ? D[begin - 1] : 0.0);
+
+            for (size_t k = begin; k < end; k++)
+            {
+                const double prevD = k ? D[k - 1] : 0.0;
+
+                while (currE != lastE && *currE < prevD)
+                    currE++;
+
+                AliasTableEntry& e = table[lights[k]];
+
+                if (currE != lastE)
+                    e.Alias = heavies[currE - firstE];
+                else
+                {
+                    e.Alias = lights[k];
+                    e.P_Curr = 1.0f;
+                }
+            }
+        });
+
+    ForEachBlock(numHeavy, useWorkers, [&table, &heavies, &D, &E, numHeavy](size_t b, size_t begin, size_t end)
+        {
+            const double* firstD = D.begin();
+            const double* lastD = D.end();
+            const double* currD = std::upper_bound(firstD, lastD, E[begin]);
+
+            for (size_t j = begin; j < end; j++)
+            {
+                while (currD != lastD && *currD <= E[j])
+                    currD++;
+
+                AliasTableEntry& e = table[heavies[j]];
+
+                // Never ran out of excess
+                if (currD == lastD || j == numHeavy - 1)
+                {
+                    e.Alias = heavies[j];
+                    e.P_Curr = 1.0f;
+                }
+                else
+                {
+                    e.Alias = heavies[j + 1];
+                    e.P_Curr = (float)(1.0 - (*currD - E[j]));
+                }
+            }
+        });
+}
+
 uint32_t Math::SampleAliasTable(Span<AliasTableEntry> table, RNG& rng, float& pdf)
 {
     uint32_t idx = rng.UniformUintBounded((uint32_t)table.size());
@@ -29,6 +29,13 @@ namespace ZetaRay::Math
     void AliasTable_Normalize(Util::MutableSpan<float> weights);
     // Generates an alias table for the given distribution.
     void AliasTable_Build(Util::MutableSpan<float> weights, Util::MutableSpan<AliasTableEntry> table);
+    // Generates an alias table with the same distribution as AliasTable_Build(), but without 
+    // the serial worklists, so that work can be split into independent blocks. Light (p < 1) 
+    // and heavy (p >= 1) items are partitioned using prefix sums, after which every item finds
+    // its alias with a binary search. Blocks are processed on the worker threads unless 
+    // "useWorkers" is false. Weights aren't modified.
+    void AliasTable_BuildPartitioned(Util::Span<float> weights, Util::MutableSpan<AliasTableEntry> table,
+        bool useWorkers = true);
     // Draws sample from the given alias table
     uint32_t SampleAliasTable(Util::Span<AliasTableEntry> table, Util::RNG& rng, float& pdf);
 }
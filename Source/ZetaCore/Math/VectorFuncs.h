@@ -279,6 +279,105 @@ namespace ZetaRay::Math
         return Result;
     }
 
+    // 8-wide version of acos() above
+    ZetaInline __m256 __vectorcall acos(const __m256 V)
+    {
+        const __m256 nonnegative = _mm256_cmp_ps(V, _mm256_setzero_ps(), _CMP_GE_OQ);
+        const __m256 x = abs(V);
+
+        // Compute (1-|V|), clamp to zero to avoid sqrt of negative number.
+        const __m256 oneMValue = _mm256_sub_ps(_mm256_set1_ps(1.0f), x);
+        const __m256 root = _mm256_sqrt_ps(_mm256_max_ps(_mm256_setzero_ps(), oneMValue));
+
+        // Compute polynomial approximation
+        __m256 t0 = _mm256_set1_ps(-0.0012624911f);
+        t0 = _mm256_fmadd_ps(t0, x, _mm256_set1_ps(0.0066700901f));
+        t0 = _mm256_fmadd_ps(t0, x, _mm256_set1_ps(-0.0170881256f));
+        t0 = _mm256_fmadd_ps(t0, x, _mm256_set1_ps(0.0308918810f));
+        t0 = _mm256_fmadd_ps(t0, x, _mm256_set1_ps(-0.0501743046f));
+        t0 = _mm256_fmadd_ps(t0, x, _mm256_set1_ps(0.0889789874f));
+        t0 = _mm256_fmadd_ps(t0, x, _mm256_set1_ps(-0.2145988016f));
+        t0 = _mm256_fmadd_ps(t0, x, _mm256_set1_ps(1.5707963050f));
+        t0 = _mm256_mul_ps(t0, root);
+
+        const __m256 t1 = _mm256_sub_ps(_mm256_set1_ps(PI), t0);
+
+        return _mm256_blendv_ps(t1, t0, nonnegative);
+    }
+
+    // 8-wide version of sin() above. vTheta must be in -XM_PI <= theta < XM_PI
+    ZetaInline __m256 __vectorcall sin(__m256 vTheta)
+    {
+        // Map in [-pi/2,pi/2] with sin(y) = sin(x).
+        const __m256 sign = _mm256_and_ps(vTheta, _mm256_set1_ps(-0.0f));
+        const __m256 c = _mm256_or_ps(_mm256_set1_ps(PI), sign);  // pi when x >= 0, -pi when x < 0
+        const __m256 absx = _mm256_andnot_ps(sign, vTheta);  // |x|
+        const __m256 rflx = _mm256_sub_ps(c, vTheta);
+        const __m256 comp = _mm256_cmp_ps(absx, _mm256_set1_ps(PI_OVER_2), _CMP_LE_OQ);
+        vTheta = _mm256_blendv_ps(rflx, vTheta, comp);
+
+        const __m256 x2 = _mm256_mul_ps(vTheta, vTheta);
+
+        // Compute polynomial approximation
+        __m256 result = _mm256_set1_ps(-2.3889859e-08f);
+        result = _mm256_fmadd_ps(result, x2, _mm256_set1_ps(2.7525562e-06f));
+        result = _mm256_fmadd_ps(result, x2, _mm256_set1_ps(-0.00019840874f));
+        result = _mm256_fmadd_ps(result, x2, _mm256_set1_ps(0.0083333310f));
+        result = _mm256_fmadd_ps(result, x2, _mm256_set1_ps(-0.16666667f));
+        result = _mm256_fmadd_ps(result, x2, _mm256_set1_ps(1.0f));
+
+        return _mm256_mul_ps(result, vTheta);
+    }
+
+    // 8-wide SoA version of encode_octahedral() above. Follows the same order of operations
+    // so that results match.
+    ZetaInline void __vectorcall encode_octahedral(const __m256 vX, const __m256 vY, const __m256 vZ,
+        __m256& vU, __m256& vV)
+    {
+        // Same as hadd_float3()
+        const __m256 vSum = _mm256_add_ps(_mm256_add_ps(abs(vX), abs(vZ)), abs(vY));
+        const __m256 vEncodedPosZ_X = _mm256_div_ps(vX, vSum);
+        const __m256 vEncodedPosZ_Y = _mm256_div_ps(vY, vSum);
+
+        const __m256 vOne = _mm256_set1_ps(1.0f);
+        const __m256 vOneNeg = _mm256_set1_ps(-1.0f);
+        const __m256 vZero = _mm256_setzero_ps();
+        const __m256 vSignX = _mm256_blendv_ps(vOneNeg, vOne, _mm256_cmp_ps(vX, vZero, _CMP_GE_OS));
+        const __m256 vSignY = _mm256_blendv_ps(vOneNeg, vOne, _mm256_cmp_ps(vY, vZero, _CMP_GE_OS));
+
+        // v.z <= 0.0 ? 1.0 - abs(v.yx) * SignNotZero(v) : v
+        const __m256 vEncodedNegZ_X = _mm256_mul_ps(_mm256_sub_ps(vOne, abs(vEncodedPosZ_Y)), vSignX);
+        const __m256 vEncodedNegZ_Y = _mm256_mul_ps(_mm256_sub_ps(vOne, abs(vEncodedPosZ_X)), vSignY);
+        const __m256 vZLe0 = _mm256_cmp_ps(vZ, vZero, _CMP_LE_OS);
+
+        vU = _mm256_blendv_ps(vEncodedPosZ_X, vEncodedNegZ_X, vZLe0);
+        vV = _mm256_blendv_ps(vEncodedPosZ_Y, vEncodedNegZ_Y, vZLe0);
+    }
+
+    // 8-wide SoA version of decode_octahedral() above
+    ZetaInline void __vectorcall decode_octahedral(const __m256 vU, const __m256 vV,
+        __m256& vX, __m256& vY, __m256& vZ)
+    {
+        const __m256 vOne = _mm256_set1_ps(1.0f);
+        const __m256 vZero = _mm256_setzero_ps();
+        const __m256 vMinusZero = _mm256_set1_ps(-0.0f);
+
+        vZ = _mm256_sub_ps(vOne, _mm256_add_ps(abs(vU), abs(vV)));
+
+        const __m256 vPosT = _mm256_min_ps(_mm256_max_ps(_mm256_xor_ps(vMinusZero, vZ), vZero), vOne);
+        const __m256 vNegT = _mm256_xor_ps(vMinusZero, vPosT);
+        vX = _mm256_add_ps(vU, _mm256_blendv_ps(vPosT, vNegT, _mm256_cmp_ps(vU, vZero, _CMP_GE_OS)));
+        vY = _mm256_add_ps(vV, _mm256_blendv_ps(vPosT, vNegT, _mm256_cmp_ps(vV, vZero, _CMP_GE_OS)));
+
+        // Same as normalize()
+        const __m256 vNorm2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vX, vX), _mm256_mul_ps(vY, vY)),
+            _mm256_mul_ps(vZ, vZ));
+        const __m256 vNorm = _mm256_sqrt_ps(vNorm2);
+        vX = _mm256_div_ps(vX, vNorm);
+        vY = _mm256_div_ps(vY, vNorm);
+        vZ = _mm256_div_ps(vZ, vNorm);
+    }
+
     ZetaInline float4a __vectorcall store(__m128 v)
     {
         float4a f;
@@ -0,0 +1,415 @@
+#include "WideBVH.h"
+#include "SIMDLanes.h"
+#include "../Math/CollisionFuncs.h"
+#include "../Utility/Error.h"
+#include "../Scene/SceneCommon.h"
+
+using namespace ZetaRay::Util;
+using namespace ZetaRay::Math;
+
+//--------------------------------------------------------------------------------------
+// WideBVH
+//--------------------------------------------------------------------------------------
+
+template<int WIDTH>
+struct WideBVH<WIDTH>::Item
+{
+    enum class TYPE
+    {
+        // Internal node of the binary BVH
+        NODE,
+        // Range of instances -- either a binary leaf or part of one
+        RANGE,
+        INSTANCE
+    };
+
+    TYPE Type;
+    // Node index for NODE, first instance for RANGE and INSTANCE
+    int Idx;
+    int Count;
+    AABB Box;
+    float Area;
+};
+
+template<int WIDTH>
+int WideBVH<WIDTH>::Collapse(const BVH& bvh, const Item& item)
+{
+    auto makeInstanceItem = [&bvh](int i)
+        {
+            const AABB& box = bvh.m_instances[i].BoundingBox;
+            return Item{ .Type = Item::TYPE::INSTANCE, .Idx = i, .Count = 1, .Box = box,
+                .Area = AABBSurfaceArea(v_AABB(box)) };
+        };
+
+    auto makeRangeItem = [&bvh, &makeInstanceItem](int base, int count)
+        {
+            if (count == 1)
+                return makeInstanceItem(base);
+
+            v_AABB vBox(bvh.m_instances[base].BoundingBox);
+            for (int i = base + 1; i < base + count; i++)
+                vBox = unionAABB(vBox, v_AABB(bvh.m_instances[i].BoundingBox));
+
+            return Item{ .Type = Item::TYPE::RANGE, .Idx = base, .Count = count, .Box = store(vBox),
+                .Area = AABBSurfaceArea(vBox) };
+        };
+
+    Item children[WIDTH];
+    int numChildren = 0;
+
+    // Replaces given item with its children. Caller makes sure they fit.
+    auto expand = [&](const Item& e)
+        {
+            if (e.Type == Item::TYPE::NODE)
+            {
+                const BVH::Node& node = bvh.m_nodes[e.Idx];
+
+                for (int c : { e.Idx + 1, node.RightChild })
+                {
+                    const BVH::Node& child = bvh.m_nodes[c];
+
+                    if (!child.IsLeaf())
+                    {
+                        children[numChildren++] = Item{ .Type = Item::TYPE::NODE, .Idx = c, .Count = 0,
+                            .Box = child.BoundingBox, .Area = AABBSurfaceArea(v_AABB(child.BoundingBox)) };
+                    }
+                    // Leaves emptied by removals are dropped
+                    else if (child.Count > 0)
+                        children[numChildren++] = makeRangeItem(child.Base, child.Count);
+                }
+            }
+            else
+            {
+                Assert(e.Type == Item::TYPE::RANGE, "Instances can't be expanded.");
+
+                if (numChildren + e.Count <= WIDTH)
+                {
+                    for (int i = e.Idx; i < e.Idx + e.Count; i++)
+                        children[numChildren++] = makeInstanceItem(i);
+                }
+                // Doesn't fit -- split into groups that form the next level
+                else
+                {
+                    const int numGroups = WIDTH - numChildren;
+                    const int groupSize = (e.Count + numGroups - 1) / numGroups;
+
+                    for (int base = e.Idx; base < e.Idx + e.Count; base += groupSize)
+                        children[numChildren++] = makeRangeItem(base, Math::Min(groupSize, e.Idx + e.Count - base));
+                }
+            }
+        };
+
+    expand(item);
+
+    // Greedily pull up grandchildren, largest surface area first, as long as they fit
+    while (true)
+    {
+        int best = -1;
+        float bestArea = -1.0f;
+
+        for (int c = 0; c < numChildren; c++)
+        {
+            const int growth = children[c].Type == Item::TYPE::NODE ? 1 :
+                (children[c].Type == Item::TYPE::RANGE ? children[c].Count - 1 : WIDTH);
+
+            if (numChildren + growth <= WIDTH && children[c].Area > bestArea)
+            {
+                best = c;
+                bestArea = children[c].Area;
+            }
+        }
+
+        if (best == -1)
+            break;
+
+        const Item e = children[best];
+        children[best] = children[--numChildren];
+        expand(e);
+    }
+
+    const int nodeIdx = (int)m_nodes.size();
+    m_nodes.emplace_back();
+
+    int32_t childIndices[WIDTH];
+
+    for (int c = 0; c < numChildren; c++)
+    {
+        childIndices[c] = children[c].Type == Item::TYPE::INSTANCE ?
+            ~children[c].Idx :
+            Collapse(bvh, children[c]);
+    }
+
+    // m_nodes may have been reallocated during recursion
+    Node& node = m_nodes[nodeIdx];
+
+    for (int c = 0; c < WIDTH; c++)
+    {
+        if (c < numChildren)
+        {
+            const float3 c0 = children[c].Box.Center - children[c].Box.Extents;
+            const float3 c1 = children[c].Box.Center + children[c].Box.Extents;
+
+            node.MinX[c] = c0.x;
+            node.MinY[c] = c0.y;
+            node.MinZ[c] = c0.z;
+            node.MaxX[c] = c1.x;
+            node.MaxY[c] = c1.y;
+            node.MaxZ[c] = c1.z;
+            node.Children[c] = childIndices[c];
+        }
+        else
+        {
+            node.MinX[c] = FLT_MAX;
+            node.MinY[c] = FLT_MAX;
+            node.MinZ[c] = FLT_MAX;
+            node.MaxX[c] = -FLT_MAX;
+            node.MaxY[c] = -FLT_MAX;
+            node.MaxZ[c] = -FLT_MAX;
+            node.Children[c] = EMPTY_SLOT;
+        }
+    }
+
+    return nodeIdx;
+}
+
+template<int WIDTH>
+void WideBVH<WIDTH>::Build(const BVH& bvh)
+{
+    Assert(bvh.m_numNodes > 0, "BVH hasn't been built yet.");
+
+    m_nodes.free_memory();
+    m_instanceIDs.resize(bvh.m_instances.size());
+
+    for (size_t i = 0; i < bvh.m_instances.size(); i++)
+        m_instanceIDs[i] = bvh.m_instances[i].InstanceID;
+
+    // Roughly one wide node per (WIDTH - 1) binary internal nodes
+    m_nodes.reserve(bvh.m_numNodes / (WIDTH - 1) + 1);
+
+    const BVH::Node& root = bvh.m_nodes[0];
+    const Item rootItem{ .Type = root.IsLeaf() ? Item::TYPE::RANGE : Item::TYPE::NODE,
+        .Idx = root.IsLeaf() ? root.Base : 0,
+        .Count = root.IsLeaf() ? root.Count : 0,
+        .Box = root.BoundingBox,
+        .Area = 0.0f };
+
+    Collapse(bvh, rootItem);
+}
+
+template<int WIDTH>
+void WideBVH<WIDTH>::DoFrustumCulling(const Math::ViewFrustum& viewFrustum,
+    const Math::float4x4a& viewToWorld,
+    Vector<uint64_t, App::FrameAllocator>& visibleInstanceIDs)
+{
+    using L = SIMDLanes<WIDTH>;
+    using V = typename L::V;
+
+    if (m_nodes.empty())
+        return;
+
+    // Transform view frustum from view space into world space
+    v_float4x4 vM = load4x4(const_cast<float4x4a&>(viewToWorld));
+    v_ViewFrustum vFrustum(const_cast<ViewFrustum&>(viewFrustum));
+    vFrustum = Math::transform(vM, vFrustum);
+
+    alignas(32) float N_x[8];
+    alignas(32) float N_y[8];
+    alignas(32) float N_z[8];
+    alignas(32) float d[8];
+    _mm256_store_ps(N_x, vFrustum.vN_x);
+    _mm256_store_ps(N_y, vFrustum.vN_y);
+    _mm256_store_ps(N_z, vFrustum.vN_z);
+    _mm256_store_ps(d, vFrustum.vd);
+
+    // Box is outside if its farthest corner along the plane normal is behind the plane.
+    // Which corner that is only depends on signs of the normal, so it's picked once per
+    // plane by choosing between min & max arrays.
+    constexpr int NUM_PLANES = 6;
+    V vN_x[NUM_PLANES];
+    V vN_y[NUM_PLANES];
+    V vN_z[NUM_PLANES];
+    V vD[NUM_PLANES];
+    bool useMaxX[NUM_PLANES];
+    bool useMaxY[NUM_PLANES];
+    bool useMaxZ[NUM_PLANES];
+
+    for (int p = 0; p < NUM_PLANES; p++)
+    {
+        vN_x[p] = L::Set1(N_x[p]);
+        vN_y[p] = L::Set1(N_y[p]);
+        vN_z[p] = L::Set1(N_z[p]);
+        vD[p] = L::Set1(d[p]);
+        useMaxX[p] = N_x[p] >= 0.0f;
+        useMaxY[p] = N_y[p] >= 0.0f;
+        useMaxZ[p] = N_z[p] >= 0.0f;
+    }
+
+    const V vZero = L::Zero();
+
+    // Manual stack
+    constexpr int STACK_SIZE = 32 * WIDTH;
+    int stack[STACK_SIZE];
+    int currStackIdx = 0;
+
+    // Insert root
+    stack[currStackIdx] = 0;
+
+    while (currStackIdx >= 0)
+    {
+        const Node& node = m_nodes[stack[currStackIdx--]];
+        int overlapMask = L::ALL;
+
+        for (int p = 0; p < NUM_PLANES && overlapMask; p++)
+        {
+            const V vX = L::Load(useMaxX[p] ? node.MaxX : node.MinX);
+            const V vY = L::Load(useMaxY[p] ? node.MaxY : node.MinY);
+            const V vZ = L::Load(useMaxZ[p] ? node.MaxZ : node.MinZ);
+
+            V vDist = L::Fmadd(vN_x[p], vX, vD[p]);
+            vDist = L::Fmadd(vN_y[p], vY, vDist);
+            vDist = L::Fmadd(vN_z[p], vZ, vDist);
+
+            overlapMask &= L::GreaterEqual(vDist, vZero);
+        }
+
+        while (overlapMask)
+        {
+            const int c = _tzcnt_u32(overlapMask);
+            overlapMask &= overlapMask - 1;
+            const int32_t child = node.Children[c];
+
+            if (child >= 0)
+            {
+                Assert(currStackIdx + 1 < STACK_SIZE, "Stack size exceeded maximum allowed.");
+                stack[++currStackIdx] = child;
+            }
+            else
+                visibleInstanceIDs.push_back(m_instanceIDs[~child]);
+        }
+    }
+}
+
+template<int WIDTH>
+uint64_t WideBVH<WIDTH>::CastRay(Math::Ray& r)
+{
+    using L = SIMDLanes<WIDTH>;
+    using V = typename L::V;
+
+    if (m_nodes.empty())
+        return Scene::INVALID_INSTANCE;
+
+    const V vOrigX = L::Set1(r.Origin.x);
+    const V vOrigY = L::Set1(r.Origin.y);
+    const V vOrigZ = L::Set1(r.Origin.z);
+    const V vRcpX = L::Set1(1.0f / r.Dir.x);
+    const V vRcpY = L::Set1(1.0f / r.Dir.y);
+    const V vRcpZ = L::Set1(1.0f / r.Dir.z);
+    const V vZero = L::Zero();
+
+    // Slab planes that the ray enters first only depend on sign of ray direction. This
+    // also makes empty slots (min > max) fail the test as entry ends up after exit.
+    const bool dirPosX = r.Dir.x >= 0.0f;
+    const bool dirPosY = r.Dir.y >= 0.0f;
+    const bool dirPosZ = r.Dir.z >= 0.0f;
+
+    struct Entry
+    {
+        int Node;
+        // Distance to (clamped) entry point of the node
+        float T;
+    };
+
+    // Manual stack
+    constexpr int STACK_SIZE = 32 * WIDTH;
+    Entry stack[STACK_SIZE];
+    int currStackIdx = 0;
+
+    // Insert root
+    stack[currStackIdx] = Entry{ .Node = 0, .T = 0.0f };
+    float minT = FLT_MAX;
+    uint64_t closestID = Scene::INVALID_INSTANCE;
+
+    alignas(32) float tEntry[WIDTH];
+    alignas(32) float tExit[WIDTH];
+
+    while (currStackIdx >= 0)
+    {
+        const Entry curr = stack[currStackIdx--];
+
+        // An earlier hit is closer than anything in this subtree
+        if (curr.T >= minT)
+            continue;
+
+        const Node& node = m_nodes[curr.Node];
+
+        const V vNearX = L::Mul(L::Sub(L::Load(dirPosX ? node.MinX : node.MaxX), vOrigX), vRcpX);
+        const V vNearY = L::Mul(L::Sub(L::Load(dirPosY ? node.MinY : node.MaxY), vOrigY), vRcpY);
+        const V vNearZ = L::Mul(L::Sub(L::Load(dirPosZ ? node.MinZ : node.MaxZ), vOrigZ), vRcpZ);
+        const V vFarX = L::Mul(L::Sub(L::Load(dirPosX ? node.MaxX : node.MinX), vOrigX), vRcpX);
+        const V vFarY = L::Mul(L::Sub(L::Load(dirPosY ? node.MaxY : node.MinY), vOrigY), vRcpY);
+        const V vFarZ = L::Mul(L::Sub(L::Load(dirPosZ ? node.MaxZ : node.MinZ), vOrigZ), vRcpZ);
+
+        const V vEntry = L::Max(L::Max(vNearX, vNearY), vNearZ);
+        const V vExit = L::Min(L::Min(vFarX, vFarY), vFarZ);
+        const V vEntryClamped = L::Max(vEntry, vZero);
+
+        int hitMask = L::GreaterEqual(vExit, vEntryClamped) & L::Less(vEntryClamped, L::Set1(minT));
+        if (!hitMask)
+            continue;
+
+        L::Store(tEntry, vEntry);
+        L::Store(tExit, vExit);
+
+        // Child nodes that were hit, sorted by entry distance in descending order
+        Entry hitNodes[WIDTH];
+        int numHitNodes = 0;
+
+        while (hitMask)
+        {
+            const int c = _tzcnt_u32(hitMask);
+            hitMask &= hitMask - 1;
+            const int32_t child = node.Children[c];
+
+            if (child < 0)
+            {
+                // Same as intersectRayVsAABB() -- when ray origin is inside the box, the
+                // exit point is reported
+                const float t = tEntry[c] >= 0.0f ? tEntry[c] : tExit[c];
+
+                if (t < minT)
+                {
+                    minT = t;
+                    closestID = m_instanceIDs[~child];
+                }
+
+                continue;
+            }
+
+            const float t = Math::Max(tEntry[c], 0.0f);
+            int j = numHitNodes++;
+
+            while (j > 0 && hitNodes[j - 1].T < t)
+            {
+                hitNodes[j] = hitNodes[j - 1];
+                j--;
+            }
+
+            hitNodes[j] = Entry{ .Node = child, .T = t };
+        }
+
+        // Farthest is pushed first so that the nearest child is visited next
+        for (int i = 0; i < numHitNodes; i++)
+        {
+            Assert(currStackIdx + 1 < STACK_SIZE, "Stack size exceeded maximum allowed.");
+            stack[++currStackIdx] = hitNodes[i];
+        }
+    }
+
+    return closestID;
+}
+
+namespace ZetaRay::Math
+{
+    template class WideBVH<4>;
+    template class WideBVH<8>;
+}
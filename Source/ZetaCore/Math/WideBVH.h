@@ -0,0 +1,77 @@
+// References:
+// 1. I. Wald, C. Benthin and S. Boulos, "Getting Rid of Packets - Efficient SIMD Single-Ray
+//    Traversal using Multi-branching BVHs," IEEE Symposium on Interactive Ray Tracing, 2008.
+// 2. H. Dammertz, J. Hanika and A. Keller, "Shallow Bounding Volume Hierarchies for Fast
+//    SIMD Ray Tracing of Incoherent Rays," EGSR 2008.
+
+#pragma once
+
+#include "BVH.h"
+
+namespace ZetaRay::Math
+{
+    // Read-only BVH with up to WIDTH children per node, created by collapsing a binary BVH.
+    // Child bounds are stored in SoA form so that all the children of a node are tested
+    // against a frustum or ray at once (SSE for WIDTH = 4, AVX for WIDTH = 8). Doesn't
+    // track the source BVH -- Build() has to be called again after it's updated.
+    template<int WIDTH>
+    class WideBVH
+    {
+        static_assert(WIDTH == 4 || WIDTH == 8, "Only 4- and 8-wide nodes are supported.");
+
+    public:
+        WideBVH() = default;
+        ~WideBVH() = default;
+
+        WideBVH(WideBVH&&) = delete;
+        WideBVH& operator=(WideBVH&&) = delete;
+
+        bool IsBuilt() { return m_nodes.size() != 0; }
+        // Builds from the given binary BVH. Previous tree (if any) is discarded.
+        void Build(const BVH& bvh);
+        size_t NumNodes() { return m_nodes.size(); }
+
+        // Returns ID of instances that at least partially overlap the view frustum. Assumes
+        // the view frustum is in view space.
+        void DoFrustumCulling(const Math::ViewFrustum& viewFrustum,
+            const Math::float4x4a& viewToWorld,
+            Util::Vector<uint64_t, App::FrameAllocator>& visibleInstanceIDs);
+
+        // Casts a ray into the BVH and returns the closest intersection. Ray is assumed to
+        // be in world space. Children are visited in nearest-first order.
+        uint64_t CastRay(Math::Ray& r);
+
+    private:
+        // Unused child slots have inverted (empty) bounds, which fail both the frustum and
+        // the ray tests without needing a separate mask
+        static constexpr int32_t EMPTY_SLOT = INT32_MIN;
+
+        struct alignas(32) Node
+        {
+            float MinX[WIDTH];
+            float MinY[WIDTH];
+            float MinZ[WIDTH];
+            float MaxX[WIDTH];
+            float MaxY[WIDTH];
+            float MaxZ[WIDTH];
+
+            // >= 0: index of child node
+            // < 0: bitwise complement of index of instance
+            int32_t Children[WIDTH];
+        };
+
+        // Child candidate during collapse
+        struct Item;
+
+        // Recursively converts the binary subtree (or range of instances) into a wide node
+        // and returns its index
+        int Collapse(const BVH& bvh, const Item& item);
+
+        Util::SmallVector<Node> m_nodes;
+        // Copy of instance IDs in the order of the source BVH
+        Util::SmallVector<uint64_t> m_instanceIDs;
+    };
+
+    using BVH4 = WideBVH<4>;
+    using BVH8 = WideBVH<8>;
+}
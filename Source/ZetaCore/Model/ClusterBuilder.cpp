@@ -0,0 +1,227 @@
+#include "ClusterBuilder.h"
+#include "../Math/CollisionFuncs.h"
+#include "../Utility/SmallVector.h"
+
+using namespace ZetaRay;
+using namespace ZetaRay::Core;
+using namespace ZetaRay::Math;
+using namespace ZetaRay::Model;
+using namespace ZetaRay::Util;
+
+namespace
+{
+    static constexpr uint32_t INVALID_CLUSTER = UINT32_MAX;
+    // Normals are considered too spread out for the cone to be useful when the smallest dot 
+    // product with the axis is below this (~84 degrees)
+    static constexpr float MIN_CONE_DOT = 0.1f;
+
+    static_assert(ClusterBuilder::MAX_VERTICES <= UINT16_MAX && ClusterBuilder::MAX_TRIANGLES <= UINT16_MAX);
+
+    ZetaInline void DisableCone(MeshCluster& cluster)
+    {
+        cluster.ConeApex = cluster.Center;
+        cluster.ConeAxis = float3(0.0f);
+        cluster.ConeCutoff = 1.0f;
+    }
+
+    void ComputeBounds(Span<Vertex> vertices, Span<uint32_t> indices, bool buildCone, MeshCluster& cluster)
+    {
+        // Fourth element is TexUV.x and is ignored
+        __m128 vMin = _mm_set1_ps(FLT_MAX);
+        __m128 vMax = _mm_set1_ps(-FLT_MAX);
+
+        for (auto idx : indices)
+        {
+            const __m128 vPos = _mm_loadu_ps(&vertices[idx].Position.x);
+            vMin = _mm_min_ps(vMin, vPos);
+            vMax = _mm_max_ps(vMax, vPos);
+        }
+
+        const __m128 vOneDivTwo = _mm_set1_ps(0.5f);
+        const __m128 vCenter = _mm_mul_ps(_mm_add_ps(vMax, vMin), vOneDivTwo);
+        const __m128 vExtents = _mm_mul_ps(_mm_sub_ps(vMax, vMin), vOneDivTwo);
+
+        cluster.BoundingBox = AABB(storeFloat3(vCenter), storeFloat3(vExtents));
+        cluster.Center = cluster.BoundingBox.Center;
+
+        __m128 vMaxDistSq = _mm_setzero_ps();
+
+        for (auto idx : indices)
+        {
+            const __m128 vD = _mm_sub_ps(_mm_loadu_ps(&vertices[idx].Position.x), vCenter);
+            vMaxDistSq = _mm_max_ps(vMaxDistSq, _mm_dp_ps(vD, vD, 0x7f));
+        }
+
+        cluster.Radius = sqrtf(_mm_cvtss_f32(vMaxDistSq));
+
+        if (!buildCone)
+        {
+            DisableCone(cluster);
+            return;
+        }
+
+        // Front faces are clockwise, so in a left-handed coordinate system, the geometric 
+        // normal (v1 - v0) x (v2 - v0) points towards the front side. Axis is the average of 
+        // triangle normals.
+        const uint32_t numTris = (uint32_t)indices.size() / 3;
+        Assert(numTris <= ClusterBuilder::MAX_TRIANGLES, "Too many triangles.");
+        float3 normals[ClusterBuilder::MAX_TRIANGLES];
+        float3 axis(0.0f);
+
+        for (uint32_t t = 0; t < numTris; t++)
+        {
+            const float3 p0 = vertices[indices[t * 3]].Position;
+            const float3 n = (vertices[indices[t * 3 + 1]].Position - p0).cross(
+                vertices[indices[t * 3 + 2]].Position - p0);
+            const float len = n.length();
+
+            // Degenerate triangles can't be seen from either side
+            normals[t] = len > 0 ? n / len : float3(0.0f);
+            axis += normals[t];
+        }
+
+        const float axisLen = axis.length();
+        if (axisLen == 0)
+        {
+            DisableCone(cluster);
+            return;
+        }
+
+        axis = axis / axisLen;
+        float minDot = 1.0f;
+
+        for (uint32_t t = 0; t < numTris; t++)
+        {
+            if (normals[t].x != 0 || normals[t].y != 0 || normals[t].z != 0)
+                minDot = Min(minDot, axis.dot(normals[t]));
+        }
+
+        if (minDot <= MIN_CONE_DOT)
+        {
+            DisableCone(cluster);
+            return;
+        }
+
+        // Move the apex back along the axis until it's behind every triangle's plane. From
+        // there, the view direction has to be within the cone for all triangles to be back-facing
+        // (same as meshoptimizer's meshopt_computeClusterBounds()).
+        float maxT = 0.0f;
+
+        for (uint32_t t = 0; t < numTris; t++)
+        {
+            const float3 p0 = vertices[indices[t * 3]].Position;
+            const float dn = axis.dot(normals[t]);
+
+            // Degenerate triangles have dn = 0
+            if (dn > 0)
+                maxT = Max(maxT, (cluster.Center - p0).dot(normals[t]) / dn);
+        }
+
+        cluster.ConeApex = cluster.Center - axis * maxT;
+        cluster.ConeAxis = axis;
+        cluster.ConeCutoff = sqrtf(1.0f - minDot * minDot);
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// ClusterBuilder
+//--------------------------------------------------------------------------------------
+
+uint32_t ClusterBuilder::Build(Span<Vertex> vertices, Span<uint32_t> indices, bool buildCones,
+    MutableSpan<MeshCluster> clusters)
+{
+    const uint32_t numVertices = (uint32_t)vertices.size();
+    const uint32_t numTris = (uint32_t)indices.size() / 3;
+    Assert(clusters.size() >= MaxNumClusters(numTris), "Output buffer is too small.");
+
+    // Cluster that each vertex was last added to
+    SmallVector<uint32_t> vtxCluster;
+    vtxCluster.resize(numVertices, INVALID_CLUSTER);
+
+    uint32_t numClusters = 0;
+    uint32_t baseTri = 0;
+    uint32_t numClusterVertices = 0;
+
+    auto close = [&](uint32_t endTri)
+        {
+            MeshCluster& c = clusters[numClusters++];
+            c.BaseTriOffset = baseTri;
+            c.NumTriangles = (uint16_t)(endTri - baseTri);
+            c.NumVertices = (uint16_t)numClusterVertices;
+
+            ComputeBounds(vertices, Span(indices.data() + baseTri * 3, c.NumTriangles * 3), 
+                buildCones, c);
+        };
+
+    for (uint32_t t = 0; t < numTris; t++)
+    {
+        uint32_t numNew = 0;
+
+        for (int j = 0; j < 3; j++)
+        {
+            const uint32_t idx = indices[t * 3 + j];
+            Assert(idx < numVertices, "Index %u is out of bounds.", idx);
+
+            numNew += vtxCluster[idx] != numClusters;
+        }
+
+        if (numClusterVertices + numNew > MAX_VERTICES || t - baseTri == MAX_TRIANGLES)
+        {
+            close(t);
+
+            baseTri = t;
+            numClusterVertices = 0;
+        }
+
+        for (int j = 0; j < 3; j++)
+        {
+            const uint32_t idx = indices[t * 3 + j];
+
+            if (vtxCluster[idx] != numClusters)
+            {
+                vtxCluster[idx] = numClusters;
+                numClusterVertices++;
+            }
+        }
+    }
+
+    if (numTris > baseTri)
+        close(numTris);
+
+    return numClusters;
+}
+
+uint32_t ClusterBuilder::Cull(Span<MeshCluster> clusters, const ViewFrustum& viewFrustum,
+    const float4x4a& viewToWorld, const float4x3& toWorld, 
+    MutableSpan<uint32_t> visibleClusters)
+{
+    Assert(visibleClusters.size() >= clusters.size(), "Output buffer is too small.");
+
+    // Transform view frustum from view space into world space
+    const v_float4x4 vViewToWorld = load4x4(const_cast<float4x4a&>(viewToWorld));
+    v_ViewFrustum vFrustum(const_cast<ViewFrustum&>(viewFrustum));
+    vFrustum = Math::transform(vViewToWorld, vFrustum);
+
+    // Whether a triangle is back-facing is preserved by affine transformations, so cones are 
+    // tested in object space. The exception is mirroring, which flips the winding order.
+    const v_float4x4 vToWorld = load4x3(toWorld);
+    const bool testCones = _mm_cvtss_f32(det3x3(vToWorld)) > 0;
+    const float3 viewPos = storeFloat3(mul(inverseSRT(vToWorld), vViewToWorld.vRow[3]));
+
+    uint32_t numVisible = 0;
+
+    for (uint32_t i = 0; i < (uint32_t)clusters.size(); i++)
+    {
+        const MeshCluster& c = clusters[i];
+
+        if (testCones && IsBackfacing(c, viewPos))
+            continue;
+
+        const v_AABB vBox = Math::transform(vToWorld, v_AABB(c.BoundingBox));
+
+        if (Math::instersectFrustumVsAABB(vFrustum, vBox) != COLLISION_TYPE::DISJOINT)
+            visibleClusters[numVisible++] = i;
+    }
+
+    return numVisible;
+}
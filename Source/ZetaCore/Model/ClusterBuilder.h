@@ -0,0 +1,67 @@
+#pragma once
+
+#include "../Core/Vertex.h"
+#include "../Math/CollisionTypes.h"
+#include "../Math/Matrix.h"
+#include "../Utility/Span.h"
+
+namespace ZetaRay::Model
+{
+    // A run of consecutive triangles of a mesh that's small enough to be culled (and eventually, 
+    // rendered or streamed) as a unit. Everything is in mesh's object space.
+    struct MeshCluster
+    {
+        Math::AABB BoundingBox;
+        // Bounding sphere
+        Math::float3 Center;
+        float Radius;
+        // Normal cone -- every triangle is back-facing when viewed from any position p for which
+        // dot(normalize(ConeApex - p), ConeAxis) >= ConeCutoff. Axis is zero when that can never 
+        // hold, e.g. for double-sided meshes or when normals are too spread out.
+        Math::float3 ConeApex;
+        Math::float3 ConeAxis;
+        float ConeCutoff;
+        // Triangles are [BaseTriOffset, BaseTriOffset + NumTriangles) of the mesh's index buffer, 
+        // in triangles and relative to the mesh's first index
+        uint32_t BaseTriOffset;
+        uint16_t NumTriangles;
+        // Number of unique vertices
+        uint16_t NumVertices;
+    };
+}
+
+// Import-time partitioning of indexed triangle meshes into clusters. Triangles are scanned in 
+// index buffer order, so quality depends on triangle locality -- e.g. after 
+// MeshOptimizer::OptimizeVertexCache() neighboring triangles share most of their vertices.
+namespace ZetaRay::Model::ClusterBuilder
+{
+    static constexpr uint32_t MAX_VERTICES = 64;
+    static constexpr uint32_t MAX_TRIANGLES = 124;
+
+    // A cluster is only closed once the next triangle doesn't fit, which takes at least 
+    // MAX_VERTICES / 3 triangles. This bounds the number of clusters from above.
+    ZetaInline constexpr uint32_t MaxNumClusters(uint32_t numTriangles)
+    {
+        return numTriangles / (MAX_VERTICES / 3) + 1;
+    }
+
+    // Writes clusters of the given mesh to "clusters", which must have room for at least 
+    // MaxNumClusters() elements. Normal cones are only computed when buildCones is true, 
+    // which must be false for double-sided meshes. Returns the number of clusters.
+    uint32_t Build(Util::Span<Core::Vertex> vertices, Util::Span<uint32_t> indices, bool buildCones,
+        Util::MutableSpan<MeshCluster> clusters);
+
+    ZetaInline bool IsBackfacing(const MeshCluster& cluster, const Math::float3& viewPos)
+    {
+        const Math::float3 d = cluster.ConeApex - viewPos;
+        return d.dot(cluster.ConeAxis) >= cluster.ConeCutoff * d.length();
+    }
+
+    // Writes index of every cluster of a mesh instance that at least partially overlaps the 
+    // view frustum and isn't back-facing to "visibleClusters", which must have room for at 
+    // least clusters.size() elements. Assumes the view frustum is in view space. Returns the 
+    // number of visible clusters.
+    uint32_t Cull(Util::Span<MeshCluster> clusters, const Math::ViewFrustum& viewFrustum,
+        const Math::float4x4a& viewToWorld, const Math::float4x3& toWorld,
+        Util::MutableSpan<uint32_t> visibleClusters);
+}
@@ -25,12 +25,16 @@ namespace ZetaRay::Model
             uint32_t vtxBuffStartOffset,
             uint32_t idxBuffStartOffset,
             uint32_t numIndices,
-            uint32_t matID)
+            uint32_t matID,
+            uint32_t clusterOffset = 0,
+            uint32_t numClusters = 0)
             : m_numVertices((uint32_t)vertices.size()),
             m_numIndices(numIndices),
             m_materialID(matID),
             m_vtxBuffStartOffset(vtxBuffStartOffset),
-            m_idxBuffStartOffset(idxBuffStartOffset)
+            m_idxBuffStartOffset(idxBuffStartOffset),
+            m_clusterOffset(clusterOffset),
+            m_numClusters(numClusters)
         {
             Assert(vertices.size() < UINT_MAX, "Number of vertices exceeded maximum allowed.");
 
@@ -38,12 +42,34 @@ namespace ZetaRay::Model
                 sizeof(Core::Vertex), m_numVertices);
             m_AABB = Math::store(vBox);
         }
+        // For when vertices aren't available in full precision (e.g. quantized vertices, 
+        // which are relative to a known box)
+        TriangleMesh(const Math::AABB& bounds,
+            uint32_t numVertices,
+            uint32_t vtxBuffStartOffset,
+            uint32_t idxBuffStartOffset,
+            uint32_t numIndices,
+            uint32_t matID,
+            uint32_t clusterOffset = 0,
+            uint32_t numClusters = 0)
+            : m_numVertices(numVertices),
+            m_numIndices(numIndices),
+            m_materialID(matID),
+            m_vtxBuffStartOffset(vtxBuffStartOffset),
+            m_idxBuffStartOffset(idxBuffStartOffset),
+            m_clusterOffset(clusterOffset),
+            m_numClusters(numClusters),
+            m_AABB(bounds)
+        {}
 
         uint32_t m_vtxBuffStartOffset;
         uint32_t m_idxBuffStartOffset;
         uint32_t m_materialID;
         uint32_t m_numVertices;
         uint32_t m_numIndices;
+        // Range in the mesh container's cluster buffer (see ClusterBuilder.h)
+        uint32_t m_clusterOffset;
+        uint32_t m_numClusters;
         Math::AABB m_AABB;
     };
 
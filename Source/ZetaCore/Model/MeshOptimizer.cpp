@@ -0,0 +1,267 @@
+#include "MeshOptimizer.h"
+#include "../Math/Common.h"
+#include <xxHash/xxhash.h>
+
+using namespace ZetaRay;
+using namespace ZetaRay::Core;
+using namespace ZetaRay::Model;
+using namespace ZetaRay::Util;
+
+namespace
+{
+    static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+}
+
+//--------------------------------------------------------------------------------------
+// MeshOptimizer
+//--------------------------------------------------------------------------------------
+
+uint32_t MeshOptimizer::WeldVertices(MutableSpan<Vertex> vertices, MutableSpan<uint32_t> indices)
+{
+    static_assert(sizeof(Vertex) == sizeof(Math::float3) + sizeof(Math::float2) + 2 * sizeof(Math::oct32),
+        "Vertices are compared bitwise, padding is not allowed.");
+
+    const uint32_t numVertices = (uint32_t)vertices.size();
+    if (numVertices == 0)
+        return 0;
+
+    // Open addressing with linear probing, kept at most half full. Stores index of the first
+    // occurrence of each unique vertex after it's been moved to the front.
+    const size_t tableSize = Math::NextPow2(numVertices * 2llu);
+    const size_t mask = tableSize - 1;
+    SmallVector<uint32_t> table;
+    table.resize(tableSize, INVALID_INDEX);
+
+    SmallVector<uint32_t> remap;
+    remap.resize(numVertices);
+    uint32_t numUnique = 0;
+
+    for (uint32_t i = 0; i < numVertices; i++)
+    {
+        size_t slot = XXH3_64bits(&vertices[i], sizeof(Vertex)) & mask;
+
+        while (true)
+        {
+            const uint32_t existing = table[slot];
+
+            if (existing == INVALID_INDEX)
+            {
+                // Vertices before i are either unique (and were already moved) or duplicates,
+                // so it's safe to overwrite
+                table[slot] = numUnique;
+                vertices[numUnique] = vertices[i];
+                remap[i] = numUnique++;
+
+                break;
+            }
+
+            if (memcmp(&vertices[existing], &vertices[i], sizeof(Vertex)) == 0)
+            {
+                remap[i] = existing;
+                break;
+            }
+
+            slot = (slot + 1) & mask;
+        }
+    }
+
+    for (auto& idx : indices)
+    {
+        Assert(idx < numVertices, "Index %u is out of bounds.", idx);
+        idx = remap[idx];
+    }
+
+    return numUnique;
+}
+
+void MeshOptimizer::OptimizeVertexCache(MutableSpan<uint32_t> indices, uint32_t numVertices,
+    uint32_t cacheSize)
+{
+    const uint32_t numTris = (uint32_t)indices.size() / 3;
+    if (numTris == 0)
+        return;
+
+    // Number of triangles that use each vertex and haven't been emitted yet
+    SmallVector<uint32_t> numLiveTris;
+    numLiveTris.resize(numVertices, 0);
+
+    for (auto idx : indices)
+    {
+        Assert(idx < numVertices, "Index %u is out of bounds.", idx);
+        numLiveTris[idx]++;
+    }
+
+    // Vertex-triangle adjacency, triangles that use vertex v are in
+    // adjacency[adjOffsets[v]...adjOffsets[v + 1])
+    SmallVector<uint32_t> adjOffsets;
+    adjOffsets.resize(numVertices + 1);
+    adjOffsets[0] = 0;
+
+    for (uint32_t v = 0; v < numVertices; v++)
+        adjOffsets[v + 1] = adjOffsets[v] + numLiveTris[v];
+
+    SmallVector<uint32_t> adjacency;
+    adjacency.resize(indices.size());
+    SmallVector<uint32_t> cursor;
+    cursor.append_range(adjOffsets.begin(), adjOffsets.end() - 1, true);
+
+    for (uint32_t i = 0; i < (uint32_t)indices.size(); i++)
+        adjacency[cursor[indices[i]]++] = i / 3;
+
+    // Time stamp of when each vertex entered the cache
+    SmallVector<uint32_t> cacheTime;
+    cacheTime.resize(numVertices, 0);
+    SmallVector<uint8_t> emitted;
+    emitted.resize(numTris, 0);
+
+    SmallVector<uint32_t> output;
+    output.resize(indices.size());
+    // Recently referenced vertices, used to continue from when no candidate is left
+    SmallVector<uint32_t> deadEnds;
+    SmallVector<uint32_t> candidates;
+
+    uint32_t numOut = 0;
+    uint32_t timeStamp = cacheSize + 1;
+    uint32_t nextInOrder = 0;
+    int fanning = 0;
+
+    while (fanning >= 0)
+    {
+        candidates.clear();
+
+        // Emit all the remaining triangles around the fanning vertex
+        for (uint32_t k = adjOffsets[fanning]; k < adjOffsets[fanning + 1]; k++)
+        {
+            const uint32_t t = adjacency[k];
+            if (emitted[t])
+                continue;
+
+            for (int j = 0; j < 3; j++)
+            {
+                const uint32_t v = indices[t * 3 + j];
+                output[numOut++] = v;
+                deadEnds.push_back(v);
+                candidates.push_back(v);
+                numLiveTris[v]--;
+
+                if (timeStamp - cacheTime[v] > cacheSize)
+                    cacheTime[v] = timeStamp++;
+            }
+
+            emitted[t] = 1;
+        }
+
+        // Prefer the vertex that's going to stay in cache for the longest after emitting
+        // all of its triangles
+        int next = -1;
+        int bestPriority = -1;
+
+        for (auto v : candidates)
+        {
+            if (numLiveTris[v] == 0)
+                continue;
+
+            int priority = 0;
+            if (timeStamp - cacheTime[v] + 2 * numLiveTris[v] <= cacheSize)
+                priority = (int)(timeStamp - cacheTime[v]);
+
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                next = (int)v;
+            }
+        }
+
+        // Dead end -- continue from a recently referenced vertex, or failing that, the
+        // next vertex in input order
+        while (next == -1 && !deadEnds.empty())
+        {
+            const uint32_t v = deadEnds.back();
+            deadEnds.pop_back();
+
+            if (numLiveTris[v])
+                next = (int)v;
+        }
+
+        while (next == -1 && nextInOrder < numVertices)
+        {
+            if (numLiveTris[nextInOrder])
+                next = (int)nextInOrder;
+
+            nextInOrder++;
+        }
+
+        fanning = next;
+    }
+
+    Assert(numOut == indices.size(), "Every triangle must be emitted exactly once.");
+    memcpy(indices.data(), output.data(), indices.size() * sizeof(uint32_t));
+}
+
+uint32_t MeshOptimizer::OptimizeVertexFetch(MutableSpan<Vertex> vertices, MutableSpan<uint32_t> indices)
+{
+    const uint32_t numVertices = (uint32_t)vertices.size();
+
+    SmallVector<uint32_t> remap;
+    remap.resize(numVertices, INVALID_INDEX);
+    uint32_t numReferenced = 0;
+
+    for (auto& idx : indices)
+    {
+        Assert(idx < numVertices, "Index %u is out of bounds.", idx);
+
+        if (remap[idx] == INVALID_INDEX)
+            remap[idx] = numReferenced++;
+
+        idx = remap[idx];
+    }
+
+    SmallVector<Vertex> original;
+    original.append_range(vertices.begin(), vertices.end(), true);
+
+    for (uint32_t i = 0; i < numVertices; i++)
+    {
+        if (remap[i] != INVALID_INDEX)
+            vertices[remap[i]] = original[i];
+    }
+
+    return numReferenced;
+}
+
+uint32_t MeshOptimizer::NumCacheMisses(Span<uint32_t> indices, uint32_t numVertices, uint32_t cacheSize)
+{
+    // With a FIFO cache, hits don't change the order, so it's enough to remember when each
+    // vertex was inserted
+    SmallVector<uint32_t> cacheTime;
+    cacheTime.resize(numVertices, 0);
+    uint32_t timeStamp = cacheSize + 1;
+    uint32_t numMisses = 0;
+
+    for (auto idx : indices)
+    {
+        if (timeStamp - cacheTime[idx] > cacheSize)
+        {
+            cacheTime[idx] = timeStamp++;
+            numMisses++;
+        }
+    }
+
+    return numMisses;
+}
+
+MeshOptimizer::Stats MeshOptimizer::Optimize(MutableSpan<Vertex> vertices, MutableSpan<uint32_t> indices)
+{
+    Stats stats;
+    stats.NumVerticesBefore = (uint32_t)vertices.size();
+    stats.NumTriangles = (uint32_t)indices.size() / 3;
+    stats.NumCacheMissesBefore = NumCacheMisses(indices, stats.NumVerticesBefore);
+
+    uint32_t numVertices = WeldVertices(vertices, indices);
+    OptimizeVertexCache(indices, numVertices);
+    numVertices = OptimizeVertexFetch(MutableSpan(vertices.data(), numVertices), indices);
+
+    stats.NumVerticesAfter = numVertices;
+    stats.NumCacheMissesAfter = NumCacheMisses(indices, numVertices);
+
+    return stats;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "../Core/Vertex.h"
+#include "../Utility/Span.h"
+
+// Import-time optimizations for indexed triangle meshes. Indices are local to the mesh (i.e. start
+// from zero) and all functions operate in place.
+namespace ZetaRay::Model::MeshOptimizer
+{
+    // Cache size that triangle order is optimized for and statistics are reported with
+    static constexpr uint32_t VERTEX_CACHE_SIZE = 16;
+
+    struct Stats
+    {
+        uint32_t NumVerticesBefore;
+        uint32_t NumVerticesAfter;
+        uint32_t NumCacheMissesBefore;
+        uint32_t NumCacheMissesAfter;
+        uint32_t NumTriangles;
+
+        // Average cache miss ratio -- number of transformed vertices per triangle
+        ZetaInline float ACMRBefore() const { return NumTriangles ? (float)NumCacheMissesBefore / NumTriangles : 0.0f; }
+        ZetaInline float ACMRAfter() const { return NumTriangles ? (float)NumCacheMissesAfter / NumTriangles : 0.0f; }
+    };
+
+    // Merges vertices that are bit-for-bit identical. Unique vertices are moved to the front in
+    // order of first occurrence. Returns the new number of vertices.
+    uint32_t WeldVertices(Util::MutableSpan<Core::Vertex> vertices, Util::MutableSpan<uint32_t> indices);
+    // Reorders triangles for post-transform vertex cache locality using Tipsify ("Fast Triangle
+    // Reordering for Vertex Locality and Reduced Overdraw", Sander et al. 2007). Linear in the
+    // number of triangles.
+    void OptimizeVertexCache(Util::MutableSpan<uint32_t> indices, uint32_t numVertices,
+        uint32_t cacheSize = VERTEX_CACHE_SIZE);
+    // Reorders vertices in order of first use by the index buffer, so that vertex fetches are
+    // mostly sequential. Unreferenced vertices are removed. Returns the new number of vertices.
+    uint32_t OptimizeVertexFetch(Util::MutableSpan<Core::Vertex> vertices, Util::MutableSpan<uint32_t> indices);
+    // Number of vertex transforms with a FIFO cache of given size
+    uint32_t NumCacheMisses(Util::Span<uint32_t> indices, uint32_t numVertices,
+        uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+    // All of the above, in order. New number of vertices is returned in Stats::NumVerticesAfter.
+    Stats Optimize(Util::MutableSpan<Core::Vertex> vertices, Util::MutableSpan<uint32_t> indices);
+}
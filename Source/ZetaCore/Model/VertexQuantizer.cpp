@@ -0,0 +1,131 @@
+#include "VertexQuantizer.h"
+#include "../Math/CollisionFuncs.h"
+
+using namespace ZetaRay;
+using namespace ZetaRay::Core;
+using namespace ZetaRay::Math;
+using namespace ZetaRay::Model;
+using namespace ZetaRay::Util;
+
+namespace
+{
+    static constexpr float MAX_QUANTIZED = float(UINT16_MAX);
+
+    static_assert(sizeof(CompactVertex) == 20);
+    static_assert(offsetof(Vertex, TexUV) == sizeof(float3), "Position is loaded as four floats.");
+
+    // Smallest corner of the box, with the fourth element set to zero
+    ZetaInline __m128 __vectorcall MinCorner(const AABB& bounds)
+    {
+        return _mm_setr_ps(bounds.Center.x - bounds.Extents.x, bounds.Center.y - bounds.Extents.y,
+            bounds.Center.z - bounds.Extents.z, 0.0f);
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// VertexQuantizer
+//--------------------------------------------------------------------------------------
+
+AABB VertexQuantizer::ComputeBounds(Span<Vertex> vertices)
+{
+    if (vertices.empty())
+        return AABB(float3(0.0f), float3(0.0f));
+
+    v_AABB vBox = compueMeshAABB(vertices.data(), offsetof(Vertex, Position), sizeof(Vertex),
+        (uint32_t)vertices.size());
+
+    return store(vBox);
+}
+
+void VertexQuantizer::Encode(Span<Vertex> vertices, const AABB& bounds, MutableSpan<CompactVertex> compact)
+{
+    Assert(compact.size() >= vertices.size(), "Output buffer is too small.");
+
+    // Degenerate dimensions are encoded as zero and decode to the box's center
+    const float3 e = bounds.Extents;
+    const __m128 vScale = _mm_setr_ps(e.x > 0 ? MAX_QUANTIZED / (2.0f * e.x) : 0.0f,
+        e.y > 0 ? MAX_QUANTIZED / (2.0f * e.y) : 0.0f,
+        e.z > 0 ? MAX_QUANTIZED / (2.0f * e.z) : 0.0f,
+        0.0f);
+    const __m128 vMin = MinCorner(bounds);
+    const __m128 vMaxQ = _mm_set1_ps(MAX_QUANTIZED);
+    const __m128 vZero = _mm_setzero_ps();
+
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        const Vertex& v = vertices[i];
+        CompactVertex& c = compact[i];
+
+        // Fourth element is TexUV.x, zero it out
+        __m128 vPos = _mm_loadu_ps(&v.Position.x);
+        vPos = _mm_insert_ps(vPos, vPos, 0x8);
+        __m128 vQ = _mm_mul_ps(_mm_sub_ps(vPos, vMin), vScale);
+        // Positions outside the box (and NaNs) are clamped
+        vQ = _mm_min_ps(_mm_max_ps(vQ, vZero), vMaxQ);
+
+        // Round to nearest and pack to 16 bits
+        __m128i vQi = _mm_cvtps_epi32(vQ);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(c.Position), _mm_packus_epi32(vQi, vQi));
+
+        __m128 vUV = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(&v.TexUV)));
+        const uint32_t uv = _mm_cvtsi128_si32(_mm_cvtps_ph(vUV, 0));
+        memcpy(&c.TexUV, &uv, sizeof(uv));
+
+        c.Normal = v.Normal;
+        c.Tangent = v.Tangent;
+    }
+}
+
+void VertexQuantizer::Decode(Span<CompactVertex> compact, const AABB& bounds, MutableSpan<Vertex> vertices)
+{
+    Assert(vertices.size() >= compact.size(), "Output buffer is too small.");
+
+    const float3 e = bounds.Extents;
+    const __m128 vStep = _mm_setr_ps(2.0f * e.x / MAX_QUANTIZED, 2.0f * e.y / MAX_QUANTIZED,
+        2.0f * e.z / MAX_QUANTIZED, 0.0f);
+    const __m128 vMin = MinCorner(bounds);
+
+    for (size_t i = 0; i < compact.size(); i++)
+    {
+        const CompactVertex& c = compact[i];
+        Vertex& v = vertices[i];
+
+        __m128i vQ = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(c.Position)));
+        __m128 vPos = _mm_fmadd_ps(_mm_cvtepi32_ps(vQ), vStep, vMin);
+
+        uint32_t uv;
+        memcpy(&uv, &c.TexUV, sizeof(uv));
+        __m128 vUV = _mm_cvtph_ps(_mm_cvtsi32_si128(uv));
+
+        // Fourth element overlaps TexUV.x, which is written right after
+        _mm_storeu_ps(&v.Position.x, vPos);
+        _mm_store_sd(reinterpret_cast<double*>(&v.TexUV), _mm_castps_pd(vUV));
+
+        v.Normal = c.Normal;
+        v.Tangent = c.Tangent;
+    }
+}
+
+VertexQuantizer::Error VertexQuantizer::MeasureError(Span<Vertex> original, Span<Vertex> decoded,
+    const AABB& bounds)
+{
+    Assert(original.size() == decoded.size(), "Number of vertices must match.");
+
+    Error err;
+
+    for (size_t i = 0; i < original.size(); i++)
+    {
+        const Vertex& a = original[i];
+        const Vertex& b = decoded[i];
+
+        err.MaxPositionError = Max(err.MaxPositionError, Max(Max(fabsf(a.Position.x - b.Position.x),
+            fabsf(a.Position.y - b.Position.y)), fabsf(a.Position.z - b.Position.z)));
+        err.MaxTexUVError = Max(err.MaxTexUVError, Max(fabsf(a.TexUV.x - b.TexUV.x),
+            fabsf(a.TexUV.y - b.TexUV.y)));
+    }
+
+    const float maxDim = 2.0f * Max(Max(bounds.Extents.x, bounds.Extents.y), bounds.Extents.z);
+    err.MaxRelativePositionError = maxDim > 0 ? err.MaxPositionError / maxDim : 0.0f;
+
+    return err;
+}
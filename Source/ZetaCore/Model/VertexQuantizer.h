@@ -0,0 +1,38 @@
+#pragma once
+
+#include "../Core/Vertex.h"
+#include "../Math/CollisionTypes.h"
+#include "../Utility/Span.h"
+
+// Conversion between Core::Vertex and the compact Core::CompactVertex layout. Positions are 
+// quantized to 16 bits per component relative to mesh's AABB, so the error is at most half 
+// a quantization step, i.e. extent / (2 * 65535) along each axis. Normal and tangent are 
+// already octahedral-encoded and are copied as is.
+namespace ZetaRay::Model::VertexQuantizer
+{
+    struct Error
+    {
+        // In object space
+        float MaxPositionError = 0.0f;
+        // Relative to the largest dimension of the mesh's AABB
+        float MaxRelativePositionError = 0.0f;
+        float MaxTexUVError = 0.0f;
+
+        ZetaInline void Merge(const Error& other)
+        {
+            MaxPositionError = Math::Max(MaxPositionError, other.MaxPositionError);
+            MaxRelativePositionError = Math::Max(MaxRelativePositionError, other.MaxRelativePositionError);
+            MaxTexUVError = Math::Max(MaxTexUVError, other.MaxTexUVError);
+        }
+    };
+
+    // Bounding box of the given vertices, which is what positions are quantized relative to
+    Math::AABB ComputeBounds(Util::Span<Core::Vertex> vertices);
+    void Encode(Util::Span<Core::Vertex> vertices, const Math::AABB& bounds,
+        Util::MutableSpan<Core::CompactVertex> compact);
+    void Decode(Util::Span<Core::CompactVertex> compact, const Math::AABB& bounds,
+        Util::MutableSpan<Core::Vertex> vertices);
+    // Compares decoded vertices to the original ones
+    Error MeasureError(Util::Span<Core::Vertex> original, Util::Span<Core::Vertex> decoded,
+        const Math::AABB& bounds);
+}
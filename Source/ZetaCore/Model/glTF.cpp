@@ -1,10 +1,16 @@
 #include "glTF.h"
+#include "glTFCache.h"
+#include "MeshOptimizer.h"
+#include "ClusterBuilder.h"
+#include "VertexQuantizer.h"
+#include "glTFAccessor.h"
 #include "../Math/MatrixFuncs.h"
 #include "../Math/Surface.h"
 #include "../Math/Quaternion.h"
 #include "../Scene/SceneCore.h"
 #include "../Support/Task.h"
 #include "../App/Log.h"
+#include "../App/Timer.h"
 #include "../Utility/Utility.h"
 #include <algorithm>
 
@@ -91,29 +97,48 @@ namespace
     {
         const App::Filesystem::Path* glTFPath;
         uint32_t SceneID;
+        // Null when loading from cache
         cgltf_data* Model;
+        // glTF (or GLB) file and external buffer files are mapped into memory for as long as 
+        // Model is alive. Accessors are decoded directly from the mapped pages.
+        Filesystem::MemoryMappedFile glTFFile;
+        SmallVector<Filesystem::MemoryMappedFile> BufferFiles;
+        SmallVector<char> BufferURIBlob;
+
+        // Processed scene data -- either points to the vectors below or into the 
+        // memory-mapped cache file
+        glTF::Cache::SceneData Data;
 
         SmallVector<Vertex> Vertices;
         SmallVector<uint32_t> Indices;
         SmallVector<Mesh> Meshes;
-        // All unique textures that need to be loaded from disk
-        SmallVector<Texture> DDSImages;
+        SmallVector<MaterialDesc> Materials;
+        SmallVector<char> ImagePathBlob;
+        SmallVector<int> TreeLevels;
+        SmallVector<InstanceDesc> Instances;
         SmallVector<EmissiveMeshPrim> EmissiveMeshPrims;
         SmallVector<EmissiveInstance> EmissiveInstances;
         SmallVector<RT::EmissiveTriangle> RTEmissives;
+        SmallVector<CompactVertex> CompactVertices;
+        SmallVector<AABB> MeshBounds;
+        SmallVector<MeshCluster> Clusters;
 
-        int NumMeshWorkers;
-        int NumImgWorkers;
-        size_t* MeshThreadOffsets;
-        size_t* MeshThreadSizes;
-        size_t* ImgThreadOffsets;
-        size_t* ImgThreadSizes;
-        uint32_t* EmissiveMeshPrimCountPerWorker;
+        // Points into Data.ImagePaths
+        SmallVector<const char*> ImagePaths;
+        // All unique textures that need to be loaded from disk
+        SmallVector<Texture> DDSImages;
+
+        glTF::Options Opts;
+        // Totals over all optimized meshes
+        std::atomic_uint64_t NumVerticesBeforeOpt = 0;
+        std::atomic_uint64_t NumVerticesAfterOpt = 0;
+        std::atomic_uint64_t NumCacheMissesBeforeOpt = 0;
+        std::atomic_uint64_t NumCacheMissesAfterOpt = 0;
 
         std::atomic_uint32_t CurrVtxOffset = 0;
         std::atomic_uint32_t CurrIdxOffset = 0;
         std::atomic_uint32_t CurrMeshPrimOffset = 0;
-        int NumEmissiveMeshPrims = 0;
+        std::atomic_int32_t NumEmissiveMeshPrims = 0;
         int NumEmissiveInstances = 0;
         uint32_t NumEmissiveTris = 0;
     };
@@ -142,138 +167,206 @@ namespace
             subsets[subsets.size() - 1 - i].MeshID = Scene::INVALID_MESH;
     }
 
-    void ProcessPositions(const cgltf_data& model, const cgltf_accessor& accessor, 
-        MutableSpan<Vertex> vertices, uint32_t baseOffset)
+    glTF::Accessor::COMPONENT_TYPE GetComponentType(cgltf_component_type t)
     {
-        Check(accessor.type == cgltf_type_vec3, "Invalid type for POSITION attribute.");
-        Check(accessor.component_type == cgltf_component_type_r_32f,
-            "Invalid component type for POSITION attribute.");
+        switch (t)
+        {
+        case cgltf_component_type_r_8:
+            return glTF::Accessor::COMPONENT_TYPE::INT8;
+        case cgltf_component_type_r_8u:
+            return glTF::Accessor::COMPONENT_TYPE::UINT8;
+        case cgltf_component_type_r_16:
+            return glTF::Accessor::COMPONENT_TYPE::INT16;
+        case cgltf_component_type_r_16u:
+            return glTF::Accessor::COMPONENT_TYPE::UINT16;
+        case cgltf_component_type_r_32u:
+            return glTF::Accessor::COMPONENT_TYPE::UINT32;
+        case cgltf_component_type_r_32f:
+            return glTF::Accessor::COMPONENT_TYPE::FLOAT32;
+        default:
+            Check(false, "Invalid accessor component type.");
+            return glTF::Accessor::COMPONENT_TYPE::FLOAT32;
+        }
+    }
 
-        const cgltf_buffer_view& bufferView = *accessor.buffer_view;
-        Check(accessor.stride == sizeof(float3), "Invalid stride for POSITION attribute.");
+    ZetaInline const uint8_t* GetBufferViewData(const cgltf_buffer_view& bufferView)
+    {
+        return reinterpret_cast<const uint8_t*>(bufferView.buffer->data) + bufferView.offset;
+    }
 
-        const cgltf_buffer& buffer = *bufferView.buffer;
-        const float3* start = reinterpret_cast<float3*>(reinterpret_cast<uintptr_t>(
-            buffer.data) + bufferView.offset + accessor.offset);
+    // Dense part of the accessor
+    glTF::Accessor::Stream GetStream(const cgltf_accessor& accessor)
+    {
+        glTF::Accessor::Stream stream{ .Count = accessor.count,
+            .Stride = (uint32_t)accessor.stride,
+            .Type = GetComponentType(accessor.component_type),
+            .Normalized = (bool)accessor.normalized };
 
-        for (size_t i = 0; i < accessor.count; i++)
+        if (accessor.buffer_view)
         {
-            const float3* curr = start + i;
-
-            // glTF uses a right-handed coordinate system with +Y as up
-            vertices[baseOffset + i].Position = float3(curr->x, curr->y, -curr->z);
+            Check(accessor.offset <= accessor.buffer_view->size, "Invalid accessor offset.");
+            stream.Data = GetBufferViewData(*accessor.buffer_view) + accessor.offset;
+            stream.SizeInBytes = accessor.buffer_view->size - accessor.offset;
         }
+        else
+            Check(accessor.is_sparse, "Accessor without a buffer view must be sparse.");
+
+        return stream;
     }
 
-    void ProcessNormals(const cgltf_data& model, const cgltf_accessor& accessor, 
+    // Indices of elements that are replaced by a sparse accessor
+    void GetSparseIndices(const cgltf_accessor& accessor, SmallVector<uint32_t>& indices)
+    {
+        const cgltf_accessor_sparse& sparse = accessor.sparse;
+        const glTF::Accessor::COMPONENT_TYPE type = GetComponentType(sparse.indices_component_type);
+        Check(type == glTF::Accessor::COMPONENT_TYPE::UINT8 || type == glTF::Accessor::COMPONENT_TYPE::UINT16 ||
+            type == glTF::Accessor::COMPONENT_TYPE::UINT32, "Invalid sparse index type.");
+
+        const glTF::Accessor::Stream stream{ .Data = GetBufferViewData(*sparse.indices_buffer_view) + 
+                sparse.indices_byte_offset,
+            .Count = sparse.count,
+            .Stride = glTF::Accessor::ComponentSize(type),
+            .Type = type,
+            .SizeInBytes = sparse.indices_buffer_view->size - sparse.indices_byte_offset };
+
+        indices.resize(sparse.count);
+        glTF::Accessor::DecodeIndices(stream, indices, false);
+
+        for (auto idx : indices)
+            Check(idx < accessor.count, "Sparse accessor index %u is out of bounds.", idx);
+    }
+
+    // Replacement values of a sparse accessor, which are always tightly packed
+    glTF::Accessor::Stream GetSparseValues(const cgltf_accessor& accessor)
+    {
+        const cgltf_accessor_sparse& sparse = accessor.sparse;
+
+        return glTF::Accessor::Stream{ .Data = GetBufferViewData(*sparse.values_buffer_view) + 
+                sparse.values_byte_offset,
+            .Count = sparse.count,
+            .Stride = (uint32_t)cgltf_calc_size(accessor.type, accessor.component_type),
+            .Type = GetComponentType(accessor.component_type),
+            .Normalized = (bool)accessor.normalized,
+            .SizeInBytes = sparse.values_buffer_view->size - sparse.values_byte_offset };
+    }
+
+    // Decodes the attribute into given member of vertices starting at baseOffset, then applies
+    // sparse substitutions (if any)
+    template<typename T>
+    void ProcessAttribute(const cgltf_accessor& accessor, T Vertex::* member,
+        void (*decode)(const glTF::Accessor::Stream&, MutableSpan<Vertex>),
         MutableSpan<Vertex> vertices, uint32_t baseOffset)
     {
-        Check(accessor.type == cgltf_type_vec3, "Invalid type for NORMAL attribute.");
-        Check(accessor.component_type == cgltf_component_type_r_32f,
-            "Invalid component type for NORMAL attribute.");
+        Check(baseOffset + accessor.count <= vertices.size(), "Out-of-bound access.");
+        MutableSpan<Vertex> dst(vertices.data() + baseOffset, accessor.count);
+        decode(GetStream(accessor), dst);
 
-        const cgltf_buffer_view& bufferView = *accessor.buffer_view;
-        Check(accessor.stride == sizeof(float3), "Invalid stride for NORMAL attribute.");
+        if (!accessor.is_sparse)
+            return;
 
-        const cgltf_buffer& buffer = *bufferView.buffer;
-        const float3* start = reinterpret_cast<float3*>(reinterpret_cast<uintptr_t>(
-            buffer.data) + bufferView.offset + accessor.offset);
+        SmallVector<uint32_t> sparseIndices;
+        GetSparseIndices(accessor, sparseIndices);
 
-        for (size_t i = 0; i < accessor.count; i++)
-        {
-            const float3* curr = start + i;
+        SmallVector<Vertex> sparseValues;
+        sparseValues.resize(sparseIndices.size());
+        decode(GetSparseValues(accessor), sparseValues);
 
-            // glTF uses a right-handed coordinate system with +Y as up
-            vertices[baseOffset + i].Normal = oct32(curr->x, curr->y, -curr->z);
-        }
+        for (size_t i = 0; i < sparseIndices.size(); i++)
+            dst[sparseIndices[i]].*member = sparseValues[i].*member;
     }
 
-    void ProcessTexCoords(const cgltf_data& model, const cgltf_accessor& accessor, 
+    // KHR_mesh_quantization allows 8 and 16-bit integers for positions and texture coordinates 
+    // (either normalized or not) and normalized 8 and 16-bit integers for normals and tangents
+    ZetaInline bool IsValidComponentType(const cgltf_accessor& accessor, bool allowUnnormalized)
+    {
+        if (accessor.component_type == cgltf_component_type_r_32f)
+            return true;
+
+        return (accessor.normalized || allowUnnormalized) && (
+            accessor.component_type == cgltf_component_type_r_8 ||
+            accessor.component_type == cgltf_component_type_r_8u ||
+            accessor.component_type == cgltf_component_type_r_16 ||
+            accessor.component_type == cgltf_component_type_r_16u);
+    }
+
+    void ProcessPositions(const cgltf_data& model, const cgltf_accessor& accessor, 
         MutableSpan<Vertex> vertices, uint32_t baseOffset)
     {
-        Check(accessor.type == cgltf_type_vec2, "Invalid type for TEXCOORD_0 attribute.");
-        Check(accessor.component_type == cgltf_component_type_r_32f,
-            "Invalid component type for TEXCOORD_0 attribute.");
+        Check(accessor.type == cgltf_type_vec3, "Invalid type for POSITION attribute.");
+        Check(IsValidComponentType(accessor, true), "Invalid component type for POSITION attribute.");
 
-        const cgltf_buffer_view& bufferView = *accessor.buffer_view;
-        Check(accessor.stride == sizeof(float2), "Invalid stride for TEXCOORD_0 attribute.");
+        // glTF uses a right-handed coordinate system with +Y as up
+        ProcessAttribute(accessor, &Vertex::Position, glTF::Accessor::DecodePositions, vertices, baseOffset);
+    }
 
-        const cgltf_buffer& buffer = *bufferView.buffer;
-        const float2* start = reinterpret_cast<float2*>(reinterpret_cast<uintptr_t>(
-            buffer.data) + bufferView.offset + accessor.offset);
+    void ProcessNormals(const cgltf_data& model, const cgltf_accessor& accessor, 
+        MutableSpan<Vertex> vertices, uint32_t baseOffset)
+    {
+        Check(accessor.type == cgltf_type_vec3, "Invalid type for NORMAL attribute.");
+        Check(IsValidComponentType(accessor, false), "Invalid component type for NORMAL attribute.");
 
-        for (size_t i = 0; i < accessor.count; i++)
-        {
-            const float2* curr = start + i;
-            vertices[baseOffset + i].TexUV = float2(curr->x, curr->y);
-        }
+        ProcessAttribute(accessor, &Vertex::Normal, glTF::Accessor::DecodeNormals, vertices, baseOffset);
     }
 
-    void ProcessTangents(const cgltf_data& model, const cgltf_accessor& accessor, 
+    void ProcessTexCoords(const cgltf_data& model, const cgltf_accessor& accessor, 
         MutableSpan<Vertex> vertices, uint32_t baseOffset)
     {
-        Check(accessor.type == cgltf_type_vec4, "Invalid type for TANGENT attribute.");
-        Check(accessor.component_type == cgltf_component_type_r_32f,
-            "Invalid component type for TANGENT attribute.");
-
-        const cgltf_buffer_view& bufferView = *accessor.buffer_view;
+        Check(accessor.type == cgltf_type_vec2, "Invalid type for TEXCOORD_0 attribute.");
+        Check(IsValidComponentType(accessor, true), "Invalid component type for TEXCOORD_0 attribute.");
 
-        const cgltf_buffer& buffer = *bufferView.buffer;
-        const float4* start = reinterpret_cast<float4*>(reinterpret_cast<uintptr_t>(
-            buffer.data) + bufferView.offset + accessor.offset);
+        ProcessAttribute(accessor, &Vertex::TexUV, glTF::Accessor::DecodeTexCoords, vertices, baseOffset);
+    }
 
-        for (size_t i = 0; i < accessor.count; i++)
-        {
-            const float4* curr = start + i;
+    void ProcessTangents(const cgltf_data& model, const cgltf_accessor& accessor, 
+        MutableSpan<Vertex> vertices, uint32_t baseOffset)
+    {
+        Check(accessor.type == cgltf_type_vec4, "Invalid type for TANGENT attribute.");
+        Check(IsValidComponentType(accessor, false), "Invalid component type for TANGENT attribute.");
 
-            // glTF uses a right-handed coordinate system with +Y as up
-            vertices[baseOffset + i].Tangent = oct32(curr->x, curr->y, -curr->z);
-        }
+        ProcessAttribute(accessor, &Vertex::Tangent, glTF::Accessor::DecodeTangents, vertices, baseOffset);
     }
 
     void ProcessIndices(const cgltf_data& model, const cgltf_accessor& accessor, 
         MutableSpan<uint32_t> indices, uint32_t baseOffset)
     {
         Check(accessor.type == cgltf_type_scalar, "Invalid index type.");
-        Check(accessor.stride != -1, "Invalid index stride.");
+        Check(accessor.component_type == cgltf_component_type_r_8u ||
+            accessor.component_type == cgltf_component_type_r_16u ||
+            accessor.component_type == cgltf_component_type_r_32u, "Invalid index component type.");
+        Check(accessor.stride == cgltf_component_size(accessor.component_type), "Invalid index stride.");
         Check(accessor.count % 3 == 0, "Invalid number of indices.");
+        Check(accessor.buffer_view, "Index buffer is required.");
+        Check(baseOffset + accessor.count <= indices.size(), "Out-of-bound access.");
 
-        const cgltf_buffer_view& bufferView = *accessor.buffer_view;
-        const cgltf_buffer& buffer = *bufferView.buffer;
+        MutableSpan<uint32_t> dst(indices.data() + baseOffset, accessor.count);
 
-        // Populate the mesh indices
-        uint8_t* curr = reinterpret_cast<uint8_t*>(reinterpret_cast<uintptr_t>(buffer.data) + bufferView.offset + accessor.offset);
-        const size_t numFaces = accessor.count / 3;
-        const size_t indexStrideInBytes = accessor.stride;
-        size_t currIdxOffset = 0;
+        // Use clockwise ordering. With sparse substitutions, winding is flipped afterwards.
+        glTF::Accessor::DecodeIndices(GetStream(accessor), dst, !accessor.is_sparse);
 
-        for (size_t face = 0; face < numFaces; face++)
-        {
-            uint32_t i0 = 0;
-            uint32_t i1 = 0;
-            uint32_t i2 = 0;
-
-            memcpy(&i0, curr, indexStrideInBytes);
-            curr += indexStrideInBytes;
-            memcpy(&i1, curr, indexStrideInBytes);
-            curr += indexStrideInBytes;
-            memcpy(&i2, curr, indexStrideInBytes);
-            curr += indexStrideInBytes;
-
-            // Use clockwise ordering
-            indices[baseOffset + currIdxOffset++] = i0;
-            indices[baseOffset + currIdxOffset++] = i2;
-            indices[baseOffset + currIdxOffset++] = i1;
-        }
+        if (!accessor.is_sparse)
+            return;
+
+        SmallVector<uint32_t> sparseIndices;
+        GetSparseIndices(accessor, sparseIndices);
+
+        glTF::Accessor::Stream values = GetSparseValues(accessor);
+        SmallVector<uint32_t> sparseValues;
+        sparseValues.resize(sparseIndices.size());
+        glTF::Accessor::DecodeIndices(values, sparseValues, false);
+
+        for (size_t i = 0; i < sparseIndices.size(); i++)
+            dst[sparseIndices[i]] = sparseValues[i];
+
+        glTF::Accessor::FlipWinding(dst);
     }
 
     void ProcessMeshes(const cgltf_data& model, uint32_t sceneID, size_t offset, size_t size,
         MutableSpan<Vertex> vertices, std::atomic_uint32_t& vertexCounter,
         MutableSpan<uint32_t> indices, std::atomic_uint32_t& idxCounter,
         MutableSpan<Mesh> meshes, std::atomic_uint32_t& meshCounter,
-        MutableSpan<EmissiveMeshPrim> emissivesPrims, uint32_t& emissivePrimCount)
+        MutableSpan<EmissiveMeshPrim> emissivesPrims, std::atomic_int32_t& emissivePrimCounter,
+        ThreadContext& tc)
     {
-        SceneCore& scene = App::GetScene();
         uint32_t totalPrims = 0;
         uint32_t totalVertices = 0;
         uint32_t totalIndices = 0;
@@ -316,15 +409,27 @@ namespace
             totalPrims += (uint32_t)mesh.primitives_count;
         }
 
-        // (sub)allocate
-        const uint32_t workerBaseVtxOffset = vertexCounter.fetch_add(totalVertices, std::memory_order_relaxed);
+        // (sub)allocate. When meshes are optimized, final number of vertices isn't known until 
+        // all of them have been processed, so they're written to a temporary buffer first.
+        const bool optimize = tc.Opts.OptimizeMeshes;
+        SmallVector<Vertex> optVertices;
+        if (optimize)
+            optVertices.resize(totalVertices);
+
+        const uint32_t workerBaseVtxOffset = optimize ? 0 : 
+            vertexCounter.fetch_add(totalVertices, std::memory_order_relaxed);
         const uint32_t workerBaseIdxOffset = idxCounter.fetch_add(totalIndices, std::memory_order_relaxed);
         const uint32_t workerPrimBaseOffset = meshCounter.fetch_add(totalPrims, std::memory_order_relaxed);
         const uint32_t workerBaseEmissiveOffset = workerPrimBaseOffset;
+        MutableSpan<Vertex> dstVertices = optimize ? MutableSpan<Vertex>(optVertices) : vertices;
 
         uint32_t currVtxOffset = workerBaseVtxOffset;
         uint32_t currIdxOffset = workerBaseIdxOffset;
         uint32_t currMeshPrimOffset = workerPrimBaseOffset;
+        uint64_t numVerticesBeforeOpt = 0;
+        uint64_t numVerticesAfterOpt = 0;
+        uint64_t numCacheMissesBeforeOpt = 0;
+        uint64_t numCacheMissesAfterOpt = 0;
 
         // Now iterate again and populate the buffers
         for (size_t meshIdx = offset; meshIdx != offset + size; meshIdx++)
@@ -356,16 +461,16 @@ namespace
 
                 // Populate the vertex attributes
                 const cgltf_accessor& accessor = *prim.attributes[posIt].data;
-                const uint32_t numVertices = (uint32_t)accessor.count;
+                uint32_t numVertices = (uint32_t)accessor.count;
 
                 const cgltf_buffer_view& bufferView = *prim.indices->buffer_view;
                 const uint32_t numIndices = (uint32_t)prim.indices->count;
 
                 // POSITION
-                ProcessPositions(model, *prim.attributes[posIt].data, vertices, currVtxOffset);
+                ProcessPositions(model, *prim.attributes[posIt].data, dstVertices, currVtxOffset);
 
                 // NORMAL
-                ProcessNormals(model, *prim.attributes[normalIt].data, vertices, currVtxOffset);
+                ProcessNormals(model, *prim.attributes[normalIt].data, dstVertices, currVtxOffset);
 
                 // indices
                 ProcessIndices(model, *prim.indices, indices, currIdxOffset);
@@ -373,20 +478,43 @@ namespace
                 // TEXCOORD_0
                 if (texIt != -1)
                 {
-                    ProcessTexCoords(model, *prim.attributes[texIt].data, vertices, currVtxOffset);
+                    ProcessTexCoords(model, *prim.attributes[texIt].data, dstVertices, currVtxOffset);
 
                     // If vertex tangents aren't present, compute them. Make sure the computation 
                     // happens after vertex and index processing.
                     if (tangentIt != -1)
-                        ProcessTangents(model, *prim.attributes[tangentIt].data, vertices, currVtxOffset);
+                        ProcessTangents(model, *prim.attributes[tangentIt].data, dstVertices, currVtxOffset);
                     else if(prim.material->normal_texture.texture)
                     {
-                        Math::ComputeMeshTangentVectors(MutableSpan(vertices.begin() + currVtxOffset, numVertices),
+                        Math::ComputeMeshTangentVectors(MutableSpan(dstVertices.begin() + currVtxOffset, numVertices),
                             Span(indices.begin() + currIdxOffset, numIndices),
                             false);
                     }
                 }
 
+                if (optimize)
+                {
+                    const MeshOptimizer::Stats stats = MeshOptimizer::Optimize(
+                        MutableSpan(dstVertices.begin() + currVtxOffset, numVertices),
+                        MutableSpan(indices.begin() + currIdxOffset, numIndices));
+
+                    if (tc.Opts.LogMeshStats)
+                    {
+                        LOG_UI_INFO("Mesh %s (primitive %d): ACMR %.3f -> %.3f, %u -> %u vertices (%u -> %u KB)\n",
+                            mesh.name ? mesh.name : "unnamed", primIdx,
+                            stats.ACMRBefore(), stats.ACMRAfter(),
+                            stats.NumVerticesBefore, stats.NumVerticesAfter,
+                            uint32_t(stats.NumVerticesBefore * sizeof(Vertex) / 1024),
+                            uint32_t(stats.NumVerticesAfter * sizeof(Vertex) / 1024));
+                    }
+
+                    numVerticesBeforeOpt += stats.NumVerticesBefore;
+                    numVerticesAfterOpt += stats.NumVerticesAfter;
+                    numCacheMissesBeforeOpt += stats.NumCacheMissesBefore;
+                    numCacheMissesAfterOpt += stats.NumCacheMissesAfter;
+                    numVertices = stats.NumVerticesAfter;
+                }
+
                 meshes[currMeshPrimOffset++] = Mesh
                     {
                         .SceneID = sceneID,
@@ -427,14 +555,33 @@ namespace
             }
         }
 
-        emissivePrimCount = numEmissiveMeshPrims;
+        if (optimize)
+        {
+            // Now that the final number of vertices is known, (sub)allocate and copy over
+            const uint32_t baseVtxOffset = vertexCounter.fetch_add(currVtxOffset, std::memory_order_relaxed);
+            memcpy(vertices.begin() + baseVtxOffset, optVertices.data(), currVtxOffset * sizeof(Vertex));
+
+            for (uint32_t i = workerPrimBaseOffset; i < currMeshPrimOffset; i++)
+                meshes[i].BaseVtxOffset += baseVtxOffset;
+
+            for (int i = 0; i < numEmissiveMeshPrims; i++)
+                emissivesPrims[workerBaseEmissiveOffset + i].BaseVtxOffset += baseVtxOffset;
+
+            tc.NumVerticesBeforeOpt.fetch_add(numVerticesBeforeOpt, std::memory_order_relaxed);
+            tc.NumVerticesAfterOpt.fetch_add(numVerticesAfterOpt, std::memory_order_relaxed);
+            tc.NumCacheMissesBeforeOpt.fetch_add(numCacheMissesBeforeOpt, std::memory_order_relaxed);
+            tc.NumCacheMissesAfterOpt.fetch_add(numCacheMissesAfterOpt, std::memory_order_relaxed);
+        }
+
+        emissivePrimCounter.fetch_add(numEmissiveMeshPrims, std::memory_order_relaxed);
     }
 
-    void LoadDDSImages(uint32_t sceneID, const Filesystem::Path& modelDir, const cgltf_data& model,
+    void LoadDDSImages(uint32_t sceneID, const Filesystem::Path& modelDir, Span<const char*> imagePaths,
         size_t offset, size_t num, MutableSpan<Texture> ddsImages)
     {
-        // For loading DDS data from disk
-        MemoryArena memArena(64 * 1024 * 1024);
+        // For loading DDS data from disk. Pages are committed as needed and texture data 
+        // usually goes through the arena's large-allocation path.
+        MemoryArena memArena;
         // For uploading texture to GPU 
         UploadHeapArena heapArena(64 * 1024 * 1024);
 
@@ -452,12 +599,10 @@ namespace
 
         for (size_t m = offset; m != offset + num; m++)
         {
-            const cgltf_image& image = model.images[m];
             const size_t idx = m - offset;
-            Check(image.uri, "Image has no URI.");
 
             Filesystem::Path path(modelDir.GetView());
-            path.Append(image.uri);
+            path.Append(imagePaths[m]);
 
             char ext[8];
             path.Extension(ext);
@@ -521,7 +666,7 @@ namespace
     }
 
     void ProcessMaterials(uint32_t sceneID, const Filesystem::Path& modelDir, const cgltf_data& model,
-        int offset, int size, MutableSpan<Texture> ddsImages)
+        int offset, int size, MutableSpan<MaterialDesc> materials)
     {
         auto getAlphaMode = [](cgltf_alpha_mode m)
             {
@@ -546,7 +691,8 @@ namespace
             const auto& mat = model.materials[m];
             Check(mat.has_pbr_metallic_roughness, "Material is not supported.");
 
-            glTF::Asset::MaterialDesc desc;
+            glTF::Asset::MaterialDesc& desc = materials[m];
+            desc = glTF::Asset::MaterialDesc();
             desc.ID = Scene::MaterialID(sceneID, m);
             desc.AlphaMode = getAlphaMode(mat.alpha_mode);
             desc.AlphaCutoff = (float)mat.alpha_cutoff;
@@ -636,9 +782,6 @@ namespace
                 desc.CoatWeight = mat.clearcoat.clearcoat_factor;
                 desc.CoatRoughness = mat.clearcoat.clearcoat_roughness_factor;
             }
-
-            SceneCore& scene = App::GetScene();
-            scene.AddMaterial(desc, ddsImages, false);
         }
     }
 
@@ -692,7 +835,6 @@ namespace
     void ProcessEmissiveSubtree(const cgltf_node& node, ThreadContext& context, int& emissiveMeshIdx,
         uint32_t& rtEmissiveTriIdx)
     {
-        SceneCore& scene = App::GetScene();
         uint32_t currGlobalTriIdx = rtEmissiveTriIdx;
 
         if (node.mesh)
@@ -717,9 +859,9 @@ namespace
                             meshPrim.material->emissive_factor[2]));
 
                         const auto& meshPrimInfo = context.EmissiveMeshPrims[idx];
-
-                        const uint32_t matID = Scene::MaterialID(context.SceneID, meshPrimInfo.MaterialIdx);
-                        const Material* mat = scene.GetMaterial(matID).value();
+                        const cgltf_material& mat = *meshPrim.material;
+                        const half emissiveStr = half(mat.has_emissive_strength ? 
+                            mat.emissive_strength.emissive_strength : 1.0f);
 
                         const int nodeIdx = (int)(&node - context.Model->nodes);
                         const uint64_t currInstanceID = Scene::InstanceID(context.SceneID, nodeIdx, meshIdx, primIdx);
@@ -749,8 +891,8 @@ namespace
                             context.RTEmissives[currGlobalTriIdx++] = RT::EmissiveTriangle(
                                 v0.Position, v1.Position, v2.Position,
                                 v0.TexUV, v1.TexUV, v2.TexUV,
-                                emissiveFactorRGB, mat->GetEmissiveTex(), mat->GetEmissiveStrength(),
-                                currMeshTriIdx++, mat->DoubleSided());
+                                emissiveFactorRGB, Material::INVALID_ID, emissiveStr,
+                                currMeshTriIdx++, mat.double_sided);
                         }
                     }
                 }
@@ -782,7 +924,7 @@ namespace
     }
 
     void ProcessNodeSubtree(const cgltf_node& node, uint32_t sceneID, const cgltf_data& model,
-        uint64_t parentId)
+        uint64_t parentId, SmallVector<InstanceDesc>& instances)
     {
         uint64_t currInstanceID = SceneCore::ROOT_ID;
 
@@ -921,8 +1063,7 @@ namespace
                     .RtInstanceMask = rtInsMask,
                     .IsOpaque = isOpaque };
 
-                SceneCore& scene = App::GetScene();
-                scene.AddInstance(desc, false);
+                instances.push_back(desc);
             }
         }
         else
@@ -940,24 +1081,51 @@ namespace
                     .RtInstanceMask = RT_AS_SUBGROUP::NON_EMISSIVE,
                     .IsOpaque = true };
 
-            SceneCore& scene = App::GetScene();
-            scene.AddInstance(desc, false);
+            instances.push_back(desc);
         }
 
         for (int c = 0; c < node.children_count; c++)
         {
             const cgltf_node& childNode = *node.children[c];
-            ProcessNodeSubtree(childNode, sceneID, model, currInstanceID);
+            ProcessNodeSubtree(childNode, sceneID, model, currInstanceID, instances);
         }
     }
 
-    void ProcessNodes(const cgltf_data& model, uint32_t sceneID)
+    void ProcessNodes(const cgltf_data& model, uint32_t sceneID, SmallVector<InstanceDesc>& instances)
     {
-        for (size_t i = 0; i < model.scene->nodes_count; i++)
+        // Subtrees of root nodes are independent. Each chunk of them is processed in parallel 
+        // and chunks are then concatenated in order, so instances remain in depth-first order.
+        constexpr size_t ROOTS_PER_CHUNK = 16;
+        const size_t numRoots = model.scene->nodes_count;
+        const size_t numChunks = (numRoots + ROOTS_PER_CHUNK - 1) / ROOTS_PER_CHUNK;
+
+        if (numChunks <= 1)
         {
-            const cgltf_node& node = *model.scene->nodes[i];
-            ProcessNodeSubtree(node, sceneID, model, SceneCore::ROOT_ID);
+            for (size_t i = 0; i < numRoots; i++)
+                ProcessNodeSubtree(*model.scene->nodes[i], sceneID, model, SceneCore::ROOT_ID, instances);
+
+            return;
         }
+
+        SmallVector<SmallVector<InstanceDesc>> chunks;
+        chunks.resize(numChunks);
+
+        App::ParallelFor(0, numChunks, 1, [&model, sceneID, numRoots, &chunks](size_t begin, size_t end)
+            {
+                for (size_t c = begin; c < end; c++)
+                {
+                    const size_t last = Min((c + 1) * ROOTS_PER_CHUNK, numRoots);
+
+                    for (size_t i = c * ROOTS_PER_CHUNK; i < last; i++)
+                    {
+                        ProcessNodeSubtree(*model.scene->nodes[i], sceneID, model, SceneCore::ROOT_ID, 
+                            chunks[c]);
+                    }
+                }
+            });
+
+        for (auto& chunk : chunks)
+            instances.append_range(chunk.begin(), chunk.end(), true);
     }
 
     void DescendTree(const cgltf_node& node, int height, Vector<int>& treeLevels)
@@ -1056,215 +1224,551 @@ namespace
             }
         }
     }
-}
 
-void glTF::Load(const App::Filesystem::Path& pathToglTF)
-{
-    // Parse json
-    cgltf_options options{};
-    cgltf_data* model = nullptr;
-    Checkgltf(cgltf_parse_file(&options, pathToglTF.GetView().data(), &model));
-
-    // Load buffers
-    Check(model->buffers_count == 1, "Invalid number of buffers.");
-    Filesystem::Path bufferPath(pathToglTF.GetView());
-    bufferPath.Directory();
-    bufferPath.Append(model->buffers[0].uri);
-    Checkgltf(cgltf_load_buffers(&options, model, bufferPath.Get()));
-
-    Check(model->scene, "glTF model doesn't have a default scene: %s.", pathToglTF.GetView());
-    const uint32_t sceneID = XXH3_64_To_32(XXH3_64bits(pathToglTF.GetView().data(), pathToglTF.Length()));
-    SceneCore& scene = App::GetScene();
+    // Meshes and images are distributed over the worker threads with ParallelFor(). 
+    // Following is the minimum number of items that are processed together.
+    static constexpr size_t MESHES_PER_JOB = 8;
+    // Every image job allocates its own staging memory, so use larger batches
+    static constexpr size_t IMAGES_PER_JOB = 16;
 
-    // Figure out total number of vertices and indices
-    size_t totalNumVertices;
-    size_t totalNumIndices;
-    size_t totalNumMeshPrims;
-    TotalNumVerticesAndIndices(model, totalNumVertices, totalNumIndices, totalNumMeshPrims);
+    void SplitImagePaths(Span<char> blob, SmallVector<const char*>& paths)
+    {
+        const char* curr = blob.data();
+        const char* end = blob.data() + blob.size();
 
-    // Height of the node hierarchy
-    const int height = ComputeNodeHierarchyHeight(*model);
-    constexpr int DEFAULT_NUM_LEVELS = 10;
-    SmallVector<int, SystemAllocator, DEFAULT_NUM_LEVELS> levels;
-    levels.resize(height, 0);
+        while (curr != end)
+        {
+            paths.push_back(curr);
+            curr += strlen(curr) + 1;
+        }
+    }
 
-    // Precompute number of nodes per level
-    PrecomputeNodeHierarchy(*model, levels);
+    // Emissive texture index is a descriptor table offset that's assigned when materials are 
+    // added to the scene
+    void PatchEmissiveTextures(uint32_t sceneID, Span<EmissiveInstance> instances, 
+        MutableSpan<RT::EmissiveTriangle> tris)
+    {
+        SceneCore& scene = App::GetScene();
 
-    size_t total = 0;
-    for (size_t i = 0; i < levels.size(); i++)
-        total += levels[i];
+        for (auto& instance : instances)
+        {
+            // Emissive instances store material index plus one
+            const uint32_t matID = Scene::MaterialID(sceneID, instance.MaterialIdx - 1);
+            const Material* mat = scene.GetMaterial(matID).value();
+            const uint32_t emissiveTex = mat->GetEmissiveTex();
 
-    // Preallocate
-    scene.ResizeAdditionalMaterials((uint32_t)model->materials_count);
-    scene.ReserveInstances(levels, total);
-
-    // How many meshes are processed by each worker
-    constexpr size_t MAX_NUM_MESH_WORKERS = 4;
-    constexpr size_t MIN_MESHES_PER_WORKER = 20;
-    size_t meshWorkerOffset[MAX_NUM_MESH_WORKERS];
-    size_t meshWorkerCount[MAX_NUM_MESH_WORKERS];
-    uint32_t workerEmissiveCount[MAX_NUM_MESH_WORKERS];
-
-    const int numMeshWorkers = (int)SubdivideRangeWithMin(model->meshes_count,
-        MAX_NUM_MESH_WORKERS,
-        meshWorkerOffset,
-        meshWorkerCount,
-        MIN_MESHES_PER_WORKER);
-
-    // How many images are processed by each worker
-    constexpr size_t MAX_NUM_IMAGE_WORKERS = 5;
-    constexpr size_t MIN_IMAGES_PER_WORKER = 15;
-    size_t imgWorkerOffset[MAX_NUM_IMAGE_WORKERS];
-    size_t imgWorkerCount[MAX_NUM_IMAGE_WORKERS];
-
-    const int numImgWorkers = (int)SubdivideRangeWithMin(model->images_count,
-        MAX_NUM_IMAGE_WORKERS,
-        imgWorkerOffset,
-        imgWorkerCount,
-        MIN_IMAGES_PER_WORKER);
+            for (uint32_t t = instance.BaseTriOffset; t < instance.BaseTriOffset + instance.NumTriangles; t++)
+                tris[t].PackedB = (tris[t].PackedB & ~Material::TEXTURE_MASK) | emissiveTex;
+        }
+    }
 
-    ThreadContext tc;
-    tc.glTFPath = &pathToglTF;
-    tc.SceneID = sceneID;
-    tc.Model = model;
-    tc.NumMeshWorkers = numMeshWorkers;
-    tc.NumImgWorkers = numImgWorkers;
-    tc.MeshThreadOffsets = meshWorkerOffset;
-    tc.MeshThreadSizes = meshWorkerCount;
-    tc.ImgThreadOffsets = imgWorkerOffset;
-    tc.ImgThreadSizes = imgWorkerCount;
-    tc.EmissiveMeshPrimCountPerWorker = workerEmissiveCount;
+    // Parses the glTF file and sets up everything that's needed for processing tasks
+    // Quantizes vertices of every mesh and replaces them with the decoded values, so that they 
+    // match what's loaded from the cache
+    void QuantizeVertices(ThreadContext& tc)
+    {
+        tc.CompactVertices.resize(tc.Vertices.size());
+        tc.MeshBounds.resize(tc.Meshes.size());
 
-    // Preallocate
-    tc.Vertices.resize(totalNumVertices);
-    tc.Indices.resize(totalNumIndices);
-    tc.Meshes.resize(totalNumMeshPrims);
-    tc.DDSImages.resize(model->images_count);
-    tc.EmissiveMeshPrims.resize(totalNumMeshPrims);
-    ResetEmissiveSubsets(tc.EmissiveMeshPrims);
+        SmallVector<VertexQuantizer::Error> errors;
+        errors.resize(tc.Meshes.size());
 
-    TaskSet ts;
+        App::ParallelFor(0, tc.Meshes.size(), MESHES_PER_JOB, [&tc, &errors](size_t begin, size_t end)
+            {
+                SmallVector<Vertex> decoded;
 
-    auto procEmissiveMeshPrims = ts.EmplaceTask("gltf::EmissivePrims", [&tc]()
-        {
-            // EmissiveMeshPrimCountPerWorker is filled in by mesh workers
-            for (int i = 0; i < tc.NumMeshWorkers; i++)
-                tc.NumEmissiveMeshPrims += tc.EmissiveMeshPrimCountPerWorker[i];
-
-            // For binary search. Also, since non-emissive meshes were assigned the INVALID
-            // ID (= UINT64_MAX), this also partitions the non-null entries before the null
-            // entries.
-            std::sort(tc.EmissiveMeshPrims.begin(), tc.EmissiveMeshPrims.end(),
-                [](const EmissiveMeshPrim& lhs, const EmissiveMeshPrim& rhs)
+                for (size_t i = begin; i < end; i++)
                 {
-                    return lhs.MeshID < rhs.MeshID;
-                });
-
-            // In order to do only one allocation, number of emissive mesh primitives was assumed
-            // to be the worst case -- total number of mesh primitives. As such, there may be a number 
-            // of "null" entries in the EmissiveMeshPrims. Now that the actual size is known, adjust 
-            // the size accordingly.
-            //tc.EmissiveMeshPrims = MutableSpan(tc.EmissiveMeshPrims.data(), tc.NumEmissiveMeshPrims);
-            tc.EmissiveMeshPrims.resize(tc.NumEmissiveMeshPrims);
-            NumEmissiveInstancesAndTriangles(tc);
-        });
-
-    for (int i = 0; i < tc.NumMeshWorkers; i++)
+                    const Mesh& mesh = tc.Meshes[i];
+                    MutableSpan<Vertex> vertices(tc.Vertices.data() + mesh.BaseVtxOffset, mesh.NumVertices);
+                    MutableSpan<CompactVertex> compact(tc.CompactVertices.data() + mesh.BaseVtxOffset, 
+                        mesh.NumVertices);
+
+                    tc.MeshBounds[i] = VertexQuantizer::ComputeBounds(vertices);
+                    VertexQuantizer::Encode(vertices, tc.MeshBounds[i], compact);
+
+                    decoded.resize(mesh.NumVertices);
+                    VertexQuantizer::Decode(compact, tc.MeshBounds[i], decoded);
+                    errors[i] = VertexQuantizer::MeasureError(vertices, decoded, tc.MeshBounds[i]);
+
+                    memcpy(vertices.data(), decoded.data(), mesh.NumVertices * sizeof(Vertex));
+                }
+            });
+
+        VertexQuantizer::Error err;
+        for (auto& e : errors)
+            err.Merge(e);
+
+        const size_t numVertices = tc.Vertices.size();
+        LOG_UI_INFO("Vertex quantization: max position error %g (%.5f%% of mesh size), max UV error %g, %llu -> %llu KB.\n",
+            err.MaxPositionError, err.MaxRelativePositionError * 100.0f, err.MaxTexUVError,
+            numVertices * sizeof(Vertex) / 1024, numVertices * sizeof(CompactVertex) / 1024);
+
+        tc.Data.CompactVertices = tc.CompactVertices;
+        tc.Data.MeshBounds = tc.MeshBounds;
+    }
+
+    // Partitions every mesh into clusters. Ranges are sized for the worst case first so that 
+    // meshes can be processed in parallel, then compacted in mesh order.
+    void BuildClusters(ThreadContext& tc)
     {
-        StackStr(tname, n, "gltf::Mesh_%d", i);
+        SmallVector<uint32_t> maxOffsets;
+        maxOffsets.resize(tc.Meshes.size() + 1);
+        maxOffsets[0] = 0;
+
+        for (size_t i = 0; i < tc.Meshes.size(); i++)
+            maxOffsets[i + 1] = maxOffsets[i] + ClusterBuilder::MaxNumClusters(tc.Meshes[i].NumIndices / 3);
 
-        auto procMesh = ts.EmplaceTask(tname, [&tc, workerIdx = i]()
+        SmallVector<MeshCluster> clusters;
+        clusters.resize(maxOffsets.back());
+
+        App::ParallelFor(0, tc.Meshes.size(), MESHES_PER_JOB, [&tc, &maxOffsets, &clusters](size_t begin, size_t end)
             {
-                ProcessMeshes(*tc.Model, tc.SceneID, tc.MeshThreadOffsets[workerIdx],
-                    tc.MeshThreadSizes[workerIdx],
-                    tc.Vertices, tc.CurrVtxOffset,
-                    tc.Indices, tc.CurrIdxOffset,
-                    tc.Meshes, tc.CurrMeshPrimOffset,
-                    tc.EmissiveMeshPrims, 
-                    tc.EmissiveMeshPrimCountPerWorker[workerIdx]);
+                for (size_t i = begin; i < end; i++)
+                {
+                    Mesh& mesh = tc.Meshes[i];
+                    // Back faces of double-sided meshes are visible
+                    const bool doubleSided = mesh.glTFMaterialIdx != -1 && 
+                        tc.Model->materials[mesh.glTFMaterialIdx].double_sided;
+
+                    mesh.NumClusters = ClusterBuilder::Build(
+                        Span(tc.Vertices.data() + mesh.BaseVtxOffset, mesh.NumVertices),
+                        Span(tc.Indices.data() + mesh.BaseIdxOffset, mesh.NumIndices),
+                        !doubleSided,
+                        MutableSpan(clusters.data() + maxOffsets[i], maxOffsets[i + 1] - maxOffsets[i]));
+                }
             });
 
-        ts.AddOutgoingEdge(procMesh, procEmissiveMeshPrims);
+        size_t numClusters = 0;
+        for (auto& mesh : tc.Meshes)
+            numClusters += mesh.NumClusters;
+
+        tc.Clusters.resize(numClusters);
+        uint32_t offset = 0;
+
+        for (size_t i = 0; i < tc.Meshes.size(); i++)
+        {
+            Mesh& mesh = tc.Meshes[i];
+            memcpy(tc.Clusters.data() + offset, clusters.data() + maxOffsets[i], mesh.NumClusters * sizeof(MeshCluster));
+            mesh.BaseClusterOffset = offset;
+            offset += mesh.NumClusters;
+        }
+
+        tc.Data.Clusters = tc.Clusters;
     }
 
-    auto procMats = ts.EmplaceTask("gltf::Materials", [&tc]()
+    // Points buffers to their data without copying -- external buffer files are memory-mapped 
+    // and GLB's buffer is its binary chunk, which is part of the already mapped GLB file. Only
+    // buffers that are embedded as data URIs are decoded (by cgltf) into heap memory.
+    void MapBuffers(const App::Filesystem::Path& pathToglTF, cgltf_data& model, ThreadContext& tc)
+    {
+        tc.BufferFiles.resize(model.buffers_count);
+
+        for (size_t i = 0; i < model.buffers_count; i++)
         {
-            // For binary search
-            std::sort(tc.DDSImages.begin(), tc.DDSImages.end(),
-                [](const Texture& lhs, const Texture& rhs)
-                {
-                    return lhs.ID() < rhs.ID();
-                });
+            cgltf_buffer& buffer = model.buffers[i];
+
+            if (!buffer.uri)
+            {
+                Check(i == 0 && model.bin, "Buffer %llu doesn't have a URI.", i);
+                Check(model.bin_size >= buffer.size, "GLB binary chunk is smaller than its buffer.");
+
+                buffer.data = const_cast<void*>(model.bin);
+                tc.glTFFile.Prefetch();
+
+                continue;
+            }
 
-            Filesystem::Path parent(tc.glTFPath->GetView());
-            parent.ToParent();
+            if (strncmp(buffer.uri, "data:", 5) == 0)
+                continue;
+
+            Filesystem::Path bufferPath(pathToglTF.GetView());
+            bufferPath.Directory();
+            bufferPath.Append(buffer.uri);
+
+            Filesystem::MemoryMappedFile& file = tc.BufferFiles[i];
+            const bool opened = file.Open(bufferPath.Get());
+            Check(opened, "Buffer file %s was not found.", bufferPath.Get());
+            Check(file.Size() >= buffer.size, "Buffer file %s is smaller than its buffer.", bufferPath.Get());
 
-            ProcessMaterials(tc.SceneID, parent, *tc.Model, 0, (int)tc.Model->materials_count, 
-                tc.DDSImages);
-        });
+            // Start reading the file in the background. Mesh workers don't have to wait for 
+            // it -- pages that aren't resident yet are faulted in as they're accessed.
+            file.Prefetch();
+            buffer.data = file.Data();
+
+            tc.BufferURIBlob.append_range(buffer.uri, buffer.uri + strlen(buffer.uri) + 1);
+        }
 
-    for (int i = 0; i < numImgWorkers; i++)
+        // Buffers that already have data are skipped
+        cgltf_options options{};
+        Checkgltf(cgltf_load_buffers(&options, &model, pathToglTF.Get()));
+    }
+
+    // Buffers that point into mapped files aren't owned by cgltf, so they're detached before
+    // freeing the model
+    void FreeModel(ThreadContext& tc)
     {
-        StackStr(tname, n, "gltf::Img_%d", i);
+        for (size_t i = 0; i < tc.Model->buffers_count; i++)
+        {
+            cgltf_buffer& buffer = tc.Model->buffers[i];
 
-        // Loads dds textures from disk and upload them to GPU
-        auto h = ts.EmplaceTask(tname, [&tc, workerIdx = i]()
+            if (tc.BufferFiles[i].IsOpen() || (buffer.data && buffer.data == tc.Model->bin))
+                buffer.data = nullptr;
+        }
+
+        cgltf_free(tc.Model);
+        tc.Model = nullptr;
+
+        tc.BufferFiles.free_memory();
+        tc.glTFFile.Close();
+    }
+
+    void Parse(const App::Filesystem::Path& pathToglTF, ThreadContext& tc)
+    {
+        // Parse json. GLB's binary chunk is used in place, so the file stays mapped until the
+        // model is freed.
+        const bool opened = tc.glTFFile.Open(pathToglTF.Get());
+        Check(opened, "glTF file %s was not found.", pathToglTF.Get());
+
+        cgltf_options options{};
+        cgltf_data* model = nullptr;
+        Checkgltf(cgltf_parse(&options, tc.glTFFile.Data(), tc.glTFFile.Size(), &model));
+        tc.Model = model;
+
+        // Load buffers
+        MapBuffers(pathToglTF, *model, tc);
+
+        Check(model->scene, "glTF model doesn't have a default scene: %s.", pathToglTF.GetView());
+
+        // Figure out total number of vertices and indices
+        size_t totalNumVertices;
+        size_t totalNumIndices;
+        size_t totalNumMeshPrims;
+        TotalNumVerticesAndIndices(model, totalNumVertices, totalNumIndices, totalNumMeshPrims);
+
+        // Height of the node hierarchy
+        const int height = ComputeNodeHierarchyHeight(*model);
+        tc.TreeLevels.resize(height, 0);
+
+        // Precompute number of nodes per level
+        PrecomputeNodeHierarchy(*model, tc.TreeLevels);
+
+        size_t totalNumInstances = 0;
+        for (size_t i = 0; i < tc.TreeLevels.size(); i++)
+            totalNumInstances += tc.TreeLevels[i];
+
+        // Image paths, one after the other
+        for (size_t i = 0; i < model->images_count; i++)
+        {
+            const cgltf_image& image = model->images[i];
+            Check(image.uri, "Image has no URI.");
+
+            tc.ImagePathBlob.append_range(image.uri, image.uri + strlen(image.uri) + 1);
+        }
+
+        // Preallocate
+        tc.Vertices.resize(totalNumVertices);
+        tc.Indices.resize(totalNumIndices);
+        tc.Meshes.resize(totalNumMeshPrims);
+        tc.Materials.resize(model->materials_count);
+        tc.Instances.reserve(totalNumInstances);
+        tc.EmissiveMeshPrims.resize(totalNumMeshPrims);
+        ResetEmissiveSubsets(tc.EmissiveMeshPrims);
+
+        tc.Data.BufferURIs = tc.BufferURIBlob;
+        tc.Data.Vertices = tc.Vertices;
+        tc.Data.Indices = tc.Indices;
+        tc.Data.Meshes = tc.Meshes;
+        tc.Data.Materials = tc.Materials;
+        tc.Data.ImagePaths = tc.ImagePathBlob;
+        tc.Data.TreeLevels = tc.TreeLevels;
+    }
+
+    // Tasks that convert the parsed glTF to scene data. Scene isn't touched, so these can run 
+    // without a renderer. Returns the task that runs after all the others have finished.
+    TaskSet::TaskHandle EmplaceProcessingTasks(TaskSet& ts, ThreadContext& tc, TaskSet::TaskHandle& procMats, 
+        TaskSet::TaskHandle& procNodes, bool writeCache)
+    {
+        auto procEmissiveMeshPrims = ts.EmplaceTask("gltf::EmissivePrims", [&tc]()
+            {
+                // For binary search. Also, since non-emissive meshes were assigned the INVALID
+                // ID (= UINT64_MAX), this also partitions the non-null entries before the null
+                // entries.
+                std::sort(tc.EmissiveMeshPrims.begin(), tc.EmissiveMeshPrims.end(),
+                    [](const EmissiveMeshPrim& lhs, const EmissiveMeshPrim& rhs)
+                    {
+                        return lhs.MeshID < rhs.MeshID;
+                    });
+
+                // In order to do only one allocation, number of emissive mesh primitives was assumed
+                // to be the worst case -- total number of mesh primitives. As such, there may be a number 
+                // of "null" entries in the EmissiveMeshPrims. Now that the actual size is known, adjust 
+                // the size accordingly.
+                tc.EmissiveMeshPrims.resize(tc.NumEmissiveMeshPrims.load(std::memory_order_relaxed));
+                NumEmissiveInstancesAndTriangles(tc);
+            });
+
+        auto procMeshes = ts.EmplaceTask("gltf::Meshes", [&tc]()
+            {
+                App::ParallelFor(0, tc.Model->meshes_count, MESHES_PER_JOB, [&tc](size_t begin, size_t end)
+                    {
+                        ProcessMeshes(*tc.Model, tc.SceneID, begin, end - begin,
+                            tc.Vertices, tc.CurrVtxOffset,
+                            tc.Indices, tc.CurrIdxOffset,
+                            tc.Meshes, tc.CurrMeshPrimOffset,
+                            tc.EmissiveMeshPrims, 
+                            tc.NumEmissiveMeshPrims,
+                            tc);
+                    });
+
+                if (tc.Opts.OptimizeMeshes)
+                {
+                    // Welded vertices leave unused space at the end
+                    tc.Vertices.resize(tc.CurrVtxOffset.load(std::memory_order_relaxed));
+                    tc.Data.Vertices = tc.Vertices;
+
+                    const uint64_t numVerticesBefore = tc.NumVerticesBeforeOpt.load(std::memory_order_relaxed);
+                    const uint64_t numVerticesAfter = tc.NumVerticesAfterOpt.load(std::memory_order_relaxed);
+                    const double numTris = (double)Math::Max(tc.Indices.size() / 3, size_t(1));
+
+                    LOG_UI_INFO("Mesh optimization: ACMR %.3f -> %.3f, %llu -> %llu vertices (%llu -> %llu KB).\n",
+                        tc.NumCacheMissesBeforeOpt.load(std::memory_order_relaxed) / numTris,
+                        tc.NumCacheMissesAfterOpt.load(std::memory_order_relaxed) / numTris,
+                        numVerticesBefore, numVerticesAfter,
+                        numVerticesBefore * sizeof(Vertex) / 1024, numVerticesAfter * sizeof(Vertex) / 1024);
+                }
+
+                if (tc.Opts.CompactVertices)
+                    QuantizeVertices(tc);
+
+                // After quantization, so that bounds enclose the final positions
+                BuildClusters(tc);
+            });
+
+        ts.AddOutgoingEdge(procMeshes, procEmissiveMeshPrims);
+
+        procMats = ts.EmplaceTask("gltf::Materials", [&tc]()
             {
                 Filesystem::Path parent(tc.glTFPath->GetView());
                 parent.ToParent();
 
-                LoadDDSImages(tc.SceneID, parent, *tc.Model, tc.ImgThreadOffsets[workerIdx], 
-                    tc.ImgThreadSizes[workerIdx], tc.DDSImages);
+                ProcessMaterials(tc.SceneID, parent, *tc.Model, 0, (int)tc.Model->materials_count, 
+                    tc.Materials);
+            });
+
+        // For each node with an emissive mesh primitive, add all of its triangles to 
+        // the emissives buffer
+        auto procEmissives = ts.EmplaceTask("gltf::Emissives", [&tc]()
+            {
+                tc.EmissiveInstances.resize(tc.NumEmissiveInstances);
+                tc.RTEmissives.resize(tc.NumEmissiveTris);
+
+                ProcessEmissives(tc);
+
+                tc.Data.EmissiveInstances = tc.EmissiveInstances;
+                tc.Data.EmissiveTris = tc.RTEmissives;
+            });
+
+        ts.AddOutgoingEdge(procEmissiveMeshPrims, procEmissives);
+
+        procNodes = ts.EmplaceTask("gltf::Nodes", [&tc]()
+            {
+                ProcessNodes(*tc.Model, tc.SceneID, tc.Instances);
+                tc.Data.Instances = tc.Instances;
+            });
+
+        auto last = ts.EmplaceTask("gltf::WriteCache", [&tc, writeCache]()
+            {
+                if (writeCache)
+                    glTF::Cache::Write(*tc.glTFPath, tc.SceneID, glTF::Cache::GetFlags(tc.Opts), tc.Data);
+
+                // Everything that's needed from the glTF file has been copied out
+                FreeModel(tc);
+            });
+
+        ts.AddOutgoingEdge(procMeshes, last);
+        ts.AddOutgoingEdge(procMats, last);
+        ts.AddOutgoingEdge(procEmissives, last);
+        ts.AddOutgoingEdge(procNodes, last);
+
+        return last;
+    }
+
+    // Tasks that add scene data to the scene. Given tasks, if valid, indicate when the 
+    // corresponding data is ready.
+    void EmplaceSceneTasks(TaskSet& ts, ThreadContext& tc, TaskSet::TaskHandle matsReady, TaskSet::TaskHandle nodesReady, 
+        TaskSet::TaskHandle allReady)
+    {
+        auto addEdge = [&ts](TaskSet::TaskHandle from, TaskSet::TaskHandle to)
+            {
+                if (from != TaskSet::INVALID_TASK_HANDLE)
+                    ts.AddOutgoingEdge(from, to);
+            };
+
+        // Loads dds textures from disk and upload them to GPU
+        auto procImages = ts.EmplaceTask("gltf::Images", [&tc]()
+            {
+                App::ParallelFor(0, tc.ImagePaths.size(), IMAGES_PER_JOB, [&tc](size_t begin, size_t end)
+                    {
+                        Filesystem::Path parent(tc.glTFPath->GetView());
+                        parent.ToParent();
+
+                        LoadDDSImages(tc.SceneID, parent, tc.ImagePaths, begin, end - begin, tc.DDSImages);
+                    });
+            });
+
+        auto addMats = ts.EmplaceTask("gltf::AddMaterials", [&tc]()
+            {
+                // For binary search
+                std::sort(tc.DDSImages.begin(), tc.DDSImages.end(),
+                    [](const Texture& lhs, const Texture& rhs)
+                    {
+                        return lhs.ID() < rhs.ID();
+                    });
+
+                SceneCore& scene = App::GetScene();
+
+                for (auto& desc : tc.Data.Materials)
+                    scene.AddMaterial(desc, tc.DDSImages, false);
             });
 
         // Material processing should start after textures are loaded
-        ts.AddOutgoingEdge(h, procMats);
+        ts.AddOutgoingEdge(procImages, addMats);
+        addEdge(matsReady, addMats);
+
+        auto addEmissives = ts.EmplaceTask("gltf::AddEmissives", [&tc]()
+            {
+                PatchEmissiveTextures(tc.SceneID, tc.Data.EmissiveInstances, tc.Data.EmissiveTris);
+
+                SceneCore& scene = App::GetScene();
+                scene.AddEmissives(tc.Data.EmissiveInstances, tc.Data.EmissiveTris, false);
+            });
+
+        // Emissive textures are known after materials are added
+        ts.AddOutgoingEdge(addMats, addEmissives);
+        addEdge(allReady, addEmissives);
+
+        auto addNodes = ts.EmplaceTask("gltf::AddNodes", [&tc]()
+            {
+                SceneCore& scene = App::GetScene();
+                scene.AddInstances(tc.Data.Instances, false);
+            });
+
+        addEdge(nodesReady, addNodes);
+
+        auto addMeshes = ts.EmplaceTask("gltf::AddMeshes", [&tc]()
+            {
+                SceneCore& scene = App::GetScene();
+                const bool ownsData = tc.Data.Meshes.data() == tc.Meshes.data();
+
+                // Compact vertices are only decoded when the vertex buffer is uploaded. The
+                // full-precision ones (if processed here) aren't needed anymore.
+                if (tc.Opts.CompactVertices)
+                {
+                    tc.Vertices.free_memory();
+
+                    if (ownsData)
+                    {
+                        scene.AddMeshes(ZetaMove(tc.Meshes), ZetaMove(tc.CompactVertices), tc.Data.MeshBounds,
+                            ZetaMove(tc.Indices), tc.Data.Clusters, false);
+                    }
+                    else
+                    {
+                        scene.AddMeshes(tc.Data.Meshes, tc.Data.CompactVertices, tc.Data.MeshBounds,
+                            tc.Data.Indices, tc.Data.Clusters, false);
+                    }
+                }
+                // Transfer ownership of mesh buffers when they were processed here, otherwise copy 
+                // from the cache file
+                else if (ownsData)
+                {
+                    scene.AddMeshes(ZetaMove(tc.Meshes), ZetaMove(tc.Vertices), ZetaMove(tc.Indices), 
+                        tc.Data.Clusters, false);
+                }
+                else
+                {
+                    scene.AddMeshes(tc.Data.Meshes, tc.Data.Vertices, tc.Data.Indices, 
+                        tc.Data.Clusters, false);
+                }
+            });
+
+        addEdge(allReady, addMeshes);
     }
 
-    // For each node with an emissive mesh primitive, add all of its triangles to 
-    // the emissives buffer
-    auto procEmissives = ts.EmplaceTask("gltf::Emissives", [&tc]()
-        {
-            tc.EmissiveInstances.resize(tc.NumEmissiveInstances);
-            tc.RTEmissives.resize(tc.NumEmissiveTris);
+    void RunAndWait(TaskSet& ts)
+    {
+        WaitObject waitObj;
+        ts.Sort();
+        ts.Finalize(&waitObj);
+        App::Submit(ZetaMove(ts));
+
+        // Help out with unfinished tasks. Note: This thread might help
+        // with tasks that are not related to loading glTF.
+        App::FlushWorkerThreadPool();
+        waitObj.Wait();
+    }
+}
+
+void glTF::Load(const App::Filesystem::Path& pathToglTF, const Options& options)
+{
+    DeltaTimer timer;
+    timer.Start();
 
-            ProcessEmissives(tc);
+    ThreadContext tc;
+    tc.glTFPath = &pathToglTF;
+    tc.SceneID = XXH3_64_To_32(XXH3_64bits(pathToglTF.GetView().data(), pathToglTF.Length()));
+    tc.Model = nullptr;
+    tc.Opts = options;
 
-            // Transfer ownership of emissives
-            SceneCore& scene = App::GetScene();
-            scene.AddEmissives(ZetaMove(tc.EmissiveInstances), ZetaMove(tc.RTEmissives), false);
-        });
+    // Use the cache file if it's up to date, otherwise process the glTF file and create it
+    Filesystem::MemoryMappedFile cacheFile;
+    const bool fromCache = Cache::Open(pathToglTF, tc.SceneID, Cache::GetFlags(options), cacheFile, tc.Data);
 
-    // Processing emissives starts after materials are loaded and emissive primitives 
-    // have been processed
-    ts.AddOutgoingEdge(procEmissiveMeshPrims, procEmissives);
-    ts.AddOutgoingEdge(procMats, procEmissives);
+    if (!fromCache)
+        Parse(pathToglTF, tc);
 
-    ts.EmplaceTask("gltf::Nodes", [&tc]()
-        {
-            ProcessNodes(*tc.Model, tc.SceneID);
-        });
+    SplitImagePaths(tc.Data.ImagePaths, tc.ImagePaths);
+    tc.DDSImages.resize(tc.ImagePaths.size());
 
-    auto last = ts.EmplaceTask("gltf::Final", [&tc]()
-        {
-            // Transfer ownership of mesh buffers
-            SceneCore& scene = App::GetScene();
-            scene.AddMeshes(ZetaMove(tc.Meshes), ZetaMove(tc.Vertices), ZetaMove(tc.Indices), false);
+    size_t totalNumInstances = 0;
+    for (auto n : tc.Data.TreeLevels)
+        totalNumInstances += n;
+
+    // Preallocate
+    SceneCore& scene = App::GetScene();
+    scene.ResizeAdditionalMaterials((uint32_t)tc.Data.Materials.size());
+    scene.ReserveInstances(tc.Data.TreeLevels, totalNumInstances);
+
+    TaskSet ts;
+    TaskSet::TaskHandle procMats = TaskSet::INVALID_TASK_HANDLE;
+    TaskSet::TaskHandle procNodes = TaskSet::INVALID_TASK_HANDLE;
+    TaskSet::TaskHandle processed = TaskSet::INVALID_TASK_HANDLE;
 
-            cgltf_free(tc.Model);
-        });
+    if (!fromCache)
+        processed = EmplaceProcessingTasks(ts, tc, procMats, procNodes, true);
 
-    // Final task has to run after all the other tasks
-    ts.AddIncomingEdgeFromAll(last);
+    EmplaceSceneTasks(ts, tc, procMats, procNodes, processed);
+    RunAndWait(ts);
 
-    WaitObject waitObj;
-    ts.Sort();
-    ts.Finalize(&waitObj);
-    App::Submit(ZetaMove(ts));
+    timer.End();
+    LOG_UI_INFO("Loaded %s (%s) in %u [ms].\n", pathToglTF.Get(), fromCache ? "cached" : "glTF", 
+        (uint32_t)timer.DeltaMilli());
+}
+
+void glTF::Bake(const App::Filesystem::Path& pathToglTF, const Options& options, bool writeCache)
+{
+    ThreadContext tc;
+    tc.glTFPath = &pathToglTF;
+    tc.SceneID = XXH3_64_To_32(XXH3_64bits(pathToglTF.GetView().data(), pathToglTF.Length()));
+    tc.Model = nullptr;
+    tc.Opts = options;
+
+    Parse(pathToglTF, tc);
+
+    TaskSet ts;
+    TaskSet::TaskHandle procMats;
+    TaskSet::TaskHandle procNodes;
+    EmplaceProcessingTasks(ts, tc, procMats, procNodes, writeCache);
 
-    // Help out with unfinished tasks. Note: This thread might help
-    // with tasks that are not related to loading glTF.
-    App::FlushWorkerThreadPool();
-    waitObj.Wait();
+    RunAndWait(ts);
 }
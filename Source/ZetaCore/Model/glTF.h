@@ -4,5 +4,25 @@
 
 namespace ZetaRay::Model::glTF
 {
-    void Load(const App::Filesystem::Path& p);
+    struct Options
+    {
+        // Welds duplicate vertices and reorders triangles and vertices for cache locality 
+        // (see MeshOptimizer.h)
+        bool OptimizeMeshes = true;
+        // Logs before/after statistics for every optimized mesh primitive
+        bool LogMeshStats = false;
+        // Quantizes vertices to the 20-byte Core::CompactVertex layout (see VertexQuantizer.h), 
+        // which is what the scene cache stores and what the scene keeps in memory until the 
+        // vertex buffer is uploaded (where they're decoded). Rendered vertices are the same 
+        // whether or not the cache was used.
+        bool CompactVertices = false;
+    };
+
+    // Loads the glTF (or GLB) file and adds it to the scene. Buffer files are memory-mapped 
+    // rather than read. Processed scene data is cached in a binary file next to the glTF file 
+    // (see glTFCache.h), which subsequent loads map instead.
+    void Load(const App::Filesystem::Path& p, const Options& options = Options());
+    // Processes the glTF file without adding anything to the scene and writes the results to 
+    // its cache file, e.g. for baking scenes offline. Doesn't require a renderer.
+    void Bake(const App::Filesystem::Path& p, const Options& options = Options(), bool writeCache = true);
 }
\ No newline at end of file
@@ -0,0 +1,372 @@
+#include "glTFAccessor.h"
+#include "../Math/Common.h"
+
+using namespace ZetaRay;
+using namespace ZetaRay::Core;
+using namespace ZetaRay::Math;
+using namespace ZetaRay::Model::glTF;
+using namespace ZetaRay::Util;
+
+namespace
+{
+    static_assert(sizeof(oct32) == sizeof(uint32_t), "Encoded vectors are stored as 32-bit words.");
+
+    // Number of leading elements that are decoded in batches of eight. Last component of
+    // every element in a batch is read as a 32-bit word, which must not go past the end.
+    size_t NumBatchedElements(const Accessor::Stream& src, int numComponents)
+    {
+        const size_t lastWordEnd = (numComponents - 1) * Accessor::ComponentSize(src.Type) + sizeof(uint32_t);
+        if (src.Stride == 0 || src.SizeInBytes < lastWordEnd)
+            return 0;
+
+        const size_t numReadable = Min((src.SizeInBytes - lastWordEnd) / src.Stride + 1, src.Count);
+
+        return numReadable & ~size_t(7);
+    }
+
+    ZetaInline float LoadComponent(const uint8_t* ptr, Accessor::COMPONENT_TYPE type, bool normalized)
+    {
+        // Normalized integers are converted as specified by glTF, e.g. max(c / 127.0, -1.0)
+        // for signed bytes
+        switch (type)
+        {
+        case Accessor::COMPONENT_TYPE::INT8:
+        {
+            int8_t v;
+            memcpy(&v, ptr, sizeof(v));
+            return normalized ? Max(v / 127.0f, -1.0f) : float(v);
+        }
+        case Accessor::COMPONENT_TYPE::UINT8:
+        {
+            uint8_t v;
+            memcpy(&v, ptr, sizeof(v));
+            return normalized ? v / 255.0f : float(v);
+        }
+        case Accessor::COMPONENT_TYPE::INT16:
+        {
+            int16_t v;
+            memcpy(&v, ptr, sizeof(v));
+            return normalized ? Max(v / 32767.0f, -1.0f) : float(v);
+        }
+        case Accessor::COMPONENT_TYPE::UINT16:
+        {
+            uint16_t v;
+            memcpy(&v, ptr, sizeof(v));
+            return normalized ? v / 65535.0f : float(v);
+        }
+        default:
+        {
+            float v;
+            memcpy(&v, ptr, sizeof(v));
+            return v;
+        }
+        }
+    }
+
+    // Loads the same component from eight elements -- ptr points to the component in the
+    // first element and vOffsets are byte offsets of other elements relative to it
+    ZetaInline __m256 __vectorcall LoadComponent8(const uint8_t* ptr, __m256i vOffsets,
+        Accessor::COMPONENT_TYPE type, bool normalized)
+    {
+        if (type == Accessor::COMPONENT_TYPE::FLOAT32)
+            return _mm256_i32gather_ps(reinterpret_cast<const float*>(ptr), vOffsets, 1);
+
+        __m256i vWord = _mm256_i32gather_epi32(reinterpret_cast<const int*>(ptr), vOffsets, 1);
+        float maxVal;
+        bool isSigned;
+
+        // Component is in the low bits of each word, shift up and back down to sign extend it
+        switch (type)
+        {
+        case Accessor::COMPONENT_TYPE::INT8:
+            vWord = _mm256_srai_epi32(_mm256_slli_epi32(vWord, 24), 24);
+            maxVal = 127.0f;
+            isSigned = true;
+            break;
+        case Accessor::COMPONENT_TYPE::UINT8:
+            vWord = _mm256_and_si256(vWord, _mm256_set1_epi32(0xff));
+            maxVal = 255.0f;
+            isSigned = false;
+            break;
+        case Accessor::COMPONENT_TYPE::INT16:
+            vWord = _mm256_srai_epi32(_mm256_slli_epi32(vWord, 16), 16);
+            maxVal = 32767.0f;
+            isSigned = true;
+            break;
+        default:
+            vWord = _mm256_and_si256(vWord, _mm256_set1_epi32(0xffff));
+            maxVal = 65535.0f;
+            isSigned = false;
+            break;
+        }
+
+        __m256 vVal = _mm256_cvtepi32_ps(vWord);
+        if (!normalized)
+            return vVal;
+
+        // Division rather than multiplication by reciprocal so that results match LoadComponent()
+        vVal = _mm256_div_ps(vVal, _mm256_set1_ps(maxVal));
+        if (isSigned)
+            vVal = _mm256_max_ps(vVal, _mm256_set1_ps(-1.0f));
+
+        return vVal;
+    }
+
+    // Decodes the first N components of every element. Calls batchFn(i, vComponents) for each
+    // batch of eight elements starting at i and elementFn(i, components) for the rest.
+    template<int N, typename BatchFunc, typename ElementFunc>
+    void Decode(const Accessor::Stream& src, size_t dstSize, BatchFunc batchFn, ElementFunc elementFn)
+    {
+        Assert(src.Count <= dstSize, "Destination is too small.");
+        Assert(src.Type != Accessor::COMPONENT_TYPE::UINT32, "Invalid component type for vertex attribute.");
+
+        if (!src.Data)
+        {
+            const float zero[N] = {};
+
+            for (size_t i = 0; i < src.Count; i++)
+                elementFn(i, zero);
+
+            return;
+        }
+
+        const uint32_t componentSize = Accessor::ComponentSize(src.Type);
+        const size_t numBatched = NumBatchedElements(src, N);
+        const __m256i vOffsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+            _mm256_set1_epi32((int)src.Stride));
+        size_t i = 0;
+
+        for (; i < numBatched; i += 8)
+        {
+            const uint8_t* ptr = src.Data + i * src.Stride;
+            __m256 vComponents[N];
+
+            for (int c = 0; c < N; c++)
+                vComponents[c] = LoadComponent8(ptr + c * componentSize, vOffsets, src.Type, src.Normalized);
+
+            batchFn(i, vComponents);
+        }
+
+        for (; i < src.Count; i++)
+        {
+            const uint8_t* ptr = src.Data + i * src.Stride;
+            float components[N];
+
+            for (int c = 0; c < N; c++)
+                components[c] = LoadComponent(ptr + c * componentSize, src.Type, src.Normalized);
+
+            elementFn(i, components);
+        }
+    }
+
+    ZetaInline __m256 __vectorcall Negate8(__m256 v)
+    {
+        return _mm256_xor_ps(v, _mm256_set1_ps(-0.0f));
+    }
+
+    // Same as oct32(x, y, z) for eight vectors at a time. Encoded vectors are returned as
+    // (x | y << 16).
+    ZetaInline __m256i __vectorcall EncodeOctahedral8(__m256 vX, __m256 vY, __m256 vZ)
+    {
+        // Same order of additions as hadd_float3()
+        const __m256 vSum = _mm256_add_ps(_mm256_add_ps(abs(vX), abs(vZ)), abs(vY));
+        __m256 vEncodedX = _mm256_div_ps(vX, vSum);
+        __m256 vEncodedY = _mm256_div_ps(vY, vSum);
+
+        const __m256 vOne = _mm256_set1_ps(1.0f);
+        const __m256 vMinusOne = _mm256_set1_ps(-1.0f);
+        const __m256 vZero = _mm256_setzero_ps();
+        const __m256 vSignX = _mm256_blendv_ps(vMinusOne, vOne, _mm256_cmp_ps(vX, vZero, _CMP_GE_OQ));
+        const __m256 vSignY = _mm256_blendv_ps(vMinusOne, vOne, _mm256_cmp_ps(vY, vZero, _CMP_GE_OQ));
+
+        // v.z <= 0.0 ? 1.0 - abs(v.yx) * SignNotZero(v) : v
+        const __m256 vNegZX = _mm256_mul_ps(_mm256_sub_ps(vOne, abs(vEncodedY)), vSignX);
+        const __m256 vNegZY = _mm256_mul_ps(_mm256_sub_ps(vOne, abs(vEncodedX)), vSignY);
+        const __m256 vZLe0 = _mm256_cmp_ps(vZ, vZero, _CMP_LE_OQ);
+        vEncodedX = _mm256_blendv_ps(vEncodedX, vNegZX, vZLe0);
+        vEncodedY = _mm256_blendv_ps(vEncodedY, vNegZY, vZLe0);
+
+        // [-1, 1] -> [0, 1] -> [0, 2^16 - 1]
+        const __m256 vHalf = _mm256_set1_ps(0.5f);
+        const __m256 vMax = _mm256_set1_ps((1 << 16) - 1);
+        const __m256i vX16 = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_fmadd_ps(vEncodedX, vHalf, vHalf), vMax));
+        const __m256i vY16 = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_fmadd_ps(vEncodedY, vHalf, vHalf), vMax));
+
+        return _mm256_or_si256(_mm256_and_si256(vX16, _mm256_set1_epi32(0xffff)), _mm256_slli_epi32(vY16, 16));
+    }
+
+    template<oct32 Vertex::* Member>
+    void DecodeOctahedral(const Accessor::Stream& src, MutableSpan<Vertex> vertices)
+    {
+        Decode<3>(src, vertices.size(),
+            [vertices](size_t i, const __m256* vComponents)
+            {
+                alignas(32) uint32_t encoded[8];
+                _mm256_store_si256(reinterpret_cast<__m256i*>(encoded),
+                    EncodeOctahedral8(vComponents[0], vComponents[1], Negate8(vComponents[2])));
+
+                for (int j = 0; j < 8; j++)
+                    memcpy(&(vertices[i + j].*Member), &encoded[j], sizeof(oct32));
+            },
+            [vertices](size_t i, const float* components)
+            {
+                vertices[i].*Member = oct32(components[0], components[1], -components[2]);
+            });
+    }
+
+    ZetaInline __m256i __vectorcall LoadIndices8(const uint8_t* ptr, Accessor::COMPONENT_TYPE type)
+    {
+        switch (type)
+        {
+        case Accessor::COMPONENT_TYPE::UINT8:
+            return _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(ptr)));
+        case Accessor::COMPONENT_TYPE::UINT16:
+            return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr)));
+        default:
+            return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr));
+        }
+    }
+
+    // Swaps second and third index of eight consecutive triangles. Triangles 2 and 5 straddle
+    // two registers, which is fixed up with a blend.
+    ZetaInline void __vectorcall FlipWinding8(__m256i& v0, __m256i& v1, __m256i& v2)
+    {
+        // Indices 0-7: 0 2 1 | 3 5 4 | 6 [8]
+        const __m256i vOut0 = _mm256_blend_epi32(
+            _mm256_permutevar8x32_epi32(v0, _mm256_setr_epi32(0, 2, 1, 3, 5, 4, 6, 6)),
+            _mm256_permutevar8x32_epi32(v1, _mm256_setzero_si256()), 0x80);
+        // Indices 8-15: [7] | 9 11 10 | 12 14 13 | 15
+        const __m256i vOut1 = _mm256_blend_epi32(
+            _mm256_permutevar8x32_epi32(v1, _mm256_setr_epi32(0, 1, 3, 2, 4, 6, 5, 7)),
+            _mm256_permutevar8x32_epi32(v0, _mm256_set1_epi32(7)), 0x01);
+        // Indices 16-23: 17 16 | 18 20 19 | 21 23 22
+        const __m256i vOut2 = _mm256_permutevar8x32_epi32(v2, _mm256_setr_epi32(1, 0, 2, 4, 3, 5, 7, 6));
+
+        v0 = vOut0;
+        v1 = vOut1;
+        v2 = vOut2;
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// Accessor
+//--------------------------------------------------------------------------------------
+
+void Accessor::DecodePositions(const Stream& src, MutableSpan<Vertex> vertices)
+{
+    Decode<3>(src, vertices.size(),
+        [vertices](size_t i, const __m256* vComponents)
+        {
+            alignas(32) float x[8];
+            alignas(32) float y[8];
+            alignas(32) float z[8];
+            _mm256_store_ps(x, vComponents[0]);
+            _mm256_store_ps(y, vComponents[1]);
+            _mm256_store_ps(z, Negate8(vComponents[2]));
+
+            for (int j = 0; j < 8; j++)
+                vertices[i + j].Position = float3(x[j], y[j], z[j]);
+        },
+        [vertices](size_t i, const float* components)
+        {
+            vertices[i].Position = float3(components[0], components[1], -components[2]);
+        });
+}
+
+void Accessor::DecodeNormals(const Stream& src, MutableSpan<Vertex> vertices)
+{
+    DecodeOctahedral<&Vertex::Normal>(src, vertices);
+}
+
+void Accessor::DecodeTexCoords(const Stream& src, MutableSpan<Vertex> vertices)
+{
+    Decode<2>(src, vertices.size(),
+        [vertices](size_t i, const __m256* vComponents)
+        {
+            // Interleave to (u0, v0, u1, v1, ...)
+            const __m256 vLo = _mm256_unpacklo_ps(vComponents[0], vComponents[1]);
+            const __m256 vHi = _mm256_unpackhi_ps(vComponents[0], vComponents[1]);
+            alignas(32) float2 uv[8];
+            _mm256_store_ps(reinterpret_cast<float*>(uv), _mm256_permute2f128_ps(vLo, vHi, 0x20));
+            _mm256_store_ps(reinterpret_cast<float*>(uv + 4), _mm256_permute2f128_ps(vLo, vHi, 0x31));
+
+            for (int j = 0; j < 8; j++)
+                vertices[i + j].TexUV = uv[j];
+        },
+        [vertices](size_t i, const float* components)
+        {
+            vertices[i].TexUV = float2(components[0], components[1]);
+        });
+}
+
+void Accessor::DecodeTangents(const Stream& src, MutableSpan<Vertex> vertices)
+{
+    DecodeOctahedral<&Vertex::Tangent>(src, vertices);
+}
+
+void Accessor::DecodeIndices(const Stream& src, MutableSpan<uint32_t> indices, bool flipWinding)
+{
+    Assert(src.Data, "Index buffer is required.");
+    Assert(src.Type == COMPONENT_TYPE::UINT8 || src.Type == COMPONENT_TYPE::UINT16 ||
+        src.Type == COMPONENT_TYPE::UINT32, "Invalid index type.");
+    Assert(src.Stride == ComponentSize(src.Type), "Indices must be tightly packed.");
+    Assert(!flipWinding || src.Count % 3 == 0, "Invalid number of indices.");
+    Assert(src.Count <= indices.size(), "Destination is too small.");
+
+    // Eight triangles at a time
+    const size_t numBatched = src.Count - src.Count % 24;
+    uint32_t* dst = indices.data();
+
+    for (size_t i = 0; i < numBatched; i += 24)
+    {
+        const uint8_t* ptr = src.Data + i * src.Stride;
+        __m256i v0 = LoadIndices8(ptr, src.Type);
+        __m256i v1 = LoadIndices8(ptr + 8 * src.Stride, src.Type);
+        __m256i v2 = LoadIndices8(ptr + 16 * src.Stride, src.Type);
+
+        if (flipWinding)
+            FlipWinding8(v0, v1, v2);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), v0);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 8), v1);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 16), v2);
+    }
+
+    for (size_t i = numBatched; i < src.Count; i++)
+    {
+        // Little endian, so the low bytes hold the index
+        uint32_t idx = 0;
+        memcpy(&idx, src.Data + i * src.Stride, src.Stride);
+        dst[i] = idx;
+    }
+
+    if (flipWinding)
+    {
+        for (size_t i = numBatched; i < src.Count; i += 3)
+            std::swap(dst[i + 1], dst[i + 2]);
+    }
+}
+
+void Accessor::FlipWinding(MutableSpan<uint32_t> indices)
+{
+    Assert(indices.size() % 3 == 0, "Invalid number of indices.");
+
+    const size_t numBatched = indices.size() - indices.size() % 24;
+    uint32_t* ptr = indices.data();
+
+    for (size_t i = 0; i < numBatched; i += 24)
+    {
+        __m256i v0 = _mm256_loadu_si256(reinterpret_cast<__m256i*>(ptr + i));
+        __m256i v1 = _mm256_loadu_si256(reinterpret_cast<__m256i*>(ptr + i + 8));
+        __m256i v2 = _mm256_loadu_si256(reinterpret_cast<__m256i*>(ptr + i + 16));
+
+        FlipWinding8(v0, v1, v2);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(ptr + i), v0);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(ptr + i + 8), v1);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(ptr + i + 16), v2);
+    }
+
+    for (size_t i = numBatched; i < indices.size(); i += 3)
+        std::swap(ptr[i + 1], ptr[i + 2]);
+}
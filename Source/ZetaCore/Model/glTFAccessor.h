@@ -0,0 +1,58 @@
+#pragma once
+
+#include "../Core/Vertex.h"
+#include "../Utility/Span.h"
+
+// Decoding of glTF accessors into engine's vertex and index formats. Supports every component
+// type allowed for mesh attributes, including the normalized and unnormalized 8 and 16-bit
+// types from KHR_mesh_quantization, with arbitrary strides. Elements are decoded eight at a
+// time with AVX2 gathers, while glTF's right-handed coordinates are converted to left-handed
+// by negating z. Independent of cgltf -- sparse accessors are handled by the caller by decoding
+// their indices and values separately.
+namespace ZetaRay::Model::glTF::Accessor
+{
+    enum class COMPONENT_TYPE : uint8_t
+    {
+        INT8,
+        UINT8,
+        INT16,
+        UINT16,
+        UINT32,
+        FLOAT32
+    };
+
+    ZetaInline constexpr uint32_t ComponentSize(COMPONENT_TYPE t)
+    {
+        return t == COMPONENT_TYPE::INT8 || t == COMPONENT_TYPE::UINT8 ? 1 :
+            (t == COMPONENT_TYPE::INT16 || t == COMPONENT_TYPE::UINT16 ? 2 : 4);
+    }
+
+    // Strided view of accessor's elements
+    struct Stream
+    {
+        // When null, every element is zero, as is the case for sparse accessors without a
+        // buffer view
+        const uint8_t* Data = nullptr;
+        size_t Count = 0;
+        // Bytes between the start of consecutive elements
+        uint32_t Stride = 0;
+        COMPONENT_TYPE Type = COMPONENT_TYPE::FLOAT32;
+        bool Normalized = false;
+        // Number of readable bytes starting from Data. Components are gathered as 32-bit words,
+        // so 8 and 16-bit elements that are too close to the end are decoded one at a time.
+        size_t SizeInBytes = 0;
+    };
+
+    // Element i is written to vertices[i]
+    void DecodePositions(const Stream& src, Util::MutableSpan<Core::Vertex> vertices);
+    void DecodeNormals(const Stream& src, Util::MutableSpan<Core::Vertex> vertices);
+    void DecodeTexCoords(const Stream& src, Util::MutableSpan<Core::Vertex> vertices);
+    // Only the xyz components are used, handedness in w is ignored
+    void DecodeTangents(const Stream& src, Util::MutableSpan<Core::Vertex> vertices);
+    // Source must be tightly packed with one of the unsigned component types. With flipWinding,
+    // second and third index of every triangle are swapped to convert from counter-clockwise
+    // to clockwise winding.
+    void DecodeIndices(const Stream& src, Util::MutableSpan<uint32_t> indices, bool flipWinding);
+    // Swaps second and third index of every triangle
+    void FlipWinding(Util::MutableSpan<uint32_t> indices);
+}
@@ -6,6 +6,7 @@
 #include "../App/Filesystem.h"
 #include "../Core/Material.h"
 #include "../Model/Mesh.h"
+#include "../Model/ClusterBuilder.h"
 #include "../Scene/SceneCommon.h"
 
 namespace ZetaRay::Model::glTF::Asset
@@ -20,6 +21,9 @@ namespace ZetaRay::Model::glTF::Asset
         uint32_t BaseIdxOffset;
         uint32_t NumVertices;
         uint32_t NumIndices;
+        // Range of this mesh's clusters (see ClusterBuilder.h)
+        uint32_t BaseClusterOffset;
+        uint32_t NumClusters;
     };
 
     struct EmissiveInstance
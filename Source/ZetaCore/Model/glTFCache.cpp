@@ -0,0 +1,334 @@
+#include "glTFCache.h"
+#include "../App/Log.h"
+#include "../Math/Common.h"
+#include <xxHash/xxhash.h>
+
+using namespace ZetaRay;
+using namespace ZetaRay::App;
+using namespace ZetaRay::Core;
+using namespace ZetaRay::Util;
+using namespace ZetaRay::Model;
+using namespace ZetaRay::Model::glTF;
+using namespace ZetaRay::Model::glTF::Asset;
+
+namespace
+{
+    static constexpr uint32_t MAGIC = 'Z' | ('S' << 8) | ('C' << 16) | ('N' << 24);
+    // Offset of every section is aligned to this value
+    static constexpr size_t SECTION_ALIGNMENT = 16;
+
+    enum class SECTION : uint32_t
+    {
+        BUFFER_URIS,
+        VERTICES,
+        INDICES,
+        MESHES,
+        MATERIALS,
+        IMAGE_PATHS,
+        TREE_LEVELS,
+        INSTANCES,
+        EMISSIVE_INSTANCES,
+        EMISSIVE_TRIANGLES,
+        MESH_BOUNDS,
+        CLUSTERS,
+        COUNT
+    };
+
+    struct Section
+    {
+        uint64_t Offset;
+        uint64_t Size;
+    };
+
+    struct Header
+    {
+        uint32_t Magic;
+        uint32_t Version;
+        // Catches changes to any of the cached types that weren't accompanied by a version bump
+        uint64_t LayoutHash;
+        // Hash of glTF file's contents. For GLB files, only the header and JSON chunk.
+        uint64_t glTFHash;
+        // Buffer files can be hundreds of megabytes, so rather than hashing their contents,
+        // size and last-write time of each one are hashed. The binary chunk of a GLB file is
+        // treated the same way.
+        uint64_t BuffersHash;
+        uint32_t SceneID;
+        uint32_t Flags;
+        Section Sections[(int)SECTION::COUNT];
+    };
+
+    static_assert(std::is_trivially_copyable_v<Vertex>);
+    static_assert(std::is_trivially_copyable_v<CompactVertex>);
+    static_assert(std::is_trivially_copyable_v<Asset::Mesh>);
+    static_assert(std::is_trivially_copyable_v<MaterialDesc>);
+    static_assert(std::is_trivially_copyable_v<InstanceDesc>);
+    static_assert(std::is_trivially_copyable_v<EmissiveInstance>);
+    static_assert(std::is_trivially_copyable_v<RT::EmissiveTriangle>);
+    static_assert(std::is_trivially_copyable_v<MeshCluster>);
+
+    uint64_t LayoutHash()
+    {
+        const uint64_t sizes[] = { sizeof(Header), sizeof(Vertex), sizeof(CompactVertex), sizeof(Math::AABB),
+            sizeof(Asset::Mesh), sizeof(MaterialDesc), sizeof(InstanceDesc), sizeof(EmissiveInstance),
+            sizeof(RT::EmissiveTriangle), sizeof(MeshCluster) };
+
+        return XXH3_64bits(sizes, sizeof(sizes));
+    }
+
+    struct SourceInfo
+    {
+        uint64_t glTFHash;
+        uint64_t BuffersHash;
+    };
+
+    // 12-byte header, followed by the JSON chunk's 8-byte header and contents
+    static constexpr uint32_t GLB_MAGIC = 'g' | ('l' << 8) | ('T' << 16) | ('F' << 24);
+    static constexpr size_t GLB_HEADER_SIZE = 12;
+    static constexpr size_t GLB_CHUNK_HEADER_SIZE = 8;
+
+    bool GetSourceInfo(const Filesystem::Path& glTFPath, Span<char> bufferURIs, SourceInfo& info)
+    {
+        Filesystem::MemoryMappedFile glTFFile;
+        if (!glTFFile.Open(glTFPath.Get()))
+            return false;
+
+        // Size and last-write time of every buffer file
+        SmallVector<uint64_t> buffers;
+        size_t hashedSize = glTFFile.Size();
+        uint32_t magic = 0;
+
+        if (glTFFile.Size() >= GLB_HEADER_SIZE + GLB_CHUNK_HEADER_SIZE)
+            memcpy(&magic, glTFFile.Data(), sizeof(magic));
+
+        if (magic == GLB_MAGIC)
+        {
+            uint32_t jsonLength;
+            memcpy(&jsonLength, glTFFile.Data() + GLB_HEADER_SIZE, sizeof(jsonLength));
+            hashedSize = Math::Min(GLB_HEADER_SIZE + GLB_CHUNK_HEADER_SIZE + jsonLength, glTFFile.Size());
+
+            buffers.push_back(glTFFile.Size());
+            buffers.push_back(Filesystem::GetLastWriteTime(glTFPath.Get()));
+        }
+
+        info.glTFHash = XXH3_64bits(glTFFile.Data(), hashedSize);
+
+        for (size_t i = 0; i < bufferURIs.size(); i += strlen(bufferURIs.data() + i) + 1)
+        {
+            Filesystem::Path bufferPath(glTFPath.GetView());
+            bufferPath.Directory();
+            bufferPath.Append(bufferURIs.data() + i);
+
+            const size_t size = Filesystem::GetFileSize(bufferPath.Get());
+            if (size == size_t(-1))
+                return false;
+
+            buffers.push_back(size);
+            buffers.push_back(Filesystem::GetLastWriteTime(bufferPath.Get()));
+        }
+
+        info.BuffersHash = XXH3_64bits(buffers.data(), buffers.size() * sizeof(uint64_t));
+
+        return true;
+    }
+
+    template<typename T>
+    ZetaInline MutableSpan<T> GetSection(uint8_t* base, const Header& header, SECTION s)
+    {
+        const Section& section = header.Sections[(int)s];
+        return MutableSpan<T>(reinterpret_cast<T*>(base + section.Offset), section.Size / sizeof(T));
+    }
+}
+
+void Cache::GetPath(const Filesystem::Path& glTFPath, Filesystem::Path& cachePath)
+{
+    constexpr char EXT[] = ".cache";
+    const size_t n = strlen(glTFPath.Get());
+
+    cachePath.Reset(StrView(glTFPath.Get(), n));
+    cachePath.Resize(n + sizeof(EXT));
+    memcpy(cachePath.Get() + n, EXT, sizeof(EXT));
+}
+
+void Cache::Write(const Filesystem::Path& glTFPath, uint32_t sceneID, uint32_t flags, const SceneData& data)
+{
+    SourceInfo source;
+    if (!GetSourceInfo(glTFPath, data.BufferURIs, source))
+        return;
+
+    Header header{ .Magic = MAGIC,
+        .Version = VERSION,
+        .LayoutHash = LayoutHash(),
+        .glTFHash = source.glTFHash,
+        .BuffersHash = source.BuffersHash,
+        .SceneID = sceneID,
+        .Flags = flags };
+
+    const bool compact = flags & FLAGS::COMPACT_VERTICES;
+    Assert(!compact || data.MeshBounds.size() == data.Meshes.size(), "Every mesh must have bounds.");
+
+    const MemoryRegion sections[(int)SECTION::COUNT] = {
+        { data.BufferURIs.data(), data.BufferURIs.size() },
+        compact ? MemoryRegion{ data.CompactVertices.data(), data.CompactVertices.size() * sizeof(CompactVertex) } :
+            MemoryRegion{ data.Vertices.data(), data.Vertices.size() * sizeof(Vertex) },
+        { data.Indices.data(), data.Indices.size() * sizeof(uint32_t) },
+        { data.Meshes.data(), data.Meshes.size() * sizeof(Asset::Mesh) },
+        { data.Materials.data(), data.Materials.size() * sizeof(MaterialDesc) },
+        { data.ImagePaths.data(), data.ImagePaths.size() },
+        { data.TreeLevels.data(), data.TreeLevels.size() * sizeof(int) },
+        { data.Instances.data(), data.Instances.size() * sizeof(InstanceDesc) },
+        { data.EmissiveInstances.data(), data.EmissiveInstances.size() * sizeof(EmissiveInstance) },
+        { data.EmissiveTris.data(), data.EmissiveTris.size() * sizeof(RT::EmissiveTriangle) },
+        { data.MeshBounds.data(), compact ? data.MeshBounds.size() * sizeof(Math::AABB) : 0 },
+        { data.Clusters.data(), data.Clusters.size() * sizeof(MeshCluster) } };
+
+    // Header, then each section preceded by padding for alignment
+    alignas(SECTION_ALIGNMENT) static constexpr uint8_t PADDING[SECTION_ALIGNMENT] = { 0 };
+    MemoryRegion regions[1 + 2 * (int)SECTION::COUNT];
+    int numRegions = 0;
+    regions[numRegions++] = MemoryRegion{ .Data = &header, .SizeInBytes = sizeof(Header) };
+    size_t offset = sizeof(Header);
+
+    for (int i = 0; i < (int)SECTION::COUNT; i++)
+    {
+        const size_t alignedOffset = Math::AlignUp(offset, SECTION_ALIGNMENT);
+
+        if (alignedOffset != offset)
+        {
+            regions[numRegions++] = MemoryRegion{ .Data = const_cast<uint8_t*>(PADDING),
+                .SizeInBytes = alignedOffset - offset };
+        }
+
+        header.Sections[i] = Section{ .Offset = alignedOffset, .Size = sections[i].SizeInBytes };
+        offset = alignedOffset + sections[i].SizeInBytes;
+
+        if (sections[i].SizeInBytes)
+            regions[numRegions++] = sections[i];
+    }
+
+    Filesystem::Path cachePath;
+    GetPath(glTFPath, cachePath);
+
+    // Write to a temporary file and then rename it over the cache, so that readers never 
+    // see a partially written file (e.g. after a crash or when disk is full)
+    constexpr char TMP_EXT[] = ".tmp";
+    const size_t n = strlen(cachePath.Get());
+    Filesystem::Path tmpPath;
+    tmpPath.Reset(StrView(cachePath.Get(), n));
+    tmpPath.Resize(n + sizeof(TMP_EXT));
+    memcpy(tmpPath.Get() + n, TMP_EXT, sizeof(TMP_EXT));
+
+    if (!Filesystem::WriteToFile(tmpPath.Get(), Span(regions, numRegions)))
+    {
+        LOG_UI_WARNING("Writing scene cache file %s failed.\n", tmpPath.Get());
+        return;
+    }
+
+    if (!Filesystem::Rename(tmpPath.Get(), cachePath.Get()))
+    {
+        LOG_UI_WARNING("Replacing scene cache file %s failed.\n", cachePath.Get());
+        Filesystem::RemoveFile(tmpPath.Get());
+    }
+}
+
+bool Cache::Open(const Filesystem::Path& glTFPath, uint32_t sceneID, uint32_t flags, 
+    Filesystem::MemoryMappedFile& file, SceneData& data)
+{
+    Filesystem::Path cachePath;
+    GetPath(glTFPath, cachePath);
+
+    if (!file.Open(cachePath.Get()))
+        return false;
+
+    auto reject = [&file, &cachePath](const char* reason)
+        {
+            LOG_UI_INFO("Scene cache %s is %s, falling back to glTF...\n", cachePath.Get(), reason);
+            file.Close();
+
+            return false;
+        };
+
+    if (file.Size() < sizeof(Header))
+        return reject("truncated");
+
+    const Header& header = *reinterpret_cast<const Header*>(file.Data());
+
+    if (header.Magic != MAGIC)
+        return reject("invalid");
+    if (header.Version != VERSION || header.LayoutHash != LayoutHash() || header.SceneID != sceneID ||
+        header.Flags != flags)
+        return reject("out of date");
+
+    for (int i = 0; i < (int)SECTION::COUNT; i++)
+    {
+        const Section& s = header.Sections[i];
+
+        if ((s.Offset & (SECTION_ALIGNMENT - 1)) || s.Offset > file.Size() || s.Size > file.Size() - s.Offset)
+            return reject("truncated");
+    }
+
+    uint8_t* base = file.Data();
+    data.BufferURIs = GetSection<char>(base, header, SECTION::BUFFER_URIS);
+
+    if (!data.BufferURIs.empty() && data.BufferURIs[data.BufferURIs.size() - 1] != '\0')
+        return reject("invalid");
+
+    SourceInfo source;
+    if (!GetSourceInfo(glTFPath, data.BufferURIs, source) ||
+        source.glTFHash != header.glTFHash ||
+        source.BuffersHash != header.BuffersHash)
+    {
+        return reject("out of date");
+    }
+
+    if (flags & FLAGS::COMPACT_VERTICES)
+    {
+        data.Vertices = MutableSpan<Vertex>(nullptr, 0);
+        data.CompactVertices = GetSection<CompactVertex>(base, header, SECTION::VERTICES);
+    }
+    else
+        data.Vertices = GetSection<Vertex>(base, header, SECTION::VERTICES);
+
+    data.Indices = GetSection<uint32_t>(base, header, SECTION::INDICES);
+    data.Meshes = GetSection<Asset::Mesh>(base, header, SECTION::MESHES);
+    data.Materials = GetSection<MaterialDesc>(base, header, SECTION::MATERIALS);
+    data.ImagePaths = GetSection<char>(base, header, SECTION::IMAGE_PATHS);
+    data.TreeLevels = GetSection<int>(base, header, SECTION::TREE_LEVELS);
+    data.Instances = GetSection<InstanceDesc>(base, header, SECTION::INSTANCES);
+    data.EmissiveInstances = GetSection<EmissiveInstance>(base, header, SECTION::EMISSIVE_INSTANCES);
+    data.EmissiveTris = GetSection<RT::EmissiveTriangle>(base, header, SECTION::EMISSIVE_TRIANGLES);
+    data.MeshBounds = GetSection<Math::AABB>(base, header, SECTION::MESH_BOUNDS);
+    data.Clusters = GetSection<MeshCluster>(base, header, SECTION::CLUSTERS);
+
+    if (!data.ImagePaths.empty() && data.ImagePaths[data.ImagePaths.size() - 1] != '\0')
+        return reject("invalid");
+    if ((flags & FLAGS::COMPACT_VERTICES) && data.MeshBounds.size() != data.Meshes.size())
+        return reject("invalid");
+
+    // Ranges index into the mapped sections, so a corrupt file that made it this far must not 
+    // be trusted with them
+    auto inRange = [](uint32_t base, uint32_t count, size_t size)
+        {
+            return base <= size && count <= size - base;
+        };
+
+    const size_t numVertices = (flags & FLAGS::COMPACT_VERTICES) ? data.CompactVertices.size() : 
+        data.Vertices.size();
+
+    for (auto& mesh : data.Meshes)
+    {
+        if (!inRange(mesh.BaseVtxOffset, mesh.NumVertices, numVertices) ||
+            !inRange(mesh.BaseIdxOffset, mesh.NumIndices, data.Indices.size()) ||
+            !inRange(mesh.BaseClusterOffset, mesh.NumClusters, data.Clusters.size()))
+        {
+            return reject("invalid");
+        }
+    }
+
+    for (auto& instance : data.EmissiveInstances)
+    {
+        if (!inRange(instance.BaseTriOffset, instance.NumTriangles, data.EmissiveTris.size()))
+            return reject("invalid");
+    }
+
+    return true;
+}
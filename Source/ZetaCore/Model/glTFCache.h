@@ -0,0 +1,69 @@
+#pragma once
+
+#include "glTF.h"
+#include "glTFAsset.h"
+#include "../App/Path.h"
+#include "../RayTracing/RtCommon.h"
+
+// Binary cache of a processed glTF scene. Contains everything that glTF::Load() derives from the
+// glTF file that doesn't depend on renderer state -- final vertex and index buffers, mesh records,
+// material descriptions, instance hierarchy and emissive triangles. Each section is laid out exactly
+// as in memory, so after validation, the file is memory-mapped and sections are used in place.
+namespace ZetaRay::Model::glTF::Cache
+{
+    // Has to be incremented whenever file layout or meaning of any of the cached fields changes
+    static constexpr uint32_t VERSION = 5;
+
+    struct SceneData
+    {
+        // Null-terminated paths of external buffer files (relative to glTF file's directory) 
+        // stored back to back. Buffers embedded in a GLB file or as data URIs aren't included.
+        Util::MutableSpan<char> BufferURIs = Util::MutableSpan<char>(nullptr, 0);
+        // Empty when loaded from a cache with compact vertices
+        Util::MutableSpan<Core::Vertex> Vertices = Util::MutableSpan<Core::Vertex>(nullptr, 0);
+        // Only with FLAGS::COMPACT_VERTICES. Positions of each mesh are relative to its bounds
+        // in MeshBounds.
+        Util::MutableSpan<Core::CompactVertex> CompactVertices = Util::MutableSpan<Core::CompactVertex>(nullptr, 0);
+        Util::MutableSpan<Math::AABB> MeshBounds = Util::MutableSpan<Math::AABB>(nullptr, 0);
+        Util::MutableSpan<uint32_t> Indices = Util::MutableSpan<uint32_t>(nullptr, 0);
+        Util::MutableSpan<Asset::Mesh> Meshes = Util::MutableSpan<Asset::Mesh>(nullptr, 0);
+        // Referenced by Mesh::BaseClusterOffset and NumClusters
+        Util::MutableSpan<MeshCluster> Clusters = Util::MutableSpan<MeshCluster>(nullptr, 0);
+        Util::MutableSpan<Asset::MaterialDesc> Materials = Util::MutableSpan<Asset::MaterialDesc>(nullptr, 0);
+        // Null-terminated image paths (relative to glTF file's directory) stored back to back
+        Util::MutableSpan<char> ImagePaths = Util::MutableSpan<char>(nullptr, 0);
+        // Number of instances at each level of the node hierarchy
+        Util::MutableSpan<int> TreeLevels = Util::MutableSpan<int>(nullptr, 0);
+        // In depth-first order, parents always come before their children
+        Util::MutableSpan<Asset::InstanceDesc> Instances = Util::MutableSpan<Asset::InstanceDesc>(nullptr, 0);
+        Util::MutableSpan<Asset::EmissiveInstance> EmissiveInstances = Util::MutableSpan<Asset::EmissiveInstance>(nullptr, 0);
+        // Emissive texture index is a descriptor table offset that is only known at runtime, so
+        // it's stored as Material::INVALID_ID and has to be patched after materials are added
+        Util::MutableSpan<RT::EmissiveTriangle> EmissiveTris = Util::MutableSpan<RT::EmissiveTriangle>(nullptr, 0);
+    };
+
+    // Load options that change the cached data. Cache is only used when these match.
+    enum FLAGS : uint32_t
+    {
+        OPTIMIZED_MESHES = 1 << 0,
+        COMPACT_VERTICES = 1 << 1
+    };
+
+    ZetaInline uint32_t GetFlags(const Options& options)
+    {
+        return (options.OptimizeMeshes ? FLAGS::OPTIMIZED_MESHES : 0) |
+            (options.CompactVertices ? FLAGS::COMPACT_VERTICES : 0);
+    }
+
+    // Cache file for given glTF file, which is "<path to glTF>.cache"
+    void GetPath(const App::Filesystem::Path& glTFPath, App::Filesystem::Path& cachePath);
+    void Write(const App::Filesystem::Path& glTFPath, uint32_t sceneID, uint32_t flags, 
+        const SceneData& data);
+    // Maps cache file for given glTF (or GLB) file. Returns false if it doesn't exist, or is 
+    // stale -- either the glTF or any of the buffer files have changed since it was written or
+    // it was written by a different version or with different flags. On success, returned spans point into
+    // file's mapping and remain valid as long as it's open. Pages are copy-on-write, so they
+    // can be modified in place.
+    bool Open(const App::Filesystem::Path& glTFPath, uint32_t sceneID, uint32_t flags,
+        App::Filesystem::MemoryMappedFile& file, SceneData& data);
+}
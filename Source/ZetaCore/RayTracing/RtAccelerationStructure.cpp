@@ -36,6 +36,21 @@ namespace
         uint32_t LevelIdx;
     };
 
+    // Range of instances in one scene graph level. Counts of static and dynamic instances 
+    // in the range are replaced by their offsets in the frame mesh instance array after 
+    // the prefix sum.
+    struct MeshInstanceChunk
+    {
+        uint32_t TreeLevel;
+        uint32_t Begin;
+        uint32_t End;
+        uint32_t StaticOffset;
+        uint32_t DynamicOffset;
+    };
+
+    static constexpr uint32_t MESH_INSTANCES_PER_CHUNK = 1024;
+    static constexpr uint32_t MESH_INSTANCE_UPDATES_PER_JOB = 64;
+
     ZetaInline D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS BuildFlags(RT_MESH_MODE t)
     {
         D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS f = 
@@ -55,6 +70,110 @@ namespace
     }
 }
 
+//--------------------------------------------------------------------------------------
+// Mesh instance packing
+//--------------------------------------------------------------------------------------
+
+void RT::PackMeshInstances(Span<MeshInstanceLevel> levels, uint32_t numStatic,
+    MutableSpan<RT::MeshInstance> instances, MutableSpan<uint64_t> instanceIDs,
+    FillMeshInstanceFn fill, void* ctx)
+{
+    Assert(instances.size() == instanceIDs.size(), "Invalid arguments.");
+
+    // Every level is split into fixed-size chunks. Instances in each chunk are counted 
+    // first, then a prefix sum over the chunks gives the offset of each chunk's first 
+    // static and dynamic instance. Packing order is the same as walking the levels 
+    // serially -- (level, index in level) for static instances followed by the same for 
+    // dynamic ones.
+    SmallVector<MeshInstanceChunk, App::FrameAllocator> chunks;
+
+    for (uint32_t level = 0; level < (uint32_t)levels.size(); level++)
+    {
+        const uint32_t levelSize = (uint32_t)levels[level].RtFlags.size();
+
+        for (uint32_t begin = 0; begin < levelSize; begin += MESH_INSTANCES_PER_CHUNK)
+        {
+            chunks.push_back(MeshInstanceChunk{
+                .TreeLevel = level,
+                .Begin = begin,
+                .End = Min(begin + MESH_INSTANCES_PER_CHUNK, levelSize),
+                .StaticOffset = 0,
+                .DynamicOffset = 0 });
+        }
+    }
+
+    App::ParallelFor(0, chunks.size(), 1, [levels, &chunks](size_t begin, size_t end)
+        {
+            for (size_t c = begin; c < end; c++)
+            {
+                auto& chunk = chunks[c];
+                const auto& currLevel = levels[chunk.TreeLevel];
+                uint32_t numStatic = 0;
+                uint32_t numDynamic = 0;
+
+                for (uint32_t i = chunk.Begin; i < chunk.End; i++)
+                {
+                    if (currLevel.MeshIDs[i] == Scene::INVALID_MESH)
+                        continue;
+
+                    const auto rtFlags = RT_Flags::Decode(currLevel.RtFlags[i]);
+                    numStatic += rtFlags.MeshMode == RT_MESH_MODE::STATIC;
+                    numDynamic += rtFlags.MeshMode == RT_MESH_MODE::DYNAMIC_NO_REBUILD;
+                }
+
+                chunk.StaticOffset = numStatic;
+                chunk.DynamicOffset = numDynamic;
+            }
+        });
+
+    uint32_t currStatic = 0;
+    uint32_t currDynamic = numStatic;
+
+    for (auto& chunk : chunks)
+    {
+        const uint32_t numStaticInChunk = chunk.StaticOffset;
+        const uint32_t numDynamicInChunk = chunk.DynamicOffset;
+        chunk.StaticOffset = currStatic;
+        chunk.DynamicOffset = currDynamic;
+        currStatic += numStaticInChunk;
+        currDynamic += numDynamicInChunk;
+    }
+
+    Assert(currStatic == numStatic, "Invalid instance count.");
+    Assert(currDynamic == instances.size(), "Invalid instance count.");
+
+    App::ParallelFor(0, chunks.size(), 1, [levels, instances, instanceIDs, &chunks, fill, ctx](
+        size_t begin, size_t end)
+        {
+            for (size_t c = begin; c < end; c++)
+            {
+                const auto& chunk = chunks[c];
+                const auto& currLevel = levels[chunk.TreeLevel];
+                uint32_t currStatic = chunk.StaticOffset;
+                uint32_t currDynamic = chunk.DynamicOffset;
+
+                for (uint32_t i = chunk.Begin; i < chunk.End; i++)
+                {
+                    if (currLevel.MeshIDs[i] == Scene::INVALID_MESH)
+                        continue;
+
+                    const auto rtFlags = RT_Flags::Decode(currLevel.RtFlags[i]);
+                    if (rtFlags.MeshMode != RT_MESH_MODE::STATIC &&
+                        rtFlags.MeshMode != RT_MESH_MODE::DYNAMIC_NO_REBUILD)
+                    {
+                        continue;
+                    }
+
+                    const bool staticMesh = rtFlags.MeshMode == RT_MESH_MODE::STATIC;
+                    const uint32_t currInstance = staticMesh ? currStatic++ : currDynamic++;
+
+                    fill(ctx, chunk.TreeLevel, i, staticMesh, instances[currInstance]);
+                    instanceIDs[currInstance] = currLevel.IDs[i];
+                }
+            }
+        });
+}
+
 //--------------------------------------------------------------------------------------
 // StaticBLAS
 //--------------------------------------------------------------------------------------
@@ -149,7 +268,7 @@ void StaticBLAS::Rebuild(ComputeCmdList& cmdList)
                 if (meshID == Scene::INVALID_MESH)
                     continue;
 
-                const TriangleMesh* mesh = scene.GetMesh(meshID).value();
+                const TriangleMesh* mesh = scene.GetMesh(currTreeLevel.m_meshHandles[i]).value();
 
                 meshDescs[currInstance].Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
                 // Force mesh to be opaque when possible to avoid invoking any-hit shaders
@@ -315,15 +434,14 @@ void StaticBLAS::CompactionCompletedCallback()
 // TLAS
 //--------------------------------------------------------------------------------------
 
-void TLAS::FillMeshInstanceData(uint64_t instanceID, uint64_t meshID, const float4x3& M,
-    uint32_t emissiveTriOffset, bool staticMesh, uint32_t currInstance)
+void TLAS::FillMeshInstanceData(uint64_t instanceID, Scene::MeshHandle meshHandle, const float4x3& M,
+    uint32_t emissiveTriOffset, bool staticMesh, RT::MeshInstance& instance)
 {
-    Assert(meshID != Scene::INVALID_MESH, "Invalid call.");
-
     SceneCore& scene = App::GetScene();
-    const TriangleMesh* mesh = scene.GetMesh(meshID).value();
+    Scene::MaterialHandle matHandle;
+    const TriangleMesh* mesh = scene.GetMesh(meshHandle, &matHandle).value();
     uint32 matBufferIdx = UINT32_MAX;
-    const Material* mat = scene.GetMaterial(mesh->m_materialID, &matBufferIdx).value();
+    const Material* mat = scene.GetMaterial(matHandle, &matBufferIdx).value();
 
     v_float4x4 vM = load4x3(M);
 
@@ -339,21 +457,21 @@ void TLAS::FillMeshInstanceData(uint64_t instanceID, uint64_t meshID, const floa
     float4a s;
     decomposeSRT(vM, s, r, t);
 
-    m_frameInstanceData[currInstance].MatIdx = (uint16_t)matBufferIdx;
-    m_frameInstanceData[currInstance].BaseVtxOffset = mesh->m_vtxBuffStartOffset;
-    m_frameInstanceData[currInstance].BaseIdxOffset = mesh->m_idxBuffStartOffset;
-    m_frameInstanceData[currInstance].Rotation = unorm4::FromNormalized(r);
-    m_frameInstanceData[currInstance].Scale = half3(s);
-    m_frameInstanceData[currInstance].Translation = float3(t.x, t.y, t.z);
-    m_frameInstanceData[currInstance].BaseEmissiveTriOffset = emissiveTriOffset;
+    instance.MatIdx = (uint16_t)matBufferIdx;
+    instance.BaseVtxOffset = mesh->m_vtxBuffStartOffset;
+    instance.BaseIdxOffset = mesh->m_idxBuffStartOffset;
+    instance.Rotation = unorm4::FromNormalized(r);
+    instance.Scale = half3(s);
+    instance.Translation = float3(t.x, t.y, t.z);
+    instance.BaseEmissiveTriOffset = emissiveTriOffset;
 
     const uint32_t texIdx = mat->GetBaseColorTex();
-    m_frameInstanceData[currInstance].BaseColorTex = texIdx == Material::INVALID_ID ?
+    instance.BaseColorTex = texIdx == Material::INVALID_ID ?
         UINT16_MAX :
         (uint16_t)texIdx;
 
     float alpha = float((mat->BaseColorFactor >> 24) & 0xff) / 255.0f;
-    m_frameInstanceData[currInstance].AlphaFactor_Cutoff =
+    instance.AlphaFactor_Cutoff =
         Float2ToRG8(float2(alpha, mat->GetAlphaCutoff()));
 
     if (!staticMesh)
@@ -365,17 +483,15 @@ void TLAS::FillMeshInstanceData(uint64_t instanceID, uint64_t meshID, const floa
         float4a s_prev;
         decomposeSRT(vM_prev, s_prev, r_prev, t_prev);
 
-        m_frameInstanceData[currInstance].PrevRotation = unorm4::FromNormalized(r_prev);
-        m_frameInstanceData[currInstance].PrevScale = half3(s_prev);
-        m_frameInstanceData[currInstance].dTranslation = half3(t - t_prev);
+        instance.PrevRotation = unorm4::FromNormalized(r_prev);
+        instance.PrevScale = half3(s_prev);
+        instance.dTranslation = half3(t - t_prev);
     }
     else
     {
-        m_frameInstanceData[currInstance].PrevRotation =
-            m_frameInstanceData[currInstance].Rotation;
-        m_frameInstanceData[currInstance].PrevScale =
-            m_frameInstanceData[currInstance].Scale;
-        m_frameInstanceData[currInstance].dTranslation = half3(0, 0, 0);
+        instance.PrevRotation = instance.Rotation;
+        instance.PrevScale = instance.Scale;
+        instance.dTranslation = half3(0, 0, 0);
     }
 }
 
@@ -385,10 +501,9 @@ void TLAS::RebuildFrameMeshInstanceData()
     const uint32_t numInstances = scene.m_numStaticInstances + scene.m_numDynamicInstances;
     m_frameInstanceData.resize(numInstances);
 
-    size_t currInstance = 0;
     const bool sceneHasEmissives = scene.NumEmissiveInstances() > 0;
 
-    // Resize to avoid repeatedly growing it
+    // Every slot is written by PackMeshInstances()
     scene.m_rtMeshInstanceIdxToID.resize(numInstances);
 
     // Layout:
@@ -404,75 +519,34 @@ void TLAS::RebuildFrameMeshInstanceData()
     //  - With this setup, every instance can use GeometryIndex() + InstanceID() to index 
     //    into the mesh instance buffer
 
-    // Static meshes
-    if (scene.m_numStaticInstances)
-    {
-        for (size_t treeLevelIdx = 1; treeLevelIdx < scene.m_sceneGraph.size(); treeLevelIdx++)
-        {
-            auto& currTreeLevel = scene.m_sceneGraph[treeLevelIdx];
-            const auto& rtFlagVec = currTreeLevel.m_rtFlags;
-
-            for (size_t i = 0; i < rtFlagVec.size(); i++)
-            {
-                const auto rtFlags = RT_Flags::Decode(currTreeLevel.m_rtFlags[i]);
-                const uint64_t meshID = currTreeLevel.m_meshIDs[i];
-                if (meshID == Scene::INVALID_MESH)
-                    continue;
-
-                if (rtFlags.MeshMode == RT_MESH_MODE::STATIC)
-                {
-                    const uint64_t instanceID = currTreeLevel.m_IDs[i];
-                    const uint32_t emissiveTriOffset = sceneHasEmissives &&
-                        (rtFlags.InstanceMask & RT_AS_SUBGROUP::EMISSIVE) ?
-                        scene.m_emissives.FindInstance(instanceID).value()->BaseTriOffset :
-                        UINT32_MAX;
+    // Level 0 is the root and doesn't have any meshes
+    SmallVector<MeshInstanceLevel, App::FrameAllocator> levels;
 
-                    FillMeshInstanceData(instanceID, meshID, currTreeLevel.m_toWorlds[i], 
-                        emissiveTriOffset, true, (uint32)currInstance);
-
-                    // Update RT mesh to instance ID map
-                    scene.m_rtMeshInstanceIdxToID[currInstance++] = currTreeLevel.m_IDs[i];
-                }
-            }
-        }
-    }
-
-    Assert(currInstance == scene.m_numStaticInstances, "Invalid instance count.");
-
-    // Dynamic meshes
-    if (scene.m_numDynamicInstances)
+    for (uint32_t treeLevelIdx = 1; treeLevelIdx < (uint32_t)scene.m_sceneGraph.size(); treeLevelIdx++)
     {
-        for (size_t treeLevelIdx = 1; treeLevelIdx < scene.m_sceneGraph.size(); treeLevelIdx++)
-        {
-            auto& currTreeLevel = scene.m_sceneGraph[treeLevelIdx];
-            const auto& rtFlagVec = currTreeLevel.m_rtFlags;
-
-            for (size_t i = 0; i < rtFlagVec.size(); i++)
-            {
-                const auto rtFlags = RT_Flags::Decode(currTreeLevel.m_rtFlags[i]);
-                const uint64_t meshID = currTreeLevel.m_meshIDs[i];
-                if (meshID == Scene::INVALID_MESH)
-                    continue;
-
-                if (rtFlags.MeshMode == RT_MESH_MODE::DYNAMIC_NO_REBUILD)
-                {
-                    const uint64_t instanceID = currTreeLevel.m_IDs[i];
-                    const uint32_t emissiveTriOffset = sceneHasEmissives &&
-                        (rtFlags.InstanceMask & RT_AS_SUBGROUP::EMISSIVE) ?
-                        scene.m_emissives.FindInstance(instanceID).value()->BaseTriOffset :
-                        UINT32_MAX;
-
-                    FillMeshInstanceData(instanceID, meshID, currTreeLevel.m_toWorlds[i], 
-                        emissiveTriOffset, false, (uint32)currInstance);
-
-                    // Update RT mesh to instance ID map
-                    scene.m_rtMeshInstanceIdxToID[currInstance++] = currTreeLevel.m_IDs[i];
-                }
-            }
-        }
+        const auto& currTreeLevel = scene.m_sceneGraph[treeLevelIdx];
+        levels.push_back(MeshInstanceLevel{
+            .IDs = currTreeLevel.m_IDs,
+            .MeshIDs = currTreeLevel.m_meshIDs,
+            .RtFlags = currTreeLevel.m_rtFlags });
     }
 
-    Assert(currInstance == numInstances, "Invalid instance count.");
+    PackMeshInstances(levels, scene.m_numStaticInstances, m_frameInstanceData, 
+        scene.m_rtMeshInstanceIdxToID, 
+        [this, &scene, sceneHasEmissives](uint32_t level, uint32_t idx, bool staticMesh, 
+            RT::MeshInstance& instance)
+        {
+            const auto& currTreeLevel = scene.m_sceneGraph[level + 1];
+            const uint64_t instanceID = currTreeLevel.m_IDs[idx];
+            const auto rtFlags = RT_Flags::Decode(currTreeLevel.m_rtFlags[idx]);
+            const uint32_t emissiveTriOffset = sceneHasEmissives &&
+                (rtFlags.InstanceMask & RT_AS_SUBGROUP::EMISSIVE) ?
+                scene.m_emissives.FindInstance(instanceID).value()->BaseTriOffset :
+                UINT32_MAX;
+
+            FillMeshInstanceData(instanceID, currTreeLevel.m_meshHandles[idx], 
+                currTreeLevel.m_toWorlds[idx], emissiveTriOffset, staticMesh, instance);
+        });
 
     const uint32_t sizeInBytes = numInstances * sizeof(RT::MeshInstance);
 
@@ -594,8 +668,9 @@ void TLAS::UpdateFrameMeshInstances_StaticToDynamic()
             UINT32_MAX;
 
         // Unsorted, sort happens below
-        FillMeshInstanceData(instance, meshID, currTreeLevel.m_toWorlds[treePos.Offset],
-            emissiveTriOffset, false, currInstance);
+        FillMeshInstanceData(instance, currTreeLevel.m_meshHandles[treePos.Offset], 
+            currTreeLevel.m_toWorlds[treePos.Offset], emissiveTriOffset, false, 
+            m_frameInstanceData[currInstance]);
         scene.m_rtMeshInstanceIdxToID[currInstance++] = instance;
 
         dynamicInstanceTreePositions.push_back(TreePosAndIdx{
@@ -651,21 +726,22 @@ void TLAS::UpdateFrameMeshInstances_NewTransform()
 {
     SceneCore& scene = App::GetScene();
     const bool sceneHasEmissives = scene.NumEmissiveInstances() > 0;
-    int64 minIdx = m_dynamicBLASes.size() - 1;
-    int64 maxIdx = 0;
+
+    struct InstanceUpdate
+    {
+        uint64_t ID;
+        SceneCore::TreePos TreePos;
+        // Index in m_dynamicBLASes
+        uint32_t DynamicIdx;
+    };
+
+    SmallVector<InstanceUpdate, App::FrameAllocator> updates;
+    updates.reserve(scene.m_instanceUpdates.size());
 
     for (auto it = scene.m_instanceUpdates.begin_it(); it != scene.m_instanceUpdates.end_it();
         it = scene.m_instanceUpdates.next_it(it))
     {
-        const auto instance = it->Key;
-        const auto treePos = scene.FindTreePosFromID(instance).value();
-        const auto& treeLevel = scene.m_sceneGraph[treePos.Level];
-
-        const auto rtFlags = RT_Flags::Decode(treeLevel.m_rtFlags[treePos.Offset]);
-        const uint32_t emissiveTriOffset = sceneHasEmissives &&
-            (rtFlags.InstanceMask & RT_AS_SUBGROUP::EMISSIVE) ?
-            scene.m_emissives.FindInstance(instance).value()->BaseTriOffset :
-            UINT32_MAX;
+        const auto treePos = scene.m_instances[it->Val.Handle];
 
         auto vecIt = std::lower_bound(m_dynamicBLASes.begin(), m_dynamicBLASes.end(), treePos,
             [](const DynamicBLAS& lhs, const SceneCore::TreePos& key)
@@ -679,30 +755,79 @@ void TLAS::UpdateFrameMeshInstances_NewTransform()
             });
 
         Assert(vecIt != m_dynamicBLASes.end(), "Dynamic BLAS for instance was not found.");
-        const auto& blas = *vecIt;
-        Assert(blas.TreeLevel == treePos.Level && blas.LevelIdx == treePos.Offset,
+        Assert(vecIt->TreeLevel == treePos.Level && vecIt->LevelIdx == treePos.Offset,
             "Dynamic BLAS for instance was not found.");
-        const auto idx = vecIt - m_dynamicBLASes.begin();
 
-        FillMeshInstanceData(instance, treeLevel.m_meshIDs[treePos.Offset],
-            treeLevel.m_toWorlds[treePos.Offset], 
-            emissiveTriOffset, 
-            false, 
-            blas.InstanceID);
-
-        minIdx = Min(minIdx, idx);
-        maxIdx = Max(maxIdx, idx);
+        updates.push_back(InstanceUpdate{
+            .ID = it->Key,
+            .TreePos = treePos,
+            .DynamicIdx = (uint32_t)(vecIt - m_dynamicBLASes.begin()) });
     }
 
-    Assert(minIdx <= maxIdx, "Invalid range.");
-    const size_t numInstancesToCopy = maxIdx - minIdx + 1;
-    const size_t sizeInBytes = numInstancesToCopy * sizeof(RT::MeshInstance);
-    const size_t offset = scene.m_numStaticInstances + minIdx;
+    if (updates.empty())
+        return;
+
+    // Sort by position in the mesh instance buffer so that adjacent updates can be copied 
+    // together
+    std::sort(updates.begin(), updates.end(), [](const InstanceUpdate& lhs, const InstanceUpdate& rhs)
+        {
+            return lhs.DynamicIdx < rhs.DynamicIdx;
+        });
+
+    // Only the updated instances are repacked. They're written directly to the mapped 
+    // upload memory (rather than staging the whole dynamic range in m_frameInstanceData 
+    // and copying it from there), and are then copied to their slots in the default heap 
+    // buffer.
+    const uint32_t numUpdates = (uint32_t)updates.size();
+    UploadHeapBuffer uploadBuffer = GpuMemory::GetUploadHeapBuffer(
+        numUpdates * sizeof(RT::MeshInstance));
+    uint8_t* mapped = reinterpret_cast<uint8_t*>(uploadBuffer.MappedMemory()) + uploadBuffer.Offset();
+
+    App::ParallelFor(0, numUpdates, MESH_INSTANCE_UPDATES_PER_JOB, 
+        [this, &scene, &updates, mapped, sceneHasEmissives](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; i++)
+            {
+                const auto& update = updates[i];
+                const auto& treeLevel = scene.m_sceneGraph[update.TreePos.Level];
+                const uint32_t offset = update.TreePos.Offset;
+
+                const auto rtFlags = RT_Flags::Decode(treeLevel.m_rtFlags[offset]);
+                const uint32_t emissiveTriOffset = sceneHasEmissives &&
+                    (rtFlags.InstanceMask & RT_AS_SUBGROUP::EMISSIVE) ?
+                    scene.m_emissives.FindInstance(update.ID).value()->BaseTriOffset :
+                    UINT32_MAX;
+
+                RT::MeshInstance instance;
+                FillMeshInstanceData(update.ID, treeLevel.m_meshHandles[offset],
+                    treeLevel.m_toWorlds[offset], emissiveTriOffset, false, instance);
+
+                // CPU copy is still needed for static-to-dynamic updates
+                m_frameInstanceData[m_dynamicBLASes[update.DynamicIdx].InstanceID] = instance;
+                memcpy(mapped + i * sizeof(RT::MeshInstance), &instance, sizeof(RT::MeshInstance));
+            }
+        });
+
+    // One copy per run of consecutive slots
+    SmallVector<BufferCopyRegion, App::FrameAllocator> regions;
+
+    for (uint32_t i = 0; i < numUpdates;)
+    {
+        uint32_t j = i + 1;
+        while (j < numUpdates && updates[j].DynamicIdx == updates[j - 1].DynamicIdx + 1)
+            j++;
+
+        regions.push_back(BufferCopyRegion{
+            .SrcOffsetInBytes = i * (uint32_t)sizeof(RT::MeshInstance),
+            .DestOffsetInBytes = (scene.m_numStaticInstances + updates[i].DynamicIdx) * 
+                (uint32_t)sizeof(RT::MeshInstance),
+            .SizeInBytes = (j - i) * (uint32_t)sizeof(RT::MeshInstance) });
+
+        i = j;
+    }
 
-    GpuMemory::UploadToDefaultHeapBuffer(m_framesMeshInstances[m_frameIdx], (uint32)sizeInBytes,
-        MemoryRegion{ .Data = m_frameInstanceData.data() + offset,
-        .SizeInBytes = sizeInBytes },
-        (uint32)(offset * sizeof(RT::MeshInstance)));
+    GpuMemory::UploadToDefaultHeapBuffer(m_framesMeshInstances[m_frameIdx], ZetaMove(uploadBuffer), 
+        regions);
 }
 
 void TLAS::Update()
@@ -826,7 +951,7 @@ void TLAS::BuildDynamicBLASes(ComputeCmdList& cmdList)
 
             if (flags.MeshMode != RT_MESH_MODE::STATIC)
             {
-                const TriangleMesh* mesh = scene.GetMesh(currTreeLevel.m_meshIDs[i]).value();
+                const TriangleMesh* mesh = scene.GetMesh(currTreeLevel.m_meshHandles[i]).value();
                 const auto sceneVBGpuVa = scene.GetMeshVB().GpuVA();
                 const auto sceneIBGpuVa = scene.GetMeshIB().GpuVA();
 
@@ -1053,9 +1178,9 @@ void TLAS::RebuildOrUpdateBLASes(ComputeCmdList& cmdList)
         for (auto instance : scene.m_pendingRtMeshModeSwitch)
         {
             const auto treePos = scene.FindTreePosFromID(instance).value();
-            const auto meshID = scene.m_sceneGraph[treePos.Level].m_meshIDs[treePos.Offset];
+            const auto meshHandle = scene.m_sceneGraph[treePos.Level].m_meshHandles[treePos.Offset];
 
-            const TriangleMesh* mesh = scene.GetMesh(meshID).value();
+            const TriangleMesh* mesh = scene.GetMesh(meshHandle).value();
             const auto sceneVBGpuVa = scene.GetMeshVB().GpuVA();
             const auto sceneIBGpuVa = scene.GetMeshIB().GpuVA();
 
@@ -1395,11 +1520,11 @@ void TLAS::UpdateTLASInstances_NewTransform(ComputeCmdList& cmdList)
     {
         // Just need to update current frame's transformation for TLAS instances (same
         // check as SceneCore::UpdateWorldTransformations())
-        if (it->Val < currFrame - 1)
+        if (it->Val.Frame < currFrame - 1)
             continue;
 
-        const auto instance = it->Key;
-        const SceneCore::TreePos treePos = scene.FindTreePosFromID(instance).value();
+        const InstanceHandle instance = it->Val.Handle;
+        const SceneCore::TreePos treePos = scene.m_instances[instance];
 
         auto vecIt = std::lower_bound(m_dynamicBLASes.begin(), m_dynamicBLASes.end(), treePos,
             [](const DynamicBLAS& lhs, const SceneCore::TreePos &key)
@@ -1473,7 +1598,7 @@ void TLAS::UpdateTLASInstances_NewTransform(ComputeCmdList& cmdList)
         // T + 2: Prev transform in scene and then mesh instance buffer are updated to W_new. Motion
         //        vectors become zero again.
         // T + 3: ?
-        if (it->Val < currFrame - 2)
+        if (it->Val.Frame < currFrame - 2)
         {
             scene.m_instanceUpdates.erase(it->Key);
             //LOG_UI_INFO("Erased frame %llu", it->Val);
@@ -4,6 +4,7 @@
 #include "RtCommon.h"
 #include "../Scene/SceneCommon.h"
 #include "../Support/Task.h"
+#include "../Utility/Span.h"
 
 namespace ZetaRay::Core
 {
@@ -11,14 +12,50 @@ namespace ZetaRay::Core
     class ComputeCmdList;
 }
 
-namespace ZetaRay::Util
-{
-    template<typename T>
-    struct Span;
-}
-
 namespace ZetaRay::RT
 {
+    //--------------------------------------------------------------------------------------
+    // Mesh instance packing
+    //--------------------------------------------------------------------------------------
+
+    // Instances of one scene graph level, indexed by offset in level
+    struct MeshInstanceLevel
+    {
+        Util::Span<uint64_t> IDs;
+        Util::Span<uint64_t> MeshIDs;
+        Util::Span<uint8_t> RtFlags;
+    };
+
+    // Fills in instance "idx" of level "level" (index into the levels passed to 
+    // PackMeshInstances())
+    using FillMeshInstanceFn = void(*)(void* ctx, uint32_t level, uint32_t idx, bool staticMesh, 
+        RT::MeshInstance& instance);
+
+    // Packs every instance with a static or dynamic (no rebuild) mesh -- static ones first, 
+    // each group in (level, offset in level) order. Levels are split into fixed-size chunks 
+    // that are counted, prefix summed and filled on the worker threads. instanceIDs[i] is set 
+    // to ID of the instance packed at instances[i]. Both spans must have exactly one element 
+    // per packed instance.
+    void PackMeshInstances(Util::Span<MeshInstanceLevel> levels, uint32_t numStatic,
+        Util::MutableSpan<RT::MeshInstance> instances, Util::MutableSpan<uint64_t> instanceIDs,
+        FillMeshInstanceFn fill, void* ctx);
+
+    // fill is called as fill(uint32_t level, uint32_t idx, bool staticMesh, RT::MeshInstance& instance)
+    template<typename F>
+    ZetaInline void PackMeshInstances(Util::Span<MeshInstanceLevel> levels, uint32_t numStatic,
+        Util::MutableSpan<RT::MeshInstance> instances, Util::MutableSpan<uint64_t> instanceIDs, 
+        F&& fill)
+    {
+        using Fn = std::remove_reference_t<F>;
+
+        PackMeshInstances(levels, numStatic, instances, instanceIDs, 
+            [](void* ctx, uint32_t level, uint32_t idx, bool staticMesh, RT::MeshInstance& instance)
+            {
+                (*reinterpret_cast<Fn*>(ctx))(level, idx, staticMesh, instance);
+            },
+            const_cast<void*>(reinterpret_cast<const void*>(&fill)));
+    }
+
     //--------------------------------------------------------------------------------------
     // Static BLAS
     //--------------------------------------------------------------------------------------
@@ -89,8 +126,8 @@ namespace ZetaRay::RT
         };
 
         // Frame mesh instances
-        void FillMeshInstanceData(uint64_t instanceID, uint64_t meshID, const Math::float4x3& M,
-            uint32_t emissiveTriOffset, bool staticMesh, uint32_t currInstance);
+        void FillMeshInstanceData(uint64_t instanceID, Scene::MeshHandle meshHandle, const Math::float4x3& M,
+            uint32_t emissiveTriOffset, bool staticMesh, RT::MeshInstance& instance);
         void RebuildFrameMeshInstanceData();
         void UpdateFrameMeshInstances_StaticToDynamic();
         void UpdateFrameMeshInstances_NewTransform();
@@ -299,6 +299,19 @@ namespace ZetaRay
         // 1. Draw another uniform sample u in [0, 1)
         // 2. If u <= AliasTable[x].P_Curr, return x
         // 3. Return AliasTable[x].Alias
+        // 
+        // Emissive triangles are sampled in two levels -- an instance is drawn proportional to its total
+        // power, followed by a triangle from that instance's own alias table. This way, a material change 
+        // only invalidates the tables of affected instances plus the (small) top level. For N triangles 
+        // and M instances, the alias table buffer is laid out as
+        // 
+        //      [0, N):             EmissiveLumenAliasTableEntry per triangle, aliases are within the same instance
+        //      N:                  EmissiveAliasTableHeader
+        //      [N + 1, N + 1 + M): EmissiveInstanceAliasTableEntry per instance
+        // 
+        // Triangle probabilities are stored unnormalized (i.e. triangle power), so that they remain valid
+        // when power of other instances changes. Multiplying by EmissiveAliasTableHeader::RcpTotalPower 
+        // gives the final probability.
         struct EmissiveLumenAliasTableEntry
         {
             // Cache the probabilities for both outcomes to avoid another (random) memory access at the
@@ -309,6 +322,24 @@ namespace ZetaRay
             uint32_t Alias;
         };
 
+        // Members alias the ones in EmissiveLumenAliasTableEntry as the whole table is read
+        // through the same buffer
+        struct EmissiveAliasTableHeader
+        {
+            float RcpTotalPower;
+            uint32_t NumInstances;
+            float Unused0;
+            uint32_t Unused1;
+        };
+
+        struct EmissiveInstanceAliasTableEntry
+        {
+            uint32_t BaseTriOffset;
+            uint32_t NumTriangles;
+            float P_Curr;
+            uint32_t Alias;
+        };
+
         struct PresampledEmissiveTriangle
         {
             float3_ pos;
@@ -0,0 +1,255 @@
+#include "Animation.h"
+#include "../Math/VectorFuncs.h"
+#include <algorithm>
+
+using namespace ZetaRay::Scene;
+using namespace ZetaRay::Scene::Internal;
+using namespace ZetaRay::Util;
+using namespace ZetaRay::Math;
+
+namespace
+{
+    // Number of keyframes that are stepped over one by one before falling back to binary search
+    static constexpr uint32_t MAX_LINEAR_STEPS = 4;
+
+    // Keyframe pairs and interpolation factors of NUM_LANES tracks
+    struct alignas(32) Lanes
+    {
+        float U[AnimationTracks::NUM_LANES];
+        float T1[3][AnimationTracks::NUM_LANES];
+        float T2[3][AnimationTracks::NUM_LANES];
+        float S1[3][AnimationTracks::NUM_LANES];
+        float S2[3][AnimationTracks::NUM_LANES];
+        float Q1[4][AnimationTracks::NUM_LANES];
+        float Q2[4][AnimationTracks::NUM_LANES];
+    };
+
+    ZetaInline __m256 __vectorcall Lerp(const __m256 v0, const __m256 v1, const __m256 vT)
+    {
+        // fma(t, v1, fma(-t, v0, v0));
+        return _mm256_fmadd_ps(vT, v1, _mm256_fnmadd_ps(vT, v0, v0));
+    }
+
+    // Same as slerp() in Quaternion.h for NUM_LANES quaternions at a time
+    void __vectorcall Slerp(const __m256 vU, const float q1[4][AnimationTracks::NUM_LANES],
+        const float q2[4][AnimationTracks::NUM_LANES], float res[4][AnimationTracks::NUM_LANES])
+    {
+        __m256 vQ1[4];
+        __m256 vQ2[4];
+
+        for (int c = 0; c < 4; c++)
+        {
+            vQ1[c] = _mm256_load_ps(q1[c]);
+            vQ2[c] = _mm256_load_ps(q2[c]);
+        }
+
+        __m256 vCosTheta = _mm256_mul_ps(vQ1[0], vQ2[0]);
+        vCosTheta = _mm256_fmadd_ps(vQ1[1], vQ2[1], vCosTheta);
+        vCosTheta = _mm256_fmadd_ps(vQ1[2], vQ2[2], vCosTheta);
+        vCosTheta = _mm256_fmadd_ps(vQ1[3], vQ2[3], vCosTheta);
+
+        // q and -q represent the same rotation. If on opposite hemispheres, negate q2 so that
+        // the shortest path is taken.
+        const __m256 vSign = _mm256_and_ps(vCosTheta, _mm256_set1_ps(-0.0f));
+        vCosTheta = _mm256_xor_ps(vCosTheta, vSign);
+
+        for (int c = 0; c < 4; c++)
+            vQ2[c] = _mm256_xor_ps(vQ2[c], vSign);
+
+        const __m256 vOne = _mm256_set1_ps(1.0f);
+        const __m256 vSinTheta = _mm256_sqrt_ps(_mm256_max_ps(_mm256_fnmadd_ps(vCosTheta, vCosTheta, vOne),
+            _mm256_setzero_ps()));
+        const __m256 vTheta = acos(vCosTheta);
+        const __m256 vS1 = sin(_mm256_mul_ps(_mm256_sub_ps(vOne, vU), vTheta));
+        const __m256 vS2 = sin(_mm256_mul_ps(vU, vTheta));
+        const __m256 vRcpSinTheta = _mm256_div_ps(vOne, vSinTheta);
+
+        // If theta is near zero, use linear interpolation followed by normalization,
+        // otherwise, there might be a divide-by-zero.
+        const __m256 vIsThetaNearZero = _mm256_cmp_ps(vCosTheta, _mm256_set1_ps(1.0f - FLT_EPSILON), _CMP_GT_OQ);
+        __m256 vLerp[4];
+        __m256 vNorm2 = _mm256_setzero_ps();
+
+        for (int c = 0; c < 4; c++)
+        {
+            vLerp[c] = Lerp(vQ1[c], vQ2[c], vU);
+            vNorm2 = _mm256_fmadd_ps(vLerp[c], vLerp[c], vNorm2);
+        }
+
+        const __m256 vRcpNorm = _mm256_div_ps(vOne, _mm256_sqrt_ps(vNorm2));
+
+        for (int c = 0; c < 4; c++)
+        {
+            __m256 vSlerp = _mm256_mul_ps(vQ1[c], vS1);
+            vSlerp = _mm256_fmadd_ps(vQ2[c], vS2, vSlerp);
+            vSlerp = _mm256_mul_ps(vSlerp, vRcpSinTheta);
+
+            const __m256 vRes = _mm256_blendv_ps(vSlerp, _mm256_mul_ps(vLerp[c], vRcpNorm), vIsThetaNearZero);
+            _mm256_store_ps(res[c], vRes);
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// AnimationTracks
+//--------------------------------------------------------------------------------------
+
+uint32_t AnimationTracks::Add(Span<Keyframe> keyframes, float t0, bool loop)
+{
+    Check(keyframes.size() > 1, "Invalid animation.");
+
+    const uint32_t track = (uint32_t)m_startOffsets.size();
+    m_startOffsets.push_back((uint32_t)m_times.size());
+    m_lengths.push_back((uint32_t)keyframes.size());
+    m_startTimes.push_back(t0);
+    m_loop.push_back(loop);
+    m_cursors.push_back(0);
+
+    for (size_t i = 0; i < keyframes.size(); i++)
+    {
+        const Keyframe& k = keyframes[i];
+        Check(i == 0 || keyframes[i - 1].Time < k.Time, "Keyframes must be sorted and have distinct times.");
+
+        m_times.push_back(k.Time);
+        m_translations.push_back(k.Transform.Translation);
+        m_rotations.push_back(k.Transform.Rotation);
+        m_scales.push_back(k.Transform.Scale);
+    }
+
+    return track;
+}
+
+uint32_t AnimationTracks::FindInterval(uint32_t track, float t)
+{
+    const float* times = m_times.data() + m_startOffsets[track];
+    // Index of the last interval
+    const uint32_t last = m_lengths[track] - 2;
+    uint32_t k = m_cursors[track];
+
+    // Time has moved backwards
+    if (t < times[k])
+        k = 0;
+
+    uint32_t numSteps = 0;
+
+    while (k < last && times[k + 1] <= t)
+    {
+        if (++numSteps > MAX_LINEAR_STEPS)
+        {
+            // First keyframe that comes after t, minus one
+            const float* next = std::upper_bound(times + k + 1, times + last + 1, t);
+            k = (uint32_t)(next - times) - 1;
+
+            break;
+        }
+
+        k++;
+    }
+
+    m_cursors[track] = k;
+
+    return k;
+}
+
+void AnimationTracks::Evaluate(float t, uint32_t begin, uint32_t end, MutableSpan<AffineTransformation> out)
+{
+    Assert(end <= NumTracks() && begin <= end, "Invalid range.");
+    Assert(out.size() >= end - begin, "Output is too small.");
+
+    Lanes lanes;
+    alignas(32) float T[3][NUM_LANES];
+    alignas(32) float S[3][NUM_LANES];
+    alignas(32) float Q[4][NUM_LANES];
+
+    for (uint32_t base = begin; base < end; base += NUM_LANES)
+    {
+        const int numLanes = (int)Min(end - base, (uint32_t)NUM_LANES);
+
+        // Gather keyframe pairs
+        for (int l = 0; l < numLanes; l++)
+        {
+            const uint32_t track = base + l;
+            const uint32_t start = m_startOffsets[track];
+            const uint32_t length = m_lengths[track];
+            const float* times = m_times.data() + start;
+            const float tFirst = times[0];
+            const float tLast = times[length - 1];
+            float tLocal = t - m_startTimes[track];
+            uint32_t k;
+            float u;
+
+            if (tLocal <= tFirst)
+            {
+                k = 0;
+                u = 0.0f;
+            }
+            else if (tLocal >= tLast && !m_loop[track])
+            {
+                k = length - 2;
+                u = 1.0f;
+            }
+            else
+            {
+                if (tLocal >= tLast)
+                    tLocal = tFirst + fmodf(tLocal - tFirst, tLast - tFirst);
+
+                k = FindInterval(track, tLocal);
+                u = Min((tLocal - times[k]) / (times[k + 1] - times[k]), 1.0f);
+            }
+
+            const uint32_t k1 = start + k;
+            const float* t1 = reinterpret_cast<const float*>(&m_translations[k1]);
+            const float* s1 = reinterpret_cast<const float*>(&m_scales[k1]);
+            const float* q1 = reinterpret_cast<const float*>(&m_rotations[k1]);
+            lanes.U[l] = u;
+
+            // Next keyframe immediately follows
+            for (int c = 0; c < 3; c++)
+            {
+                lanes.T1[c][l] = t1[c];
+                lanes.T2[c][l] = t1[c + 3];
+                lanes.S1[c][l] = s1[c];
+                lanes.S2[c][l] = s1[c + 3];
+            }
+
+            for (int c = 0; c < 4; c++)
+            {
+                lanes.Q1[c][l] = q1[c];
+                lanes.Q2[c][l] = q1[c + 4];
+            }
+        }
+
+        // Unused lanes of the last batch -- their results are discarded
+        for (int l = numLanes; l < NUM_LANES; l++)
+        {
+            lanes.U[l] = 0.0f;
+
+            for (int c = 0; c < 3; c++)
+            {
+                lanes.T1[c][l] = lanes.T2[c][l] = 0.0f;
+                lanes.S1[c][l] = lanes.S2[c][l] = 1.0f;
+            }
+
+            for (int c = 0; c < 4; c++)
+                lanes.Q1[c][l] = lanes.Q2[c][l] = c == 3 ? 1.0f : 0.0f;
+        }
+
+        const __m256 vU = _mm256_load_ps(lanes.U);
+
+        for (int c = 0; c < 3; c++)
+        {
+            _mm256_store_ps(T[c], Lerp(_mm256_load_ps(lanes.T1[c]), _mm256_load_ps(lanes.T2[c]), vU));
+            _mm256_store_ps(S[c], Lerp(_mm256_load_ps(lanes.S1[c]), _mm256_load_ps(lanes.S2[c]), vU));
+        }
+
+        Slerp(vU, lanes.Q1, lanes.Q2, Q);
+
+        for (int l = 0; l < numLanes; l++)
+        {
+            AffineTransformation& tr = out[base - begin + l];
+            tr.Translation = float3(T[0][l], T[1][l], T[2][l]);
+            tr.Scale = float3(S[0][l], S[1][l], S[2][l]);
+            tr.Rotation = float4(Q[0][l], Q[1][l], Q[2][l], Q[3][l]);
+        }
+    }
+}
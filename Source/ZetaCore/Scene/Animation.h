@@ -0,0 +1,70 @@
+#pragma once
+
+#include "../Math/Matrix.h"
+#include "../Utility/SmallVector.h"
+#include "../Utility/Span.h"
+
+namespace ZetaRay::Scene
+{
+    struct Keyframe
+    {
+        static Keyframe Identity()
+        {
+            Keyframe k;
+            k.Transform = Math::AffineTransformation::GetIdentity();
+
+            return k;
+        }
+
+        Math::AffineTransformation Transform;
+        float Time;
+    };
+}
+
+namespace ZetaRay::Scene::Internal
+{
+    //--------------------------------------------------------------------------------------
+    // AnimationTracks: Keyframe animations in structure-of-arrays form. Keyframes of all the
+    // tracks are stored back to back, with times, translations, rotations and scales in
+    // separate arrays. Tracks are evaluated NUM_LANES at a time -- keyframe pairs are
+    // gathered into SIMD lanes and interpolated (lerp for translation and scale, slerp for
+    // rotation) with AVX2.
+    //
+    // Every track remembers the keyframe interval that contained the last evaluation time
+    // and advances it incrementally, so binary search is only needed when time jumps
+    // backwards (e.g. loop restart) or skips past several keyframes.
+    //--------------------------------------------------------------------------------------
+
+    struct AnimationTracks
+    {
+        static constexpr int NUM_LANES = 8;
+
+        // Keyframes must be sorted by time. Returns index of the new track.
+        uint32_t Add(Util::Span<Keyframe> keyframes, float t0, bool loop);
+        // Writes transformation of tracks [begin, end) at time t to out[0, end - begin).
+        // Updates cursors of those tracks, so disjoint ranges can be evaluated concurrently.
+        void Evaluate(float t, uint32_t begin, uint32_t end,
+            Util::MutableSpan<Math::AffineTransformation> out);
+
+        ZetaInline uint32_t NumTracks() const { return (uint32_t)m_startOffsets.size(); }
+        ZetaInline bool Empty() const { return m_startOffsets.empty(); }
+
+    private:
+        // Interval [k, k + 1] of track's keyframes that contains given (local) time
+        uint32_t FindInterval(uint32_t track, float t);
+
+        // Keyframes
+        Util::SmallVector<float> m_times;
+        Util::SmallVector<Math::float3> m_translations;
+        Util::SmallVector<Math::float4> m_rotations;
+        Util::SmallVector<Math::float3> m_scales;
+
+        // Tracks
+        Util::SmallVector<uint32_t> m_startOffsets;
+        Util::SmallVector<uint32_t> m_lengths;
+        Util::SmallVector<float> m_startTimes;
+        Util::SmallVector<uint8_t> m_loop;
+        // Relative to track's first keyframe
+        Util::SmallVector<uint32_t> m_cursors;
+    };
+}
@@ -4,6 +4,7 @@
 #include "SceneCore.h"
 #include "../App/Log.h"
 #include "../App/Timer.h"
+#include "../Model/VertexQuantizer.h"
 #include <algorithm>
 
 using namespace ZetaRay::Core;
@@ -133,7 +134,9 @@ void MaterialBuffer::Add(uint32_t ID, const Material& mat)
     freeIdx += i << 6;        // Each uint64_t covers 64 slots
     Assert(freeIdx < MAX_NUM_MATERIALS, "Invalid table index.");
 
-    m_materials[ID] = Entry{ .Mat = mat, .GpuBufferIdx = freeIdx };
+    Assert(!m_IDtoHandle.find(ID), "Material with ID %u already exists.", ID);
+    const SlotHandle h = m_materials.insert(Entry{ .Mat = mat, .GpuBufferIdx = freeIdx });
+    m_IDtoHandle.insert_or_assign(ID, h);
 }
 
 void MaterialBuffer::UploadToGPU()
@@ -144,12 +147,11 @@ void MaterialBuffer::UploadToGPU()
         SmallVector<Material, FrameAllocator> buffer;
         buffer.resize(m_materials.size());
 
-        // Convert hash table to array
-        for (auto it = m_materials.begin_it(); it < m_materials.end_it(); it = m_materials.next_it(it))
-        {
-            const uint32_t bufferIndex = it->Val.GpuBufferIdx;
-            buffer[bufferIndex] = it->Val.Mat;
-        }
+        // Order in GPU buffer is given by buffer index rather than slot
+        m_materials.for_each([&buffer](SlotHandle, Entry& e)
+            {
+                buffer[e.GpuBufferIdx] = e.Mat;
+            });
 
         auto& renderer = App::GetRenderer();
         const size_t sizeInBytes = buffer.size() * sizeof(Material);
@@ -162,21 +164,22 @@ void MaterialBuffer::UploadToGPU()
         r.InsertOrAssignDefaultHeapBuffer(GlobalResource::MATERIAL_BUFFER, m_buffer);
     }
     // Update a single material
-    else if (m_staleID != UINT32_MAX)
+    else if (m_staleHandle.IsValid())
     {
-        auto* entry = m_materials.find(m_staleID).value();
+        const Entry* entry = m_materials.find(m_staleHandle).value();
 
         GpuMemory::UploadToDefaultHeapBuffer(m_buffer, sizeof(Material),
             MemoryRegion{.Data = &entry->Mat, .SizeInBytes = sizeof(Material)}, 
             sizeof(Material) * entry->GpuBufferIdx);
 
-        m_staleID = UINT32_MAX;
+        m_staleHandle = SlotHandle();
     }
 }
 
 void MaterialBuffer::ResizeAdditionalMaterials(uint32_t num)
 {
-    m_materials.resize(m_materials.size() + num, true);
+    m_materials.reserve(m_materials.size() + num);
+    m_IDtoHandle.resize(m_IDtoHandle.size() + num, true);
 }
 
 void MaterialBuffer::Clear()
@@ -192,14 +195,27 @@ void MaterialBuffer::Clear()
 uint32_t MeshContainer::Add(SmallVector<Core::Vertex>&& vertices, SmallVector<uint32_t>&& indices,
     uint32_t matIdx)
 {
-    const uint32_t vtxOffset = (uint32_t)m_vertices.size();
+    const uint32_t vtxOffset = m_numVertices;
     const uint32_t idxOffset = (uint32_t)m_indices.size();
 
+    // Material isn't known to be single-sided, so no normal cones
+    const uint32_t clusterOffset = (uint32_t)m_clusters.size();
+    m_clusters.resize(clusterOffset + ClusterBuilder::MaxNumClusters((uint32_t)indices.size() / 3));
+    const uint32_t numClusters = ClusterBuilder::Build(vertices, indices, false, 
+        MutableSpan(m_clusters.data() + clusterOffset, m_clusters.size() - clusterOffset));
+    m_clusters.resize(clusterOffset + numClusters);
+
     const uint32_t meshIdx = (uint32_t)m_meshes.size();
     const uint64_t meshFromSceneID = Scene::MeshID(Scene::DEFAULT_SCENE_ID, meshIdx, 0);
-    bool success = m_meshes.try_emplace(meshFromSceneID, vertices, vtxOffset, idxOffset, 
-        (uint32_t)indices.size(), matIdx);
-    Check(success, "mesh with ID (from mesh index %u) already exists.", meshIdx);
+    Check(!m_IDtoHandle.find(meshFromSceneID), "mesh with ID (from mesh index %u) already exists.", meshIdx);
+    Insert(meshFromSceneID, TriangleMesh(vertices, vtxOffset, idxOffset, (uint32_t)indices.size(), 
+        matIdx, clusterOffset, numClusters));
+
+    m_vertexRanges.push_back(VertexRange{ .SrcOffset = (uint32_t)m_vertices.size(), 
+        .DstOffset = vtxOffset, 
+        .NumVertices = (uint32_t)vertices.size(),
+        .Compact = false });
+    m_numVertices += (uint32_t)vertices.size();
 
     m_vertices.append_range(vertices.begin(), vertices.end());
     m_indices.append_range(indices.begin(), indices.end());
@@ -208,39 +224,156 @@ uint32_t MeshContainer::Add(SmallVector<Core::Vertex>&& vertices, SmallVector<ui
 }
 
 void MeshContainer::AddBatch(SmallVector<Model::glTF::Asset::Mesh>&& meshes, 
-    SmallVector<Core::Vertex>&& vertices, SmallVector<uint32_t>&& indices)
+    SmallVector<Core::Vertex>&& vertices, SmallVector<uint32_t>&& indices, Span<MeshCluster> clusters)
 {
-    const uint32_t vtxOffset = (uint32_t)m_vertices.size();
+    InsertMeshes(meshes, vertices, Span<AABB>(nullptr, 0), clusters);
+
+    m_vertexRanges.push_back(VertexRange{ .SrcOffset = (uint32_t)m_vertices.size(), 
+        .DstOffset = m_numVertices, 
+        .NumVertices = (uint32_t)vertices.size(),
+        .Compact = false });
+    m_numVertices += (uint32_t)vertices.size();
+
+    if (m_vertices.empty())
+        m_vertices = ZetaMove(vertices);
+    else
+        m_vertices.append_range(vertices.begin(), vertices.end());
+
+    if (m_indices.empty())
+        m_indices = ZetaMove(indices);
+    else
+        m_indices.append_range(indices.begin(), indices.end());
+}
+
+void MeshContainer::AddBatch(Span<Model::glTF::Asset::Mesh> meshes, Span<Core::Vertex> vertices, 
+    Span<uint32_t> indices, Span<MeshCluster> clusters)
+{
+    InsertMeshes(meshes, vertices, Span<AABB>(nullptr, 0), clusters);
+
+    m_vertexRanges.push_back(VertexRange{ .SrcOffset = (uint32_t)m_vertices.size(), 
+        .DstOffset = m_numVertices, 
+        .NumVertices = (uint32_t)vertices.size(),
+        .Compact = false });
+    m_numVertices += (uint32_t)vertices.size();
+
+    m_vertices.append_range(vertices.begin(), vertices.end(), true);
+    m_indices.append_range(indices.begin(), indices.end(), true);
+}
+
+void MeshContainer::AddBatch(SmallVector<Model::glTF::Asset::Mesh>&& meshes, 
+    SmallVector<Core::CompactVertex>&& vertices, Span<AABB> bounds, SmallVector<uint32_t>&& indices, 
+    Span<MeshCluster> clusters)
+{
+    InsertMeshes(meshes, Span<Vertex>(nullptr, 0), bounds, clusters);
+    AddCompactRanges(meshes, bounds, (uint32_t)m_compactVertices.size());
+    m_numVertices += (uint32_t)vertices.size();
+
+    if (m_compactVertices.empty())
+        m_compactVertices = ZetaMove(vertices);
+    else
+        m_compactVertices.append_range(vertices.begin(), vertices.end());
+
+    if (m_indices.empty())
+        m_indices = ZetaMove(indices);
+    else
+        m_indices.append_range(indices.begin(), indices.end());
+}
+
+void MeshContainer::AddBatch(Span<Model::glTF::Asset::Mesh> meshes, Span<Core::CompactVertex> vertices, 
+    Span<AABB> bounds, Span<uint32_t> indices, Span<MeshCluster> clusters)
+{
+    InsertMeshes(meshes, Span<Vertex>(nullptr, 0), bounds, clusters);
+    AddCompactRanges(meshes, bounds, (uint32_t)m_compactVertices.size());
+    m_numVertices += (uint32_t)vertices.size();
+
+    m_compactVertices.append_range(vertices.begin(), vertices.end(), true);
+    m_indices.append_range(indices.begin(), indices.end(), true);
+}
+
+void MeshContainer::InsertMeshes(Span<Model::glTF::Asset::Mesh> meshes, Span<Core::Vertex> vertices,
+    Span<AABB> bounds, Span<MeshCluster> clusters)
+{
+    Assert(bounds.empty() || bounds.size() == meshes.size(), "Every mesh must have bounds.");
+
+    const uint32_t vtxOffset = m_numVertices;
     const uint32_t idxOffset = (uint32_t)m_indices.size();
-    m_meshes.resize(meshes.size(), true);
+    const uint32_t clusterOffset = (uint32_t)m_clusters.size();
+    m_meshes.reserve(m_meshes.size() + meshes.size());
+    m_IDtoHandle.resize(m_IDtoHandle.size() + meshes.size(), true);
+    m_clusters.append_range(clusters.begin(), clusters.end(), true);
 
     // Each mesh primitive + material index combo must be unique
-    for (auto& mesh : meshes)
+    for (size_t i = 0; i < meshes.size(); i++)
     {
+        const auto& mesh = meshes[i];
         const uint64_t meshFromSceneID = Scene::MeshID(mesh.SceneID, mesh.MeshIdx, mesh.MeshPrimIdx);
         const uint32_t matFromSceneID = mesh.glTFMaterialIdx != -1 ?
             Scene::MaterialID(mesh.SceneID, mesh.glTFMaterialIdx) :
             Scene::DEFAULT_MATERIAL_ID;
 
-        bool success = m_meshes.try_emplace(meshFromSceneID, 
-            Span(vertices.begin() + mesh.BaseVtxOffset, mesh.NumVertices),
-            vtxOffset + mesh.BaseVtxOffset,
-            idxOffset + mesh.BaseIdxOffset,
-            mesh.NumIndices, 
-            matFromSceneID);
+        Assert(!m_IDtoHandle.find(meshFromSceneID), "Mesh with ID %llu already exists.", meshFromSceneID);
+
+        if (bounds.empty())
+        {
+            Insert(meshFromSceneID, TriangleMesh(Span(vertices.begin() + mesh.BaseVtxOffset, mesh.NumVertices),
+                vtxOffset + mesh.BaseVtxOffset,
+                idxOffset + mesh.BaseIdxOffset,
+                mesh.NumIndices, 
+                matFromSceneID,
+                clusterOffset + mesh.BaseClusterOffset,
+                mesh.NumClusters));
+        }
+        else
+        {
+            Insert(meshFromSceneID, TriangleMesh(bounds[i],
+                mesh.NumVertices,
+                vtxOffset + mesh.BaseVtxOffset,
+                idxOffset + mesh.BaseIdxOffset,
+                mesh.NumIndices, 
+                matFromSceneID,
+                clusterOffset + mesh.BaseClusterOffset,
+                mesh.NumClusters));
+        }
+    }
+}
+
+void MeshContainer::AddCompactRanges(Span<Model::glTF::Asset::Mesh> meshes, Span<AABB> bounds, 
+    uint32_t srcOffset)
+{
+    Assert(bounds.size() == meshes.size(), "Every mesh must have bounds.");
+    m_vertexRanges.reserve(m_vertexRanges.size() + meshes.size());
 
-        Assert(success, "Mesh with ID %llu already exists.", meshFromSceneID);
+    // Quantization bounds are per mesh, so each mesh is its own range
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        m_vertexRanges.push_back(VertexRange{ .Bounds = bounds[i],
+            .SrcOffset = srcOffset + meshes[i].BaseVtxOffset,
+            .DstOffset = m_numVertices + meshes[i].BaseVtxOffset,
+            .NumVertices = meshes[i].NumVertices,
+            .Compact = true });
     }
+}
 
-    if (m_vertices.empty())
-        m_vertices = ZetaMove(vertices);
-    else
-        m_vertices.append_range(vertices.begin(), vertices.end());
+void MeshContainer::Insert(uint64_t id, const TriangleMesh& mesh)
+{
+    const SlotHandle h = m_meshes.insert(Entry{ .Mesh = mesh, .Material = SlotHandle() });
+    m_IDtoHandle.insert_or_assign(id, h);
+}
 
-    if (m_indices.empty())
-        m_indices = ZetaMove(indices);
-    else
-        m_indices.append_range(indices.begin(), indices.end());
+bool MeshContainer::ResolveMaterials(const MaterialBuffer& matBuffer)
+{
+    bool resolved = true;
+
+    m_meshes.for_each([&matBuffer, &resolved](SlotHandle, Entry& e)
+        {
+            if (!e.Material.IsValid())
+            {
+                e.Material = matBuffer.GetHandle(e.Mesh.m_materialID);
+                resolved = resolved && e.Material.IsValid();
+            }
+        });
+
+    return resolved;
 }
 
 void MeshContainer::Reserve(size_t numVertices, size_t numIndices)
@@ -251,10 +384,10 @@ void MeshContainer::Reserve(size_t numVertices, size_t numIndices)
 
 void MeshContainer::RebuildBuffers()
 {
-    Assert(m_vertices.size() > 0, "vertex buffer is empty");
+    Assert(m_numVertices > 0, "vertex buffer is empty");
     Assert(m_indices.size() > 0, "index buffer is empty");
 
-    const uint32_t vbSizeInBytes = sizeof(Vertex) * (uint32_t)m_vertices.size();
+    const uint32_t vbSizeInBytes = sizeof(Vertex) * m_numVertices;
     const uint32_t ibSizeInBytes = sizeof(uint32_t) * (uint32_t)m_indices.size();
 
     PlacedResourceList<2> list;
@@ -266,9 +399,39 @@ void MeshContainer::RebuildBuffers()
     ID3D12Heap* heap = m_heap.Heap();
     auto allocs = list.AllocInfos();
 
-    m_vertexBuffer = GpuMemory::GetPlacedHeapBufferAndInit(GlobalResource::SCENE_VERTEX_BUFFER, 
-        vbSizeInBytes, heap, allocs[0].Offset, false, 
-        MemoryRegion{ .Data = m_vertices.data(), .SizeInBytes = vbSizeInBytes }, true);
+    m_vertexBuffer = GpuMemory::GetPlacedHeapBuffer(GlobalResource::SCENE_VERTEX_BUFFER, 
+        vbSizeInBytes, heap, allocs[0].Offset, false, false);
+
+    // Vertex buffer is assembled directly in the mapped upload memory. Compact vertices are 
+    // decoded there, so they never exist in full precision in CPU memory.
+    {
+        UploadHeapBuffer uploadBuffer = GpuMemory::GetUploadHeapBuffer(vbSizeInBytes, 4, true);
+        Vertex* mapped = reinterpret_cast<Vertex*>(reinterpret_cast<uint8_t*>(
+            uploadBuffer.MappedMemory()) + uploadBuffer.Offset());
+
+        App::ParallelFor(0, m_vertexRanges.size(), VERTEX_RANGES_PER_JOB, 
+            [this, mapped](size_t begin, size_t end)
+            {
+                for (size_t i = begin; i < end; i++)
+                {
+                    const VertexRange& r = m_vertexRanges[i];
+                    MutableSpan<Vertex> dst(mapped + r.DstOffset, r.NumVertices);
+
+                    if (r.Compact)
+                    {
+                        VertexQuantizer::Decode(Span(m_compactVertices.data() + r.SrcOffset, r.NumVertices),
+                            r.Bounds, dst);
+                    }
+                    else
+                        memcpy(dst.data(), m_vertices.data() + r.SrcOffset, r.NumVertices * sizeof(Vertex));
+                }
+            });
+
+        const BufferCopyRegion region = { .SrcOffsetInBytes = 0, 
+            .DestOffsetInBytes = 0, 
+            .SizeInBytes = vbSizeInBytes };
+        GpuMemory::UploadToDefaultHeapBuffer(m_vertexBuffer, ZetaMove(uploadBuffer), Span(&region, 1));
+    }
 
     m_indexBuffer = GpuMemory::GetPlacedHeapBufferAndInit(GlobalResource::SCENE_INDEX_BUFFER,
         ibSizeInBytes, heap, allocs[1].Offset, false, 
@@ -279,6 +442,8 @@ void MeshContainer::RebuildBuffers()
     r.InsertOrAssignDefaultHeapBuffer(GlobalResource::SCENE_INDEX_BUFFER, m_indexBuffer);
 
     m_vertices.free_memory();
+    m_compactVertices.free_memory();
+    m_vertexRanges.free_memory();
     m_indices.free_memory();
 }
 
@@ -293,15 +458,14 @@ void MeshContainer::Clear()
 // EmissiveBuffer
 //--------------------------------------------------------------------------------------
 
-void EmissiveBuffer::AddBatch(SmallVector<Asset::EmissiveInstance>&& instances, 
-    SmallVector<RT::EmissiveTriangle>&& tris)
+void EmissiveBuffer::AddBatch(Span<Asset::EmissiveInstance> instances, Span<RT::EmissiveTriangle> tris)
 {
     App::DeltaTimer timer;
     timer.Start();
 
     // TODO implement
     Check(m_trisCpu.empty(), "Not implemented.");
-    m_instances = instances;
+    m_instances.append_range(instances.begin(), instances.end(), true);
 
     // Map instance ID to index in instances
     HashTable<uint32, uint64, App::FrameAllocator> idToIdxMap;
@@ -358,19 +522,19 @@ void EmissiveBuffer::UploadToGPU()
         auto& r = App::GetRenderer().GetSharedShaderResources();
         r.InsertOrAssignDefaultHeapBuffer(GlobalResource::EMISSIVE_TRIANGLE_BUFFER, m_trisGpu);
     }
-    else if(m_staleNumTris > 0)
+    else if(!m_staleRanges.empty())
     {
-        Assert(m_staleBaseOffset != UINT32_MAX, "Invalid base offset.");
-        const size_t numMbytes = sizeof(RT::EmissiveTriangle) * m_staleNumTris / (1024 * 1024);
-        LOG_UI_INFO("Uploading %d emissive triangles (%d MB)...", m_staleNumTris, numMbytes);
+        CoalesceStaleRanges();
 
-        const size_t sizeInBytes = sizeof(RT::EmissiveTriangle) * m_staleNumTris;
-        GpuMemory::UploadToDefaultHeapBuffer(m_trisGpu, (uint32)sizeInBytes,
-            MemoryRegion{ .Data = &m_trisCpu[m_staleBaseOffset], .SizeInBytes = (uint32)sizeInBytes },
-            m_staleBaseOffset * sizeof(RT::EmissiveTriangle));
+        for (auto r : m_staleRanges)
+        {
+            const size_t sizeInBytes = sizeof(RT::EmissiveTriangle) * (r.End - r.Begin);
+            GpuMemory::UploadToDefaultHeapBuffer(m_trisGpu, (uint32)sizeInBytes,
+                MemoryRegion{ .Data = &m_trisCpu[r.Begin], .SizeInBytes = (uint32)sizeInBytes },
+                r.Begin * sizeof(RT::EmissiveTriangle));
+        }
 
-        m_staleNumTris = 0;
-        m_staleBaseOffset = UINT32_MAX;
+        m_staleRanges.clear();
     }
 }
 
@@ -392,7 +556,7 @@ void EmissiveBuffer::UpdateMaterial(uint64_t instanceID, const float3& emissiveF
     const uint32 newEmissiveFactor = Float3ToRGB8(emissiveFactor);
     const half newStrength(strength);
 
-    m_staleBaseOffset = m_instances[idx].BaseTriOffset;
+    const uint32_t begin = m_instances[idx].BaseTriOffset;
 
     // Find every instance that uses this material
     while (idx < (int64)m_instances.size() && m_instances[idx].MaterialIdx == modifiedMatIdx)
@@ -405,15 +569,59 @@ void EmissiveBuffer::UpdateMaterial(uint64_t instanceID, const float3& emissiveF
             m_trisCpu[i].SetStrength(newStrength);
         }
 
-        m_staleNumTris += m_instances[idx].NumTriangles;
         idx++;
     } 
+
+    // Since instances are sorted by material, modified triangles form a contiguous range
+    const uint32_t end = m_instances[idx - 1].BaseTriOffset + m_instances[idx - 1].NumTriangles;
+
+    m_staleRanges.push_back(TriRange{ .Begin = begin, .End = end });
+    AddStalePowerRange(begin, end);
+}
+
+void EmissiveBuffer::UpdateTriPositions(size_t startIdx, size_t endIdx, bool powerChanged)
+{
+    Assert(startIdx <= endIdx && endIdx <= m_trisCpu.size(), "Invalid index.");
+
+    if (startIdx == endIdx)
+        return;
+
+    m_staleRanges.push_back(TriRange{ .Begin = (uint32)startIdx, .End = (uint32)endIdx });
+
+    if (powerChanged)
+        AddStalePowerRange((uint32)startIdx, (uint32)endIdx);
+}
+
+void EmissiveBuffer::AddStalePowerRange(uint32_t begin, uint32_t end)
+{
+    // Merge with ranges from previous calls that haven't been consumed yet
+    const uint32_t newBase = m_stalePowerNumTris > 0 ? Min(m_stalePowerBaseOffset, begin) : begin;
+    const uint32_t newEnd = m_stalePowerNumTris > 0 ? 
+        Max(m_stalePowerBaseOffset + m_stalePowerNumTris, end) : 
+        end;
+
+    m_stalePowerBaseOffset = newBase;
+    m_stalePowerNumTris = newEnd - newBase;
 }
 
-void EmissiveBuffer::UpdateTriPositions(size_t startIdx, size_t endIdx)
+void EmissiveBuffer::CoalesceStaleRanges()
 {
-    Assert(endIdx <= m_trisCpu.size(), "Invalid index.");
+    std::sort(m_staleRanges.begin(), m_staleRanges.end(),
+        [](const TriRange& r1, const TriRange& r2)
+        {
+            return r1.Begin < r2.Begin;
+        });
+
+    // Merge overlapping or nearby ranges in place
+    size_t curr = 0;
+
+    for (size_t i = 1; i < m_staleRanges.size(); i++)
+    {
+        if (m_staleRanges[i].Begin <= m_staleRanges[curr].End + MAX_STALE_RANGE_GAP)
+            m_staleRanges[curr].End = Max(m_staleRanges[curr].End, m_staleRanges[i].End);
+        else
+            m_staleRanges[++curr] = m_staleRanges[i];
+    }
 
-    m_staleBaseOffset = (uint32)startIdx;
-    m_staleNumTris = (uint32)(endIdx - startIdx);
+    m_staleRanges.resize(curr + 1);
 }
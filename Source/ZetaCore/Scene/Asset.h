@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../Utility/HashTable.h"
+#include "../Utility/SlotMap.h"
 #include "../Core/DescriptorHeap.h"
 #include "../Model/glTFAsset.h"
 #include "../RayTracing/RtCommon.h"
@@ -75,17 +76,30 @@ namespace ZetaRay::Scene::Internal
         void Add(uint32_t ID, const Material& mat);
         void Update(uint32_t ID, const Material& mat)
         {
-            auto it = m_materials.find(ID);
-            it.value()->Mat = mat;
-            m_staleID = ID;
+            const Util::SlotHandle h = GetHandle(ID);
+            m_materials[h].Mat = mat;
+            m_staleHandle = h;
         }
         void UploadToGPU();
         void ResizeAdditionalMaterials(uint32_t num);
         uint32_t NumMaterials() const { return (uint32_t)m_materials.size(); }
 
+        // Returns an invalid handle if there's no material with the given ID
+        ZetaInline Util::SlotHandle GetHandle(uint32_t ID) const
+        {
+            auto it = m_IDtoHandle.find(ID);
+            if (it)
+                return *it.value();
+
+            return Util::SlotHandle();
+        }
         ZetaInline Util::Optional<const Material*> Get(uint32_t ID, uint32* bufferIdx = nullptr) const
         {
-            auto it = m_materials.find(ID);
+            return Get(GetHandle(ID), bufferIdx);
+        }
+        ZetaInline Util::Optional<const Material*> Get(Util::SlotHandle h, uint32* bufferIdx = nullptr) const
+        {
+            auto it = m_materials.find(h);
             if (it)
             {
                 auto* entry = it.value();
@@ -112,8 +126,9 @@ namespace ZetaRay::Scene::Internal
         uint64_t m_inUseBitset[NUM_MASKS] = { 0 };
 
         Core::GpuMemory::Buffer m_buffer;
-        Util::HashTable<Entry, uint32_t> m_materials;
-        uint32 m_staleID = UINT32_MAX;
+        Util::SlotMap<Entry> m_materials;
+        Util::HashTable<Util::SlotHandle, uint32_t> m_IDtoHandle;
+        Util::SlotHandle m_staleHandle;
     };
 
     //--------------------------------------------------------------------------------------
@@ -126,29 +141,112 @@ namespace ZetaRay::Scene::Internal
             uint32_t matIdx);
         void AddBatch(Util::SmallVector<Model::glTF::Asset::Mesh>&& meshes, 
             Util::SmallVector<Core::Vertex>&& vertices,
-            Util::SmallVector<uint32_t>&& indices);
+            Util::SmallVector<uint32_t>&& indices,
+            Util::Span<Model::MeshCluster> clusters);
+        // Same as above, but data is copied
+        void AddBatch(Util::Span<Model::glTF::Asset::Mesh> meshes,
+            Util::Span<Core::Vertex> vertices,
+            Util::Span<uint32_t> indices,
+            Util::Span<Model::MeshCluster> clusters);
+        // Vertices are kept in the compact layout and are only decoded when the vertex buffer 
+        // is uploaded. Positions of each mesh are relative to its element in bounds.
+        void AddBatch(Util::SmallVector<Model::glTF::Asset::Mesh>&& meshes, 
+            Util::SmallVector<Core::CompactVertex>&& vertices,
+            Util::Span<Math::AABB> bounds,
+            Util::SmallVector<uint32_t>&& indices,
+            Util::Span<Model::MeshCluster> clusters);
+        // Same as above, but data is copied
+        void AddBatch(Util::Span<Model::glTF::Asset::Mesh> meshes,
+            Util::Span<Core::CompactVertex> vertices,
+            Util::Span<Math::AABB> bounds,
+            Util::Span<uint32_t> indices,
+            Util::Span<Model::MeshCluster> clusters);
         void Reserve(size_t numVertices, size_t numIndices);
         void RebuildBuffers();
         void Clear();
 
         // Note: not thread safe for reading and writing at the same time
+        // Returns an invalid handle if there's no mesh with the given ID
+        ZetaInline Util::SlotHandle GetHandle(uint64_t id) const
+        {
+            auto it = m_IDtoHandle.find(id);
+            if (it)
+                return *it.value();
+
+            return Util::SlotHandle();
+        }
         ZetaInline Util::Optional<const Model::TriangleMesh*> GetMesh(uint64_t id) const
         {
-            auto it = m_meshes.find(id);
+            return GetMesh(GetHandle(id));
+        }
+        // Optionally returns handle of mesh's material, which is invalid until set by
+        // ResolveMaterials()
+        ZetaInline Util::Optional<const Model::TriangleMesh*> GetMesh(Util::SlotHandle h, 
+            Util::SlotHandle* matHandle = nullptr) const
+        {
+            auto it = m_meshes.find(h);
             if (it)
-                return it.value();
+            {
+                auto* entry = it.value();
+
+                if (matHandle)
+                    *matHandle = entry->Material;
+
+                return &entry->Mesh;
+            }
 
             return {};
         }
+        // Returns false if the material of some mesh isn't in the given buffer yet
+        bool ResolveMaterials(const MaterialBuffer& matBuffer);
+
+        // Clusters are kept on the CPU for culling after vertex and index buffers are uploaded
+        ZetaInline Util::Span<Model::MeshCluster> GetClusters(const Model::TriangleMesh& mesh) const
+        {
+            return Util::Span(m_clusters.data() + mesh.m_clusterOffset, mesh.m_numClusters);
+        }
 
         const Core::GpuMemory::Buffer& GetVB() const { return m_vertexBuffer; }
         const Core::GpuMemory::Buffer& GetIB() const { return m_indexBuffer; }
         uint32_t NumMeshes() const { return (uint32_t)m_meshes.size(); }
 
     private:
-        Util::HashTable<Model::TriangleMesh> m_meshes;
+        struct Entry
+        {
+            Model::TriangleMesh Mesh;
+            Util::SlotHandle Material;
+        };
+
+        static constexpr size_t VERTEX_RANGES_PER_JOB = 16;
+
+        // Range of the vertex buffer and where its vertices are kept until upload
+        struct VertexRange
+        {
+            // Only for compact ranges
+            Math::AABB Bounds;
+            // Offset in m_vertices or m_compactVertices
+            uint32_t SrcOffset;
+            uint32_t DstOffset;
+            uint32_t NumVertices;
+            bool Compact;
+        };
+
+        void Insert(uint64_t id, const Model::TriangleMesh& mesh);
+        // Mesh bounds are computed from vertices unless given
+        void InsertMeshes(Util::Span<Model::glTF::Asset::Mesh> meshes, Util::Span<Core::Vertex> vertices,
+            Util::Span<Math::AABB> bounds, Util::Span<Model::MeshCluster> clusters);
+        void AddCompactRanges(Util::Span<Model::glTF::Asset::Mesh> meshes, Util::Span<Math::AABB> bounds,
+            uint32_t srcOffset);
+
+        Util::SlotMap<Entry> m_meshes;
+        Util::HashTable<Util::SlotHandle> m_IDtoHandle;
         Util::SmallVector<Core::Vertex> m_vertices;
+        Util::SmallVector<Core::CompactVertex> m_compactVertices;
+        Util::SmallVector<VertexRange> m_vertexRanges;
+        // Total over all ranges
+        uint32_t m_numVertices = 0;
         Util::SmallVector<uint32_t> m_indices;
+        Util::SmallVector<Model::MeshCluster> m_clusters;
 
         Core::GpuMemory::Buffer m_vertexBuffer;
         Core::GpuMemory::Buffer m_indexBuffer;
@@ -186,7 +284,16 @@ namespace ZetaRay::Scene::Internal
         ZetaInline Util::Span<Instance> Instances() { return m_instances; }
         ZetaInline Util::MutableSpan<RT::EmissiveTriangle> Triagnles() { return m_trisCpu; }
         ZetaInline Util::MutableSpan<Triangle> InitialTriPositions() { return m_triInitialPos; }
-        ZetaInline bool HasStaleMaterials() const { return m_staleNumTris > 0; }
+        ZetaInline bool HasStalePower() const { return m_stalePowerNumTris > 0; }
+        // Triangles in [base, base + num) need their power re-estimated since the last call to 
+        // ClearStalePower() -- either their material was modified or their instance was scaled
+        ZetaInline uint32_t StalePowerBaseOffset() const { return m_stalePowerBaseOffset; }
+        ZetaInline uint32_t NumStalePowerTriangles() const { return m_stalePowerNumTris; }
+        ZetaInline void ClearStalePower()
+        {
+            m_stalePowerBaseOffset = UINT32_MAX;
+            m_stalePowerNumTris = 0;
+        }
         ZetaInline Util::Optional<const Instance*> FindInstance(uint64_t ID)
         {
             auto it = m_idToIdxMap.find(ID);
@@ -199,19 +306,39 @@ namespace ZetaRay::Scene::Internal
         // Assumes proper GPU synchronization has been performed
         void Clear();
         void UpdateMaterial(uint64_t instanceID, const Math::float3& emissiveFactor, float strength);
-        void UpdateTriPositions(size_t startIdx, size_t endIdx);
-        void AddBatch(Util::SmallVector<Instance>&& instances,
-            Util::SmallVector<RT::EmissiveTriangle>&& tris);
+        // Marks triangles [startIdx, endIdx) as moved. Ranges from multiple calls are kept
+        // separate and coalesced before upload, so that only touched triangles are uploaded.
+        // Rigid motion preserves power, otherwise (e.g. scaling) the range is also added to 
+        // the stale power range.
+        void UpdateTriPositions(size_t startIdx, size_t endIdx, bool powerChanged);
+        void AddBatch(Util::Span<Instance> instances, Util::Span<RT::EmissiveTriangle> tris);
         void UploadToGPU();
 
     private:
+        // Ranges that are at most this many triangles apart are uploaded together -- a few
+        // unchanged triangles are cheaper than another copy
+        static constexpr uint32_t MAX_STALE_RANGE_GAP = 64;
+
+        struct TriRange
+        {
+            uint32_t Begin;
+            uint32_t End;
+        };
+
+        void CoalesceStaleRanges();
+        void AddStalePowerRange(uint32_t begin, uint32_t end);
+
         Util::SmallVector<Instance> m_instances;
         Util::SmallVector<RT::EmissiveTriangle> m_trisCpu;
         Util::SmallVector<Triangle> m_triInitialPos;
         // Maps instance ID to index in m_instances
         Util::HashTable<uint32_t> m_idToIdxMap;
         Core::GpuMemory::Buffer m_trisGpu;
-        uint32_t m_staleBaseOffset = UINT32_MAX;
-        uint32_t m_staleNumTris = 0;
+        // Triangle ranges modified since the last upload
+        Util::SmallVector<TriRange> m_staleRanges;
+        // Union of triangle ranges whose power changed. Unlike m_staleRanges, it's not reset 
+        // on upload, as position updates come in after the scene has checked it for the frame.
+        uint32_t m_stalePowerBaseOffset = UINT32_MAX;
+        uint32_t m_stalePowerNumTris = 0;
     };
 }
\ No newline at end of file
@@ -0,0 +1,932 @@
+#include "LightTree.h"
+#include "../RayTracing/RtCommon.h"
+#include "../App/App.h"
+#include <algorithm>
+#include <atomic>
+
+using namespace ZetaRay;
+using namespace ZetaRay::Scene;
+using namespace ZetaRay::Math;
+using namespace ZetaRay::Util;
+
+namespace
+{
+    // Marks an empty cone, i.e. bounds that don't contain any light yet
+    static constexpr float EMPTY_CONE = 2.0f;
+    static constexpr float ONE_MINUS_EPSILON = 0x1.fffffep-1f;
+
+    ZetaInline float SafeSqrt(float x)
+    {
+        return sqrtf(Max(x, 0.0f));
+    }
+
+    ZetaInline float SafeACos(float x)
+    {
+        return acosf(Min(Max(x, -1.0f), 1.0f));
+    }
+
+    ZetaInline float3 Min3(const float3& a, const float3& b)
+    {
+        return float3(Min(a.x, b.x), Min(a.y, b.y), Min(a.z, b.z));
+    }
+
+    ZetaInline float3 Max3(const float3& a, const float3& b)
+    {
+        return float3(Max(a.x, b.x), Max(a.y, b.y), Max(a.z, b.z));
+    }
+
+    ZetaInline float SurfaceArea(const float3& boxMin, const float3& boxMax)
+    {
+        if (boxMin.x > boxMax.x)
+            return 0.0f;
+
+        const float3 d = boxMax - boxMin;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    // cos(max(0, theta_a - theta_b))
+    ZetaInline float CosSubClamped(float sinTheta_a, float cosTheta_a, float sinTheta_b, float cosTheta_b)
+    {
+        if (cosTheta_a > cosTheta_b)
+            return 1.0f;
+
+        return cosTheta_a * cosTheta_b + sinTheta_a * sinTheta_b;
+    }
+
+    // sin(max(0, theta_a - theta_b))
+    ZetaInline float SinSubClamped(float sinTheta_a, float cosTheta_a, float sinTheta_b, float cosTheta_b)
+    {
+        if (cosTheta_a > cosTheta_b)
+            return 0.0f;
+
+        return sinTheta_a * cosTheta_b - cosTheta_a * sinTheta_b;
+    }
+
+    // Smallest cone (approximately) that contains both cones (Ref. [2])
+    void ConeUnion(const float3& w_a, float cosTheta_a, const float3& w_b, float cosTheta_b,
+        float3& w, float& cosTheta)
+    {
+        if (cosTheta_a == EMPTY_CONE || cosTheta_b == EMPTY_CONE)
+        {
+            w = cosTheta_a == EMPTY_CONE ? w_b : w_a;
+            cosTheta = cosTheta_a == EMPTY_CONE ? cosTheta_b : cosTheta_a;
+
+            return;
+        }
+
+        // Containment tests don't need the angles, which makes the common case when binning
+        // (a narrow cone added to a wider one that already contains it) much cheaper.
+        // theta_d + theta_b <= theta_a iff theta_d + theta_b <= pi and
+        // cos(theta_d + theta_b) >= cos(theta_a).
+        const float cosTheta_d = Min(Max(w_a.dot(w_b), -1.0f), 1.0f);
+        const float sinTheta_d = SafeSqrt(1.0f - cosTheta_d * cosTheta_d);
+        const float sinTheta_a = SafeSqrt(1.0f - cosTheta_a * cosTheta_a);
+        const float sinTheta_b = SafeSqrt(1.0f - cosTheta_b * cosTheta_b);
+
+        if (cosTheta_a == -1.0f || (cosTheta_d >= -cosTheta_b &&
+            cosTheta_d * cosTheta_b - sinTheta_d * sinTheta_b >= cosTheta_a))
+        {
+            w = w_a;
+            cosTheta = cosTheta_a;
+
+            return;
+        }
+
+        if (cosTheta_b == -1.0f || (cosTheta_d >= -cosTheta_a &&
+            cosTheta_d * cosTheta_a - sinTheta_d * sinTheta_a >= cosTheta_b))
+        {
+            w = w_b;
+            cosTheta = cosTheta_b;
+
+            return;
+        }
+
+        const float theta_a = SafeACos(cosTheta_a);
+        const float theta_b = SafeACos(cosTheta_b);
+        const float theta_d = SafeACos(cosTheta_d);
+
+        const float theta_o = 0.5f * (theta_a + theta_d + theta_b);
+        float3 w_r = w_a.cross(w_b);
+        const float lenSq = w_r.dot(w_r);
+
+        if (theta_o >= PI || lenSq == 0.0f)
+        {
+            w = w_a;
+            cosTheta = -1.0f;
+
+            return;
+        }
+
+        // Rotate w_a towards w_b around w_r, which is orthogonal to w_a
+        w_r /= sqrtf(lenSq);
+        const float theta_r = theta_o - theta_a;
+        w = w_a * cosf(theta_r) + w_r.cross(w_a) * sinf(theta_r);
+        w.normalize();
+        cosTheta = cosf(theta_o);
+    }
+
+    struct LightBounds
+    {
+        void Init()
+        {
+            BoxMin = float3(FLT_MAX);
+            BoxMax = float3(-FLT_MAX);
+            Axis = float3(0.0f, 0.0f, 1.0f);
+            CosTheta_o = EMPTY_CONE;
+            CosTheta_e = 1.0f;
+            Power = 0.0f;
+            TwoSided = false;
+        }
+
+        void Extend(const LightBounds& other)
+        {
+            if (other.CosTheta_o == EMPTY_CONE)
+                return;
+
+            BoxMin = Min3(BoxMin, other.BoxMin);
+            BoxMax = Max3(BoxMax, other.BoxMax);
+            ConeUnion(Axis, CosTheta_o, other.Axis, other.CosTheta_o, Axis, CosTheta_o);
+            CosTheta_e = Min(CosTheta_e, other.CosTheta_e);
+            Power += other.Power;
+            TwoSided = TwoSided || other.TwoSided;
+        }
+
+        // Solid angle measure of the emission directions (M_Omega in Ref. [1])
+        float OrientationMeasure() const
+        {
+            const float theta_o = SafeACos(CosTheta_o);
+            const float theta_e = SafeACos(CosTheta_e);
+            const float theta_w = Min(theta_o + theta_e, PI);
+            const float sinTheta_o = SafeSqrt(1.0f - CosTheta_o * CosTheta_o);
+
+            return TWO_PI * (1.0f - CosTheta_o) + 0.5f * PI * (2.0f * theta_w * sinTheta_o -
+                cosf(theta_o - 2.0f * theta_w) - 2.0f * theta_o * sinTheta_o + CosTheta_o);
+        }
+
+        void ToNode(LightTree::Node& node) const
+        {
+            node.BoxMin = BoxMin;
+            node.BoxMax = BoxMax;
+            node.Power = Power;
+            node.Axis = Axis;
+            node.CosTheta_o = CosTheta_o == EMPTY_CONE ? 1.0f : CosTheta_o;
+            node.CosTheta_e = CosTheta_e;
+            node.TwoSided = TwoSided;
+        }
+
+        float3 BoxMin;
+        float3 BoxMax;
+        float3 Axis;
+        float CosTheta_o;
+        float CosTheta_e;
+        float Power;
+        bool TwoSided;
+    };
+
+    LightBounds TriangleBounds(const RT::EmissiveTriangle& t, float power)
+    {
+        // LoadVertices() isn't const
+        RT::EmissiveTriangle tri = t;
+        __m128 v0, v1, v2;
+        tri.LoadVertices(v0, v1, v2);
+
+        const float3 p0 = storeFloat3(v0);
+        const float3 p1 = storeFloat3(v1);
+        const float3 p2 = storeFloat3(v2);
+
+        LightBounds b;
+        b.BoxMin = Min3(p0, Min3(p1, p2));
+        b.BoxMax = Max3(p0, Max3(p1, p2));
+        b.Power = power;
+        b.TwoSided = tri.IsDoubleSided();
+        // Triangles emit over the hemisphere around each direction
+        b.CosTheta_e = 0.0f;
+
+        float3 n = (p1 - p0).cross(p2 - p0);
+        const float len = n.length();
+
+        // Degenerate triangles don't have an orientation, include every direction
+        b.Axis = len > 0.0f ? n / len : float3(0.0f, 0.0f, 1.0f);
+        b.CosTheta_o = len > 0.0f ? 1.0f : -1.0f;
+
+        return b;
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// Builder
+//--------------------------------------------------------------------------------------
+
+struct LightTree::Builder
+{
+    // Subtrees with at least this many triangles are built on the worker threads
+    static constexpr uint32_t PARALLEL_BUILD_THRESHOLD = 4096;
+    // Nodes with at least this many triangles are binned on the worker threads
+    static constexpr uint32_t PARALLEL_BINNING_THRESHOLD = 32 * 1024;
+    static constexpr uint32_t BINNING_CHUNK_SIZE = 8192;
+    static constexpr uint32_t MAX_NUM_BINNING_CHUNKS = 32;
+    static constexpr size_t PRIMS_PER_JOB = 4096;
+
+    struct Prim
+    {
+        LightBounds B;
+        float3 Centroid;
+        uint32_t TriIdx;
+    };
+
+    struct CentroidBounds
+    {
+        void Init()
+        {
+            Min = float3(FLT_MAX);
+            Max = float3(-FLT_MAX);
+        }
+
+        void Extend(const CentroidBounds& other)
+        {
+            Min = Min3(Min, other.Min);
+            Max = Max3(Max, other.Max);
+        }
+
+        float3 Min;
+        float3 Max;
+    };
+
+    // One set of bins per axis
+    struct BinSet
+    {
+        void Init()
+        {
+            for (int axis = 0; axis < 3; axis++)
+            {
+                for (int b = 0; b < NUM_SAOH_BINS; b++)
+                {
+                    Bins[axis][b].Init();
+                    Counts[axis][b] = 0;
+                }
+            }
+        }
+
+        void Merge(const BinSet& other)
+        {
+            for (int axis = 0; axis < 3; axis++)
+            {
+                for (int b = 0; b < NUM_SAOH_BINS; b++)
+                {
+                    Bins[axis][b].Extend(other.Bins[axis][b]);
+                    Counts[axis][b] += other.Counts[axis][b];
+                }
+            }
+        }
+
+        LightBounds Bins[3][NUM_SAOH_BINS];
+        uint32_t Counts[3][NUM_SAOH_BINS];
+    };
+
+    // Maps centroid coordinates to bin indices
+    struct BinMapping
+    {
+        ZetaInline int Index(const float3& c, int axis) const
+        {
+            const int idx = (int)(((&c.x)[axis] - Min[axis]) * Scale[axis]);
+            return Math::Min(Math::Max(idx, 0), (int)NUM_SAOH_BINS - 1);
+        }
+
+        float Min[3];
+        float Scale[3];
+    };
+
+    struct Split
+    {
+        int Axis = -1;
+        // Bins [0, Bin) go to the left child
+        int Bin;
+        float Cost = FLT_MAX;
+    };
+
+    struct BuildNode
+    {
+        LightBounds B;
+        // -1 for leaves
+        int Left;
+        int Right;
+        uint32_t Base;
+        uint32_t Count;
+    };
+
+    Builder(Span<RT::EmissiveTriangle> tris, Span<float> triPower, bool parallel)
+        : m_parallel(parallel)
+    {
+        const size_t n = tris.size();
+        m_prims.resize(n);
+        // Every leaf contains at least one triangle
+        m_nodes.resize(2 * n - 1);
+
+        auto init = [this, &tris, &triPower](size_t begin, size_t end)
+            {
+                for (size_t i = begin; i < end; i++)
+                {
+                    Prim& p = m_prims[i];
+                    p.B = TriangleBounds(tris[i], triPower[i]);
+                    p.Centroid = (p.B.BoxMin + p.B.BoxMax) * 0.5f;
+                    p.TriIdx = (uint32_t)i;
+                }
+            };
+
+        if (m_parallel)
+            App::ParallelFor(0, n, PRIMS_PER_JOB, init);
+        else
+            init(0, n);
+    }
+
+    // Splits [base, base + count) into chunks that are processed on the worker threads. fn
+    // is called as fn(chunkIdx, chunkBase, chunkCount). Returns number of chunks.
+    template<typename F>
+    static uint32_t ForEachChunk(uint32_t base, uint32_t count, F&& fn)
+    {
+        const uint32_t numChunks = Math::Min(CeilUnsignedIntDiv(count, BINNING_CHUNK_SIZE),
+            MAX_NUM_BINNING_CHUNKS);
+        const uint32_t chunkSize = CeilUnsignedIntDiv(count, numChunks);
+
+        App::ParallelFor(0, numChunks, 1, [base, count, chunkSize, &fn](size_t b, size_t e)
+            {
+                for (size_t c = b; c < e; c++)
+                {
+                    const uint32_t chunkBase = base + (uint32_t)c * chunkSize;
+                    const uint32_t chunkEnd = Math::Min(chunkBase + chunkSize, base + count);
+
+                    if (chunkEnd > chunkBase)
+                        fn((uint32_t)c, chunkBase, chunkEnd - chunkBase);
+                }
+            });
+
+        return numChunks;
+    }
+
+    void ComputeBounds(uint32_t base, uint32_t count, LightBounds& bounds, CentroidBounds& centroids)
+    {
+        bounds.Init();
+        centroids.Init();
+
+        for (uint32_t i = base; i < base + count; i++)
+        {
+            bounds.Extend(m_prims[i].B);
+            centroids.Min = Min3(centroids.Min, m_prims[i].Centroid);
+            centroids.Max = Max3(centroids.Max, m_prims[i].Centroid);
+        }
+    }
+
+    void ComputeCentroidBounds(uint32_t base, uint32_t count, CentroidBounds& centroids)
+    {
+        auto compute = [this](uint32_t b, uint32_t n, CentroidBounds& c)
+            {
+                c.Init();
+
+                for (uint32_t i = b; i < b + n; i++)
+                {
+                    c.Min = Min3(c.Min, m_prims[i].Centroid);
+                    c.Max = Max3(c.Max, m_prims[i].Centroid);
+                }
+            };
+
+        if (!m_parallel || count < PARALLEL_BINNING_THRESHOLD)
+        {
+            compute(base, count, centroids);
+            return;
+        }
+
+        CentroidBounds chunkBounds[MAX_NUM_BINNING_CHUNKS];
+        const uint32_t numChunks = ForEachChunk(base, count, [&compute, &chunkBounds](uint32_t c, uint32_t b, uint32_t n)
+            {
+                compute(b, n, chunkBounds[c]);
+            });
+
+        centroids.Init();
+
+        for (uint32_t c = 0; c < numChunks; c++)
+            centroids.Extend(chunkBounds[c]);
+    }
+
+    void BinRange(const BinMapping& mapping, uint32_t base, uint32_t count, BinSet& bins)
+    {
+        for (uint32_t i = base; i < base + count; i++)
+        {
+            const Prim& p = m_prims[i];
+
+            for (int axis = 0; axis < 3; axis++)
+            {
+                const int b = mapping.Index(p.Centroid, axis);
+                bins.Bins[axis][b].Extend(p.B);
+                bins.Counts[axis][b]++;
+            }
+        }
+    }
+
+    // Cost of a split is the sum of power times orientation measure times surface area for
+    // both children. Kr penalizes splitting thin boxes along their short axes (Ref. [1]).
+    Split FindBestSplit(const BinSet& bins, const LightBounds& bounds)
+    {
+        Split best;
+        const float3 d = bounds.BoxMax - bounds.BoxMin;
+        const float maxExtent = Max(d.x, Max(d.y, d.z));
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            const LightBounds* axisBins = bins.Bins[axis];
+            const uint32_t* axisCounts = bins.Counts[axis];
+            const float extent = (&d.x)[axis];
+            const float Kr = extent > 0.0f ? maxExtent / extent : 1.0f;
+
+            // Cost and count of everything to the right of each split plane. Plane p
+            // separates bins p - 1 and p.
+            float rightCost[NUM_SAOH_BINS];
+            uint32_t rightCount[NUM_SAOH_BINS];
+            LightBounds acc;
+            acc.Init();
+            uint32_t count = 0;
+
+            for (int p = NUM_SAOH_BINS - 1; p > 0; p--)
+            {
+                acc.Extend(axisBins[p]);
+                count += axisCounts[p];
+                rightCost[p] = count > 0 ? acc.Power * acc.OrientationMeasure() *
+                    SurfaceArea(acc.BoxMin, acc.BoxMax) : 0.0f;
+                rightCount[p] = count;
+            }
+
+            acc.Init();
+            count = 0;
+
+            for (int p = 1; p < NUM_SAOH_BINS; p++)
+            {
+                acc.Extend(axisBins[p - 1]);
+                count += axisCounts[p - 1];
+
+                if (count == 0 || rightCount[p] == 0)
+                    continue;
+
+                const float leftCost = acc.Power * acc.OrientationMeasure() *
+                    SurfaceArea(acc.BoxMin, acc.BoxMax);
+                const float cost = Kr * (leftCost + rightCost[p]);
+
+                if (cost < best.Cost)
+                {
+                    best.Axis = axis;
+                    best.Bin = p;
+                    best.Cost = cost;
+                }
+            }
+        }
+
+        return best;
+    }
+
+    int BuildSubtree(uint32_t base, uint32_t count, const LightBounds& bounds)
+    {
+        const int nodeIdx = m_numNodes.fetch_add(1, std::memory_order_relaxed);
+        Assert(nodeIdx < (int)m_nodes.size(), "Out-of-bound access in node array.");
+
+        BuildNode& node = m_nodes[nodeIdx];
+        node.B = bounds;
+        node.Left = -1;
+        node.Right = -1;
+        node.Base = base;
+        node.Count = count;
+
+        if (count <= MAX_NUM_TRIS_PER_LEAF)
+            return nodeIdx;
+
+        CentroidBounds centroids;
+        ComputeCentroidBounds(base, count, centroids);
+        const float3 centExtents = centroids.Max - centroids.Min;
+
+        uint32_t splitCount;
+        LightBounds leftBounds;
+        LightBounds rightBounds;
+
+        // All centroids are (almost) the same point, split in the middle
+        if (centExtents.x + centExtents.y + centExtents.z <= 2e-5f)
+        {
+            splitCount = count >> 1;
+
+            CentroidBounds unused;
+            ComputeBounds(base, splitCount, leftBounds, unused);
+            ComputeBounds(base + splitCount, count - splitCount, rightBounds, unused);
+        }
+        else
+        {
+            BinMapping mapping;
+
+            for (int axis = 0; axis < 3; axis++)
+            {
+                const float extent = (&centExtents.x)[axis];
+                mapping.Min[axis] = (&centroids.Min.x)[axis];
+                // Degenerate axes map everything to the first bin and are never split
+                mapping.Scale[axis] = extent > 1e-7f ? (NUM_SAOH_BINS * (1.0f - 1e-6f)) / extent : 0.0f;
+            }
+
+            BinSet bins;
+            bins.Init();
+
+            if (m_parallel && count >= PARALLEL_BINNING_THRESHOLD)
+            {
+                SmallVector<BinSet> chunkBins;
+                chunkBins.resize(MAX_NUM_BINNING_CHUNKS);
+
+                const uint32_t numChunks = ForEachChunk(base, count,
+                    [this, &mapping, &chunkBins](uint32_t c, uint32_t b, uint32_t n)
+                    {
+                        chunkBins[c].Init();
+                        BinRange(mapping, b, n, chunkBins[c]);
+                    });
+
+                for (uint32_t c = 0; c < numChunks; c++)
+                    bins.Merge(chunkBins[c]);
+            }
+            else
+                BinRange(mapping, base, count, bins);
+
+            const Split split = FindBestSplit(bins, bounds);
+            Assert(split.Axis != -1, "Centroid bounds aren't degenerate, a valid split must exist.");
+
+            auto it = std::partition(m_prims.begin() + base, m_prims.begin() + base + count,
+                [&mapping, &split](const Prim& p)
+                {
+                    return mapping.Index(p.Centroid, split.Axis) < split.Bin;
+                });
+
+            splitCount = (uint32_t)(it - m_prims.begin() - base);
+
+            // Child bounds are known from the bins, no need to iterate over triangles again
+            leftBounds.Init();
+            rightBounds.Init();
+
+            for (int b = 0; b < split.Bin; b++)
+                leftBounds.Extend(bins.Bins[split.Axis][b]);
+
+            for (int b = split.Bin; b < NUM_SAOH_BINS; b++)
+                rightBounds.Extend(bins.Bins[split.Axis][b]);
+        }
+
+        Assert(splitCount > 0 && splitCount < count, "bug");
+        int children[2];
+
+        if (m_parallel && count >= PARALLEL_BUILD_THRESHOLD)
+        {
+            App::ParallelFor(0, 2, 1, [&](size_t b, size_t e)
+                {
+                    for (size_t c = b; c < e; c++)
+                    {
+                        children[c] = c == 0 ? BuildSubtree(base, splitCount, leftBounds) :
+                            BuildSubtree(base + splitCount, count - splitCount, rightBounds);
+                    }
+                });
+        }
+        else
+        {
+            children[0] = BuildSubtree(base, splitCount, leftBounds);
+            children[1] = BuildSubtree(base + splitCount, count - splitCount, rightBounds);
+        }
+
+        // Node array is never resized during build, so "node" is still valid
+        node.Left = children[0];
+        node.Right = children[1];
+
+        return nodeIdx;
+    }
+
+    int Build()
+    {
+        const uint32_t n = (uint32_t)m_prims.size();
+        LightBounds rootBounds;
+        rootBounds.Init();
+
+        if (m_parallel && n >= PARALLEL_BINNING_THRESHOLD)
+        {
+            LightBounds chunkBounds[MAX_NUM_BINNING_CHUNKS];
+            const uint32_t numChunks = ForEachChunk(0, n, [this, &chunkBounds](uint32_t c, uint32_t b, uint32_t count)
+                {
+                    CentroidBounds unused;
+                    ComputeBounds(b, count, chunkBounds[c], unused);
+                });
+
+            for (uint32_t c = 0; c < numChunks; c++)
+                rootBounds.Extend(chunkBounds[c]);
+        }
+        else
+        {
+            CentroidBounds unused;
+            ComputeBounds(0, n, rootBounds, unused);
+        }
+
+        return BuildSubtree(0, n, rootBounds);
+    }
+
+    int Flatten(LightTree& tree, int buildNodeIdx, int parent)
+    {
+        const BuildNode& buildNode = m_nodes[buildNodeIdx];
+        const int nodeIdx = (int)tree.m_nodes.size();
+        tree.m_nodes.emplace_back();
+
+        LightTree::Node& node = tree.m_nodes[nodeIdx];
+        buildNode.B.ToNode(node);
+        node.Parent = parent;
+        node.Base = 0;
+        node.Count = 0;
+
+        if (buildNode.Left == -1)
+        {
+            node.RightChild = -1;
+            node.Base = buildNode.Base;
+            node.Count = (uint16_t)buildNode.Count;
+
+            for (uint32_t i = buildNode.Base; i < buildNode.Base + buildNode.Count; i++)
+                tree.m_triToLeaf[m_prims[i].TriIdx] = nodeIdx;
+
+            return nodeIdx;
+        }
+
+        // Left child is placed right after its parent
+        Flatten(tree, buildNode.Left, nodeIdx);
+        const int right = Flatten(tree, buildNode.Right, nodeIdx);
+        // Node array might have been reallocated
+        tree.m_nodes[nodeIdx].RightChild = right;
+
+        return nodeIdx;
+    }
+
+    SmallVector<Prim> m_prims;
+    SmallVector<BuildNode> m_nodes;
+    std::atomic_int32_t m_numNodes = 0;
+    const bool m_parallel;
+};
+
+//--------------------------------------------------------------------------------------
+// LightTree
+//--------------------------------------------------------------------------------------
+
+void LightTree::Build(Span<RT::EmissiveTriangle> tris, Span<float> triPower, bool parallel)
+{
+    Assert(tris.size() == triPower.size(), "Every triangle must have a power estimate.");
+    Check(tris.size() < UINT32_MAX, "#Triangles can't exceed UINT32_MAX.");
+
+    m_nodes.clear();
+    m_triIndices.clear();
+    m_leafTriPower.clear();
+    m_triToLeaf.clear();
+    m_dirty.clear();
+    m_toRefit.clear();
+
+    if (tris.empty())
+        return;
+
+    Builder builder(tris, triPower, parallel);
+    const int root = builder.Build();
+    const int numNodes = builder.m_numNodes.load(std::memory_order_relaxed);
+
+    m_nodes.reserve(numNodes);
+    m_triToLeaf.resize(tris.size());
+    builder.Flatten(*this, root, -1);
+    Assert(m_nodes.size() == (size_t)numNodes, "bug");
+
+    m_triIndices.resize(tris.size());
+    m_leafTriPower.resize(tris.size());
+
+    for (size_t i = 0; i < tris.size(); i++)
+    {
+        m_triIndices[i] = builder.m_prims[i].TriIdx;
+        m_leafTriPower[i] = builder.m_prims[i].B.Power;
+    }
+
+    m_dirty.resize(numNodes, 0);
+}
+
+void LightTree::ComputeLeaf(Span<RT::EmissiveTriangle> tris, Node& leaf)
+{
+    LightBounds b;
+    b.Init();
+
+    for (uint32_t i = leaf.Base; i < leaf.Base + leaf.Count; i++)
+        b.Extend(TriangleBounds(tris[m_triIndices[i]], m_leafTriPower[i]));
+
+    b.ToNode(leaf);
+}
+
+void LightTree::Refit(Span<RT::EmissiveTriangle> tris, uint32_t begin, uint32_t end)
+{
+    Assert(IsBuilt(), "Tree hasn't been built yet.");
+    Assert(end <= m_triToLeaf.size() && begin <= end, "Invalid triangle range.");
+
+    m_toRefit.clear();
+
+    // Mark the leaves and their ancestors. Going up the tree stops at the first node that
+    // has already been marked, so shared ancestors are only added once.
+    for (uint32_t t = begin; t < end; t++)
+    {
+        int curr = m_triToLeaf[t];
+
+        while (curr != -1 && !m_dirty[curr])
+        {
+            m_dirty[curr] = 1;
+            m_toRefit.push_back(curr);
+            curr = m_nodes[curr].Parent;
+        }
+    }
+
+    // Children always come after their parent in the node array, so going in decreasing
+    // index order refits every node after its children
+    std::sort(m_toRefit.begin(), m_toRefit.end(), [](int a, int b) { return a > b; });
+
+    for (int nodeIdx : m_toRefit)
+    {
+        Node& node = m_nodes[nodeIdx];
+
+        if (node.IsLeaf())
+            ComputeLeaf(tris, node);
+        else
+        {
+            const Node& left = m_nodes[nodeIdx + 1];
+            const Node& right = m_nodes[node.RightChild];
+
+            LightBounds b;
+            b.BoxMin = Min3(left.BoxMin, right.BoxMin);
+            b.BoxMax = Max3(left.BoxMax, right.BoxMax);
+            b.Power = left.Power + right.Power;
+            b.CosTheta_e = Min(left.CosTheta_e, right.CosTheta_e);
+            b.TwoSided = left.TwoSided || right.TwoSided;
+            ConeUnion(left.Axis, left.CosTheta_o, right.Axis, right.CosTheta_o, b.Axis, b.CosTheta_o);
+            b.ToNode(node);
+        }
+
+        m_dirty[nodeIdx] = 0;
+    }
+}
+
+float LightTree::Importance(const Node& node, const float3& pos, const float3& normal) const
+{
+    if (node.Power == 0.0f)
+        return 0.0f;
+
+    const float3 center = (node.BoxMin + node.BoxMax) * 0.5f;
+    const float3 diag = node.BoxMax - node.BoxMin;
+    const float radius = 0.5f * diag.length();
+    float3 wi = pos - center;
+    const float distSq = wi.dot(wi);
+    wi.normalize();
+
+    // Clamp distance to avoid blowing up for points close to or inside the bounds
+    const float d2 = Max(distSq, radius);
+
+    float cosTheta_w = node.Axis.dot(wi);
+    cosTheta_w = node.TwoSided ? fabsf(cosTheta_w) : cosTheta_w;
+    const float sinTheta_w = SafeSqrt(1.0f - cosTheta_w * cosTheta_w);
+
+    // Angle subtended by the bounding sphere
+    const float cosTheta_b = distSq < radius * radius ? -1.0f : SafeSqrt(1.0f - radius * radius / distSq);
+    const float sinTheta_b = SafeSqrt(1.0f - cosTheta_b * cosTheta_b);
+    const float sinTheta_o = SafeSqrt(1.0f - node.CosTheta_o * node.CosTheta_o);
+
+    // Minimum angle between emission directions and vector towards the shading point
+    const float cosTheta_x = CosSubClamped(sinTheta_w, cosTheta_w, sinTheta_o, node.CosTheta_o);
+    const float sinTheta_x = SinSubClamped(sinTheta_w, cosTheta_w, sinTheta_o, node.CosTheta_o);
+    const float cosTheta_p = CosSubClamped(sinTheta_x, cosTheta_x, sinTheta_b, cosTheta_b);
+
+    if (cosTheta_p <= node.CosTheta_e)
+        return 0.0f;
+
+    float importance = node.Power * cosTheta_p / d2;
+
+    // Bound the cosine factor at the receiver
+    if (normal.dot(normal) > 0.0f)
+    {
+        const float cosTheta_i = fabsf(wi.dot(normal));
+        const float sinTheta_i = SafeSqrt(1.0f - cosTheta_i * cosTheta_i);
+        importance *= CosSubClamped(sinTheta_i, cosTheta_i, sinTheta_b, cosTheta_b);
+    }
+
+    return Max(importance, 0.0f);
+}
+
+LightTree::Sample LightTree::SampleLight(const float3& pos, const float3& normal, float u) const
+{
+    Sample ret;
+
+    if (!IsBuilt())
+        return ret;
+
+    int nodeIdx = 0;
+    float pdf = 1.0f;
+
+    while (!m_nodes[nodeIdx].IsLeaf())
+    {
+        const Node& node = m_nodes[nodeIdx];
+        const float importanceLeft = Importance(m_nodes[nodeIdx + 1], pos, normal);
+        const float importanceRight = Importance(m_nodes[node.RightChild], pos, normal);
+
+        if (importanceLeft + importanceRight == 0.0f)
+            return ret;
+
+        // Pdf() must compute the exact same probabilities
+        const float pLeft = importanceLeft / (importanceLeft + importanceRight);
+
+        if (u < pLeft)
+        {
+            nodeIdx = nodeIdx + 1;
+            pdf *= pLeft;
+            u = Min(u / pLeft, ONE_MINUS_EPSILON);
+        }
+        else
+        {
+            nodeIdx = node.RightChild;
+            pdf *= 1.0f - pLeft;
+            u = Min((u - pLeft) / (1.0f - pLeft), ONE_MINUS_EPSILON);
+        }
+    }
+
+    const Node& leaf = m_nodes[nodeIdx];
+    float leafPower = 0.0f;
+
+    for (uint32_t i = leaf.Base; i < leaf.Base + leaf.Count; i++)
+        leafPower += m_leafTriPower[i];
+
+    if (leafPower == 0.0f)
+        return ret;
+
+    // Choose a triangle proportional to power
+    const float target = u * leafPower;
+    float sum = 0.0f;
+    uint32_t chosen = leaf.Base;
+
+    for (uint32_t i = leaf.Base; i < leaf.Base + leaf.Count; i++)
+    {
+        if (m_leafTriPower[i] == 0.0f)
+            continue;
+
+        chosen = i;
+        sum += m_leafTriPower[i];
+
+        if (target < sum)
+            break;
+    }
+
+    ret.TriIdx = m_triIndices[chosen];
+    ret.Pdf = pdf * m_leafTriPower[chosen] / leafPower;
+
+    return ret;
+}
+
+float LightTree::Pdf(const float3& pos, const float3& normal, uint32_t triIdx) const
+{
+    Assert(triIdx < m_triToLeaf.size(), "Out-of-bound access.");
+    const int leafIdx = m_triToLeaf[triIdx];
+    const Node& leaf = m_nodes[leafIdx];
+    float leafPower = 0.0f;
+    float triPower = 0.0f;
+
+    for (uint32_t i = leaf.Base; i < leaf.Base + leaf.Count; i++)
+    {
+        leafPower += m_leafTriPower[i];
+        triPower = m_triIndices[i] == triIdx ? m_leafTriPower[i] : triPower;
+    }
+
+    if (leafPower == 0.0f)
+        return 0.0f;
+
+    float pdf = triPower / leafPower;
+    int curr = leafIdx;
+
+    while (m_nodes[curr].Parent != -1)
+    {
+        const int parentIdx = m_nodes[curr].Parent;
+        const Node& parent = m_nodes[parentIdx];
+        const float importanceLeft = Importance(m_nodes[parentIdx + 1], pos, normal);
+        const float importanceRight = Importance(m_nodes[parent.RightChild], pos, normal);
+
+        if (importanceLeft + importanceRight == 0.0f)
+            return 0.0f;
+
+        const float pLeft = importanceLeft / (importanceLeft + importanceRight);
+        pdf *= curr == parentIdx + 1 ? pLeft : 1.0f - pLeft;
+        curr = parentIdx;
+    }
+
+    return pdf;
+}
+
+float LightTree::EstimatePower(const RT::EmissiveTriangle& t)
+{
+    RT::EmissiveTriangle tri = t;
+    __m128 v0, v1, v2;
+    tri.LoadVertices(v0, v1, v2);
+
+    const float3 p0 = storeFloat3(v0);
+    const float3 e0 = storeFloat3(v1) - p0;
+    const float3 e1 = storeFloat3(v2) - p0;
+    const float area = 0.5f * e0.cross(e1).length();
+
+    const float3 factor = tri.GetFactor();
+    const float luminance = 0.2126f * factor.x + 0.7152f * factor.y + 0.0722f * factor.z;
+    const float strength = HalfToFloat(tri.GetStrength().x);
+
+    return luminance * strength * area * PI;
+}
@@ -0,0 +1,108 @@
+// References:
+// 1. A. Conty Estevez and C. Kulla, "Importance Sampling of Many Lights with Adaptive Tree Splitting,"
+//    Proceedings of the ACM on Computer Graphics and Interactive Techniques, 2018.
+// 2. M. Pharr, W. Jakob, and G. Humphreys, Physically Based Rendering: From theory to implementation,
+//    4th ed., MIT Press, 2023.
+
+#pragma once
+
+#include "../Utility/SmallVector.h"
+#include "../Utility/Span.h"
+#include "../Math/Vector.h"
+
+namespace ZetaRay::RT
+{
+    struct EmissiveTriangle;
+}
+
+namespace ZetaRay::Scene
+{
+    // Bounding volume hierarchy over emissive triangles, where every node stores total power,
+    // an AABB and a cone bounding the emission directions. Given a shading point, children
+    // are chosen proportional to an importance estimate that accounts for distance and
+    // orientation, which the global alias table can't.
+    class LightTree
+    {
+    public:
+        struct Node
+        {
+            ZetaInline bool IsLeaf() const { return RightChild == -1; }
+
+            Math::float3 BoxMin;
+            float Power;
+            Math::float3 BoxMax;
+            // Emission directions are within angle theta_o of Axis. Every direction is
+            // included when CosTheta_o = -1.
+            float CosTheta_o;
+            Math::float3 Axis;
+            // Spread of emission around each direction in the cone, cos(pi / 2) for triangles
+            float CosTheta_e;
+            // Left child is placed right after its parent. -1 for leaves.
+            int RightChild;
+            // For leaves, range of triangles in TriIndices()
+            uint32_t Base;
+            uint16_t Count;
+            uint16_t TwoSided;
+            int Parent;
+        };
+
+        struct Sample
+        {
+            uint32_t TriIdx = UINT32_MAX;
+            float Pdf = 0.0f;
+        };
+
+        static constexpr uint32_t NUM_SAOH_BINS = 12;
+        static constexpr uint32_t MAX_NUM_TRIS_PER_LEAF = 4;
+
+        LightTree() = default;
+        ~LightTree() = default;
+
+        LightTree(const LightTree&) = delete;
+        LightTree& operator=(const LightTree&) = delete;
+
+        ZetaInline bool IsBuilt() const { return !m_nodes.empty(); }
+        ZetaInline Util::Span<Node> Nodes() const { return m_nodes; }
+        // Triangle indices, ordered such that each leaf's triangles are contiguous
+        ZetaInline Util::Span<uint32_t> TriIndices() const { return m_triIndices; }
+
+        // Builds the tree from scratch using binned surface area orientation heuristic (SAOH).
+        // Triangle power can come from the GPU estimates or EstimatePower(). Large subtrees are
+        // built on the worker threads unless "parallel" is false.
+        void Build(Util::Span<RT::EmissiveTriangle> tris, Util::Span<float> triPower,
+            bool parallel = true);
+        // Recomputes bounds and orientation cones of triangles [begin, end) along with their
+        // ancestors, e.g. after the range passed to EmissiveBuffer::UpdateTriPositions() has
+        // moved. Topology and power are unchanged. Cost is linear in the number of changed
+        // triangles times tree depth.
+        void Refit(Util::Span<RT::EmissiveTriangle> tris, uint32_t begin, uint32_t end);
+
+        // Reference sampler -- traverses the tree from the root, choosing either child
+        // proportional to its importance for point "pos" with normal "normal" (zero normal
+        // ignores orientation of the receiver). Within a leaf, triangles are chosen proportional
+        // to their power. Returns a sample with zero pdf when nothing can contribute.
+        Sample SampleLight(const Math::float3& pos, const Math::float3& normal, float u) const;
+        // Probability of SampleLight() returning the given triangle
+        float Pdf(const Math::float3& pos, const Math::float3& normal, uint32_t triIdx) const;
+
+        // Textureless power estimate -- luminance of emissive factor times strength times area
+        static float EstimatePower(const RT::EmissiveTriangle& tri);
+
+    private:
+        struct Builder;
+
+        float Importance(const Node& node, const Math::float3& pos, const Math::float3& normal) const;
+        void ComputeLeaf(Util::Span<RT::EmissiveTriangle> tris, Node& leaf);
+
+        Util::SmallVector<Node> m_nodes;
+        // Reordered triangle indices and their power
+        Util::SmallVector<uint32_t> m_triIndices;
+        Util::SmallVector<float> m_leafTriPower;
+        // Maps triangle index to the leaf that contains it
+        Util::SmallVector<int> m_triToLeaf;
+        // Used during refit to visit every node once. Node list is kept around to avoid
+        // reallocating it every frame.
+        Util::SmallVector<uint8_t> m_dirty;
+        Util::SmallVector<int> m_toRefit;
+    };
+}
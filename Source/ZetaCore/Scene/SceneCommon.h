@@ -1,6 +1,7 @@
 #pragma once
 
 #include <App/ZetaRay.h>
+#include "../Utility/SlotMap.h"
 
 namespace ZetaRay::Scene
 {
@@ -8,4 +9,12 @@ namespace ZetaRay::Scene
     static constexpr uint64_t INVALID_MESH = UINT64_MAX;
     static constexpr uint32_t DEFAULT_MATERIAL_ID = 0;
     static constexpr uint32_t DEFAULT_SCENE_ID = 0;
+
+    // Handles are what the renderer uses to refer to scene objects every frame -- they index
+    // directly into the underlying arrays. IDs (see SceneCore.h) are stable across runs and 
+    // are what's exposed to tooling and the GUI. They're mapped to handles once, rather than
+    // probing a hash table on every access.
+    using InstanceHandle = Util::SlotHandle;
+    using MeshHandle = Util::SlotHandle;
+    using MaterialHandle = Util::SlotHandle;
 }
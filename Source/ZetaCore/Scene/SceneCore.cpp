@@ -34,6 +34,183 @@ namespace
         v.z += v.x * v.y;
         return v;
     }
+
+    // Elements of a 4x3 affine transformation, each broadcast to all lanes
+    struct EmissiveTransformSoA
+    {
+        explicit EmissiveTransformSoA(const float4x3& M)
+        {
+            for (int r = 0; r < 4; r++)
+            {
+                vM[r][0] = _mm256_set1_ps(M.m[r].x);
+                vM[r][1] = _mm256_set1_ps(M.m[r].y);
+                vM[r][2] = _mm256_set1_ps(M.m[r].z);
+            }
+        }
+
+        __m256 vM[4][3];
+    };
+
+    // Decodes the initial positions of up to 8 triangles, applies world transformation and 
+    // stores the encoded results. Triangles are transposed so that each lane processes one
+    // triangle. Mirrors the steps in EmissiveTriangle::DecodeVertices(), mul() and 
+    // EmissiveTriangle::StoreVertices() in the same order, so that results match.
+    void TransformEmissives8(const EmissiveTransformSoA& W, const EmissiveBuffer::Triangle* initTris,
+        RT::EmissiveTriangle* tris, uint32_t num, uint32_t instanceID)
+    {
+        constexpr int N = 8;
+        Assert(num > 0 && num <= N, "Invalid number of triangles.");
+
+        alignas(32) float vtx0[3][N];
+        // V0V1.x, V0V1.y, V0V2.x, V0V2.y
+        alignas(32) int32_t edges[4][N];
+        alignas(16) uint16_t lengths[2][N];
+
+        for (uint32_t i = 0; i < N; i++)
+        {
+            // Pad the last batch by repeating the last triangle
+            const EmissiveBuffer::Triangle& t = initTris[Min(i, num - 1)];
+
+            vtx0[0][i] = t.Vtx0.x;
+            vtx0[1][i] = t.Vtx0.y;
+            vtx0[2][i] = t.Vtx0.z;
+            edges[0][i] = t.V0V1.x;
+            edges[1][i] = t.V0V1.y;
+            edges[2][i] = t.V0V2.x;
+            edges[3][i] = t.V0V2.y;
+            lengths[0][i] = t.EdgeLengths.x;
+            lengths[1][i] = t.EdgeLengths.y;
+        }
+
+        // Decode UNORM-16 and map [0, 1] -> [-1, 1]
+        const __m256 vMax = _mm256_set1_ps((1 << 16) - 1);
+        const __m256 vTwo = _mm256_set1_ps(2.0f);
+        const __m256 vMinusOne = _mm256_set1_ps(-1.0f);
+        __m256 vE[4];
+
+        for (int c = 0; c < 4; c++)
+        {
+            vE[c] = _mm256_cvtepi32_ps(_mm256_load_si256(reinterpret_cast<__m256i*>(edges[c])));
+            vE[c] = _mm256_fmadd_ps(_mm256_div_ps(vE[c], vMax), vTwo, vMinusOne);
+        }
+
+        const __m256 vLength0 = _mm256_cvtph_ps(_mm_load_si128(reinterpret_cast<__m128i*>(lengths[0])));
+        const __m256 vLength1 = _mm256_cvtph_ps(_mm_load_si128(reinterpret_cast<__m128i*>(lengths[1])));
+
+        // vV[vertex][component]
+        __m256 vV[3][3];
+        __m256 vDir[3];
+
+        for (int c = 0; c < 3; c++)
+            vV[0][c] = _mm256_load_ps(vtx0[c]);
+
+        decode_octahedral(vE[0], vE[1], vDir[0], vDir[1], vDir[2]);
+
+        for (int c = 0; c < 3; c++)
+            vV[1][c] = _mm256_fmadd_ps(vDir[c], vLength0, vV[0][c]);
+
+        decode_octahedral(vE[2], vE[3], vDir[0], vDir[1], vDir[2]);
+
+        for (int c = 0; c < 3; c++)
+            vV[2][c] = _mm256_fmadd_ps(vDir[c], vLength1, vV[0][c]);
+
+        // Transform to world space -- v * M with v.w = 1
+        __m256 vVW[3][3];
+
+        for (int v = 0; v < 3; v++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                __m256 vRes = _mm256_mul_ps(vV[v][0], W.vM[0][c]);
+                vRes = _mm256_fmadd_ps(vV[v][1], W.vM[1][c], vRes);
+                vRes = _mm256_fmadd_ps(vV[v][2], W.vM[2][c], vRes);
+                vVW[v][c] = _mm256_add_ps(vRes, W.vM[3][c]);
+            }
+        }
+
+        alignas(32) float vtxW[3][3][N];
+
+        for (int v = 0; v < 3; v++)
+        {
+            for (int c = 0; c < 3; c++)
+                _mm256_store_ps(vtxW[v][c], vVW[v][c]);
+        }
+
+#if ENCODE_EMISSIVE_POS == 1
+        // Encode normalized edges and their lengths
+        const __m256 vHalf = _mm256_set1_ps(0.5f);
+        const __m256i vMask = _mm256_set1_epi32(0xffff);
+
+        for (int e = 0; e < 2; e++)
+        {
+            __m256 vEdge[3];
+
+            for (int c = 0; c < 3; c++)
+                vEdge[c] = _mm256_sub_ps(vVW[e + 1][c], vVW[0][c]);
+
+            // Same order of summation as StoreVertices()
+            const __m256 vLength = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(
+                _mm256_mul_ps(vEdge[0], vEdge[0]), _mm256_mul_ps(vEdge[1], vEdge[1])),
+                _mm256_mul_ps(vEdge[2], vEdge[2])));
+
+            for (int c = 0; c < 3; c++)
+                vEdge[c] = _mm256_div_ps(vEdge[c], vLength);
+
+            __m256 vU;
+            __m256 vV;
+            encode_octahedral(vEdge[0], vEdge[1], vEdge[2], vU, vV);
+
+            vU = _mm256_mul_ps(_mm256_fmadd_ps(vU, vHalf, vHalf), vMax);
+            vV = _mm256_mul_ps(_mm256_fmadd_ps(vV, vHalf, vHalf), vMax);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(edges[2 * e]), 
+                _mm256_and_si256(_mm256_cvtps_epi32(vU), vMask));
+            _mm256_store_si256(reinterpret_cast<__m256i*>(edges[2 * e + 1]),
+                _mm256_and_si256(_mm256_cvtps_epi32(vV), vMask));
+            _mm_store_si128(reinterpret_cast<__m128i*>(lengths[e]), _mm256_cvtps_ph(vLength, 0));
+        }
+#endif
+
+        for (uint32_t i = 0; i < num; i++)
+        {
+            RT::EmissiveTriangle& tri = tris[i];
+            tri.Vtx0 = float3(vtxW[0][0][i], vtxW[0][1][i], vtxW[0][2][i]);
+
+#if ENCODE_EMISSIVE_POS == 1
+            tri.V0V1.x = (uint16_t)edges[0][i];
+            tri.V0V1.y = (uint16_t)edges[1][i];
+            tri.V0V2.x = (uint16_t)edges[2][i];
+            tri.V0V2.y = (uint16_t)edges[3][i];
+            tri.EdgeLengths.x = lengths[0][i];
+            tri.EdgeLengths.y = lengths[1][i];
+#else
+            tri.Vtx1 = float3(vtxW[1][0][i], vtxW[1][1][i], vtxW[1][2][i]);
+            tri.Vtx2 = float3(vtxW[2][0][i], vtxW[2][1][i], vtxW[2][2][i]);
+#endif
+
+            // Dynamic instances have geometry index = 0
+            tri.ID = Pcg3d(uint3(0, instanceID, initTris[i].PrimIdx)).x;
+        }
+    }
+
+    // Whether going from M0 to M1 changes the scale, and therefore areas of the transformed 
+    // triangles. Small relative differences (e.g. round-off from animated rotations) are 
+    // ignored.
+    bool IsScaled(const float4x3& M0, const float4x3& M1)
+    {
+        constexpr float REL_TOLERANCE = 1e-4f;
+
+        float4a s0;
+        float4a t0;
+        decomposeSRT(load4x3(M0), s0, t0);
+
+        float4a s1;
+        float4a t1;
+        decomposeSRT(load4x3(M1), s1, t1);
+
+        return fabsf(s1.x - s0.x) > REL_TOLERANCE * s0.x ||
+            fabsf(s1.y - s0.y) > REL_TOLERANCE * s0.y ||
+            fabsf(s1.z - s0.z) > REL_TOLERANCE * s0.z;
+    }
 }
 
 //--------------------------------------------------------------------------------------
@@ -64,11 +241,15 @@ void SceneCore::Init(Renderer::Interface& rendererInterface)
     m_sceneGraph.resize(2);
 
     m_sceneGraph[0].m_toWorlds.resize(1);
+    m_sceneGraph[0].m_prevToWorlds.resize(1);
     m_sceneGraph[0].m_subtreeRanges.resize(1);
     m_sceneGraph[0].m_subtreeRanges[0] = Range(0, 0);
+    m_sceneGraph[0].m_parents.resize(1);
+    m_sceneGraph[0].m_parents[0] = 0;
 
     v_float4x4 I = identity();
     m_sceneGraph[0].m_toWorlds[0] = float4x3(store(I));
+    m_sceneGraph[0].m_prevToWorlds[0] = m_sceneGraph[0].m_toWorlds[0];
 
     m_baseColorDescTable.Init(XXH3_64bits(GlobalResource::BASE_COLOR_DESCRIPTOR_TABLE,
         strlen(GlobalResource::BASE_COLOR_DESCRIPTOR_TABLE)));
@@ -104,32 +285,40 @@ void SceneCore::Update(double dt, TaskSet& sceneTS, TaskSet& sceneRendererTS)
     if (m_isPaused)
         return;
 
+    if (m_staleHandles.load(std::memory_order_relaxed))
+        ResolveHandles();
+
     auto updateWorldTransforms = sceneTS.EmplaceTask("Scene::UpdateWorldTransform", [this]()
         {
             if (m_rebuildBVHFlag)
                 InitWorldTransformations();
 
-            if (m_animate)
-            {
-                SmallVector<AnimationUpdate, App::FrameAllocator> animUpdates;
-                UpdateAnimations((float)App::GetTimer().GetTotalTime(), animUpdates);
-                UpdateLocalTransforms(animUpdates);
-            }
+            SmallVector<TreePos, App::FrameAllocator> animated;
+
+            if (m_animate && !m_animations.Empty())
+                UpdateAnimations((float)App::GetTimer().GetTotalTime(), animated);
 
-            if (!m_instanceUpdates.empty())
+            if (!m_instanceUpdates.empty() || !animated.empty())
             {
                 SmallVector<BVH::BVHUpdateInput, App::FrameAllocator> toUpdateInstances;
-                UpdateWorldTransformations(toUpdateInstances);
+                UpdateWorldTransformations(animated, toUpdateInstances);
             }
 
             m_rebuildBVHFlag = false;
         });
 
     const uint32_t numInstances = m_emissives.NumInstances();
-    m_staleEmissiveMats = m_emissives.HasStaleMaterials() || !m_emissives.Initialized();
+    m_staleEmissiveMats = m_emissives.HasStalePower() || !m_emissives.Initialized();
+    m_staleEmissiveTriBaseOffset = m_emissives.Initialized() ? m_emissives.StalePowerBaseOffset() : 0;
+    m_numStaleEmissiveTris = m_emissives.Initialized() ? m_emissives.NumStalePowerTriangles() : 
+        m_emissives.NumTriangles();
+    // Ranges added from now on (e.g. by UpdateEmissivePositions() below) are picked up 
+    // next frame
+    m_emissives.ClearStalePower();
     // Size of m_instanceUpdates may change after async. task above runs, but since it never
     // goes from > 0 to 0, it doesn't matter
-    m_staleEmissivePositions = m_staleEmissivePositions || !m_emissives.Initialized();
+    m_staleEmissivePositions = m_staleEmissivePositions || !m_emissives.Initialized() ||
+        (m_animate && m_hasEmissiveAnimations);
 
     if (!m_emissives.Initialized() && numInstances)
     {
@@ -174,76 +363,67 @@ void SceneCore::Update(double dt, TaskSet& sceneTS, TaskSet& sceneRendererTS)
         // Full rebuild of emissive buffer for first time
         if (!m_emissives.Initialized())
         {
-            constexpr size_t MAX_NUM_EMISSIVE_WORKERS = 5;
-            constexpr size_t MIN_EMISSIVE_INSTANCES_PER_WORKER = 35;
-            size_t threadOffsets[MAX_NUM_EMISSIVE_WORKERS];
-            size_t threadSizes[MAX_NUM_EMISSIVE_WORKERS];
-
-            const size_t numEmissiveWorkers = SubdivideRangeWithMin(numInstances,
-                MAX_NUM_EMISSIVE_WORKERS,
-                threadOffsets,
-                threadSizes,
-                MIN_EMISSIVE_INSTANCES_PER_WORKER);
-
-            for (size_t i = 0; i < numEmissiveWorkers; i++)
-            {
-                StackStr(tname, n, "Scene::Emissive_%d", i);
-
-                auto h = sceneTS.EmplaceTask(tname, [this, offset = threadOffsets[i], size = threadSizes[i]]()
-                    {
-                        auto emissvies = m_emissives.Instances();
-                        auto tris = m_emissives.Triagnles();
-                        auto triInitialPos = m_emissives.InitialTriPositions();
-                        v_float4x4 I = identity();
+            constexpr size_t EMISSIVE_INSTANCES_PER_JOB = 32;
 
-                        // For every emissive instance, apply world transformation to all of its triangles
-                        for (size_t instance = offset; instance < offset + size; instance++)
+            auto h = sceneTS.EmplaceTask("Scene::InitEmissives", [this, numInstances]()
+                {
+                    App::ParallelFor(0, numInstances, EMISSIVE_INSTANCES_PER_JOB, 
+                        [this](size_t begin, size_t end)
                         {
-                            const auto& e = emissvies[instance];
-                            const v_float4x4 vW = load4x3(GetToWorld(e.InstanceID));
-                            const bool skipTransform = equal(vW, I);
-
-                            const auto rtASInfo = GetInstanceRtASInfo(e.InstanceID);
+                            auto emissvies = m_emissives.Instances();
+                            auto tris = m_emissives.Triagnles();
+                            auto triInitialPos = m_emissives.InitialTriPositions();
+                            v_float4x4 I = identity();
 
-                            for (size_t t = e.BaseTriOffset; t < e.BaseTriOffset + e.NumTriangles; t++)
+                            // For every emissive instance, apply world transformation to all of its triangles
+                            for (size_t instance = begin; instance < end; instance++)
                             {
-                                if (!skipTransform)
-                                {
-                                    __m128 vV0;
-                                    __m128 vV1;
-                                    __m128 vV2;
-                                    tris[t].LoadVertices(vV0, vV1, vV2);
-
-                                    triInitialPos[t].Vtx0 = tris[t].Vtx0;
-                                    triInitialPos[t].V0V1 = tris[t].V0V1;
-                                    triInitialPos[t].V0V2 = tris[t].V0V2;
-                                    triInitialPos[t].EdgeLengths = tris[t].EdgeLengths;
-                                    triInitialPos[t].PrimIdx = tris[t].ID;
-
-                                    vV0 = mul(vW, vV0);
-                                    vV1 = mul(vW, vV1);
-                                    vV2 = mul(vW, vV2);
-                                    tris[t].StoreVertices(vV0, vV1, vV2);
-                                }
+                                const auto& e = emissvies[instance];
+                                const InstanceHandle h = GetInstanceHandle(e.InstanceID);
+                                const v_float4x4 vW = load4x3(GetToWorld(h));
+                                const bool skipTransform = equal(vW, I);
 
-                                const uint32_t hash = Pcg3d(uint3(rtASInfo.GeometryIndex, 
-                                    rtASInfo.InstanceID,
-                                    tris[t].ID)).x;
+                                const auto rtASInfo = GetInstanceRtASInfo(h);
 
-                                Assert(!tris[t].IsIDPatched(), 
-                                    "Rewriting emissive triangle ID after the first assignment is invalid.");
-                                tris[t].ResetID(hash);
+                                for (size_t t = e.BaseTriOffset; t < e.BaseTriOffset + e.NumTriangles; t++)
+                                {
+                                    if (!skipTransform)
+                                    {
+                                        __m128 vV0;
+                                        __m128 vV1;
+                                        __m128 vV2;
+                                        tris[t].LoadVertices(vV0, vV1, vV2);
+
+                                        triInitialPos[t].Vtx0 = tris[t].Vtx0;
+                                        triInitialPos[t].V0V1 = tris[t].V0V1;
+                                        triInitialPos[t].V0V2 = tris[t].V0V2;
+                                        triInitialPos[t].EdgeLengths = tris[t].EdgeLengths;
+                                        triInitialPos[t].PrimIdx = tris[t].ID;
+
+                                        vV0 = mul(vW, vV0);
+                                        vV1 = mul(vW, vV1);
+                                        vV2 = mul(vW, vV2);
+                                        tris[t].StoreVertices(vV0, vV1, vV2);
+                                    }
+
+                                    const uint32_t hash = Pcg3d(uint3(rtASInfo.GeometryIndex, 
+                                        rtASInfo.InstanceID,
+                                        tris[t].ID)).x;
+
+                                    Assert(!tris[t].IsIDPatched(), 
+                                        "Rewriting emissive triangle ID after the first assignment is invalid.");
+                                    tris[t].ResetID(hash);
+                                }
                             }
-                        }
-                    });
+                        });
+                });
 
-                sceneTS.AddOutgoingEdge(updateWorldTransforms, h);
+            sceneTS.AddOutgoingEdge(updateWorldTransforms, h);
 
-                Assert(resetRtAsInfo != TaskSet::INVALID_TASK_HANDLE, "Invalid task handle.");
-                sceneTS.AddOutgoingEdge(resetRtAsInfo, h);
+            Assert(resetRtAsInfo != TaskSet::INVALID_TASK_HANDLE, "Invalid task handle.");
+            sceneTS.AddOutgoingEdge(resetRtAsInfo, h);
 
-                sceneTS.AddOutgoingEdge(h, upload);
-            }
+            sceneTS.AddOutgoingEdge(h, upload);
         }
         else if (m_staleEmissivePositions)
         {
@@ -252,6 +432,7 @@ void SceneCore::Update(double dt, TaskSet& sceneTS, TaskSet& sceneRendererTS)
                     UpdateEmissivePositions();
                 });
 
+            sceneTS.AddOutgoingEdge(updateWorldTransforms, h);
             //sceneTS.AddOutgoingEdge(resetRtAsInfo, h);
             sceneTS.AddOutgoingEdge(h, upload);
         }
@@ -300,6 +481,7 @@ uint32_t SceneCore::AddMesh(SmallVector<Vertex>&& vertices, SmallVector<uint32_t
 
     m_numTriangles += (uint32_t)indices.size();
     uint32_t idx = m_meshes.Add(ZetaMove(vertices), ZetaMove(indices), matIdx);
+    m_staleHandles.store(true, std::memory_order_relaxed);
 
     if (lock)
         ReleaseSRWLockExclusive(&m_meshLock);
@@ -308,18 +490,80 @@ uint32_t SceneCore::AddMesh(SmallVector<Vertex>&& vertices, SmallVector<uint32_t
 }
 
 void SceneCore::AddMeshes(SmallVector<Asset::Mesh>&& meshes, SmallVector<Vertex>&& vertices,
-    SmallVector<uint32_t>&& indices, bool lock)
+    SmallVector<uint32_t>&& indices, Span<MeshCluster> clusters, bool lock)
+{
+    if (lock)
+        AcquireSRWLockExclusive(&m_meshLock);
+
+    m_numTriangles += (uint32_t)indices.size();
+    m_meshes.AddBatch(ZetaMove(meshes), ZetaMove(vertices), ZetaMove(indices), clusters);
+    m_staleHandles.store(true, std::memory_order_relaxed);
+
+    if (lock)
+        ReleaseSRWLockExclusive(&m_meshLock);
+}
+
+void SceneCore::AddMeshes(Span<Asset::Mesh> meshes, Span<Vertex> vertices, Span<uint32_t> indices, 
+    Span<MeshCluster> clusters, bool lock)
+{
+    if (lock)
+        AcquireSRWLockExclusive(&m_meshLock);
+
+    m_numTriangles += (uint32_t)indices.size();
+    m_meshes.AddBatch(meshes, vertices, indices, clusters);
+    m_staleHandles.store(true, std::memory_order_relaxed);
+
+    if (lock)
+        ReleaseSRWLockExclusive(&m_meshLock);
+}
+
+void SceneCore::AddMeshes(SmallVector<Asset::Mesh>&& meshes, SmallVector<CompactVertex>&& vertices,
+    Span<AABB> bounds, SmallVector<uint32_t>&& indices, Span<MeshCluster> clusters, bool lock)
 {
     if (lock)
         AcquireSRWLockExclusive(&m_meshLock);
 
     m_numTriangles += (uint32_t)indices.size();
-    m_meshes.AddBatch(ZetaMove(meshes), ZetaMove(vertices), ZetaMove(indices));
+    m_meshes.AddBatch(ZetaMove(meshes), ZetaMove(vertices), bounds, ZetaMove(indices), clusters);
+    m_staleHandles.store(true, std::memory_order_relaxed);
 
     if (lock)
         ReleaseSRWLockExclusive(&m_meshLock);
 }
 
+void SceneCore::AddMeshes(Span<Asset::Mesh> meshes, Span<CompactVertex> vertices, Span<AABB> bounds, 
+    Span<uint32_t> indices, Span<MeshCluster> clusters, bool lock)
+{
+    if (lock)
+        AcquireSRWLockExclusive(&m_meshLock);
+
+    m_numTriangles += (uint32_t)indices.size();
+    m_meshes.AddBatch(meshes, vertices, bounds, indices, clusters);
+    m_staleHandles.store(true, std::memory_order_relaxed);
+
+    if (lock)
+        ReleaseSRWLockExclusive(&m_meshLock);
+}
+
+void SceneCore::CullClusters(uint64_t instanceID, const ViewFrustum& viewFrustum, const float4x4a& viewToWorld,
+    Vector<uint32_t, App::FrameAllocator>& visibleClusters) const
+{
+    const uint64_t meshID = GetInstanceMeshID(instanceID);
+    if (meshID == INVALID_MESH)
+        return;
+
+    auto mesh = m_meshes.GetMesh(meshID);
+    Assert(mesh, "Mesh with ID %llu was not found.", meshID);
+
+    const Span<MeshCluster> clusters = m_meshes.GetClusters(*mesh.value());
+    const size_t base = visibleClusters.size();
+    visibleClusters.resize(base + clusters.size());
+
+    const uint32_t numVisible = ClusterBuilder::Cull(clusters, viewFrustum, viewToWorld, 
+        GetToWorld(instanceID), MutableSpan<uint32_t>(visibleClusters.data() + base, clusters.size()));
+    visibleClusters.resize(base + numVisible);
+}
+
 void SceneCore::AddMaterial(const Asset::MaterialDesc& matDesc, bool lock)
 {
     Material mat;
@@ -344,6 +588,7 @@ void SceneCore::AddMaterial(const Asset::MaterialDesc& matDesc, bool lock)
         AcquireSRWLockExclusive(&m_matLock);
 
     m_matBuffer.Add(matDesc.ID, mat);
+    m_staleHandles.store(true, std::memory_order_relaxed);
 
     if (lock)
         ReleaseSRWLockExclusive(&m_matLock);
@@ -428,6 +673,7 @@ void SceneCore::AddMaterial(const Asset::MaterialDesc& matDesc, MutableSpan<Text
     // Add this material to GPU material buffer. Contained texture indices offset into 
     // descriptor tables above.
     m_matBuffer.Add(matDesc.ID, mat);
+    m_staleHandles.store(true, std::memory_order_relaxed);
 
     if (lock)
         ReleaseSRWLockExclusive(&m_matLock);
@@ -478,32 +724,353 @@ void SceneCore::AddInstance(Asset::InstanceDesc& instance, bool lock)
         parentIdx = p.Offset;
     }
 
-    const uint32_t insertIdx = InsertAtLevel(instance.ID, treeLevel, parentIdx, instance.LocalTransform, meshID,
-        instance.RtMeshMode, instance.RtInstanceMask, instance.IsOpaque);
+    Assert(!m_IDtoHandle.find(instance.ID), "instance with id %llu already exists.", instance.ID);
+    const InstanceHandle h = m_instances.insert(TreePos{ .Level = treeLevel, .Offset = 0 });
+    m_IDtoHandle.insert_or_assign(instance.ID, h);
+
+    const uint32_t insertIdx = InsertAtLevel(instance.ID, h, treeLevel, parentIdx, instance.LocalTransform, 
+        meshID, instance.RtMeshMode, instance.RtInstanceMask, instance.IsOpaque);
+    m_instances[h].Offset = insertIdx;
+
+    // Adjust tree positions of shifted instances
+    const auto& handles = m_sceneGraph[treeLevel].m_handles;
+
+    for (size_t i = insertIdx + 1; i < handles.size(); i++)
+        m_instances[handles[i]].Offset++;
+
+    m_rebuildBVHFlag = true;
+    m_staleHandles.store(true, std::memory_order_relaxed);
+
+    if (lock)
+        ReleaseSRWLockExclusive(&m_instanceLock);
+}
+
+void SceneCore::AddInstances(Span<Asset::InstanceDesc> instances, bool lock)
+{
+    if (instances.empty())
+        return;
+
+    constexpr size_t INSTANCES_PER_JOB = 512;
+    constexpr size_t PARENTS_PER_JOB = 256;
+    const uint32_t numInstances = (uint32_t)instances.size();
+
+    // Compute mesh IDs up front in parallel
+    SmallVector<uint64_t> meshIDs;
+    meshIDs.resize(numInstances);
+
+    App::ParallelFor(0, numInstances, INSTANCES_PER_JOB, [&instances, &meshIDs](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; i++)
+            {
+                const Asset::InstanceDesc& desc = instances[i];
+                meshIDs[i] = desc.MeshIdx == -1 ? INVALID_MESH :
+                    MeshID(desc.SceneID, desc.MeshIdx, desc.MeshPrimIdx);
+            }
+        });
+
+    if (lock)
+        AcquireSRWLockExclusive(&m_instanceLock);
+
+    struct NewInstance
+    {
+        uint32_t Level;
+        // Index of parent in instances when NewParent is true, otherwise its offset in the 
+        // parent level before insertion. Replaced by parent's final offset once known.
+        uint32_t Parent;
+        // Rank among the new children of the same parent, then final offset in its level
+        uint32_t Offset;
+        bool NewParent;
+        InstanceHandle Handle;
+    };
+
+    SmallVector<NewInstance> newInstances;
+    newInstances.resize(numInstances);
+    m_instances.reserve(m_instances.size() + numInstances);
+    uint32_t maxLevel = 1;
+
+    // In depth-first order, parent of every instance is either the root, an existing instance,
+    // or one of the instances on the path from the previous instance to the root. The latter
+    // is tracked with a stack rather than hash table lookups. For other orders, parents that
+    // were added earlier in the batch but are no longer on the stack are found through a 
+    // batch-local ID -> index table, which is only filled in once it's first needed.
+    {
+        SmallVector<uint32_t> ancestors;
+        FlatHashTable<uint32_t> batchIndices;
+        uint32_t numIndexed = 0;
+
+        for (uint32_t i = 0; i < numInstances; i++)
+        {
+            const Asset::InstanceDesc& desc = instances[i];
+            Assert(!m_IDtoHandle.find(desc.ID), "instance with id %llu already exists.", desc.ID);
+
+            while (!ancestors.empty() && instances[ancestors.back()].ID != desc.ParentID)
+                ancestors.pop_back();
+
+            NewInstance& inst = newInstances[i];
+
+            if (!ancestors.empty())
+            {
+                const uint32_t p = ancestors.back();
+                inst = NewInstance{ .Level = newInstances[p].Level + 1, .Parent = p, .NewParent = true };
+            }
+            else if (desc.ParentID == ROOT_ID)
+                inst = NewInstance{ .Level = 1, .Parent = 0, .NewParent = false };
+            else
+            {
+                if (numIndexed < i)
+                {
+                    batchIndices.resize(numInstances, true);
+
+                    for (; numIndexed < i; numIndexed++)
+                        batchIndices.insert_or_assign(instances[numIndexed].ID, numIndexed);
+                }
+
+                if (auto batchIdx = batchIndices.find(desc.ParentID); batchIdx)
+                {
+                    const uint32_t p = *batchIdx.value();
+                    inst = NewInstance{ .Level = newInstances[p].Level + 1, .Parent = p, .NewParent = true };
+
+                    // Restart the stack from this parent, so that its (depth-first) descendants
+                    // that follow don't need a lookup
+                    ancestors.push_back(p);
+                }
+                else
+                {
+                    auto treePos = FindTreePosFromID(desc.ParentID);
+                    Assert(treePos, "Parent %llu of instance %llu is neither in the scene nor earlier in the batch.",
+                        desc.ParentID, desc.ID);
+
+                    const TreePos p = treePos.value();
+                    inst = NewInstance{ .Level = p.Level + 1, .Parent = p.Offset, .NewParent = false };
+                }
+            }
+
+            // Tree position is set once the instance's level has been rebuilt
+            inst.Handle = m_instances.insert(TreePos{ .Level = inst.Level, .Offset = 0 });
+            ancestors.push_back(i);
+            maxLevel = Max(maxLevel, inst.Level);
+
+            if (meshIDs[i] != INVALID_MESH)
+            {
+                m_meshBufferStale = true;
+
+                if (desc.RtMeshMode == RT_MESH_MODE::STATIC)
+                {
+                    m_numStaticInstances++;
+                    m_numOpaqueInstances += desc.IsOpaque;
+                    m_numNonOpaqueInstances += !desc.IsOpaque;
+                }
+                else
+                    m_numDynamicInstances++;
+            }
+        }
+    }
+
+    if (m_sceneGraph.size() <= maxLevel)
+        m_sceneGraph.resize(maxLevel + 1);
+
+    const uint32_t numLevels = (uint32_t)m_sceneGraph.size();
+
+    // New instances grouped by level, in depth-first order within each level
+    SmallVector<uint32_t> levelOffsets;
+    levelOffsets.resize(numLevels + 1, 0);
+
+    for (auto& inst : newInstances)
+        levelOffsets[inst.Level + 1]++;
+
+    for (uint32_t level = 0; level < numLevels; level++)
+        levelOffsets[level + 1] += levelOffsets[level];
+
+    SmallVector<uint32_t> byLevel;
+    byLevel.resize(numInstances);
+
+    {
+        SmallVector<uint32_t> cursor;
+        cursor.append_range(levelOffsets.begin(), levelOffsets.end() - 1, true);
+
+        for (uint32_t i = 0; i < numInstances; i++)
+            byLevel[cursor[newInstances[i].Level]++] = i;
+    }
+
+    // Every level that has new instances, or whose parent level changed, is rebuilt. Children 
+    // of each parent are contiguous and in the same order as parents. Existing children come 
+    // first, followed by the new ones in depth-first order, which matches inserting them one by
+    // one. Remap maps existing instances of the previous level to their new offsets (empty 
+    // when that level wasn't rebuilt).
+    SmallVector<uint32_t> prevRemap;
+    SmallVector<uint32_t> currRemap;
+    SmallVector<Range> newRanges;
+    SmallVector<uint8_t> rebuilt;
+    rebuilt.resize(numLevels, 0);
+    const float4x3 I = float4x3(store(identity()));
 
-    // Update instance "dictionary"
+    for (uint32_t level = 1; level < numLevels; level++)
     {
-        Assert(!m_IDtoTreePos.find(instance.ID), "instance with id %llu already exists.", instance.ID);
-        m_IDtoTreePos.insert_or_assign(instance.ID, TreePos{ .Level = treeLevel, .Offset = insertIdx });
+        const Span<uint32_t> newAtLevel(byLevel.data() + levelOffsets[level],
+            levelOffsets[level + 1] - levelOffsets[level]);
 
-        // Adjust tree positions of shifted instances
-        for (size_t i = insertIdx + 1; i < m_sceneGraph[treeLevel].m_IDs.size(); i++)
+        if (newAtLevel.empty() && !rebuilt[level - 1])
         {
-            uint64_t insID = m_sceneGraph[treeLevel].m_IDs[i];
-            auto pos = m_IDtoTreePos.find(insID);
+            prevRemap.clear();
+            continue;
+        }
+
+        TreeLevel& parentLevel = m_sceneGraph[level - 1];
+        TreeLevel& currLevel = m_sceneGraph[level];
+        const uint32_t numParents = (uint32_t)parentLevel.m_subtreeRanges.size();
+        const uint32_t numOld = (uint32_t)currLevel.m_IDs.size();
+        const uint32_t numTotal = numOld + (uint32_t)newAtLevel.size();
+
+        // Count new children of every parent (temporarily stored in Count)
+        newRanges.clear();
+        newRanges.resize(numParents, Range(0, 0));
 
-            // Shift tree position to right
-            pos.value()->Offset++;
+        for (auto i : newAtLevel)
+        {
+            NewInstance& inst = newInstances[i];
+
+            if (inst.NewParent)
+                inst.Parent = newInstances[inst.Parent].Offset;
+            else if (!prevRemap.empty())
+                inst.Parent = prevRemap[inst.Parent];
+
+            inst.Offset = newRanges[inst.Parent].Count++;
         }
+
+        uint32_t base = 0;
+
+        for (uint32_t p = 0; p < numParents; p++)
+        {
+            const uint32_t count = parentLevel.m_subtreeRanges[p].Count + newRanges[p].Count;
+            newRanges[p] = Range(base, count);
+            base += count;
+        }
+
+        Assert(base == numTotal, "Subtree ranges don't cover the whole level.");
+
+        TreeLevel next;
+        next.m_IDs.resize(numTotal);
+        next.m_handles.resize(numTotal);
+        next.m_localTransforms.resize(numTotal);
+        next.m_toWorlds.resize(numTotal);
+        next.m_prevToWorlds.resize(numTotal);
+        next.m_meshIDs.resize(numTotal);
+        next.m_meshHandles.resize(numTotal);
+        next.m_subtreeRanges.resize(numTotal);
+        next.m_parents.resize(numTotal);
+        next.m_rtFlags.resize(numTotal);
+        next.m_rtASInfo.resize(numTotal);
+        currRemap.resize(numOld);
+
+        // Move existing children of each parent
+        App::ParallelFor(0, numParents, PARENTS_PER_JOB, 
+            [&parentLevel, &currLevel, &next, &newRanges, &currRemap](size_t begin, size_t end)
+            {
+                for (size_t p = begin; p < end; p++)
+                {
+                    const Range oldRange = parentLevel.m_subtreeRanges[p];
+                    const uint32_t dstBase = newRanges[p].Base;
+
+                    for (uint32_t k = 0; k < oldRange.Count; k++)
+                    {
+                        const uint32_t src = oldRange.Base + k;
+                        const uint32_t dst = dstBase + k;
+
+                        next.m_IDs[dst] = currLevel.m_IDs[src];
+                        next.m_handles[dst] = currLevel.m_handles[src];
+                        next.m_localTransforms[dst] = currLevel.m_localTransforms[src];
+                        next.m_toWorlds[dst] = currLevel.m_toWorlds[src];
+                        next.m_prevToWorlds[dst] = currLevel.m_prevToWorlds[src];
+                        next.m_meshIDs[dst] = currLevel.m_meshIDs[src];
+                        next.m_meshHandles[dst] = currLevel.m_meshHandles[src];
+                        next.m_subtreeRanges[dst] = currLevel.m_subtreeRanges[src];
+                        next.m_parents[dst] = (uint32_t)p;
+                        next.m_rtFlags[dst] = currLevel.m_rtFlags[src];
+                        next.m_rtASInfo[dst] = currLevel.m_rtASInfo[src];
+                        currRemap[src] = dst;
+                    }
+                }
+            });
+
+        // Append new children after the existing ones. Their subtree ranges are set when the
+        // next level is rebuilt.
+        App::ParallelFor(0, newAtLevel.size(), INSTANCES_PER_JOB,
+            [&instances, &meshIDs, &newInstances, newAtLevel, &parentLevel, &newRanges, &next, &I](size_t begin, size_t end)
+            {
+                for (size_t j = begin; j < end; j++)
+                {
+                    const uint32_t i = newAtLevel[j];
+                    const Asset::InstanceDesc& desc = instances[i];
+                    NewInstance& inst = newInstances[i];
+                    const uint32_t dst = newRanges[inst.Parent].Base + 
+                        parentLevel.m_subtreeRanges[inst.Parent].Count + inst.Offset;
+                    inst.Offset = dst;
+
+                    next.m_IDs[dst] = desc.ID;
+                    next.m_handles[dst] = inst.Handle;
+                    next.m_localTransforms[dst] = desc.LocalTransform;
+                    next.m_toWorlds[dst] = I;
+                    next.m_prevToWorlds[dst] = I;
+                    next.m_meshIDs[dst] = meshIDs[i];
+                    next.m_meshHandles[dst] = MeshHandle();
+                    next.m_subtreeRanges[dst] = Range(0, 0);
+                    next.m_parents[dst] = inst.Parent;
+                    // Set rebuild flag to true when there's new any instance
+                    next.m_rtFlags[dst] = RT_Flags::Encode(desc.RtMeshMode, desc.RtInstanceMask, 1, 0, desc.IsOpaque);
+                    next.m_rtASInfo[dst] = RT_AS_Info();
+                }
+            });
+
+        // Ranges of the parent level are no longer needed
+        memcpy(parentLevel.m_subtreeRanges.data(), newRanges.data(), numParents * sizeof(Range));
+
+        currLevel.m_IDs.swap(next.m_IDs);
+        currLevel.m_handles.swap(next.m_handles);
+        currLevel.m_localTransforms.swap(next.m_localTransforms);
+        currLevel.m_toWorlds.swap(next.m_toWorlds);
+        currLevel.m_prevToWorlds.swap(next.m_prevToWorlds);
+        currLevel.m_meshIDs.swap(next.m_meshIDs);
+        currLevel.m_meshHandles.swap(next.m_meshHandles);
+        currLevel.m_subtreeRanges.swap(next.m_subtreeRanges);
+        currLevel.m_parents.swap(next.m_parents);
+        currLevel.m_rtFlags.swap(next.m_rtFlags);
+        currLevel.m_rtASInfo.swap(next.m_rtASInfo);
+
+        prevRemap.swap(currRemap);
+        rebuilt[level] = 1;
+    }
+
+    // Update tree positions of every instance in the rebuilt levels. Each one has its own 
+    // slot, so this is done in parallel.
+    for (uint32_t level = 1; level < numLevels; level++)
+    {
+        if (!rebuilt[level])
+            continue;
+
+        const auto& handles = m_sceneGraph[level].m_handles;
+
+        App::ParallelFor(0, handles.size(), INSTANCES_PER_JOB, [this, &handles, level](size_t begin, size_t end)
+            {
+                for (size_t i = begin; i < end; i++)
+                    m_instances[handles[i]] = TreePos{ .Level = level, .Offset = (uint32_t)i };
+            });
     }
 
+    // Only the new instances are added to the ID map -- handles of the existing ones 
+    // haven't changed
+    m_IDtoHandle.resize(m_IDtoHandle.size() + numInstances, true);
+
+    for (uint32_t i = 0; i < numInstances; i++)
+        m_IDtoHandle.insert_or_assign(instances[i].ID, newInstances[i].Handle);
+
     m_rebuildBVHFlag = true;
+    m_staleHandles.store(true, std::memory_order_relaxed);
 
     if (lock)
         ReleaseSRWLockExclusive(&m_instanceLock);
 }
 
-uint32_t SceneCore::InsertAtLevel(uint64_t id, uint32_t treeLevel, uint32_t parentIdx, 
+uint32_t SceneCore::InsertAtLevel(uint64_t id, InstanceHandle handle, uint32_t treeLevel, uint32_t parentIdx, 
     AffineTransformation& localTransform, uint64_t meshID, RT_MESH_MODE rtMeshMode, 
     uint8_t rtInstanceMask, bool isOpaque)
 {
@@ -543,12 +1110,16 @@ uint32_t SceneCore::InsertAtLevel(uint64_t id, uint32_t treeLevel, uint32_t pare
     Assert(insertIdx <= currLevel.m_IDs.size(), "Out-of-bounds insertion index.");
     Assert(currLevel.m_IDs.capacity() >= currLevel.m_IDs.size() + 1, "Scene graph hasn't been preallocated.");
     rearrange(currLevel.m_IDs, insertIdx, id);
+    rearrange(currLevel.m_handles, insertIdx, handle);
     rearrange(currLevel.m_localTransforms, insertIdx, localTransform);
     rearrange(currLevel.m_toWorlds, insertIdx, I);
+    rearrange(currLevel.m_prevToWorlds, insertIdx, I);
     rearrange(currLevel.m_meshIDs, insertIdx, meshID);
+    rearrange(currLevel.m_meshHandles, insertIdx, MeshHandle());
     const uint32_t newBase = currLevel.m_subtreeRanges.empty() ? 0 :
         currLevel.m_subtreeRanges.back().Base + currLevel.m_subtreeRanges.back().Count;
     rearrange(currLevel.m_subtreeRanges, insertIdx, newBase, 0);
+    rearrange(currLevel.m_parents, insertIdx, parentIdx);
     // Set rebuild flag to true when there's new any instance
     auto flags = RT_Flags::Encode(rtMeshMode, rtInstanceMask, 1, 0, isOpaque);
     rearrange(currLevel.m_rtFlags, insertIdx, flags);
@@ -558,6 +1129,16 @@ uint32_t SceneCore::InsertAtLevel(uint64_t id, uint32_t treeLevel, uint32_t pare
     for (size_t siblingIdx = parentIdx + 1; siblingIdx != parentLevel.m_subtreeRanges.size(); siblingIdx++)
         parentLevel.m_subtreeRanges[siblingIdx].Base++;
 
+    // Children of instances that were shifted need to point to their new offset
+    if (treeLevel + 1 < m_sceneGraph.size())
+    {
+        for (auto& parent : m_sceneGraph[treeLevel + 1].m_parents)
+        {
+            if (parent >= insertIdx)
+                parent++;
+        }
+    }
+
     return insertIdx;
 }
 
@@ -619,37 +1200,62 @@ void SceneCore::ResetRtAsInfos()
     }
 }
 
+void SceneCore::ResolveHandles()
+{
+    AcquireSRWLockExclusive(&m_instanceLock);
+    AcquireSRWLockShared(&m_meshLock);
+    AcquireSRWLockShared(&m_matLock);
+
+    bool resolved = m_meshes.ResolveMaterials(m_matBuffer);
+
+    for (size_t treeLevelIdx = 1; treeLevelIdx < m_sceneGraph.size(); treeLevelIdx++)
+    {
+        auto& currTreeLevel = m_sceneGraph[treeLevelIdx];
+
+        for (size_t i = 0; i < currTreeLevel.m_meshIDs.size(); i++)
+        {
+            const uint64_t meshID = currTreeLevel.m_meshIDs[i];
+            if (meshID == Scene::INVALID_MESH || currTreeLevel.m_meshHandles[i].IsValid())
+                continue;
+
+            currTreeLevel.m_meshHandles[i] = m_meshes.GetHandle(meshID);
+            resolved = resolved && currTreeLevel.m_meshHandles[i].IsValid();
+        }
+    }
+
+    // Try again next frame if some meshes or materials are still being loaded
+    m_staleHandles.store(!resolved, std::memory_order_relaxed);
+
+    ReleaseSRWLockShared(&m_matLock);
+    ReleaseSRWLockShared(&m_meshLock);
+    ReleaseSRWLockExclusive(&m_instanceLock);
+}
+
 void SceneCore::AddAnimation(uint64_t id, MutableSpan<Keyframe> keyframes, float t_start, 
     bool loop, bool isSorted)
 {
-#ifndef NDEBUG
-    TreePos& p = FindTreePosFromID(id).value();
-    Assert(RT_Flags::Decode(m_sceneGraph[p.Level].m_rtFlags[p.Offset]).MeshMode != RT_MESH_MODE::STATIC,
-        "Static instances can't be animated.");
-#endif
+    const InstanceHandle h = GetInstanceHandle(id);
+    Check(h.IsValid(), "Instance with ID %llu was not found.", id);
 
-    Check(keyframes.size() > 1, "Invalid animation.");
+    const TreePos& p = m_instances[h];
+    const auto rtFlags = RT_Flags::Decode(m_sceneGraph[p.Level].m_rtFlags[p.Offset]);
+    Assert(rtFlags.MeshMode != RT_MESH_MODE::STATIC, "Static instances can't be animated.");
+    // Animated instances are updated in parallel
+    Assert(std::find(m_animatedInstances.begin(), m_animatedInstances.end(), h) == m_animatedInstances.end(),
+        "Instance already has an animation.");
 
     if (!isSorted)
     {
-        std::sort(m_keyframes.begin(), m_keyframes.end(),
+        std::sort(keyframes.begin(), keyframes.end(),
             [](const Keyframe& k1, const Keyframe& k2)
             {
                 return k1.Time < k2.Time;
             });
     }
 
-    // Remember starting offset and number of keyframes
-    const uint32_t currOffset = (uint32_t)m_keyframes.size();
-    m_animationMetadata.push_back(AnimationMetadata{
-            .InstanceID = id,
-            .StartOffset = currOffset,
-            .Length = (uint32_t)keyframes.size(),
-            .T0 = t_start,
-            .Loop = loop
-        });
-
-    m_keyframes.append_range(keyframes.begin(), keyframes.end());
+    m_animations.Add(keyframes, t_start, loop);
+    m_animatedInstances.push_back(h);
+    m_hasEmissiveAnimations = m_hasEmissiveAnimations || (rtFlags.InstanceMask & RT_AS_SUBGROUP::EMISSIVE);
 }
 
 void SceneCore::TransformInstance(uint64_t id, const float3& tr, const float3x3& rotation,
@@ -657,7 +1263,8 @@ void SceneCore::TransformInstance(uint64_t id, const float3& tr, const float3x3&
 {
     m_tempWorldTransformUpdates[id] = TransformUpdate{ .Tr = tr, .Rotation = rotation, .Scale = scale };
 
-    const auto treePos = FindTreePosFromID(id).value();
+    const InstanceHandle h = GetInstanceHandle(id);
+    const TreePos treePos = m_instances[h];
     const auto rtFlags = RT_Flags::Decode(m_sceneGraph[treePos.Level].m_rtFlags[treePos.Offset]);
 
     m_staleEmissivePositions = m_staleEmissivePositions || 
@@ -666,7 +1273,7 @@ void SceneCore::TransformInstance(uint64_t id, const float3& tr, const float3x3&
 
     ConvertInstanceDynamic(id, treePos, rtFlags);
     // Updates if instance already exists
-    m_instanceUpdates[id] = App::GetTimer().GetTotalFrameCount();
+    m_instanceUpdates[id] = InstanceUpdate{ .Handle = h, .Frame = App::GetTimer().GetTotalFrameCount() };
 
     m_rendererInterface.SceneModified();
 }
@@ -680,21 +1287,25 @@ void SceneCore::ReserveInstances(Span<int> treeLevels, size_t total)
     for (size_t i = 0; i < treeLevels.size(); i++)
     {
         m_sceneGraph[i + 1].m_IDs.reserve(treeLevels[i]);
+        m_sceneGraph[i + 1].m_handles.reserve(treeLevels[i]);
         m_sceneGraph[i + 1].m_localTransforms.reserve(treeLevels[i]);
         m_sceneGraph[i + 1].m_meshIDs.reserve(treeLevels[i]);
+        m_sceneGraph[i + 1].m_meshHandles.reserve(treeLevels[i]);
         m_sceneGraph[i + 1].m_rtASInfo.reserve(treeLevels[i]);
         m_sceneGraph[i + 1].m_rtFlags.reserve(treeLevels[i]);
         m_sceneGraph[i + 1].m_subtreeRanges.reserve(treeLevels[i]);
+        m_sceneGraph[i + 1].m_parents.reserve(treeLevels[i]);
         m_sceneGraph[i + 1].m_toWorlds.reserve(treeLevels[i]);
+        m_sceneGraph[i + 1].m_prevToWorlds.reserve(treeLevels[i]);
     }
 
-    m_prevToWorlds.resize(total, true);
-    m_IDtoTreePos.resize(total, true);
+    m_IDtoHandle.resize(total, true);
+    m_instances.reserve(total);
     m_worldTransformUpdates.resize(Min(total, 32llu));
 }
 
-void SceneCore::AddEmissives(Util::SmallVector<Asset::EmissiveInstance>&& emissiveInstances,
-    SmallVector<RT::EmissiveTriangle>&& emissiveTris, bool lock)
+void SceneCore::AddEmissives(Span<Asset::EmissiveInstance> emissiveInstances,
+    Span<RT::EmissiveTriangle> emissiveTris, bool lock)
 {
     if (emissiveTris.empty())
         return;
@@ -702,7 +1313,7 @@ void SceneCore::AddEmissives(Util::SmallVector<Asset::EmissiveInstance>&& emissi
     if(lock)
         AcquireSRWLockExclusive(&m_emissiveLock);
     
-    m_emissives.AddBatch(ZetaMove(emissiveInstances), ZetaMove(emissiveTris));
+    m_emissives.AddBatch(emissiveInstances, emissiveTris);
 
     if(lock)
         ReleaseSRWLockExclusive(&m_emissiveLock);
@@ -723,79 +1334,80 @@ void SceneCore::ToggleEmissivesCallback(const Support::ParamVariant& p)
 
 void SceneCore::InitWorldTransformations()
 {
-    const float4x3 I = float4x3(store(identity()));
+    constexpr size_t INSTANCES_PER_JOB = 256;
+    constexpr size_t PARENTS_PER_JOB = 64;
 
-    // No parent transformation for first level
-    for (size_t i = 0; i < m_sceneGraph[1].m_localTransforms.size(); i++)
+    // Levels are processed in order, so that parent transformations are final by the time 
+    // their children are visited
+    for (size_t level = 1; level < m_sceneGraph.size(); level++)
     {
-        AffineTransformation& tr = m_sceneGraph[1].m_localTransforms[i];
-        v_float4x4 vLocal = affineTransformation(tr.Scale, tr.Rotation, tr.Translation);
-        const uint64_t ID = m_sceneGraph[1].m_IDs[i];
+        const TreeLevel& parentLevel = m_sceneGraph[level - 1];
+        TreeLevel& currLevel = m_sceneGraph[level];
 
-        // Set prev = new for 1st frame
-        m_sceneGraph[1].m_toWorlds[i] = float4x3(store(vLocal));
-        m_prevToWorlds[ID] = m_sceneGraph[1].m_toWorlds[i];
-    }
-
-    const size_t numLevels = m_sceneGraph.size();
-
-    for (size_t level = 1; level < numLevels - 1; ++level)
-    {
-        for (size_t i = 0; i < m_sceneGraph[level].m_subtreeRanges.size(); i++)
+        auto update = [&currLevel](const v_float4x4& vParentW, size_t begin, size_t end)
+            {
+                for (size_t j = begin; j < end; j++)
+                {
+                    const AffineTransformation& tr = currLevel.m_localTransforms[j];
+                    v_float4x4 vLocal = affineTransformation(tr.Scale, tr.Rotation, tr.Translation);
+                    // Bottom up transformation hierarchy
+                    const float4x3 W = float4x3(store(mul(vLocal, vParentW)));
+
+                    // Set prev = new for 1st frame
+                    currLevel.m_toWorlds[j] = W;
+                    currLevel.m_prevToWorlds[j] = W;
+                }
+            };
+
+        // First level has a single (identity) parent, so split over instances rather than parents
+        if (level == 1)
         {
-            const v_float4x4 vParentTr = load4x3(m_sceneGraph[level].m_toWorlds[i]);
-            const float4x3 P = float4x3(store(vParentTr));
-            const auto& range = m_sceneGraph[level].m_subtreeRanges[i];
+            App::ParallelFor(0, currLevel.m_localTransforms.size(), INSTANCES_PER_JOB, 
+                [&update](size_t begin, size_t end)
+                {
+                    update(identity(), begin, end);
+                });
 
-            for (size_t j = range.Base; j < range.Base + range.Count; j++)
-            {
-                AffineTransformation& tr = m_sceneGraph[level + 1].m_localTransforms[j];
-                v_float4x4 vLocal = affineTransformation(tr.Scale, tr.Rotation, tr.Translation);
-                // Bottom up transformation hierarchy
-                v_float4x4 newW = mul(vLocal, vParentTr);
-                const uint64_t ID = m_sceneGraph[level + 1].m_IDs[j];
-
-                // Set prev = new for 1st frame
-                m_sceneGraph[level + 1].m_toWorlds[j] = float4x3(store(newW));
-                m_prevToWorlds[ID] = m_sceneGraph[level + 1].m_toWorlds[j];
-            }
+            continue;
         }
+
+        App::ParallelFor(0, parentLevel.m_subtreeRanges.size(), PARENTS_PER_JOB,
+            [&parentLevel, &update](size_t begin, size_t end)
+            {
+                for (size_t i = begin; i < end; i++)
+                {
+                    const Range range = parentLevel.m_subtreeRanges[i];
+                    update(load4x3(parentLevel.m_toWorlds[i]), range.Base, range.Base + range.Count);
+                }
+            });
     }
 }
 
-void SceneCore::UpdateWorldTransformations(Vector<BVH::BVHUpdateInput, App::FrameAllocator>& toUpdateInstances)
+void SceneCore::UpdateWorldTransformations(MutableSpan<TreePos> animated, 
+    Vector<BVH::BVHUpdateInput, App::FrameAllocator>& toUpdateInstances)
 {
-    struct Entry
-    {
-        v_float4x4 W;
-        uint32_t TreeLevel;
-        uint32_t Base;
-        uint32_t Count;
-    };
-
-    SmallVector<Entry, App::FrameAllocator, 10> stack;
     const auto currFrame = App::GetTimer().GetTotalFrameCount();
-
-    // Can't append while iterating
-    SmallVector<uint64, App::FrameAllocator, 3> toAppend;
+    // Updated instances that have children
+    SmallVector<TreePos, App::FrameAllocator> dirtyRoots;
 
     for (auto it = m_instanceUpdates.begin_it(); it != m_instanceUpdates.end_it(); 
         it = m_instanceUpdates.next_it(it))
     {
         const auto instance = it->Key;
-        const auto frame = it->Val;
-        const TreePos& p = FindTreePosFromID(instance).value();
+        const auto frame = it->Val.Frame;
+        const TreePos& p = m_instances[it->Val.Handle];
+        TreeLevel& level = m_sceneGraph[p.Level];
 
         // -1 -> update was added at the tail end of last frame
         if (frame < currFrame - 1)
         {
             // Mesh hasn't moved, just update previous transformation
-            m_prevToWorlds[instance] = m_sceneGraph[p.Level].m_toWorlds[p.Offset];
+            level.m_prevToWorlds[p.Offset] = level.m_toWorlds[p.Offset];
             continue;
         }
 
         // Grab current to world transformation
-        const float4x3& prevW = m_sceneGraph[p.Level].m_toWorlds[p.Offset];
+        const float4x3& prevW = level.m_toWorlds[p.Offset];
         v_float4x4 vW = load4x3(prevW);
 
         float4a t;
@@ -820,17 +1432,11 @@ void SceneCore::UpdateWorldTransformations(Vector<BVH::BVHUpdateInput, App::Fram
         Assert(fabsf(R.m[2].length() - 1) < 1e-5, "");
 
         // Update previous & current transformations
-        m_prevToWorlds[instance] = prevW;
-        m_sceneGraph[p.Level].m_toWorlds[p.Offset] = float4x3(store(vNewWorld));
-        
-        // Add subtree to stack
-        if (const auto range = m_sceneGraph[p.Level].m_subtreeRanges[p.Offset]; range.Count)
-        {
-            stack.push_back(Entry{ .W = vNewWorld,
-                .TreeLevel = p.Level, 
-                .Base = range.Base, 
-                .Count = range.Count });
-        }
+        level.m_prevToWorlds[p.Offset] = prevW;
+        level.m_toWorlds[p.Offset] = float4x3(store(vNewWorld));
+
+        if (level.m_subtreeRanges[p.Offset].Count)
+            dirtyRoots.push_back(p);
 
         // Remember transformation update for future
         if (auto existingIt = m_worldTransformUpdates.find(instance); existingIt)
@@ -854,185 +1460,275 @@ void SceneCore::UpdateWorldTransformations(Vector<BVH::BVHUpdateInput, App::Fram
         }
     }
 
-    while (!stack.empty())
-    {
-        Entry e = stack.back();
-        stack.pop_back();
-        auto& currLevel = m_sceneGraph[e.TreeLevel + 1];
+    m_tempWorldTransformUpdates.clear();
+
+    if (!dirtyRoots.empty() || !animated.empty())
+        PropagateWorldTransformations(dirtyRoots, animated);
+}
 
-        for (size_t j = e.Base; j < e.Base + e.Count; j++)
+void SceneCore::PropagateWorldTransformations(MutableSpan<TreePos> dirtyRoots, MutableSpan<TreePos> animated)
+{
+    constexpr size_t INSTANCES_PER_JOB = 256;
+
+    auto byTreePos = [](const TreePos& lhs, const TreePos& rhs)
         {
-            Assert(RT_Flags::Decode(currLevel.m_rtFlags[j]).MeshMode ==
-                RT_MESH_MODE::DYNAMIC_NO_REBUILD, "Invalid scene graph.");
+            return lhs.Level < rhs.Level || (lhs.Level == rhs.Level && lhs.Offset < rhs.Offset);
+        };
 
-            const uint64_t ID = m_sceneGraph[e.TreeLevel + 1].m_IDs[j];
-            toAppend.push_back(ID);
+    std::sort(dirtyRoots.begin(), dirtyRoots.end(), byTreePos);
+    std::sort(animated.begin(), animated.end(), byTreePos);
 
-            AffineTransformation& local = currLevel.m_localTransforms[j];
+    const auto currFrame = App::GetTimer().GetTotalFrameCount();
+    const bool hasAccumulatedUpdates = !m_worldTransformUpdates.empty();
+
+    // World transformation is local transformation followed by parent's, with updates
+    // from TransformInstance() applied on top
+    auto update = [this, hasAccumulatedUpdates](TreeLevel& currLevel, uint32_t j, const v_float4x4 vParentW)
+        {
+            const AffineTransformation& local = currLevel.m_localTransforms[j];
             v_float4x4 vLocal = affineTransformation(local.Scale, local.Rotation, local.Translation);
-            v_float4x4 vNewWorld = mul(vLocal, e.W);
+            v_float4x4 vNewWorld = mul(vLocal, vParentW);
 
             // If instance has had updates, apply them
-            if (auto updateIt = m_worldTransformUpdates.find(ID); updateIt)
+            if (hasAccumulatedUpdates)
             {
-                float4a t;
-                float4a s;
-                v_float4x4 vR = decomposeSRT(vNewWorld, s, t);
+                if (auto updateIt = m_worldTransformUpdates.find(currLevel.m_IDs[j]); updateIt)
+                {
+                    float4a t;
+                    float4a s;
+                    v_float4x4 vR = decomposeSRT(vNewWorld, s, t);
 
-                AffineTransformation& existing = *updateIt.value();
-                float3 newTr = existing.Translation + t.xyz();
-                float3 newScale = existing.Scale * s.xyz();
+                    const AffineTransformation& existing = *updateIt.value();
+                    float3 newTr = existing.Translation + t.xyz();
+                    float3 newScale = existing.Scale * s.xyz();
 
-                v_float4x4 vRotUpdate = rotationMatFromQuat(loadFloat4(existing.Rotation));
-                vR = mul(vR, vRotUpdate);
+                    v_float4x4 vRotUpdate = rotationMatFromQuat(loadFloat4(existing.Rotation));
+                    vR = mul(vR, vRotUpdate);
 
-                vNewWorld = affineTransformation(vR, newScale, newTr);
+                    vNewWorld = affineTransformation(vR, newScale, newTr);
+                }
             }
 
             // Update previous & current transformations
-            m_prevToWorlds[ID] = currLevel.m_toWorlds[j];
+            currLevel.m_prevToWorlds[j] = currLevel.m_toWorlds[j];
             currLevel.m_toWorlds[j] = float4x3(store(vNewWorld));
+        };
 
-            // Add subtree to stack
-            if (const auto& subtree = currLevel.m_subtreeRanges[j]; subtree.Count)
-            {
-                stack.push_back(Entry{ .W = vNewWorld,
-                    .TreeLevel = e.TreeLevel + 2,
-                    .Base = subtree.Base,
-                    .Count = subtree.Count });
-            }
+    // Instances at current level whose children need to be updated
+    SmallVector<uint32_t, App::FrameAllocator> dirtyParents;
+    SmallVector<uint32_t, App::FrameAllocator> nextDirtyParents;
+    // Exclusive prefix sum of number of children of dirty parents -- children of all the
+    // dirty parents are split into equal-sized chunks, regardless of how they're distributed 
+    // among parents
+    SmallVector<uint32_t, App::FrameAllocator> childOffsets;
+    size_t currRoot = 0;
+    size_t currAnimated = 0;
+
+    // Animated instances are updated when their parent level is visited
+    uint32_t level = Min(dirtyRoots.empty() ? UINT32_MAX : dirtyRoots[0].Level,
+        animated.empty() ? UINT32_MAX : animated[0].Level - 1);
+
+    for (; level < m_sceneGraph.size() - 1; level++)
+    {
+        while (currRoot < dirtyRoots.size() && dirtyRoots[currRoot].Level == level)
+            dirtyParents.push_back(dirtyRoots[currRoot++].Offset);
+
+        // Animated instances in [animatedBegin, currAnimated) belong to the next level
+        const size_t animatedBegin = currAnimated;
+
+        while (currAnimated < animated.size() && animated[currAnimated].Level == level + 1)
+            currAnimated++;
+
+        if (dirtyParents.empty() && animatedBegin == currAnimated)
+        {
+            if (currRoot == dirtyRoots.size() && currAnimated == animated.size())
+                break;
+
+            continue;
         }
-    }
 
-    m_tempWorldTransformUpdates.clear();
-    
-    for(auto id : toAppend)
-        m_instanceUpdates[id] = App::GetTimer().GetTotalFrameCount() - 1;
-}
+        // Updated instance may also be a descendant of another updated instance -- children 
+        // must be visited once, otherwise the second visit would overwrite their previous 
+        // transformation
+        std::sort(dirtyParents.begin(), dirtyParents.end());
+        dirtyParents.resize(std::unique(dirtyParents.begin(), dirtyParents.end()) - dirtyParents.begin());
 
-void SceneCore::UpdateEmissivePositions()
-{
-    auto tris = m_emissives.Triagnles();
-    auto triInitialPos = m_emissives.InitialTriPositions();
+        const TreeLevel& parentLevel = m_sceneGraph[level];
+        TreeLevel& currLevel = m_sceneGraph[level + 1];
 
-    uint32_t minIdx = (uint32_t)tris.size() - 1;
-    uint32_t maxIdx = 0;
+        childOffsets.resize(dirtyParents.size() + 1);
+        childOffsets[0] = 0;
 
-    for (auto it = m_instanceUpdates.begin_it(); it != m_instanceUpdates.end_it();
-        it = m_instanceUpdates.next_it(it))
-    {
-        auto instance = it->Key;
-        const auto& emissiveInstance = *m_emissives.FindInstance(instance).value();
-        const v_float4x4 vW = load4x3(GetToWorld(instance));
-        const auto rtASInfo = GetInstanceRtASInfo(instance);
+        for (size_t i = 0; i < dirtyParents.size(); i++)
+            childOffsets[i + 1] = childOffsets[i] + parentLevel.m_subtreeRanges[dirtyParents[i]].Count;
 
-        for (size_t t = emissiveInstance.BaseTriOffset; 
-            t < emissiveInstance.BaseTriOffset + emissiveInstance.NumTriangles; t++)
-        {
-            EmissiveBuffer::Triangle& initTri = triInitialPos[t];
+        App::ParallelFor(0, childOffsets.back(), INSTANCES_PER_JOB, 
+            [&parentLevel, &currLevel, &dirtyParents, &childOffsets, &update](size_t begin, size_t end)
+            {
+                // Dirty parent of first child in this chunk (every dirty parent has at least 
+                // one child)
+                size_t p = std::upper_bound(childOffsets.begin(), childOffsets.end(), (uint32_t)begin) - 
+                    childOffsets.begin() - 1;
 
-            __m128 vV0;
-            __m128 vV1;
-            __m128 vV2;
-            RT::EmissiveTriangle::DecodeVertices(initTri.Vtx0, initTri.V0V1, initTri.V0V2,
-                initTri.EdgeLengths,
-                vV0, vV1, vV2);
+                for (size_t c = begin; c < end; p++)
+                {
+                    const uint32_t parentIdx = dirtyParents[p];
+                    const Range range = parentLevel.m_subtreeRanges[parentIdx];
+                    const v_float4x4 vParentW = load4x3(parentLevel.m_toWorlds[parentIdx]);
+                    const uint32_t first = range.Base + uint32_t(c - childOffsets[p]);
+                    const uint32_t last = range.Base + uint32_t(Min(end, (size_t)childOffsets[p + 1]) - childOffsets[p]);
 
-            vV0 = mul(vW, vV0);
-            vV1 = mul(vW, vV1);
-            vV2 = mul(vW, vV2);
-            tris[t].StoreVertices(vV0, vV1, vV2);
+                    for (uint32_t j = first; j < last; j++)
+                    {
+                        Assert(RT_Flags::Decode(currLevel.m_rtFlags[j]).MeshMode ==
+                            RT_MESH_MODE::DYNAMIC_NO_REBUILD, "Invalid scene graph.");
 
-            // Dynamic instances have geometry index = 0
-            const uint32_t hash = Pcg3d(uint3(0,
-                rtASInfo.InstanceID,
-                initTri.PrimIdx)).x;
-            tris[t].ID = hash;
-        }
+                        update(currLevel, j, vParentW);
+                    }
 
-        minIdx = Min(minIdx, emissiveInstance.BaseTriOffset);
-        maxIdx = Max(maxIdx, emissiveInstance.BaseTriOffset + emissiveInstance.NumTriangles);
-    }
+                    c += last - first;
+                }
+            });
 
-    Assert(minIdx <= maxIdx, "Invalid indices.");
-    m_emissives.UpdateTriPositions(minIdx, maxIdx);
-}
+        // Animated instances whose parent is dirty were updated above
+        auto isParentDirty = [&currLevel, &dirtyParents](uint32_t j)
+            {
+                return std::binary_search(dirtyParents.begin(), dirtyParents.end(), currLevel.m_parents[j]);
+            };
 
-void SceneCore::UpdateAnimations(float t, Vector<AnimationUpdate, App::FrameAllocator>& animVec)
-{
-    for (auto& anim : m_animationMetadata)
-    {
-        AffineTransformation vRes;
+        App::ParallelFor(animatedBegin, currAnimated, INSTANCES_PER_JOB,
+            [&parentLevel, &currLevel, animated, &isParentDirty, &update](size_t begin, size_t end)
+            {
+                for (size_t i = begin; i < end; i++)
+                {
+                    const uint32_t j = animated[i].Offset;
 
-        const Keyframe& kStart = m_keyframes[anim.StartOffset];
-        const Keyframe& kEnd = m_keyframes[anim.StartOffset + anim.Length - 1];
-        const float t_start = anim.T0;
+                    if (!isParentDirty(j))
+                        update(currLevel, j, load4x3(parentLevel.m_toWorlds[currLevel.m_parents[j]]));
+                }
+            });
+
+        // Updated instances stay in m_instanceUpdates for the rest of this frame and the 
+        // next one, same as instances that were directly updated
+        nextDirtyParents.clear();
+
+        auto addUpdate = [this, &currLevel, &nextDirtyParents, currFrame](uint32_t j)
+            {
+                m_instanceUpdates[currLevel.m_IDs[j]] = InstanceUpdate{ .Handle = currLevel.m_handles[j],
+                    .Frame = currFrame - 1 };
+
+                if (currLevel.m_subtreeRanges[j].Count)
+                    nextDirtyParents.push_back(j);
+            };
 
-        // Fast paths
-        if (t <= kStart.Time + t_start)
+        for (auto parentIdx : dirtyParents)
         {
-            vRes = kStart.Transform;
+            const Range range = parentLevel.m_subtreeRanges[parentIdx];
+
+            for (uint32_t j = range.Base; j < range.Base + range.Count; j++)
+                addUpdate(j);
         }
-        else if (!anim.Loop && t >= kEnd.Time + t_start)
+
+        for (size_t i = animatedBegin; i < currAnimated; i++)
         {
-            vRes = kEnd.Transform;
+            if (!isParentDirty(animated[i].Offset))
+                addUpdate(animated[i].Offset);
         }
-        else
-        {
-            if (t >= kEnd.Time + t_start)
-            {
-                float numLoops = floorf((t - kStart.Time) / (kEnd.Time - kStart.Time));
-                float excess = numLoops * (kEnd.Time - kStart.Time) + kStart.Time;
-                t -= excess;
-                t += kStart.Time;
-            }
 
-            auto idx = FindInterval(Span(m_keyframes), t, [](const Keyframe& k) { return k.Time; },
-                anim.StartOffset,
-                anim.StartOffset + anim.Length - 1);
-
-            Assert(idx != -1, "FindInterval() unexpectedly failed.");
-            Keyframe& k1 = m_keyframes[idx];
-            Keyframe& k2 = m_keyframes[idx + 1];
+        dirtyParents.swap(nextDirtyParents);
+    }
+}
 
-            Assert(t >= k1.Time + t_start && t <= k2.Time + t_start, "bug");
-            Assert(k1.Time < k2.Time, "divide-by-zero");
+void SceneCore::UpdateEmissivePositions()
+{
+    // Large instances are split into multiple jobs
+    constexpr uint32_t EMISSIVE_TRIS_PER_JOB = 1024;
+    constexpr uint32_t BATCH_SIZE = 8;
 
-            float interpolatedT = (t - (k1.Time + t_start)) / (k2.Time - k1.Time);
+    struct Job
+    {
+        float4x3 W;
+        uint32_t BaseTriOffset;
+        uint32_t NumTriangles;
+        uint32_t InstanceID;
+    };
 
-            // Scale
-            const __m128 vScale1 = loadFloat3(k1.Transform.Scale);
-            const __m128 vScale2 = loadFloat3(k2.Transform.Scale);
-            const __m128 vScaleInt = lerp(vScale1, vScale2, interpolatedT);
+    SmallVector<Job, App::FrameAllocator> jobs;
 
-            // Translation
-            const __m128 vTranslate1 = loadFloat3(k1.Transform.Translation);
-            const __m128 vTranslate2 = loadFloat3(k2.Transform.Translation);
-            const __m128 vTranslateInt = lerp(vTranslate1, vTranslate2, interpolatedT);
+    for (auto it = m_instanceUpdates.begin_it(); it != m_instanceUpdates.end_it();
+        it = m_instanceUpdates.next_it(it))
+    {
+        auto instance = it->Key;
+        // Updates also include non-emissive instances
+        auto emissiveIt = m_emissives.FindInstance(instance);
+        if (!emissiveIt)
+            continue;
 
-            // Rotation
-            const __m128 vRot1 = loadFloat4(k1.Transform.Rotation);
-            const __m128 vRot2 = loadFloat4(k2.Transform.Rotation);
-            const __m128 vRotInt = slerp(vRot1, vRot2, interpolatedT);
+        const auto& emissiveInstance = *emissiveIt.value();
+        const float4x3& W = GetToWorld(it->Val.Handle);
+        const auto rtASInfo = GetInstanceRtASInfo(it->Val.Handle);
+        const uint32_t end = emissiveInstance.BaseTriOffset + emissiveInstance.NumTriangles;
 
-            vRes.Scale = storeFloat3(vScaleInt);
-            vRes.Rotation = storeFloat4(vRotInt);
-            vRes.Translation = storeFloat3(vTranslateInt);
+        for (uint32_t base = emissiveInstance.BaseTriOffset; base < end; base += EMISSIVE_TRIS_PER_JOB)
+        {
+            jobs.push_back(Job{ .W = W,
+                .BaseTriOffset = base,
+                .NumTriangles = Min(EMISSIVE_TRIS_PER_JOB, end - base),
+                .InstanceID = rtASInfo.InstanceID });
         }
 
-        animVec.push_back(AnimationUpdate{
-            .M = vRes,
-            .InstanceID = anim.InstanceID });
+        // Only touched triangles are uploaded. Power only needs to be re-estimated when 
+        // triangle areas have changed, i.e. when the instance was scaled.
+        m_emissives.UpdateTriPositions(emissiveInstance.BaseTriOffset, end, 
+            IsScaled(GetPrevToWorld(it->Val.Handle), W));
     }
+
+    App::ParallelFor(0, jobs.size(), 1, [this, &jobs](size_t begin, size_t end)
+        {
+            auto tris = m_emissives.Triagnles();
+            auto triInitialPos = m_emissives.InitialTriPositions();
+
+            for (size_t j = begin; j < end; j++)
+            {
+                const Job& job = jobs[j];
+                const EmissiveTransformSoA W(job.W);
+                const uint32_t jobEnd = job.BaseTriOffset + job.NumTriangles;
+
+                for (uint32_t t = job.BaseTriOffset; t < jobEnd; t += BATCH_SIZE)
+                {
+                    TransformEmissives8(W, &triInitialPos[t], &tris[t], Min(BATCH_SIZE, jobEnd - t),
+                        job.InstanceID);
+                }
+            }
+        });
 }
 
-void SceneCore::UpdateLocalTransforms(Span<AnimationUpdate> animVec)
+void SceneCore::UpdateAnimations(float t, Vector<TreePos, App::FrameAllocator>& animated)
 {
-    for (auto& update : animVec)
-    {
-        TreePos t = FindTreePosFromID(update.InstanceID).value();
-        m_sceneGraph[t.Level].m_localTransforms[t.Offset] = update.M;
-    }
+    constexpr size_t BATCHES_PER_JOB = 32;
+    const uint32_t numTracks = m_animations.NumTracks();
+    const uint32_t numBatches = CeilUnsignedIntDiv(numTracks, (uint32_t)AnimationTracks::NUM_LANES);
+    animated.resize(numTracks);
+
+    App::ParallelFor(0, numBatches, BATCHES_PER_JOB, [this, t, numTracks, &animated](size_t begin, size_t end)
+        {
+            AffineTransformation transforms[AnimationTracks::NUM_LANES * BATCHES_PER_JOB];
+
+            for (size_t b = begin; b < end; b += BATCHES_PER_JOB)
+            {
+                const uint32_t first = (uint32_t)b * AnimationTracks::NUM_LANES;
+                const uint32_t last = Min((uint32_t)Min(b + BATCHES_PER_JOB, end) * AnimationTracks::NUM_LANES, 
+                    numTracks);
+                m_animations.Evaluate(t, first, last, transforms);
+
+                for (uint32_t track = first; track < last; track++)
+                {
+                    const TreePos& p = m_instances[m_animatedInstances[track]];
+                    m_sceneGraph[p.Level].m_localTransforms[p.Offset] = transforms[track - first];
+                    animated[track] = p;
+                }
+            }
+        });
 }
 
 bool SceneCore::ConvertInstanceDynamic(uint64_t instanceID, const TreePos& treePos, 
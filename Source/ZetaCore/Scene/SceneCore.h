@@ -2,10 +2,12 @@
 
 #include "../Math/BVH.h"
 #include "Asset.h"
+#include "Animation.h"
 #include "SceneRenderer.h"
 #include "SceneCommon.h"
 #include "../Utility/Utility.h"
 #include "../Utility/SynchronizedView.h"
+#include "../Utility/FlatHashTable.h"
 #include <xxHash/xxhash.h>
 #include <atomic>
 
@@ -27,20 +29,6 @@ namespace ZetaRay::Support
 
 namespace ZetaRay::Scene
 {
-    struct Keyframe
-    {
-        static Keyframe Identity()
-        {
-            Keyframe k;
-            k.Transform = Math::AffineTransformation::GetIdentity();
-
-            return k;
-        }
-
-        Math::AffineTransformation Transform;
-        float Time;
-    };
-
     struct RT_Flags
     {
         static RT_Flags Decode(uint8_t f)
@@ -76,28 +64,35 @@ namespace ZetaRay::Scene
         uint32_t InstanceID;
     };
 
-    ZetaInline uint64_t InstanceID(uint32_t sceneID, int nodeIdx, int mesh, int meshPrim)
+    // IDs are hashes of the glTF indices that identify each object. Indices are hashed as
+    // integers -- with a different seed for each kind of object -- rather than formatted
+    // as strings, as these are computed for every object during load.
+    enum class ID_SEED : uint64_t
     {
-        StackStr(str, n, "instance_%u_%d_%d_%d", sceneID, nodeIdx, mesh, meshPrim);
-        uint64_t instanceFromSceneID = XXH3_64bits(str, n);
+        INSTANCE = 0x9e3779b97f4a7c15,
+        MESH = 0xc2b2ae3d27d4eb4f,
+        MATERIAL = 0x165667b19e3779f9
+    };
 
-        return instanceFromSceneID;
+    ZetaInline uint64_t InstanceID(uint32_t sceneID, int nodeIdx, int mesh, int meshPrim)
+    {
+        const int32_t key[4] = { (int32_t)sceneID, nodeIdx, mesh, meshPrim };
+        return XXH3_64bits_withSeed(key, sizeof(key), (uint64_t)ID_SEED::INSTANCE);
     }
 
     ZetaInline uint32_t MaterialID(uint32_t sceneID, int matIdx)
     {
-        StackStr(str, n, "mesh_%u_%d", sceneID, matIdx);
-        uint64_t meshFromSceneID = XXH3_64bits(str, n);
+        const int32_t key[2] = { (int32_t)sceneID, matIdx };
+        const uint64_t matFromSceneID = XXH3_64bits_withSeed(key, sizeof(key), 
+            (uint64_t)ID_SEED::MATERIAL);
 
-        return Util::XXH3_64_To_32(meshFromSceneID);
+        return Util::XXH3_64_To_32(matFromSceneID);
     }
 
     ZetaInline uint64_t MeshID(uint32_t sceneID, int meshIdx, int meshPrimIdx)
     {
-        StackStr(str, n, "mesh_%u_%d_%d", sceneID, meshIdx, meshPrimIdx);
-        uint64_t meshFromSceneID = XXH3_64bits(str, n);
-
-        return meshFromSceneID;
+        const int32_t key[3] = { (int32_t)sceneID, meshIdx, meshPrimIdx };
+        return XXH3_64bits_withSeed(key, sizeof(key), (uint64_t)ID_SEED::MESH);
     }
 }
 
@@ -134,11 +129,38 @@ namespace ZetaRay::Scene
         void AddMeshes(Util::SmallVector<Model::glTF::Asset::Mesh>&& meshes,
             Util::SmallVector<Core::Vertex>&& vertices,
             Util::SmallVector<uint32_t>&& indices,
+            Util::Span<Model::MeshCluster> clusters,
+            bool lock = true);
+        // Same as above, but data is copied
+        void AddMeshes(Util::Span<Model::glTF::Asset::Mesh> meshes,
+            Util::Span<Core::Vertex> vertices,
+            Util::Span<uint32_t> indices,
+            Util::Span<Model::MeshCluster> clusters,
+            bool lock = true);
+        // Vertices stay in the compact layout until they're uploaded to the GPU. Positions of 
+        // each mesh are relative to the corresponding element of bounds (see VertexQuantizer.h).
+        void AddMeshes(Util::SmallVector<Model::glTF::Asset::Mesh>&& meshes,
+            Util::SmallVector<Core::CompactVertex>&& vertices,
+            Util::Span<Math::AABB> bounds,
+            Util::SmallVector<uint32_t>&& indices,
+            Util::Span<Model::MeshCluster> clusters,
+            bool lock = true);
+        // Same as above, but data is copied
+        void AddMeshes(Util::Span<Model::glTF::Asset::Mesh> meshes,
+            Util::Span<Core::CompactVertex> vertices,
+            Util::Span<Math::AABB> bounds,
+            Util::Span<uint32_t> indices,
+            Util::Span<Model::MeshCluster> clusters,
             bool lock = true);
         ZetaInline Util::Optional<const Model::TriangleMesh*> GetMesh(uint64_t id) const
         {
             return m_meshes.GetMesh(id);
         }
+        ZetaInline Util::Optional<const Model::TriangleMesh*> GetMesh(MeshHandle h, 
+            MaterialHandle* matHandle = nullptr) const
+        {
+            return m_meshes.GetMesh(h, matHandle);
+        }
         ZetaInline Util::Optional<const Model::TriangleMesh*> GetInstanceMesh(uint64_t id) const
         {
             const TreePos& p = FindTreePosFromID(id).value();
@@ -146,6 +168,16 @@ namespace ZetaRay::Scene
 
             return m_meshes.GetMesh(meshID);
         }
+        ZetaInline Util::Span<Model::MeshCluster> GetMeshClusters(const Model::TriangleMesh& mesh) const
+        {
+            return m_meshes.GetClusters(mesh);
+        }
+        // Appends index (into the instance mesh's clusters) of every cluster of the given instance
+        // that at least partially overlaps the view frustum and isn't back-facing. Assumes the 
+        // view frustum is in view space.
+        void CullClusters(uint64_t instanceID, const Math::ViewFrustum& viewFrustum, 
+            const Math::float4x4a& viewToWorld,
+            Util::Vector<uint32_t, App::FrameAllocator>& visibleClusters) const;
         ZetaInline const Core::GpuMemory::Buffer& GetMeshVB() { return m_meshes.GetVB(); }
         ZetaInline const Core::GpuMemory::Buffer& GetMeshIB() { return m_meshes.GetIB(); }
 
@@ -159,6 +191,10 @@ namespace ZetaRay::Scene
         {
             return m_matBuffer.Get(ID, bufferIdx);
         }
+        ZetaInline Util::Optional<const Material*> GetMaterial(MaterialHandle h, uint32_t* bufferIdx = nullptr) const
+        {
+            return m_matBuffer.Get(h, bufferIdx);
+        }
         void UpdateMaterial(uint32 ID, const Material& newMat);
         void ResizeAdditionalMaterials(uint32_t num);
         ZetaInline void AddTextureHeap(Core::GpuMemory::ResourceHeap&& heap) { m_textureHeaps.push_back(ZetaForward(heap)); }
@@ -172,19 +208,44 @@ namespace ZetaRay::Scene
         // Instance
         //
         void AddInstance(Model::glTF::Asset::InstanceDesc& instance, bool lock = true);
+        // Same as calling AddInstance() for every instance in order, but each affected tree 
+        // level is rebuilt only once. Parent of every instance must either come before it in 
+        // the batch or already be in the scene. Depth-first order (as in glTF::Cache::SceneData)
+        // is the fastest; other orders fall back to a hash table lookup for parents that are in 
+        // the batch.
+        void AddInstances(Util::Span<Model::glTF::Asset::InstanceDesc> instances, bool lock = true);
         ZetaInline Util::Optional<const Math::float4x3*> GetPrevToWorld(uint64_t id) const
         {
-            auto it = m_prevToWorlds.find(id);
-            if (it)
-                return it.value();
+            auto h = m_IDtoHandle.find(id);
+            if (h)
+                return &GetPrevToWorld(*h.value());
 
             return {};
         }
+        ZetaInline const Math::float4x3& GetPrevToWorld(InstanceHandle h) const
+        {
+            const TreePos& p = m_instances[h];
+            return m_sceneGraph[p.Level].m_prevToWorlds[p.Offset];
+        }
+        // Returns an invalid handle if there's no instance with the given ID
+        ZetaInline InstanceHandle GetInstanceHandle(uint64_t id) const
+        {
+            auto h = m_IDtoHandle.find(id);
+            if (h)
+                return *h.value();
+
+            return InstanceHandle();
+        }
         ZetaInline const Math::float4x3& GetToWorld(uint64_t id) const
         {
             const TreePos& p = FindTreePosFromID(id).value();
             return m_sceneGraph[p.Level].m_toWorlds[p.Offset];
         }
+        ZetaInline const Math::float4x3& GetToWorld(InstanceHandle h) const
+        {
+            const TreePos& p = m_instances[h];
+            return m_sceneGraph[p.Level].m_toWorlds[p.Offset];
+        }
         ZetaInline Math::AffineTransformation GetLocalTransform(uint64_t id) const
         {
             auto it = m_worldTransformUpdates.find(id);
@@ -209,6 +270,11 @@ namespace ZetaRay::Scene
             const TreePos& p = FindTreePosFromID(id).value();
             return m_sceneGraph[p.Level].m_rtASInfo[p.Offset];
         }
+        ZetaInline RT_AS_Info GetInstanceRtASInfo(InstanceHandle h) const
+        {
+            const TreePos& p = m_instances[h];
+            return m_sceneGraph[p.Level].m_rtASInfo[p.Offset];
+        }
         ZetaInline RT_Flags GetInstanceRtFlags(uint64_t id) const
         {
             const TreePos& p = FindTreePosFromID(id).value();
@@ -225,13 +291,20 @@ namespace ZetaRay::Scene
         //
         // Emissive
         //
-        void AddEmissives(Util::SmallVector<Model::glTF::Asset::EmissiveInstance>&& emissiveInstances,
-            Util::SmallVector<RT::EmissiveTriangle>&& emissiveTris, bool lock);
+        void AddEmissives(Util::Span<Model::glTF::Asset::EmissiveInstance> emissiveInstances,
+            Util::Span<RT::EmissiveTriangle> emissiveTris, bool lock);
         ZetaInline bool EmissiveLighting() const { return !m_ignoreEmissives && (m_emissives.NumInstances() > 0); }
         ZetaInline size_t NumEmissiveInstances() const { return m_emissives.NumInstances(); }
         ZetaInline size_t NumEmissiveTriangles() const { return m_emissives.NumTriangles(); }
         ZetaInline bool AreEmissivePositionsStale() const { return m_staleEmissivePositions; }
+        // True when emissive power needs to be re-estimated -- materials were modified or 
+        // emissive instances were scaled
         ZetaInline bool AreEmissiveMaterialsStale() const { return m_staleEmissiveMats; }
+        // When emissive materials are stale, range of emissive triangles whose power has changed
+        ZetaInline uint32_t StaleEmissiveTriBaseOffset() const { return m_staleEmissiveTriBaseOffset; }
+        ZetaInline uint32_t NumStaleEmissiveTriangles() const { return m_numStaleEmissiveTris; }
+        // Sorted by base triangle offset, triangles of each instance are contiguous
+        ZetaInline Util::Span<Model::glTF::Asset::EmissiveInstance> EmissiveInstances() { return m_emissives.Instances(); }
         void UpdateEmissiveMaterial(uint64_t instanceID, const Math::float3& emissiveFactor, float strength);
         void ToggleEmissivesCallback(const Support::ParamVariant& p);
 
@@ -247,7 +320,7 @@ namespace ZetaRay::Scene
         //
         //ZetaInline Math::AABB GetWorldAABB() { return m_bvh.GetWorldAABB(); }
         ZetaInline uint32_t TotalNumTriangles() const { return m_numTriangles; }
-        ZetaInline uint32_t TotalNumInstances() const { return (uint32_t)m_IDtoTreePos.size(); }
+        ZetaInline uint32_t TotalNumInstances() const { return (uint32_t)m_instances.size(); }
         ZetaInline uint32_t TotalNumMeshes() const { return m_meshes.NumMeshes(); }
         ZetaInline uint32_t TotalNumMaterials() const { return m_matBuffer.NumMaterials(); }
         ZetaInline uint32_t NumOpaqueInstances() const { return m_numOpaqueInstances; }
@@ -289,10 +362,11 @@ namespace ZetaRay::Scene
             uint32_t Offset;
         };
 
-        struct AnimationUpdate
+        struct InstanceUpdate
         {
-            Math::AffineTransformation M;
-            uint64_t InstanceID;
+            InstanceHandle Handle;
+            // Frame number when the update was made
+            uint64_t Frame;
         };
 
         struct Range
@@ -310,55 +384,60 @@ namespace ZetaRay::Scene
         struct TreeLevel
         {
             Util::SmallVector<uint64_t> m_IDs;
+            Util::SmallVector<InstanceHandle> m_handles;
             Util::SmallVector<Math::AffineTransformation> m_localTransforms;
             Util::SmallVector<Math::float4x3> m_toWorlds;
+            // Previous frame's world transformation
+            Util::SmallVector<Math::float4x3> m_prevToWorlds;
             Util::SmallVector<uint64_t> m_meshIDs;
+            // Invalid until resolved by ResolveHandles(), as instances may be added before
+            // their meshes
+            Util::SmallVector<MeshHandle> m_meshHandles;
             Util::SmallVector<Range> m_subtreeRanges;
+            // Offset of parent in the previous level
+            Util::SmallVector<uint32_t> m_parents;
             Util::SmallVector<uint8_t> m_rtFlags;
             // (Also) filled in by TLAS::RebuildTLASInstances()
             Util::SmallVector<RT_AS_Info> m_rtASInfo;
         };
 
-        // Offset into "m_keyframes" array
-        struct AnimationMetadata
-        {
-            uint64_t InstanceID;
-            uint32_t StartOffset;
-            uint32_t Length;
-            float T0;
-            bool Loop;
-        };
-
         ZetaInline Util::Optional<TreePos> FindTreePosFromID(uint64_t id) const
         {
-            auto pos = m_IDtoTreePos.find(id);
-            if (pos)
-                return *pos.value();
+            auto h = m_IDtoHandle.find(id);
+            if (h)
+                return m_instances[*h.value()];
 
             return {};
         }
 
-        uint32_t InsertAtLevel(uint64_t id, uint32_t treeLevel, uint32_t parentIdx, 
+        uint32_t InsertAtLevel(uint64_t id, InstanceHandle handle, uint32_t treeLevel, uint32_t parentIdx, 
             Math::AffineTransformation& localTransform, uint64_t meshID, 
             Model::RT_MESH_MODE rtMeshMode, uint8_t rtInstanceMask, bool isOpaque);
         void ResetRtAsInfos();
+        void ResolveHandles();
         void InitWorldTransformations();
-        void UpdateWorldTransformations(Util::Vector<Math::BVH::BVHUpdateInput, 
-            App::FrameAllocator>& toUpdateInstances);
+        void UpdateWorldTransformations(Util::MutableSpan<TreePos> animated,
+            Util::Vector<Math::BVH::BVHUpdateInput, App::FrameAllocator>& toUpdateInstances);
+        // Recomputes world transformation of every descendant of dirty roots and every 
+        // animated instance (along with its descendants), one tree level at a time
+        void PropagateWorldTransformations(Util::MutableSpan<TreePos> dirtyRoots, 
+            Util::MutableSpan<TreePos> animated);
         void UpdateEmissivePositions();
         void RebuildBVH();
-        void UpdateAnimations(float t, Util::Vector<AnimationUpdate, App::FrameAllocator>& animVec);
-        void UpdateLocalTransforms(Util::Span<AnimationUpdate> animVec);
+        // Evaluates every animation at time t and writes the results to local transformation
+        // of animated instances. Their tree positions are returned in "animated".
+        void UpdateAnimations(float t, Util::Vector<TreePos, App::FrameAllocator>& animated);
         bool ConvertInstanceDynamic(uint64_t instanceID, const TreePos& treePos, RT_Flags rtFlags);
         void ConvertSubtreeDynamic(uint32_t treeLevel, Range r);
 
-        // Maps instance ID to tree position
-        Util::HashTable<TreePos> m_IDtoTreePos;
+        // Maps instance ID to instance handle. Unlike tree positions, handles don't change
+        // when other instances are added.
+        Util::FlatHashTable<InstanceHandle> m_IDtoHandle;
+        // Maps instance handle to tree position
+        Util::SlotMap<TreePos> m_instances;
         // Maps RT mesh index to instance ID -- filled in by TLAS::BuildFrameMeshInstanceData()
         Util::SmallVector<uint64> m_rtMeshInstanceIdxToID;
         Util::SmallVector<TreeLevel, Support::SystemAllocator, 3> m_sceneGraph;
-        // Previous frame's world transformation
-        Util::HashTable<Math::float4x3> m_prevToWorlds;
         Util::SmallVector<uint64, Support::SystemAllocator, 4> m_pickedInstances;
         bool m_multiPick = false;
         bool m_isPaused = false;
@@ -372,8 +451,11 @@ namespace ZetaRay::Scene
         uint32_t m_numNonOpaqueInstances = 0;
         uint32_t m_numTriangles = 0;
         bool m_meshBufferStale = false;
+        // Set when instances, meshes or materials are added, as handles can only be resolved
+        // once both sides are in the scene
+        std::atomic_bool m_staleHandles = false;
         Util::SmallVector<uint64_t, Support::SystemAllocator, 3> m_pendingRtMeshModeSwitch;
-        Util::HashTable<uint64_t> m_instanceUpdates;
+        Util::HashTable<InstanceUpdate> m_instanceUpdates;
         
         struct TransformUpdate
         {
@@ -407,6 +489,8 @@ namespace ZetaRay::Scene
         //
         Internal::EmissiveBuffer m_emissives;
         Util::SmallVector<uint64_t, App::FrameAllocator> m_toUpdateEmissives;
+        uint32_t m_staleEmissiveTriBaseOffset = 0;
+        uint32_t m_numStaleEmissiveTris = 0;
         bool m_staleEmissiveMats = false;
         bool m_staleEmissivePositions = false;
         bool m_ignoreEmissives = false;
@@ -420,8 +504,10 @@ namespace ZetaRay::Scene
         //
         // Animation
         //
-        Util::SmallVector<AnimationMetadata> m_animationMetadata;
-        Util::SmallVector<Keyframe> m_keyframes;
+        Internal::AnimationTracks m_animations;
+        // Animated instance of each track
+        Util::SmallVector<InstanceHandle> m_animatedInstances;
+        bool m_hasEmissiveAnimations = false;
         bool m_animate = true;
 
         //
@@ -1,32 +1,67 @@
 #include "MemoryArena.h"
+#include "../App/Common.h"
 
 using namespace ZetaRay::Support;
 using namespace ZetaRay::Math;
+using namespace ZetaRay::App;
+
+namespace
+{
+    ZetaInline size_t PageSize()
+    {
+        static const size_t pageSize = Common::GetPageSize();
+        return pageSize;
+    }
+}
 
 //--------------------------------------------------------------------------------------
 // MemoryArena
 //--------------------------------------------------------------------------------------
 
-MemoryArena::MemoryArena(size_t blockSize)
-    : m_blockSize(blockSize)
+MemoryArena::MemoryArena(size_t blockSize, size_t reserveSize)
+    : m_blockSize(AlignUp(Max(blockSize, (size_t)1), PageSize())),
+    m_reserveSize(AlignUp(Max(reserveSize, m_blockSize), m_blockSize))
 {}
 
+MemoryArena::~MemoryArena()
+{
+    Release();
+}
+
 MemoryArena::MemoryArena(MemoryArena&& other)
-    : m_blockSize(other.m_blockSize)
+    : m_blockSize(other.m_blockSize),
+    m_reserveSize(other.m_reserveSize),
+    m_base(other.m_base),
+    m_offset(other.m_offset),
+    m_committed(other.m_committed)
 {
-    m_blocks.swap(other.m_blocks);
+    m_largeAllocs.swap(other.m_largeAllocs);
+
+    other.m_base = nullptr;
+    other.m_offset = 0;
+    other.m_committed = 0;
 
 #ifndef NDEBUG
     m_numAllocs = other.m_numAllocs;
+    other.m_numAllocs = 0;
 #endif
 }
 
 MemoryArena& MemoryArena::operator=(MemoryArena&& other)
 {
-    Check(m_blockSize == other.m_blockSize, "These MemoryArenas are incompatible.");
+    Check(m_blockSize == other.m_blockSize && m_reserveSize == other.m_reserveSize, 
+        "These MemoryArenas are incompatible.");
 
-    m_blocks.swap(other.m_blocks);
-    other.m_blocks.free_memory();
+    Release();
+
+    m_base = other.m_base;
+    m_offset = other.m_offset;
+    m_committed = other.m_committed;
+    m_largeAllocs.swap(other.m_largeAllocs);
+
+    other.m_base = nullptr;
+    other.m_offset = 0;
+    other.m_committed = 0;
 
 #ifndef NDEBUG
     m_numAllocs = other.m_numAllocs;
@@ -36,64 +71,106 @@ MemoryArena& MemoryArena::operator=(MemoryArena&& other)
     return *this;
 }
 
-void* MemoryArena::AllocateAligned(size_t size, size_t alignment)
+void MemoryArena::Commit(size_t end)
 {
-    for (auto& block : m_blocks)
-    {
-        const uintptr_t start = reinterpret_cast<uintptr_t>(block.Start);
-        const uintptr_t ret = AlignUp(start + block.Offset, alignment);
-        const uintptr_t startOffset = ret - start;
+    Assert(end <= m_reserveSize, "Out-of-bounds commit.");
+    const size_t newCommitted = Min(AlignUp(end, m_blockSize), m_reserveSize);
 
-        if (startOffset + size < block.Size)
-        {
-            block.Offset = startOffset + size;
+    Common::CommitVirtualMemory(m_base + m_committed, newCommitted - m_committed);
+    m_committed = newCommitted;
+}
 
+void* MemoryArena::AllocateLarge(size_t size, size_t alignment)
+{
+    // Reserved regions are at least page-aligned, extra space is only needed for larger 
+    // alignments
+    const size_t pageSize = PageSize();
+    const size_t allocSize = AlignUp(size + (alignment > pageSize ? alignment : 0), pageSize);
+
+    void* mem = Common::ReserveVirtualMemory(allocSize);
+    Common::CommitVirtualMemory(mem, allocSize);
+    m_largeAllocs.push_back(LargeAllocation{ .Mem = mem, .Size = allocSize });
+
+    return reinterpret_cast<void*>(AlignUp(reinterpret_cast<uintptr_t>(mem), alignment));
+}
+
+void* MemoryArena::AllocateAligned(size_t size, size_t alignment)
+{
 #ifndef NDEBUG
-            m_numAllocs++;
+    m_numAllocs++;
 #endif
 
-            return reinterpret_cast<void*>(ret);
-        }
-    }
+    // Large allocations would leave committed memory behind after a rewind, give them 
+    // their own allocation instead
+    if (size >= LARGE_ALLOC_SIZE)
+        return AllocateLarge(size, alignment);
 
-    size_t blockSize = Max(m_blockSize, size);
+    if (!m_base)
+        m_base = reinterpret_cast<uint8_t*>(Common::ReserveVirtualMemory(m_reserveSize));
 
-    // Memory allocationss are 16-byte aligned by default -- for larger alignments, at
-    // most alignment - 1 extra bytes are required
-    if (alignment > 16)
-        blockSize = AlignUp(blockSize + alignment - 1, alignment);
+    const uintptr_t start = reinterpret_cast<uintptr_t>(m_base);
+    const uintptr_t ret = AlignUp(start + m_offset, alignment);
+    const size_t end = (ret - start) + size;
 
-    MemoryBlock memBlock(blockSize);
+    [[unlikely]]
+    if (end > m_reserveSize)
+        return AllocateLarge(size, alignment);
 
-    const uintptr_t ret = AlignUp(reinterpret_cast<uintptr_t>(memBlock.Start), 
-        alignment);
-    memBlock.Offset = ret - reinterpret_cast<uintptr_t>(memBlock.Start);
-    memBlock.Offset += size;
-    Assert(memBlock.Offset <= memBlock.Size, "Offset must be <= size.");
+    if (end > m_committed)
+        Commit(end);
 
-    // Push the newly added block to the front, so it's searched before others 
-    // for future allocations
-    m_blocks.push_front(ZetaMove(memBlock));
+    m_offset = end;
 
     return reinterpret_cast<void*>(ret);
 }
 
 size_t MemoryArena::TotalSize() const
 {
-    size_t sum = 0;
+    size_t sum = m_committed;
 
-    for (auto& block : m_blocks)
-        sum += block.Size;
+    for (auto& alloc : m_largeAllocs)
+        sum += alloc.Size;
 
     return sum;
 }
 
+void MemoryArena::RewindTo(Marker marker)
+{
+    Assert(marker.Offset <= m_offset && marker.NumLargeAllocs <= m_largeAllocs.size(), 
+        "Marker is newer than the current state of the arena.");
+
+    while (m_largeAllocs.size() > marker.NumLargeAllocs)
+    {
+        Common::ReleaseVirtualMemory(m_largeAllocs.back().Mem);
+        m_largeAllocs.pop_back();
+    }
+
+    m_offset = marker.Offset;
+}
+
 void MemoryArena::Reset()
 {
-    while (m_blocks.size() > 1)
-        m_blocks.pop_back();
+    RewindTo(Marker{ .Offset = 0, .NumLargeAllocs = 0 });
 
-    if (!m_blocks.empty())
-        m_blocks[0].Offset = 0;
+    // Keep the first block committed as it's likely to be used again
+    if (m_committed > m_blockSize)
+    {
+        Common::DecommitVirtualMemory(m_base + m_blockSize, m_committed - m_blockSize);
+        m_committed = m_blockSize;
+    }
 }
 
+void MemoryArena::Release()
+{
+    for (auto& alloc : m_largeAllocs)
+        Common::ReleaseVirtualMemory(alloc.Mem);
+
+    m_largeAllocs.free_memory();
+
+    if (m_base)
+        Common::ReleaseVirtualMemory(m_base);
+
+    m_base = nullptr;
+    m_offset = 0;
+    m_committed = 0;
+}
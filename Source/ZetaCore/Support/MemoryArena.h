@@ -4,72 +4,90 @@
 
 namespace ZetaRay::Support
 {
+    // Linear allocator backed by a contiguous range of reserved virtual memory. Pages are 
+    // committed on demand as the arena grows, so that only the used portion is backed by 
+    // physical memory. Since the range never moves, pointers remain stable.
+    //  - Allocations that are larger than LARGE_ALLOC_SIZE (or don't fit in the reserved 
+    //    range) get their own dedicated virtual memory allocation.
+    //  - GetMarker() and RewindTo() can be used to roll back all the allocations that were 
+    //    made after a certain point.
+    //  - Reset() rewinds to the beginning and returns all committed pages except for the 
+    //    first block to the OS.
     class MemoryArena
     {
     public:
-        explicit MemoryArena(size_t blockSize = 64 * 1024);
-        ~MemoryArena() = default;
+        static constexpr size_t DEFAULT_RESERVE_SIZE = 1024 * 1024 * 1024;
+        static constexpr size_t LARGE_ALLOC_SIZE = 1024 * 1024;
+
+        struct Marker
+        {
+            size_t Offset;
+            uint32_t NumLargeAllocs;
+        };
+
+        // blockSize is the granularity that pages are committed at. Address space is 
+        // reserved lazily on the first allocation.
+        explicit MemoryArena(size_t blockSize = 64 * 1024, 
+            size_t reserveSize = DEFAULT_RESERVE_SIZE);
+        ~MemoryArena();
         MemoryArena(MemoryArena&&);
         MemoryArena& operator=(MemoryArena&&);
 
         void* AllocateAligned(size_t size, size_t alignment = alignof(std::max_align_t));
         void FreeAligned(void* pMem, size_t size, size_t alignment = alignof(std::max_align_t)) {};
+        // Total amount of committed memory
         size_t TotalSize() const;
+        ZetaInline Marker GetMarker() const
+        {
+            return Marker{ .Offset = m_offset, .NumLargeAllocs = (uint32_t)m_largeAllocs.size() };
+        }
+        // Frees every allocation that was made after the given marker was taken. Committed 
+        // pages are kept around for reuse.
+        void RewindTo(Marker marker);
         void Reset();
 
     private:
-        struct MemoryBlock
+        struct LargeAllocation
         {
-            MemoryBlock() = default;
-            explicit MemoryBlock(size_t size)
-                : Size(size),
-                Offset(0)
-            {
-                Start = malloc(size);
-            }
-            ~MemoryBlock()
-            {
-                if (Start)
-                    free(Start);
-
-                Start = nullptr;
-                Offset = 0;
-                Size = 0;
-            }
-            MemoryBlock(MemoryBlock&& rhs)
-                : Start(rhs.Start),
-                Size(rhs.Size),
-                Offset(rhs.Offset)
-            {
-                rhs.Start = nullptr;
-                rhs.Offset = 0;
-                rhs.Size = 0;
-            }
-            MemoryBlock& operator=(MemoryBlock&& rhs)
-            {
-                Start = rhs.Start;
-                Size = rhs.Size;
-                Offset = rhs.Offset;
-
-                rhs.Start = nullptr;
-                rhs.Size = 0;
-                rhs.Offset = 0;
-
-                return *this;
-            }
-
-            void* Start;
+            void* Mem;
             size_t Size;
-            uintptr_t Offset;
         };
 
+        void Commit(size_t end);
+        void* AllocateLarge(size_t size, size_t alignment);
+        void Release();
+
         const size_t m_blockSize;
-        Util::SmallVector<MemoryBlock, SystemAllocator, 8> m_blocks;
+        const size_t m_reserveSize;
+        uint8_t* m_base = nullptr;
+        size_t m_offset = 0;
+        size_t m_committed = 0;
+        Util::SmallVector<LargeAllocation, SystemAllocator> m_largeAllocs;
 #ifndef NDEBUG
         uint32_t m_numAllocs = 0;
 #endif
     };
 
+    // Rewinds the given arena to its current position when going out of scope
+    struct ScopedArenaMarker
+    {
+        explicit ScopedArenaMarker(MemoryArena& ma)
+            : m_arena(ma),
+            m_marker(ma.GetMarker())
+        {}
+        ~ScopedArenaMarker()
+        {
+            m_arena.RewindTo(m_marker);
+        }
+
+        ScopedArenaMarker(const ScopedArenaMarker&) = delete;
+        ScopedArenaMarker& operator=(const ScopedArenaMarker&) = delete;
+
+    private:
+        MemoryArena& m_arena;
+        const MemoryArena::Marker m_marker;
+    };
+
     struct ArenaAllocator
     {
         ArenaAllocator(MemoryArena& ma)
@@ -44,9 +44,12 @@ namespace ZetaRay::Support
 
         void MoveTo(MemoryPool& mp);
 
-    private:
-        void* Allocate(size_t size);
-        void Free(void* pMem, size_t size);
+        // Size classes are shared with ThreadCachingPool
+        static constexpr size_t BLOCK_SIZE = 4096;                    
+        static constexpr size_t MAX_ALLOC_SIZE = BLOCK_SIZE;        // Allocation up to 4 kb supported    
+        static constexpr size_t POOL_COUNT = 10;                    // Number of pools == log_2 (4096) - log_2 (8) + 1
+        static constexpr size_t INDEX_SHIFT = 3;                    // First block starts at 8 bytes (log_2(sizeof(void *))
+        static constexpr size_t MIN_ALLOC_SIZE = 1 << INDEX_SHIFT;        
 
         // Given x, returns:
         //        0    -> 8 bytes allocator    when 0 < x <= 8
@@ -54,26 +57,24 @@ namespace ZetaRay::Support
         //        2    -> 32 bytes allocator    when 16 < x <= 32
         //        3    -> 64 bytes allocator    when 32 < x <= 64
         //            ...
-        size_t GetPoolIndexFromSize(size_t x);
+        static size_t GetPoolIndexFromSize(size_t x);
 
         // Chunk size for given pool index
-        ZetaInline size_t GetChunkSizeFromPoolIndex(size_t x) const
+        static ZetaInline size_t GetChunkSizeFromPoolIndex(size_t x)
         {
             return 1llu << (x + INDEX_SHIFT);
         }
 
+    private:
+        void* Allocate(size_t size);
+        void Free(void* pMem, size_t size);
+
         // Allocates a new memory block and turns it into a linked list
         void* AllocateNewBlock(size_t chunkSize);
 
         // Adds a new memory block
         void Grow(size_t poolIndex);
 
-        static constexpr size_t BLOCK_SIZE = 4096;                    
-        static constexpr size_t MAX_ALLOC_SIZE = BLOCK_SIZE;        // Allocation up to 4 kb supported    
-        static constexpr size_t POOL_COUNT = 10;                    // Number of pools == log_2 (4096) - log_2 (8) + 1
-        static constexpr size_t INDEX_SHIFT = 3;                    // First block starts at 8 bytes (log_2(sizeof(void *))
-        static constexpr size_t MIN_ALLOC_SIZE = 1 << INDEX_SHIFT;        
-
         // Holds the pointer to head of memory blocks allocated for each pool size
         void** m_pools[POOL_COUNT] = { nullptr };
 
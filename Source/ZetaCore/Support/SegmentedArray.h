@@ -0,0 +1,86 @@
+#pragma once
+
+#include "../Utility/Error.h"
+#include <atomic>
+#include <bit>
+
+namespace ZetaRay::Support
+{
+    // Unbounded array with stable element addresses. Storage is split into segments where
+    // segment i holds FIRST_SEGMENT_SIZE * 2^i elements, so that mapping an index to its
+    // segment is a bit scan and growing never moves existing elements. Segments are
+    // allocated on first access and kept until Free() is called. GetOrAlloc() can be called
+    // concurrently from multiple threads.
+    template<typename T, uint32_t FIRST_SEGMENT_SIZE = 256>
+    struct SegmentedArray
+    {
+        static_assert(std::has_single_bit(FIRST_SEGMENT_SIZE), "Segment size must be a power of two.");
+
+        SegmentedArray() = default;
+        ~SegmentedArray() { Free(); }
+
+        SegmentedArray(const SegmentedArray&) = delete;
+        SegmentedArray& operator=(const SegmentedArray&) = delete;
+
+        // Returns the element at index idx, allocating its segment if needed
+        T& GetOrAlloc(uint32_t idx)
+        {
+            uint32_t offset;
+            const uint32_t seg = SegmentIndex(idx, offset);
+            T* segment = m_segments[seg].load(std::memory_order_acquire);
+
+            if (!segment)
+            {
+                T* newSegment = new T[(size_t)FIRST_SEGMENT_SIZE << seg];
+
+                // Another thread might have allocated the same segment in the meantime
+                if (m_segments[seg].compare_exchange_strong(segment, newSegment,
+                    std::memory_order_acq_rel, std::memory_order_acquire))
+                {
+                    segment = newSegment;
+                }
+                else
+                    delete[] newSegment;
+            }
+
+            return segment[offset];
+        }
+
+        // Segment containing idx must have been allocated by a prior call to GetOrAlloc()
+        T& operator[](uint32_t idx)
+        {
+            uint32_t offset;
+            const uint32_t seg = SegmentIndex(idx, offset);
+            T* segment = m_segments[seg].load(std::memory_order_acquire);
+            Assert(segment, "Segment for index %u hasn't been allocated.", idx);
+
+            return segment[offset];
+        }
+
+        // Not thread safe
+        void Free()
+        {
+            for (auto& s : m_segments)
+            {
+                delete[] s.load(std::memory_order_relaxed);
+                s.store(nullptr, std::memory_order_relaxed);
+            }
+        }
+
+    private:
+        static constexpr uint32_t LOG2_FIRST_SEGMENT_SIZE = std::countr_zero(FIRST_SEGMENT_SIZE);
+        static constexpr uint32_t NUM_SEGMENTS = 33 - LOG2_FIRST_SEGMENT_SIZE;
+
+        static ZetaInline uint32_t SegmentIndex(uint32_t idx, uint32_t& offset)
+        {
+            // Segment i covers [FIRST * (2^i - 1), FIRST * (2^(i + 1) - 1))
+            const uint64_t biased = (uint64_t)idx + FIRST_SEGMENT_SIZE;
+            const uint32_t seg = (uint32_t)std::bit_width(biased) - 1 - LOG2_FIRST_SEGMENT_SIZE;
+            offset = (uint32_t)(biased - ((uint64_t)FIRST_SEGMENT_SIZE << seg));
+
+            return seg;
+        }
+
+        std::atomic<T*> m_segments[NUM_SEGMENTS] = {};
+    };
+}
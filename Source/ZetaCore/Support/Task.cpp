@@ -1,6 +1,5 @@
 #include "Task.h"
 #include "../App/Timer.h"
-#include <intrin.h>
 
 using namespace ZetaRay::Support;
 using namespace ZetaRay::Util;
@@ -69,51 +68,50 @@ void Task::Reset(const char* name, TASK_PRIORITY priority, Function&& f)
 
 void TaskSet::AddOutgoingEdge(TaskHandle a, TaskHandle b)
 {
-    Assert(a < m_currSize && b < m_currSize, "Invalid task handles.");
-    TaskMetadata& ta = m_taskMetadata[a];
-    TaskMetadata& tb = m_taskMetadata[b];
+    Assert(!m_isSorted, "Adding edges to a sorted TaskSet is not allowed.");
+    Assert(a < (int)m_tasks.size() && b < (int)m_tasks.size(), "Invalid task handles.");
+    Assert(a != b, "Self edges are not allowed.");
 
-    bool prev1 = _bittestandset((long*)&ta.SuccessorMask, b);
-    Assert(!prev1, "Redundant call, edge already exists.");
-
-    bool prev2 = _bittestandset((long*)&tb.PredecessorMask, a);
-    Assert(!prev2, "Redundant call, edge already exists.");
+#ifndef NDEBUG
+    for (auto& e : m_edges)
+        Assert(e.From != a || e.To != b, "Redundant call, edge already exists.");
+#endif
 
+    m_edges.push_back(Edge{ .From = a, .To = b });
     m_tasks[a].m_adjacentTailNodes.push_back(m_tasks[b].m_signalHandle);
 }
 
 void TaskSet::AddOutgoingEdgeToAll(TaskHandle a)
 {
-    Assert(a < m_currSize, "Invalid task handle.");
-    TaskMetadata& ta = m_taskMetadata[a];
+    Assert(!m_isSorted, "Adding edges to a sorted TaskSet is not allowed.");
+    Assert(a < (int)m_tasks.size(), "Invalid task handle.");
+
+    m_edges.reserve(m_edges.size() + m_tasks.size() - 1);
+    m_tasks[a].m_adjacentTailNodes.reserve(m_tasks[a].m_adjacentTailNodes.size() + m_tasks.size() - 1);
 
-    for (int b = 0; b < m_currSize; b++)
+    for (int b = 0; b < (int)m_tasks.size(); b++)
     {
         if (b == a)
             continue;
 
-        TaskMetadata& tb = m_taskMetadata[b];
-        ta.SuccessorMask |= (1 << b);
-        tb.PredecessorMask |= (1 << a);
-
+        m_edges.push_back(Edge{ .From = a, .To = b });
         m_tasks[a].m_adjacentTailNodes.push_back(m_tasks[b].m_signalHandle);
     }
 }
 
 void TaskSet::AddIncomingEdgeFromAll(TaskHandle a)
 {
-    Assert(a < m_currSize, "Invalid task handle.");
-    TaskMetadata& ta = m_taskMetadata[a];
+    Assert(!m_isSorted, "Adding edges to a sorted TaskSet is not allowed.");
+    Assert(a < (int)m_tasks.size(), "Invalid task handle.");
+
+    m_edges.reserve(m_edges.size() + m_tasks.size() - 1);
 
-    for (int b = 0; b < m_currSize; b++)
+    for (int b = 0; b < (int)m_tasks.size(); b++)
     {
         if (b == a)
             continue;
 
-        TaskMetadata& tb = m_taskMetadata[b];
-        ta.PredecessorMask |= (1 << b);
-        tb.SuccessorMask |= (1 << a);
-
+        m_edges.push_back(Edge{ .From = b, .To = a });
         m_tasks[b].m_adjacentTailNodes.push_back(m_tasks[a].m_signalHandle);
     }
 }
@@ -122,7 +120,6 @@ void TaskSet::Sort()
 {
     Assert(!m_isSorted, "TaskSet is already sorted.");
     TopologicalSort();
-    ComputeInOutMask();
 
     m_isSorted = true;
 }
@@ -131,9 +128,9 @@ void TaskSet::Finalize(WaitObject* waitObj)
 {
     Assert(!m_isFinalized && m_isSorted, "Finalize() shouldn't be called when TaskSet hasn't been sorted.");
 
-    for (int i = 0; i < m_currSize; i++)
+    for (int i = 0; i < (int)m_tasks.size(); i++)
     {
-        const int indegree = m_taskMetadata[i].Indegree();
+        const int indegree = m_indegrees[i];
 
         // Dependencies between TaskSets can't be detected by indegree as those only
         // for dependencies inside the TaskSet
@@ -153,177 +150,156 @@ void TaskSet::Finalize(WaitObject* waitObj)
 
     if (waitObj)
     {
-        Assert(m_currSize < MAX_NUM_TASKS, "Out of space for new tasks in this TaskSet.");
-        m_tasks[m_currSize++].Reset("NotifyCompletion", m_tasks[0].m_priority, [waitObj]()
+        Assert(!m_tasks.empty(), "TaskSet is empty.");
+        // emplace_back() may reallocate before constructing from its arguments, so the 
+        // priority must not be passed as a reference into m_tasks
+        const TASK_PRIORITY p = m_tasks[0].m_priority;
+        m_tasks.emplace_back("NotifyCompletion", p, [waitObj]()
             {
                 waitObj->Notify();
             });
 
-        // ConnectTo(m_tasks[m_currSize]);
-        Task& notifyTask = m_tasks[m_currSize - 1];
-        uint64_t mask = m_leafMask;
-        notifyTask.m_indegree += __popcnt((uint32_t)mask);
+        Task& notifyTask = m_tasks.back();
+        notifyTask.m_indegree += (int)m_leaves.size();
 
-        unsigned long idx;
-        while (_BitScanForward64(&idx, mask))
+        for (auto idx : m_leaves)
         {
-            Assert(idx < m_currSize, "Bug");
+            Assert(idx < (int)m_tasks.size() - 1, "Bug");
             m_tasks[idx].m_adjacentTailNodes.push_back(notifyTask.m_signalHandle);
-
-            mask &= ~(1llu << idx);
         }
 
         App::TaskFinalizedCallback(notifyTask.m_signalHandle, notifyTask.m_indegree);
     }
 }
 
-void TaskSet::ComputeInOutMask()
-{
-    for (int i = 0; i < m_currSize; ++i)
-    {
-        if (m_taskMetadata[i].Indegree() == 0)
-            m_rootMask |= (1llu << i);
-
-        if (m_taskMetadata[i].Outdegree() == 0)
-            m_leafMask |= (1llu << i);
-    }
-}
-
 void TaskSet::TopologicalSort()
 {
-    // Find the root nodes
-    uint32_t rootMask = 0;
+    const int n = (int)m_tasks.size();
 
-    for (int i = 0; i < m_currSize; ++i)
+    // Convert the edge list into an adjacency array (compressed sparse row), O(V + E)
+    SmallVector<int, App::FrameAllocator, NUM_INLINE_TASKS + 1> offsets;
+    offsets.resize(n + 1, 0);
+    SmallVector<int, App::FrameAllocator, NUM_INLINE_TASKS> tempIndegree;
+    tempIndegree.resize(n, 0);
+
+    for (auto& e : m_edges)
     {
-        if (m_taskMetadata[i].Indegree() == 0)
-            rootMask |= (1llu << i);
+        offsets[e.From + 1]++;
+        tempIndegree[e.To]++;
     }
 
-    // In each iteration, points to remaining elements that have an indegree of zero
-    uint32_t currMask = rootMask;
-    size_t currIdx = 0;
-    int sorted[MAX_NUM_TASKS];
+    for (int i = 0; i < n; i++)
+        offsets[i + 1] += offsets[i];
 
-    // Make a temporary copy for the duration of topological sorting
-    int tempIndegree[MAX_NUM_TASKS];
-    for (int i = 0; i < m_currSize; i++)
-        tempIndegree[i] = m_taskMetadata[i].Indegree();
+    SmallVector<int, App::FrameAllocator, NUM_INLINE_TASKS * 2> successors;
+    successors.resize(m_edges.size());
 
-    // Find all nodes with zero indegree
-    unsigned long zeroIndegreeIdx;
-    while (_BitScanForward64(&zeroIndegreeIdx, currMask))
     {
-        Assert(zeroIndegreeIdx < m_currSize, "Invalid index.");
-        TaskMetadata& t = m_taskMetadata[zeroIndegreeIdx];
-        uint32_t tails = t.SuccessorMask;
-        unsigned long tailIdx;
+        SmallVector<int, App::FrameAllocator, NUM_INLINE_TASKS> cursor;
+        cursor.resize(n);
+        memcpy(cursor.data(), offsets.data(), n * sizeof(int));
 
-        // For every tail-adjacent node
-        while (_BitScanForward64(&tailIdx, tails))
-        {
-            Assert(tailIdx < m_currSize, "Invalid index.");
+        for (auto& e : m_edges)
+            successors[cursor[e.From]++] = e.To;
+    }
 
-            // Remove one edge
-            tempIndegree[tailIdx] -= 1;
+    // Save indegrees before they're consumed below
+    SmallVector<int, App::FrameAllocator, NUM_INLINE_TASKS> indegrees = tempIndegree;
 
-            // If tail node's indegree has become 0, add it to mask
-            if (tempIndegree[tailIdx] == 0)
-                currMask |= (1 << tailIdx);
+    // Kahn's algorithm -- "sorted" doubles as the queue of nodes with zero indegree
+    SmallVector<int, App::FrameAllocator, NUM_INLINE_TASKS> sorted;
+    sorted.resize(n);
+    int tail = 0;
 
-            tails &= ~(1 << tailIdx);
-        }
+    for (int i = 0; i < n; i++)
+    {
+        if (tempIndegree[i] == 0)
+            sorted[tail++] = i;
+    }
 
-        // Save new position for current node
-        sorted[currIdx++] = zeroIndegreeIdx;
+    for (int head = 0; head < tail; head++)
+    {
+        const int curr = sorted[head];
 
-        // Remove current node
-        currMask &= ~(1 << zeroIndegreeIdx);
+        // For every tail-adjacent node, remove one edge. If its indegree has become 0, 
+        // it's ready to be sorted.
+        for (int j = offsets[curr]; j < offsets[curr + 1]; j++)
+        {
+            const int tailIdx = successors[j];
+            if (--tempIndegree[tailIdx] == 0)
+                sorted[tail++] = tailIdx;
+        }
     }
 
-    Assert(currIdx == m_currSize, "Graph has a cycle.");
+    Assert(tail == n, "Graph has a cycle.");
 
-    for (int i = 0; i < m_currSize; i++)
-        Assert(tempIndegree[i] == 0, "Graph has a cycle.");
+    SmallVector<Task, App::FrameAllocator, NUM_INLINE_TASKS> sortedTasks;
+    sortedTasks.reserve(n);
+    m_indegrees.resize(n);
 
-    Task oldTaskArr[MAX_NUM_TASKS];
-    for (int i = 0; i < m_currSize; i++)
-        oldTaskArr[i] = ZetaMove(m_tasks[i]);
+    for (int i = 0; i < n; i++)
+    {
+        const int oldIdx = sorted[i];
+        sortedTasks.emplace_back(ZetaMove(m_tasks[oldIdx]));
+        m_indegrees[i] = indegrees[oldIdx];
 
-    TaskMetadata oldTaskMetadata[MAX_NUM_TASKS];
-    memcpy(oldTaskMetadata, m_taskMetadata, m_currSize * sizeof(TaskMetadata));
+        if (indegrees[oldIdx] == 0)
+            m_roots.push_back(i);
 
-    for (int i = 0; i < m_currSize; i++)
-    {
-        m_tasks[i] = ZetaMove(oldTaskArr[sorted[i]]);
-        m_taskMetadata[i] = oldTaskMetadata[sorted[i]];
+        if (offsets[oldIdx + 1] - offsets[oldIdx] == 0)
+            m_leaves.push_back(i);
     }
+
+    m_tasks = ZetaMove(sortedTasks);
 }
 
 void TaskSet::ConnectTo(TaskSet& other)
 {
     Assert(!m_isFinalized, "Calling this method on a finalized TaskSet is invalid.");
     Assert(!other.m_isFinalized, "Calling this method on a finalized TaskSet is invalid.");
-
-    uint64_t headMask = m_leafMask;
-    const uint64_t tailMask = other.m_rootMask;
+    Assert(m_isSorted && other.m_isSorted, "Both TaskSets must be sorted.");
 
     // Connect every leaf of this TaskSet to every root of "other"
-    unsigned long headIdx;
-    while (_BitScanForward64(&headIdx, headMask))
+    for (auto headIdx : m_leaves)
     {
-        Assert(headIdx < m_currSize, "Bug");
+        Assert(headIdx < (int)m_tasks.size(), "Bug");
         Assert(m_tasks[headIdx].m_adjacentTailNodes.empty(), "Leaf task should not have tail nodes.");
-        m_tasks[headIdx].m_adjacentTailNodes.reserve(__popcnt16(other.m_rootMask));
+        m_tasks[headIdx].m_adjacentTailNodes.reserve(other.m_roots.size());
 
-        unsigned long tailIdx;
-        uint64_t tailMaskCopy = tailMask;
-        while (_BitScanForward64(&tailIdx, tailMaskCopy))
+        for (auto tailIdx : other.m_roots)
         {
-            Assert(tailIdx < other.m_currSize, "Index out of bound.");
+            Assert(tailIdx < (int)other.m_tasks.size(), "Index out of bound.");
 
             // Add one edge
             other.m_tasks[tailIdx].m_indegree += 1;
             m_tasks[headIdx].m_adjacentTailNodes.push_back(other.m_tasks[tailIdx].m_signalHandle);
-
-            tailMaskCopy &= ~(1llu << tailIdx);
         }
-
-        headMask &= ~(1llu << headIdx);
     }
 }
 
 void TaskSet::ConnectTo(Task& other)
 {
     Assert(!m_isFinalized, "Calling this method on a finalized TaskSet is invalid.");
+    Assert(m_isSorted, "TaskSet must be sorted.");
 
-    uint64_t mask = m_leafMask;
-
-    unsigned long idx;
-    while (_BitScanForward64(&idx, mask))
+    for (auto idx : m_leaves)
     {
-        Assert(idx < m_currSize, "Bug");
+        Assert(idx < (int)m_tasks.size(), "Bug");
         m_tasks[idx].m_adjacentTailNodes.push_back(other.m_signalHandle);
-
-        mask &= ~(1llu << idx);
     }
 
-    other.m_indegree += __popcnt((uint32_t)mask);
+    other.m_indegree += (int)m_leaves.size();
 }
 
 void TaskSet::ConnectFrom(Task& other)
 {
     Assert(!m_isFinalized, "Calling this method on a finalized TaskSet is invalid.");
+    Assert(m_isSorted, "TaskSet must be sorted.");
 
-    uint64_t mask = m_rootMask;
-
-    unsigned long idx;
-    while (_BitScanForward64(&idx, mask))
+    for (auto idx : m_roots)
     {
-        Assert(idx < m_currSize, "Invalid index.");
+        Assert(idx < (int)m_tasks.size(), "Invalid index.");
         m_tasks[idx].m_indegree += 1;
         other.m_adjacentTailNodes.push_back(m_tasks[idx].m_signalHandle);
-
-        mask &= ~(1llu << idx);
     }
 }
\ No newline at end of file
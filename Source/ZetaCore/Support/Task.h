@@ -32,6 +32,9 @@ namespace ZetaRay::Support
 
         void Reset(const char* name, TASK_PRIORITY priority, Util::Function&& f);
         ZetaInline int GetSignalHandle() const { return m_signalHandle; }
+        // Number of tasks that need to finish before this task can run. Only valid after
+        // the TaskSet that this task belongs to has been finalized.
+        ZetaInline int GetIndegree() const { return m_indegree; }
         ZetaInline Util::Span<int> GetAdjacencies() { return Util::Span(m_adjacentTailNodes); }
         ZetaInline TASK_PRIORITY GetPriority() const { return m_priority; }
 
@@ -86,9 +89,14 @@ namespace ZetaRay::Support
     // 3. Sort
     // 4. (Optional) Connect different TaskSets
     // 5. Finalize
+    //
+    // Graph is stored as an edge list that is converted to an adjacency array when 
+    // sorting, so there's no upper bound on the number of tasks. Memory beyond the 
+    // inline storage comes from the frame allocator.
     struct TaskSet
     {
-        static constexpr int MAX_NUM_TASKS = 16;
+        // Number of tasks that can be added before falling back to the frame allocator
+        static constexpr int NUM_INLINE_TASKS = 16;
         using TaskHandle = int;
         static constexpr TaskHandle INVALID_TASK_HANDLE = -1;
 
@@ -101,13 +109,12 @@ namespace ZetaRay::Support
         TaskHandle EmplaceTask(const char* name, Util::Function&& f)
         {
             Assert(!m_isFinalized, "Calling AddTask() on an unfinalized TaskSet is not allowed.");
-            Assert(m_currSize < MAX_NUM_TASKS, 
-                "Current implementation doesn't support more than %d tasks.", MAX_NUM_TASKS);
+            Assert(!m_isSorted, "Adding tasks to a sorted TaskSet is not allowed.");
 
             // TaskSet is not needed for background tasks
-            m_tasks[m_currSize++].Reset(name, TASK_PRIORITY::NORMAL, ZetaMove(f));
+            m_tasks.emplace_back(name, TASK_PRIORITY::NORMAL, ZetaMove(f));
 
-            return (TaskHandle)(m_currSize - 1);
+            return (TaskHandle)(m_tasks.size() - 1);
         }
 
         // Adds a dependent task to the list of tasks that are notified by this task upon completion
@@ -122,31 +129,29 @@ namespace ZetaRay::Support
         ZetaInline bool IsFinalized() { return m_isFinalized; }
         void Sort();
         void Finalize(WaitObject* waitObj = nullptr);
-        ZetaInline int GetSize() { return m_currSize; }
-        ZetaInline Util::MutableSpan<Task> GetTasks() { return Util::MutableSpan(m_tasks, m_currSize); }
+        ZetaInline int GetSize() { return (int)m_tasks.size(); }
+        ZetaInline Util::MutableSpan<Task> GetTasks() { return Util::MutableSpan(m_tasks); }
 
     private:
-        struct TaskMetadata
+        struct Edge
         {
-            ZetaInline int Indegree() const { return __popcnt16(PredecessorMask); }
-            ZetaInline int Outdegree() const { return __popcnt16(SuccessorMask); }
-
-            // Index of adjacent tasks (i.e. this task has an edge to them)
-            uint16_t SuccessorMask = 0;
-
-            // Index of predecessor tasks (i.e. have an edge to this task)
-            uint16_t PredecessorMask = 0;
+            TaskHandle From;
+            TaskHandle To;
         };
 
-        void ComputeInOutMask();
         void TopologicalSort();
 
-        Task m_tasks[MAX_NUM_TASKS];
-        TaskMetadata m_taskMetadata[MAX_NUM_TASKS];
+        Util::SmallVector<Task, App::FrameAllocator, NUM_INLINE_TASKS> m_tasks;
+        Util::SmallVector<Edge, App::FrameAllocator, NUM_INLINE_TASKS * 2> m_edges;
+
+        // Following are populated after sorting. Indices refer to the sorted order.
+        // Number of incoming edges from other tasks in this TaskSet
+        Util::SmallVector<int, App::FrameAllocator, NUM_INLINE_TASKS> m_indegrees;
+        // Tasks without incoming edges from other tasks in this TaskSet
+        Util::SmallVector<TaskHandle, App::FrameAllocator, NUM_INLINE_TASKS> m_roots;
+        // Tasks without outgoing edges to other tasks in this TaskSet
+        Util::SmallVector<TaskHandle, App::FrameAllocator, NUM_INLINE_TASKS> m_leaves;
 
-        uint16_t m_rootMask = 0;
-        uint16_t m_leafMask = 0;
-        uint8_t m_currSize = 0;
         bool m_isSorted = false;
         bool m_isFinalized = false;
     };
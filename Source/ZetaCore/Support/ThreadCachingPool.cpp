@@ -0,0 +1,344 @@
+#include "ThreadCachingPool.h"
+#include "../Utility/Error.h"
+#include <string.h>
+
+using namespace ZetaRay::Support;
+using namespace ZetaRay::Util;
+
+namespace
+{
+    // Free chunks store a pointer to the next free chunk in their first bytes
+    ZetaInline void* Next(void* chunk)
+    {
+        void* next;
+        memcpy(&next, chunk, sizeof(void*));
+
+        return next;
+    }
+
+    ZetaInline void SetNext(void* chunk, void* next)
+    {
+        memcpy(chunk, &next, sizeof(void*));
+    }
+
+    ZetaInline void Increment(std::atomic_uint64_t& counter)
+    {
+        // Single writer, so a plain increment is enough
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    ZetaInline size_t SpanSize(size_t chunkSize, uint32_t batchSize)
+    {
+        return ZetaRay::Math::Max(ThreadCachingPool::SPAN_SIZE, chunkSize * batchSize);
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// ThreadCachingPool
+//--------------------------------------------------------------------------------------
+
+ThreadCachingPool::~ThreadCachingPool()
+{
+    Clear();
+}
+
+void ThreadCachingPool::Clear()
+{
+    for (int t = 0; t < MAX_NUM_THREADS; t++)
+    {
+        for (size_t c = 0; c < NUM_SIZE_CLASSES; c++)
+        {
+            m_caches[t].Head[c] = nullptr;
+            m_caches[t].Count[c] = 0;
+        }
+    }
+
+    for (size_t c = 0; c < NUM_SIZE_CLASSES; c++)
+    {
+        auto& central = m_central[c];
+
+        for (void* span : central.Spans)
+            free(span);
+
+        central.Spans.free_memory();
+        central.Batches.free_memory();
+        central.RemoteFrees.store(nullptr, std::memory_order_relaxed);
+        central.ReservedBytes.store(0, std::memory_order_relaxed);
+    }
+}
+
+ThreadCachingPool::Batch ThreadCachingPool::FetchBatchLocked(size_t sizeClass)
+{
+    auto& central = m_central[sizeClass];
+
+    if (!central.Batches.empty())
+    {
+        const Batch batch = central.Batches.back();
+        central.Batches.pop_back();
+
+        return batch;
+    }
+
+    // Chunks that were freed by threads without a cache. Taking the whole list at once
+    // avoids the ABA problem of popping individual nodes from a lock-free stack.
+    void* remote = central.RemoteFrees.exchange(nullptr, std::memory_order_acquire);
+
+    if (remote)
+    {
+        uint32_t count = 0;
+        for (void* curr = remote; curr; curr = Next(curr))
+            count++;
+
+        return Batch{ .Head = remote, .Count = count };
+    }
+
+    // Grow -- carve up a new span into batches
+    const size_t chunkSize = MemoryPool::GetChunkSizeFromPoolIndex(sizeClass);
+    const uint32_t batchSize = BatchSize(sizeClass);
+    const size_t spanSize = SpanSize(chunkSize, batchSize);
+    const uint32_t numChunks = (uint32_t)(spanSize / chunkSize);
+
+    uint8_t* span = reinterpret_cast<uint8_t*>(malloc(spanSize));
+    Check(span, "malloc() failed.");
+
+    central.Spans.push_back(span);
+    central.ReservedBytes.fetch_add(spanSize, std::memory_order_relaxed);
+
+    for (uint32_t i = 0; i < numChunks; i += batchSize)
+    {
+        const uint32_t n = Math::Min(batchSize, numChunks - i);
+        uint8_t* first = span + i * chunkSize;
+
+        for (uint32_t j = 0; j < n - 1; j++)
+            SetNext(first + j * chunkSize, first + (j + 1) * chunkSize);
+
+        SetNext(first + (n - 1) * chunkSize, nullptr);
+        central.Batches.push_back(Batch{ .Head = first, .Count = n });
+    }
+
+    const Batch batch = central.Batches.back();
+    central.Batches.pop_back();
+
+    return batch;
+}
+
+void ThreadCachingPool::Refill(ThreadCache& cache, size_t sizeClass)
+{
+    Assert(cache.Head[sizeClass] == nullptr, "Cache should be empty.");
+    auto& central = m_central[sizeClass];
+
+    AcquireSRWLockExclusive(&central.Lock);
+    const Batch batch = FetchBatchLocked(sizeClass);
+    ReleaseSRWLockExclusive(&central.Lock);
+
+    cache.Head[sizeClass] = batch.Head;
+    cache.Count[sizeClass] = batch.Count;
+    central.NumBatchFetches.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ThreadCachingPool::Release(ThreadCache& cache, size_t sizeClass)
+{
+    const uint32_t batchSize = BatchSize(sizeClass);
+    Assert(cache.Count[sizeClass] > batchSize, "Not enough chunks in cache.");
+
+    // Detach the first batchSize chunks
+    void* head = cache.Head[sizeClass];
+    void* tail = head;
+
+    for (uint32_t i = 1; i < batchSize; i++)
+        tail = Next(tail);
+
+    cache.Head[sizeClass] = Next(tail);
+    cache.Count[sizeClass] -= batchSize;
+    SetNext(tail, nullptr);
+
+    auto& central = m_central[sizeClass];
+
+    AcquireSRWLockExclusive(&central.Lock);
+    central.Batches.push_back(Batch{ .Head = head, .Count = batchSize });
+    ReleaseSRWLockExclusive(&central.Lock);
+
+    central.NumBatchReleases.fetch_add(1, std::memory_order_relaxed);
+}
+
+void* ThreadCachingPool::Allocate(size_t sizeClass)
+{
+    const int threadIdx = g_threadIdx;
+    Assert(threadIdx < MAX_NUM_THREADS, "Invalid thread index.");
+
+    // No cache for this thread, take one chunk directly from the central pool
+    if (threadIdx < 0)
+    {
+        auto& central = m_central[sizeClass];
+
+        AcquireSRWLockExclusive(&central.Lock);
+
+        const Batch batch = FetchBatchLocked(sizeClass);
+        if (batch.Count > 1)
+            central.Batches.push_back(Batch{ .Head = Next(batch.Head), .Count = batch.Count - 1 });
+
+        ReleaseSRWLockExclusive(&central.Lock);
+
+        central.NumUncachedAllocs.fetch_add(1, std::memory_order_relaxed);
+
+        return batch.Head;
+    }
+
+    ThreadCache& cache = m_caches[threadIdx];
+
+    if (!cache.Head[sizeClass])
+        Refill(cache, sizeClass);
+
+    void* chunk = cache.Head[sizeClass];
+    cache.Head[sizeClass] = Next(chunk);
+    cache.Count[sizeClass]--;
+    Increment(cache.NumAllocs[sizeClass]);
+
+    return chunk;
+}
+
+void ThreadCachingPool::Free(void* mem, size_t sizeClass)
+{
+    const int threadIdx = g_threadIdx;
+    Assert(threadIdx < MAX_NUM_THREADS, "Invalid thread index.");
+
+    // No cache for this thread, push onto the lock-free list of the central pool
+    if (threadIdx < 0)
+    {
+        auto& central = m_central[sizeClass];
+        void* head = central.RemoteFrees.load(std::memory_order_relaxed);
+
+        do
+        {
+            SetNext(mem, head);
+        } while (!central.RemoteFrees.compare_exchange_weak(head, mem,
+            std::memory_order_release, std::memory_order_relaxed));
+
+        central.NumRemoteFrees.fetch_add(1, std::memory_order_relaxed);
+
+        return;
+    }
+
+    ThreadCache& cache = m_caches[threadIdx];
+
+    SetNext(mem, cache.Head[sizeClass]);
+    cache.Head[sizeClass] = mem;
+    cache.Count[sizeClass]++;
+    Increment(cache.NumFrees[sizeClass]);
+
+    // Hand back the excess so that memory doesn't pile up in threads that mostly free
+    if (cache.Count[sizeClass] > 2 * BatchSize(sizeClass))
+        Release(cache, sizeClass);
+}
+
+void* ThreadCachingPool::AllocateAligned(size_t size, size_t alignment)
+{
+    if (alignment <= alignof(std::max_align_t))
+    {
+        if (size > MemoryPool::MAX_ALLOC_SIZE)
+            return malloc(size);
+
+        return Allocate(MemoryPool::GetPoolIndexFromSize(size));
+    }
+
+    // Same scheme as MemoryPool::AllocateAligned(). Returned pointer is always shifted
+    // forward by 1 to alignment bytes and the shift is stored in the byte before it.
+    const size_t maxNumBytes = size + alignment;
+
+    if (maxNumBytes > MemoryPool::MAX_ALLOC_SIZE || alignment > 256)
+        return _aligned_malloc(size, alignment);
+
+    void* mem = Allocate(MemoryPool::GetPoolIndexFromSize(maxNumBytes));
+
+    uintptr_t aligned = reinterpret_cast<uintptr_t>(mem);
+    aligned = (aligned + alignment) & ~(alignment - 1);
+
+    const uint8_t diff = (uint8_t)((aligned - reinterpret_cast<uintptr_t>(mem)) & 0xff);
+    memcpy(reinterpret_cast<void*>(aligned - 1), &diff, 1);
+
+    return reinterpret_cast<void*>(aligned);
+}
+
+void ThreadCachingPool::FreeAligned(void* mem, size_t size, size_t alignment)
+{
+    if (!mem)
+        return;
+
+    if (alignment <= alignof(std::max_align_t))
+    {
+        if (size > MemoryPool::MAX_ALLOC_SIZE)
+            free(mem);
+        else
+            Free(mem, MemoryPool::GetPoolIndexFromSize(size));
+
+        return;
+    }
+
+    const size_t maxNumBytes = size + alignment;
+
+    if (maxNumBytes > MemoryPool::MAX_ALLOC_SIZE || alignment > 256)
+    {
+        _aligned_free(mem);
+        return;
+    }
+
+    // Undo alignment (0 is interpreted as 256)
+    const uintptr_t aligned = reinterpret_cast<uintptr_t>(mem);
+    const uint8_t diff = *reinterpret_cast<uint8_t*>(aligned - 1);
+    const uintptr_t origMem = aligned - (diff > 0 ? diff : 256);
+
+    Free(reinterpret_cast<void*>(origMem), MemoryPool::GetPoolIndexFromSize(maxNumBytes));
+}
+
+ThreadCachingPool::SizeClassStats ThreadCachingPool::GetStats(size_t sizeClass) const
+{
+    Assert(sizeClass < NUM_SIZE_CLASSES, "Invalid size class.");
+    const auto& central = m_central[sizeClass];
+
+    SizeClassStats stats{ .ChunkSize = MemoryPool::GetChunkSizeFromPoolIndex(sizeClass),
+        .NumAllocs = central.NumUncachedAllocs.load(std::memory_order_relaxed),
+        .NumFrees = central.NumRemoteFrees.load(std::memory_order_relaxed),
+        .NumBatchFetches = central.NumBatchFetches.load(std::memory_order_relaxed),
+        .NumBatchReleases = central.NumBatchReleases.load(std::memory_order_relaxed),
+        .NumRemoteFrees = central.NumRemoteFrees.load(std::memory_order_relaxed),
+        .ReservedBytes = central.ReservedBytes.load(std::memory_order_relaxed) };
+
+    for (int t = 0; t < MAX_NUM_THREADS; t++)
+    {
+        stats.NumAllocs += m_caches[t].NumAllocs[sizeClass].load(std::memory_order_relaxed);
+        stats.NumFrees += m_caches[t].NumFrees[sizeClass].load(std::memory_order_relaxed);
+    }
+
+    return stats;
+}
+
+size_t ThreadCachingPool::TotalSize() const
+{
+    size_t size = 0;
+
+    for (size_t c = 0; c < NUM_SIZE_CLASSES; c++)
+        size += m_central[c].ReservedBytes.load(std::memory_order_relaxed);
+
+    return size;
+}
+
+void ThreadCachingPool::AddFrameStats(const char* group) const
+{
+    for (size_t c = 0; c < NUM_SIZE_CLASSES; c++)
+    {
+        const SizeClassStats stats = GetStats(c);
+        if (stats.ReservedBytes == 0)
+            continue;
+
+        // Counters of different threads are read at slightly different times
+        const uint64_t inUse = stats.NumAllocs > stats.NumFrees ? stats.NumAllocs - stats.NumFrees : 0;
+        const uint64_t reserved = stats.ReservedBytes / stats.ChunkSize;
+
+        char name[32];
+        stbsp_snprintf(name, sizeof(name), "%llu B chunks", stats.ChunkSize);
+
+        App::AddFrameStat(group, name, (uint32_t)inUse, (uint32_t)reserved);
+    }
+
+    App::AddFrameStat(group, "Reserved (kb)", (uint64_t)(TotalSize() >> 10));
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "MemoryPool.h"
+#include "../App/App.h"
+#include "../Math/Common.h"
+#include "../Utility/SmallVector.h"
+#include "../Win32/Win32.h"
+#include <atomic>
+
+namespace ZetaRay::Support
+{
+    // Thread-safe pool allocator with the same size classes as MemoryPool
+    //  - Every thread (identified by g_threadIdx) has its own cache of free lists, one per
+    //    size class, which is accessed without any synchronization.
+    //  - Caches exchange chunks with a shared central pool in batches. An empty cache takes
+    //    a batch from the central pool and once a cache holds more than two batches, it
+    //    returns one. Locking cost is amortized over a batch of allocations.
+    //  - The central pool grows by spans of many batches rather than one block at a time.
+    //  - Chunks don't belong to any particular thread -- a chunk freed by a thread other than
+    //    the one that allocated it simply joins the freeing thread's cache. Threads without a
+    //    cache (g_threadIdx == -1) instead push freed chunks onto a lock-free list that is
+    //    drained by the central pool.
+    //  - Requests larger than MemoryPool::MAX_ALLOC_SIZE are forwarded to malloc.
+    class ThreadCachingPool
+    {
+    public:
+        static constexpr size_t NUM_SIZE_CLASSES = MemoryPool::POOL_COUNT;
+        // Central pool allocates memory in spans of (at least) this size
+        static constexpr size_t SPAN_SIZE = 64 * 1024;
+
+        struct SizeClassStats
+        {
+            size_t ChunkSize;
+            uint64_t NumAllocs;
+            uint64_t NumFrees;
+            // Number of batches moved from the central pool to thread caches
+            uint64_t NumBatchFetches;
+            // Number of batches moved from thread caches back to the central pool
+            uint64_t NumBatchReleases;
+            // Number of chunks freed by threads without a cache
+            uint64_t NumRemoteFrees;
+            size_t ReservedBytes;
+        };
+
+        ThreadCachingPool() = default;
+        ~ThreadCachingPool();
+
+        ThreadCachingPool(ThreadCachingPool&&) = delete;
+        ThreadCachingPool& operator=(ThreadCachingPool&&) = delete;
+
+        // Releases all the memory. Caller has to make sure there aren't any live allocations
+        // and no other thread is accessing the pool.
+        void Clear();
+
+        void* AllocateAligned(size_t size, size_t alignment = alignof(std::max_align_t));
+        void FreeAligned(void* mem, size_t size, size_t alignment = alignof(std::max_align_t));
+
+        // Stats are gathered without synchronization and may be slightly out of date
+        SizeClassStats GetStats(size_t sizeClass) const;
+        size_t TotalSize() const;
+        // Adds in-use and reserved chunk counts for every size class as frame stats
+        void AddFrameStats(const char* group) const;
+
+    private:
+        // Number of chunks that are moved between a thread cache and the central pool at once
+        static ZetaInline uint32_t BatchSize(size_t sizeClass)
+        {
+            const size_t chunkSize = MemoryPool::GetChunkSizeFromPoolIndex(sizeClass);
+            return (uint32_t)Math::Min<size_t>(64, Math::Max<size_t>(8, (16 * 1024) / chunkSize));
+        }
+
+        struct Batch
+        {
+            void* Head;
+            uint32_t Count;
+        };
+
+        struct alignas(64) ThreadCache
+        {
+            void* Head[NUM_SIZE_CLASSES] = { nullptr };
+            uint32_t Count[NUM_SIZE_CLASSES] = { 0 };
+
+            // Only written by the owning thread, relaxed atomics so that they can be read
+            // for stats from other threads
+            std::atomic_uint64_t NumAllocs[NUM_SIZE_CLASSES] = {};
+            std::atomic_uint64_t NumFrees[NUM_SIZE_CLASSES] = {};
+        };
+
+        struct alignas(64) CentralFreeList
+        {
+            SRWLOCK Lock = SRWLOCK_INIT;
+            Util::SmallVector<Batch> Batches;
+            Util::SmallVector<void*> Spans;
+
+            // Chunks freed by threads without a cache, pushed without taking the lock
+            std::atomic<void*> RemoteFrees = nullptr;
+
+            std::atomic_uint64_t ReservedBytes = 0;
+            std::atomic_uint64_t NumBatchFetches = 0;
+            std::atomic_uint64_t NumBatchReleases = 0;
+            std::atomic_uint64_t NumRemoteFrees = 0;
+            std::atomic_uint64_t NumUncachedAllocs = 0;
+        };
+
+        void* Allocate(size_t sizeClass);
+        void Free(void* mem, size_t sizeClass);
+
+        // Moves a batch of chunks from the central pool into the given cache
+        void Refill(ThreadCache& cache, size_t sizeClass);
+        // Moves a batch of chunks from the given cache to the central pool
+        void Release(ThreadCache& cache, size_t sizeClass);
+        // Returns a batch of free chunks from the central pool. Central lock must be held.
+        Batch FetchBatchLocked(size_t sizeClass);
+
+        ThreadCache m_caches[MAX_NUM_THREADS];
+        CentralFreeList m_central[NUM_SIZE_CLASSES];
+    };
+}
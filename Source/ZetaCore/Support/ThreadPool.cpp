@@ -1,9 +1,33 @@
 #include "ThreadPool.h"
 #include "../App/Log.h"
+#include "../Math/Common.h"
+#include <intrin.h>
 
 using namespace ZetaRay::Support;
 using namespace ZetaRay::App;
 using namespace ZetaRay::Util;
+using namespace ZetaRay::Math;
+
+namespace
+{
+    // Per-thread state for picking steal victims
+    thread_local uint32_t g_stealRngState = 0;
+
+    ZetaInline uint32_t NextVictim(uint32_t numThreads)
+    {
+        if (g_stealRngState == 0)
+            g_stealRngState = (uint32_t)g_threadIdx * 0x9e3779b9u + 1u;
+
+        // xorshift32
+        uint32_t x = g_stealRngState;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        g_stealRngState = x;
+
+        return x % numThreads;
+    }
+}
 
 //--------------------------------------------------------------------------------------
 // ThreadPool
@@ -67,21 +91,22 @@ void ThreadPool::Start()
 
 void ThreadPool::Shutdown()
 {
-    // Relaxed since Enqueue has a release op
-    m_shutdown.store(true, std::memory_order_relaxed);
+    m_shutdown.store(true, std::memory_order_seq_cst);
 
     // Upon observing shutdown flag to be true, all the threads are going to exit
-
-    for (int i = 0; i < m_threadPoolSize; i++)
-    {
-        Task t("NoOp", TASK_PRIORITY::NORMAL, []() {});
-        Enqueue(ZetaMove(t));
-    }
+    m_workEpoch.fetch_add(1, std::memory_order_seq_cst);
+    m_workEpoch.notify_all();
 
     for (int i = 0; i < m_threadPoolSize; i++)
         m_threadPool[i].join();
 }
 
+void ThreadPool::SetSchedulingMode(SCHEDULING_MODE mode)
+{
+    Assert(AreAllTasksFinished(), "Changing the scheduling mode while there are unfinished tasks is not allowed.");
+    m_schedulingMode = mode;
+}
+
 void ThreadPool::Enqueue(Task&& task)
 {
     bool memAllocFailed = m_taskQueue.enqueue(m_producerTokens[g_threadIdx], ZetaMove(task));
@@ -89,6 +114,8 @@ void ThreadPool::Enqueue(Task&& task)
 
     m_numTasksToFinishTarget.fetch_add(1, std::memory_order_relaxed);
     m_numTasksInQueue.fetch_add(1, std::memory_order_release);
+
+    WakeWorkers(false);
 }
 
 void ThreadPool::Enqueue(TaskSet&& ts)
@@ -96,12 +123,260 @@ void ThreadPool::Enqueue(TaskSet&& ts)
     Assert(ts.IsFinalized(), "Given TaskSet is not finalized.");
 
     m_numTasksToFinishTarget.fetch_add(ts.GetSize(), std::memory_order_relaxed);
-    m_numTasksInQueue.fetch_add(ts.GetSize(), std::memory_order_release);
     auto tasks = ts.GetTasks();
 
-    bool memAllocFailed = m_taskQueue.enqueue_bulk(m_producerTokens[g_threadIdx],
-        std::make_move_iterator(tasks.data()), tasks.size());
+    if (m_schedulingMode == SCHEDULING_MODE::BLOCKING)
+    {
+        m_numTasksInQueue.fetch_add(ts.GetSize(), std::memory_order_release);
+
+        // Signal handles need to be read before tasks are moved into the queue
+        SmallVector<int, App::FrameAllocator, TaskSet::NUM_INLINE_TASKS> handles;
+
+        for (auto& task : tasks)
+        {
+            if (task.GetIndegree() > 0)
+                handles.push_back(task.GetSignalHandle());
+        }
+
+        bool memAllocFailed = m_taskQueue.enqueue_bulk(m_producerTokens[g_threadIdx],
+            std::make_move_iterator(tasks.data()), tasks.size());
+        Assert(memAllocFailed, "moodycamel::ConcurrentQueue couldn't allocate memory.");
+
+        // Tasks with dependencies are now in the queue, release their submission signal
+        for (auto h : handles)
+            App::SignalTailNode(h);
+
+        WakeWorkers(true);
+
+        return;
+    }
+
+    // Park the tasks with unfinished dependencies and compact the remaining ones 
+    // (indegree of zero) to the front. Relative order is preserved.
+    size_t numReady = 0;
+
+    for (size_t i = 0; i < tasks.size(); i++)
+    {
+        if (tasks[i].GetIndegree() > 0)
+            Submit(ZetaMove(tasks[i]));
+        else
+        {
+            if (numReady != i)
+                tasks[numReady] = ZetaMove(tasks[i]);
+
+            numReady++;
+        }
+    }
+
+    if (numReady)
+    {
+        m_numTasksInQueue.fetch_add((int)numReady, std::memory_order_release);
+
+        bool memAllocFailed = m_taskQueue.enqueue_bulk(m_producerTokens[g_threadIdx],
+            std::make_move_iterator(tasks.data()), numReady);
+        Assert(memAllocFailed, "moodycamel::ConcurrentQueue couldn't allocate memory.");
+
+        WakeWorkers(numReady > 1);
+    }
+}
+
+void ThreadPool::Submit(Task&& task)
+{
+    Assert(m_schedulingMode == SCHEDULING_MODE::DEPENDENCY_READY, "Invalid scheduling mode.");
+    const int taskHandle = task.GetSignalHandle();
+    Assert(taskHandle >= 0, "Invalid task handle.");
+
+    m_parkedTasks.GetOrAlloc(taskHandle) = ZetaMove(task);
+
+    // Release the submission signal. Whichever thread removes the last dependency (either 
+    // this one or a worker that just finished a predecessor) pushes the task into the queue.
+    if (App::SignalTailNode(taskHandle))
+        EnqueueParked(taskHandle);
+}
+
+void ThreadPool::EnqueueParked(int taskHandle)
+{
+    m_numTasksInQueue.fetch_add(1, std::memory_order_release);
+
+    bool memAllocFailed = m_taskQueue.enqueue(m_producerTokens[g_threadIdx], 
+        ZetaMove(m_parkedTasks[taskHandle]));
     Assert(memAllocFailed, "moodycamel::ConcurrentQueue couldn't allocate memory.");
+
+    WakeWorkers(false);
+}
+
+void ThreadPool::ParallelFor(size_t begin, size_t end, size_t grain, ParallelForFn fn, void* ctx)
+{
+    if (begin >= end)
+        return;
+
+    grain = Max(grain, (size_t)1);
+
+    // Not worth splitting
+    if (end - begin <= grain)
+    {
+        fn(ctx, begin, end);
+        return;
+    }
+
+    ParallelForContext context;
+    context.Fn = fn;
+    context.Ctx = ctx;
+    context.Grain = grain;
+    context.NumRemaining.store(end - begin, std::memory_order_relaxed);
+
+    RunRangeJob(RangeJob{ .Context = &context, .Begin = begin, .End = end });
+
+    // Help out until every subrange is finished. Only range jobs are picked up here 
+    // (rather than tasks from the queue), which are guaranteed to finish without blocking.
+    while (context.NumRemaining.load(std::memory_order_acquire) != 0)
+    {
+        if (!TryRunRangeJob())
+            _mm_pause();
+    }
+}
+
+void ThreadPool::RunRangeJob(RangeJob job)
+{
+    auto& deque = m_rangeJobs[g_threadIdx];
+    const size_t grain = job.Context->Grain;
+
+    while (job.Begin < job.End)
+    {
+        // Lazy binary splitting -- only split when previously split off half has been 
+        // taken by another thread (or this is the first iteration). That way, chunk sizes 
+        // adapt to how busy other threads are.
+        if (job.End - job.Begin > grain && deque.Empty())
+        {
+            const size_t mid = job.Begin + (job.End - job.Begin) / 2;
+
+            if (deque.Push(RangeJob{ .Context = job.Context, .Begin = mid, .End = job.End }))
+            {
+                job.End = mid;
+                WakeWorkers(false);
+
+                continue;
+            }
+        }
+
+        const size_t end = Min(job.Begin + grain, job.End);
+        job.Context->Fn(job.Context->Ctx, job.Begin, end);
+        job.Context->NumRemaining.fetch_sub(end - job.Begin, std::memory_order_acq_rel);
+
+        job.Begin = end;
+    }
+}
+
+bool ThreadPool::TryRunRangeJob()
+{
+    RangeJob job;
+
+    if (m_rangeJobs[g_threadIdx].Pop(job))
+    {
+        RunRangeJob(job);
+        return true;
+    }
+
+    // Start from a random victim and try every other thread once
+    const uint32_t numThreads = (uint32_t)m_totalNumThreads;
+    const uint32_t start = NextVictim(numThreads);
+
+    for (uint32_t i = 0; i < numThreads; i++)
+    {
+        const uint32_t victim = (start + i) % numThreads;
+        if (victim == (uint32_t)g_threadIdx)
+            continue;
+
+        if (m_rangeJobs[victim].Steal(job))
+        {
+            RunRangeJob(job);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool ThreadPool::HasStealableRangeJobs() const
+{
+    for (int i = 0; i < m_totalNumThreads; i++)
+    {
+        if (!m_rangeJobs[i].Empty())
+            return true;
+    }
+
+    return false;
+}
+
+void ThreadPool::WaitForWork()
+{
+    // Register as a sleeper before checking for work one last time. Publishers push 
+    // first and then check for sleepers, so either the check below sees the new work or 
+    // the publisher sees this thread and bumps the epoch.
+    m_numSleeping.fetch_add(1, std::memory_order_seq_cst);
+    const uint32_t epoch = m_workEpoch.load(std::memory_order_seq_cst);
+
+    if (m_numTasksInQueue.load(std::memory_order_seq_cst) == 0 &&
+        !HasStealableRangeJobs() &&
+        !m_shutdown.load(std::memory_order_seq_cst))
+    {
+        m_workEpoch.wait(epoch, std::memory_order_seq_cst);
+    }
+
+    m_numSleeping.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void ThreadPool::WakeWorkers(bool all)
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (m_numSleeping.load(std::memory_order_relaxed) == 0)
+        return;
+
+    m_workEpoch.fetch_add(1, std::memory_order_seq_cst);
+
+    if (all)
+        m_workEpoch.notify_all();
+    else
+        m_workEpoch.notify_one();
+}
+
+void ThreadPool::SignalAdjacentTailNodes(Span<int> taskIDs)
+{
+    if (m_schedulingMode == SCHEDULING_MODE::BLOCKING)
+    {
+        App::SignalAdjacentTailNodes(taskIDs);
+        return;
+    }
+
+    for (auto handle : taskIDs)
+    {
+        // This was the last dependency, task is now ready to run
+        if (App::SignalTailNode(handle))
+            EnqueueParked(handle);
+    }
+}
+
+void ThreadPool::RunTask(Task& task)
+{
+    const bool hasSignal = task.GetPriority() != TASK_PRIORITY::BACKGROUND;
+
+    // Block if this task has unfinished dependencies. In DEPENDENCY_READY mode, tasks
+    // only reach the queue after all of their dependencies are finished.
+    if (hasSignal && m_schedulingMode == SCHEDULING_MODE::BLOCKING)
+        App::WaitForAdjacentHeadNodes(task.GetSignalHandle());
+
+    task.DoTask();
+
+    // Signal dependent tasks that this task has finished
+    if (hasSignal)
+    {
+        auto adjacencies = task.GetAdjacencies();
+        if (adjacencies.size() > 0)
+            SignalAdjacentTailNodes(adjacencies);
+    }
+
+    m_numTasksFinished.fetch_add(1, std::memory_order_release);
 }
 
 void ThreadPool::PumpUntilEmpty()
@@ -111,23 +386,13 @@ void ThreadPool::PumpUntilEmpty()
     // "try_dequeue()" returning false doesn't guarantee that queue is empty
     while (m_numTasksInQueue.load(std::memory_order_acquire) != 0)
     {
+        if (TryRunRangeJob())
+            continue;
+
         if (m_taskQueue.try_dequeue(m_consumerTokens[g_threadIdx], task))
         {
             m_numTasksInQueue.fetch_sub(1, std::memory_order_relaxed);
-
-            const int taskHandle = task.GetSignalHandle();
-
-            // Block if this task depends on other unfinished tasks
-            App::WaitForAdjacentHeadNodes(taskHandle);
-
-            task.DoTask();
-
-            // Signal dependent tasks that this task has finished
-            auto adjacencies = task.GetAdjacencies();
-            if (adjacencies.size() > 0)
-                App::SignalAdjacentTailNodes(adjacencies);
-
-            m_numTasksFinished.fetch_add(1, std::memory_order_release);
+            RunTask(task);
         }
     }
 }
@@ -161,34 +426,27 @@ void ThreadPool::WorkerThread(int idx)
 
     while (true)
     {
-        Task task;
-
         // Exit
         if (m_shutdown.load(std::memory_order_acquire))
             break;
 
-        // block if there aren't any tasks
-        m_taskQueue.wait_dequeue(m_consumerTokens[g_threadIdx], task);
-        m_numTasksInQueue.fetch_sub(1, std::memory_order_acquire);
-
-        const int taskHandle = task.GetSignalHandle();
-
-        // Block if this task has unfinished dependencies
-        if(task.GetPriority() != TASK_PRIORITY::BACKGROUND)
-            App::WaitForAdjacentHeadNodes(taskHandle);
+        // Range jobs come first as some thread is waiting for them to finish
+        if (TryRunRangeJob())
+            continue;
 
-        task.DoTask();
+        Task task;
 
-        // Signal dependent tasks that this task has finished
-        if (task.GetPriority() != TASK_PRIORITY::BACKGROUND)
+        if (m_taskQueue.try_dequeue(m_consumerTokens[g_threadIdx], task))
         {
-            auto adjacencies = task.GetAdjacencies();
-            if (adjacencies.size() > 0)
-                App::SignalAdjacentTailNodes(adjacencies);
+            m_numTasksInQueue.fetch_sub(1, std::memory_order_acquire);
+            RunTask(task);
+
+            continue;
         }
 
-        m_numTasksFinished.fetch_add(1, std::memory_order_release);
+        // block if there isn't any work
+        WaitForWork();
     }
 
     LOG_UI(INFO, "Thread %d exiting...\n", g_threadIdx);
-}
+}
\ No newline at end of file
@@ -1,7 +1,9 @@
 #pragma once
 
 #include "Task.h"
-#include "concurrentqueue/blockingconcurrentqueue.h"
+#include "WorkStealingDeque.h"
+#include "SegmentedArray.h"
+#include "concurrentqueue/concurrentqueue.h"
 
 namespace ZetaRay::Support
 {
@@ -18,9 +20,20 @@ namespace ZetaRay::Support
         void Start();
         void Shutdown();
 
+        // Must only be called when there are no unfinished tasks
+        void SetSchedulingMode(App::SCHEDULING_MODE mode);
+        ZetaInline App::SCHEDULING_MODE GetSchedulingMode() const { return m_schedulingMode; }
+
         void Enqueue(TaskSet&& ts);
         void Enqueue(Task&& t);
 
+        // Calls fn(ctx, b, e) for disjoint subranges [b, e) that cover [begin, end). Subranges
+        // are split off lazily (only when there's a chance for other threads to steal them),
+        // so the number of chunks adapts to the load. Calling thread participates and 
+        // returns after the whole range has been processed.
+        void ParallelFor(size_t begin, size_t end, size_t grain, App::ParallelForFn fn, 
+            void* ctx);
+
         // The calling thread dequeues task until task queue becomes empty
         void PumpUntilEmpty();
         // Waits until all tasks are finished (!= empty queue)
@@ -36,7 +49,38 @@ namespace ZetaRay::Support
         ZetaInline int ThreadPoolSize() const { return m_threadPoolSize; }
 
     private:
+        static constexpr int64_t MAX_NUM_RANGE_JOBS_PER_THREAD = 256;
+
+        struct ParallelForContext
+        {
+            App::ParallelForFn Fn;
+            void* Ctx;
+            size_t Grain;
+            std::atomic_size_t NumRemaining;
+        };
+
+        // A subrange of a ParallelFor() call
+        struct RangeJob
+        {
+            ParallelForContext* Context;
+            size_t Begin;
+            size_t End;
+        };
+
         void WorkerThread(int idx);
+        void RunTask(Task& task);
+        void RunRangeJob(RangeJob job);
+        // Pops a range job from this thread's deque or steals one from a random victim
+        bool TryRunRangeJob();
+        bool HasStealableRangeJobs() const;
+        // Blocks until new work is published (or shutdown)
+        void WaitForWork();
+        void WakeWorkers(bool all);
+        // Hands over a task that has unfinished dependencies. In DEPENDENCY_READY mode, task
+        // is parked until its last dependency is finished.
+        void Submit(Task&& task);
+        void EnqueueParked(int taskHandle);
+        void SignalAdjacentTailNodes(Util::Span<int> taskIDs);
 
         int m_threadPoolSize;
         int m_totalNumThreads;
@@ -46,6 +90,11 @@ namespace ZetaRay::Support
 
         std::thread m_threadPool[MAX_NUM_THREADS];
 
+        // Tasks waiting for their dependencies to finish, indexed by signal handle. Only
+        // used in DEPENDENCY_READY mode. Grows on demand to the number of tasks per frame.
+        SegmentedArray<Task> m_parkedTasks;
+        App::SCHEDULING_MODE m_schedulingMode = App::SCHEDULING_MODE::DEPENDENCY_READY;
+
         // Concurrent task queue
         // Source: https://github.com/cameron314/concurrentqueue
         struct MyTraits : public moodycamel::ConcurrentQueueDefaultTraits
@@ -53,7 +102,7 @@ namespace ZetaRay::Support
             static const size_t BLOCK_SIZE = 256;
         };
 
-        moodycamel::BlockingConcurrentQueue<Task, MyTraits> m_taskQueue;
+        moodycamel::ConcurrentQueue<Task, MyTraits> m_taskQueue;
 
         alignas(alignof(moodycamel::ProducerToken)) uint8_t m_producerTokensMem[
             sizeof(moodycamel::ProducerToken) * MAX_NUM_THREADS];
@@ -63,6 +112,13 @@ namespace ZetaRay::Support
             sizeof(moodycamel::ConsumerToken) * MAX_NUM_THREADS];
         moodycamel::ConsumerToken* m_consumerTokens;
 
+        // One deque per thread (including threads outside this pool) for range jobs
+        WorkStealingDeque<RangeJob, MAX_NUM_RANGE_JOBS_PER_THREAD> m_rangeJobs[MAX_NUM_THREADS];
+
+        // Idle workers sleep on the epoch, which is incremented whenever new work is published
+        std::atomic_uint32_t m_workEpoch = 0;
+        std::atomic_int32_t m_numSleeping = 0;
+
         std::atomic_bool m_start = false;
         std::atomic_bool m_shutdown = false;
     };
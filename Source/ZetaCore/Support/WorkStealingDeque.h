@@ -0,0 +1,103 @@
+#pragma once
+
+#include "../Utility/Error.h"
+#include <atomic>
+
+namespace ZetaRay::Support
+{
+    // Fixed-capacity Chase-Lev work-stealing deque. Owner thread pushes and pops from the
+    // bottom, other threads steal from the top. T has to be trivially copyable.
+    //
+    // Ref: N. M. Le, A. Pop, A. Cohen and F. Zappa Nardelli, "Correct and Efficient
+    // Work-Stealing for Weak Memory Models," PPoPP 2013.
+    template<typename T, int64_t CAPACITY>
+    struct WorkStealingDeque
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "T must be trivially copyable.");
+        static_assert((CAPACITY & (CAPACITY - 1)) == 0, "Capacity must be a power of two.");
+
+        WorkStealingDeque() = default;
+        ~WorkStealingDeque() = default;
+
+        WorkStealingDeque(const WorkStealingDeque&) = delete;
+        WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+        // Must only be called by the owner. Returns false when deque is full.
+        bool Push(const T& val)
+        {
+            const int64_t b = m_bottom.load(std::memory_order_relaxed);
+            const int64_t t = m_top.load(std::memory_order_acquire);
+
+            if (b - t >= CAPACITY)
+                return false;
+
+            m_buffer[b & (CAPACITY - 1)] = val;
+            std::atomic_thread_fence(std::memory_order_release);
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+
+            return true;
+        }
+
+        // Must only be called by the owner
+        bool Pop(T& val)
+        {
+            const int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+            m_bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t t = m_top.load(std::memory_order_relaxed);
+
+            if (t > b)
+            {
+                // Empty
+                m_bottom.store(b + 1, std::memory_order_relaxed);
+                return false;
+            }
+
+            val = m_buffer[b & (CAPACITY - 1)];
+
+            // Last element, race against the thieves
+            if (t == b)
+            {
+                const bool won = m_top.compare_exchange_strong(t, t + 1,
+                    std::memory_order_seq_cst, std::memory_order_relaxed);
+                m_bottom.store(b + 1, std::memory_order_relaxed);
+
+                return won;
+            }
+
+            return true;
+        }
+
+        // Can be called by any thread
+        bool Steal(T& val)
+        {
+            int64_t t = m_top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const int64_t b = m_bottom.load(std::memory_order_acquire);
+
+            if (t >= b)
+                return false;
+
+            // Slot can't be overwritten before top is advanced as Push() doesn't wrap
+            // around past top
+            val = m_buffer[t & (CAPACITY - 1)];
+
+            return m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                std::memory_order_relaxed);
+        }
+
+        // Approximate when called by non-owner threads
+        ZetaInline bool Empty() const
+        {
+            const int64_t b = m_bottom.load(std::memory_order_relaxed);
+            const int64_t t = m_top.load(std::memory_order_relaxed);
+
+            return b <= t;
+        }
+
+    private:
+        alignas(64) std::atomic_int64_t m_top = 0;
+        alignas(64) std::atomic_int64_t m_bottom = 0;
+        T m_buffer[CAPACITY];
+    };
+}
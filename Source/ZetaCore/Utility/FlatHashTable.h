@@ -0,0 +1,532 @@
+#pragma once
+
+#include "../Math/Common.h"
+#include "../Support/Memory.h"
+#include "../Utility/Optional.h"
+
+namespace ZetaRay::Util
+{
+    // Open-set addressing with SIMD group probing (Swiss table)
+    //
+    //  - Every bucket has a one-byte control value that is either empty, deleted or the lower
+    //    7 bits of key's hash. Lookups compare 16 control bytes at a time using SSE2 and only
+    //    look at keys whose control byte matches, so most probes never touch the keys.
+    //  - Erase only leaves behind a tombstone when the surrounding group has been full at
+    //    some point (otherwise no probe sequence could have passed through it). When the table
+    //    runs out of space and tombstones make up a large fraction of it, entries are rehashed
+    //    into a table of the same size rather than a bigger one.
+    //  - Keys are stored separately from values that are larger than INLINE_VALUE_SIZE, so
+    //    that probing doesn't pull large values into cache.
+    //  - Unlike HashTable, keys don't have to be hashed beforehand, though similar to
+    //    HashTable, only the key is stored and not the original object that was hashed.
+    //  - Iterators (pointers) are NOT stable; pointer to an entry found earlier might not be valid
+    //    anymore due to subsequent insertions and possible resize.
+    //  - Not thread-safe
+    template<typename ValueType, typename KeyType = uint64_t, Support::AllocatorType Allocator = Support::SystemAllocator>
+    requires std::is_integral_v<KeyType>
+    class FlatHashTable
+    {
+        static_assert(std::is_move_constructible_v<ValueType>, "ValueType is not move-constructible.");
+
+        static constexpr size_t GROUP_SIZE = 16;
+        static constexpr size_t INLINE_VALUE_SIZE = 16;
+        static constexpr bool INLINE_VALUES = sizeof(ValueType) <= INLINE_VALUE_SIZE;
+
+        static constexpr int8_t CTRL_EMPTY = -128;     // 0b10000000
+        static constexpr int8_t CTRL_DELETED = -2;     // 0b11111110
+
+        struct Slot
+        {
+            KeyType Key;
+            ValueType Val;
+        };
+
+        static constexpr size_t SLOT_SIZE = INLINE_VALUES ? sizeof(Slot) : sizeof(KeyType);
+        static constexpr size_t SLOT_ALIGNMENT = INLINE_VALUES ? alignof(Slot) : alignof(KeyType);
+
+    public:
+        struct EntryRef
+        {
+            const KeyType Key;
+            ValueType& Val;
+        };
+
+        // Mimics HashTable's Entry* iterators, i.e. "it->Key" and "it->Val"
+        struct Iterator
+        {
+            struct Arrow
+            {
+                EntryRef Ref;
+                ZetaInline EntryRef* operator->() { return &Ref; }
+            };
+
+            ZetaInline EntryRef operator*() const { return EntryRef{ Table->key_at(Idx), Table->value_at(Idx) }; }
+            ZetaInline Arrow operator->() const { return Arrow{ **this }; }
+            ZetaInline bool operator==(const Iterator& other) const { return Idx == other.Idx; }
+            ZetaInline bool operator!=(const Iterator& other) const { return Idx != other.Idx; }
+            ZetaInline bool operator<(const Iterator& other) const { return Idx < other.Idx; }
+
+            FlatHashTable* Table;
+            size_t Idx;
+        };
+
+        explicit FlatHashTable(const Allocator& a = Allocator())
+            : m_allocator(a)
+        {}
+        explicit FlatHashTable(size_t initialSize, const Allocator& a = Allocator())
+            : m_allocator(a)
+        {
+            resize(initialSize, true);
+        }
+        ~FlatHashTable()
+        {
+            free_memory();
+
+            if constexpr (!std::is_trivially_destructible_v<Allocator>)
+                this->m_allocator.~Allocator();
+        }
+
+        FlatHashTable(const FlatHashTable&) = delete;
+        FlatHashTable& operator=(const FlatHashTable&) = delete;
+
+        // See HashTable::resize()
+        void resize(size_t n, bool accountForMaxLoad = false)
+        {
+            if (n <= bucket_count())
+                return;
+
+            n = accountForMaxLoad ? (n * MAX_LOAD_DEN + MAX_LOAD_NUM - 1) / MAX_LOAD_NUM : n;
+            n = Math::NextPow2(Math::Max(n, MIN_NUM_BUCKETS));
+            rehash(n);
+        }
+
+        Util::Optional<ValueType*> find(KeyType key) const
+        {
+            const size_t idx = find_slot(key);
+            if (idx != NOT_FOUND)
+                return &value_at(idx);
+
+            return {};
+        }
+
+        // Inserts a new entry only if it doesn't already exist
+        template<typename... Args>
+        bool try_emplace(KeyType key, Args&&... args)
+        {
+            const uint64_t h = hash(key);
+            if (find_slot(key, h) != NOT_FOUND)
+                return false;
+
+            const size_t idx = prepare_insert(key, h);
+            new (&value_at(idx)) ValueType(ZetaForward(args)...);
+
+            return true;
+        }
+
+        // Assign to the entry if already exists, otherwise inserts a new entry
+        ValueType& insert_or_assign(KeyType key, const ValueType& val)
+        {
+            const uint64_t h = hash(key);
+            size_t idx = find_slot(key, h);
+
+            if (idx != NOT_FOUND)
+                value_at(idx) = val;
+            else
+            {
+                idx = prepare_insert(key, h);
+                new (&value_at(idx)) ValueType(val);
+            }
+
+            return value_at(idx);
+        }
+
+        ValueType& insert_or_assign(KeyType key, ValueType&& val)
+        {
+            const uint64_t h = hash(key);
+            size_t idx = find_slot(key, h);
+
+            if (idx != NOT_FOUND)
+                value_at(idx) = ZetaMove(val);
+            else
+            {
+                idx = prepare_insert(key, h);
+                new (&value_at(idx)) ValueType(ZetaMove(val));
+            }
+
+            return value_at(idx);
+        }
+
+        ValueType& operator[](KeyType key)
+        {
+            static_assert(std::is_default_constructible_v<ValueType>, "ValueType must be default-constructible");
+
+            const uint64_t h = hash(key);
+            size_t idx = find_slot(key, h);
+
+            if (idx == NOT_FOUND)
+            {
+                idx = prepare_insert(key, h);
+                new (&value_at(idx)) ValueType();
+            }
+
+            return value_at(idx);
+        }
+
+        size_t erase(KeyType key)
+        {
+            const size_t idx = find_slot(key);
+            if (idx == NOT_FOUND)
+                return 0;
+
+            if constexpr (!std::is_trivially_destructible_v<ValueType>)
+                value_at(idx).~ValueType();
+
+            // If there's an empty bucket within GROUP_SIZE positions on either side, no probe
+            // sequence could have seen a full group spanning this bucket, so it can be marked
+            // as empty rather than deleted
+            const size_t mask = bucket_count() - 1;
+            const uint32_t emptyBefore = match_empty((idx - GROUP_SIZE) & mask);
+            const uint32_t emptyAfter = match_empty(idx);
+            const bool wasNeverFull = emptyBefore && emptyAfter &&
+                (_lzcnt_u32(emptyBefore << 16) + _tzcnt_u32(emptyAfter) < GROUP_SIZE);
+
+            set_ctrl(idx, wasNeverFull ? CTRL_EMPTY : CTRL_DELETED);
+            m_growthLeft += wasNeverFull;
+            m_numEntries--;
+
+            return 1;
+        }
+
+        ZetaInline size_t bucket_count() const
+        {
+            return m_numBuckets;
+        }
+
+        ZetaInline size_t size() const
+        {
+            return m_numEntries;
+        }
+
+        ZetaInline float load_factor() const
+        {
+            return m_numBuckets == 0 ? 0.0f : (float)m_numEntries / m_numBuckets;
+        }
+
+        ZetaInline bool empty() const
+        {
+            return m_numEntries == 0;
+        }
+
+        void clear()
+        {
+            if (!m_numBuckets)
+                return;
+
+            destruct_values();
+
+            memset(m_ctrl, CTRL_EMPTY, m_numBuckets + GROUP_SIZE);
+            m_numEntries = 0;
+            m_growthLeft = max_num_entries(m_numBuckets);
+            // Don't free the memory
+        }
+
+        void free_memory()
+        {
+            if (!m_numBuckets)
+                return;
+
+            destruct_values();
+            m_allocator.FreeAligned(m_ctrl, allocation_size(m_numBuckets), ALLOCATION_ALIGNMENT);
+
+            m_ctrl = nullptr;
+            m_slots = nullptr;
+            m_values = nullptr;
+            m_numBuckets = 0;
+            m_numEntries = 0;
+            m_growthLeft = 0;
+        }
+
+        void swap(FlatHashTable& other)
+        {
+            std::swap(m_ctrl, other.m_ctrl);
+            std::swap(m_slots, other.m_slots);
+            std::swap(m_values, other.m_values);
+            std::swap(m_numBuckets, other.m_numBuckets);
+            std::swap(m_numEntries, other.m_numEntries);
+            std::swap(m_growthLeft, other.m_growthLeft);
+            std::swap(m_allocator, other.m_allocator);
+        }
+
+        ZetaInline Iterator begin_it()
+        {
+            return Iterator{ this, next_full(0) };
+        }
+
+        ZetaInline Iterator next_it(Iterator curr)
+        {
+            return Iterator{ this, next_full(curr.Idx + 1) };
+        }
+
+        ZetaInline Iterator end_it()
+        {
+            return Iterator{ this, m_numBuckets };
+        }
+
+    private:
+        static constexpr size_t MIN_NUM_BUCKETS = GROUP_SIZE;
+        // Maximum load factor of 7 / 8
+        static constexpr size_t MAX_LOAD_NUM = 7;
+        static constexpr size_t MAX_LOAD_DEN = 8;
+        static constexpr size_t NOT_FOUND = size_t(-1);
+        static constexpr size_t ALLOCATION_ALIGNMENT = Math::Max(GROUP_SIZE,
+            Math::Max(SLOT_ALIGNMENT, alignof(ValueType)));
+
+        static ZetaInline size_t max_num_entries(size_t numBuckets)
+        {
+            return numBuckets * MAX_LOAD_NUM / MAX_LOAD_DEN;
+        }
+
+        // Control bytes, followed by keys (or key-value pairs when values are small), followed
+        // by values (when values are large)
+        static ZetaInline size_t slots_offset(size_t numBuckets)
+        {
+            return Math::AlignUp(numBuckets + GROUP_SIZE, SLOT_ALIGNMENT);
+        }
+
+        static ZetaInline size_t values_offset(size_t numBuckets)
+        {
+            return Math::AlignUp(slots_offset(numBuckets) + numBuckets * SLOT_SIZE, alignof(ValueType));
+        }
+
+        static ZetaInline size_t allocation_size(size_t numBuckets)
+        {
+            return INLINE_VALUES ? slots_offset(numBuckets) + numBuckets * SLOT_SIZE :
+                values_offset(numBuckets) + numBuckets * sizeof(ValueType);
+        }
+
+        // Keys aren't assumed to be well-distributed, mix the bits so that both the lower 7 bits
+        // and the position bits depend on the whole key
+        static ZetaInline uint64_t hash(KeyType key)
+        {
+            uint64_t h = (uint64_t)key * 0x9e3779b97f4a7c15ull;
+            return h ^ (h >> 32);
+        }
+
+        static ZetaInline int8_t h2(uint64_t h)
+        {
+            return (int8_t)(h & 0x7f);
+        }
+
+        ZetaInline KeyType& key_at(size_t idx) const
+        {
+            if constexpr (INLINE_VALUES)
+                return reinterpret_cast<Slot*>(m_slots)[idx].Key;
+            else
+                return reinterpret_cast<KeyType*>(m_slots)[idx];
+        }
+
+        ZetaInline ValueType& value_at(size_t idx) const
+        {
+            if constexpr (INLINE_VALUES)
+                return reinterpret_cast<Slot*>(m_slots)[idx].Val;
+            else
+                return reinterpret_cast<ValueType*>(m_values)[idx];
+        }
+
+        ZetaInline __m128i load_group(size_t pos) const
+        {
+            return _mm_loadu_si128(reinterpret_cast<__m128i*>(m_ctrl + pos));
+        }
+
+        ZetaInline uint32_t match_empty(size_t pos) const
+        {
+            return _mm_movemask_epi8(_mm_cmpeq_epi8(load_group(pos), _mm_set1_epi8(CTRL_EMPTY)));
+        }
+
+        // Empty and deleted are the only control values with the sign bit set
+        ZetaInline uint32_t match_empty_or_deleted(size_t pos) const
+        {
+            return _mm_movemask_epi8(load_group(pos));
+        }
+
+        // The first GROUP_SIZE control bytes are mirrored after the last bucket, so that
+        // loading a group never needs to wrap around
+        ZetaInline void set_ctrl(size_t idx, int8_t c)
+        {
+            m_ctrl[idx] = c;
+            m_ctrl[((idx - GROUP_SIZE) & (m_numBuckets - 1)) + GROUP_SIZE] = c;
+        }
+
+        size_t find_slot(KeyType key) const
+        {
+            return find_slot(key, hash(key));
+        }
+
+        size_t find_slot(KeyType key, uint64_t h) const
+        {
+            if (m_numBuckets == 0)
+                return NOT_FOUND;
+
+            const size_t mask = m_numBuckets - 1;
+            const __m128i tag = _mm_set1_epi8(h2(h));
+            const __m128i empty = _mm_set1_epi8(CTRL_EMPTY);
+            size_t pos = (h >> 7) & mask;
+            size_t stride = 0;
+
+            while (true)
+            {
+                const __m128i group = load_group(pos);
+                uint32_t matches = _mm_movemask_epi8(_mm_cmpeq_epi8(group, tag));
+
+                while (matches)
+                {
+                    const size_t idx = (pos + _tzcnt_u32(matches)) & mask;
+                    if (key_at(idx) == key)
+                        return idx;
+
+                    matches &= matches - 1;
+                }
+
+                // Key would've been inserted into the first empty bucket along the probe sequence
+                if (_mm_movemask_epi8(_mm_cmpeq_epi8(group, empty)))
+                    return NOT_FOUND;
+
+                // Triangular probing visits every group when #buckets is a power of two
+                stride += GROUP_SIZE;
+                pos = (pos + stride) & mask;
+                Assert(stride <= m_numBuckets, "infinite loop");
+            }
+        }
+
+        // Returns the first empty or deleted bucket along the probe sequence
+        size_t find_first_non_full(uint64_t h) const
+        {
+            const size_t mask = m_numBuckets - 1;
+            size_t pos = (h >> 7) & mask;
+            size_t stride = 0;
+
+            while (true)
+            {
+                const uint32_t available = match_empty_or_deleted(pos);
+                if (available)
+                    return (pos + _tzcnt_u32(available)) & mask;
+
+                stride += GROUP_SIZE;
+                pos = (pos + stride) & mask;
+                Assert(stride <= m_numBuckets, "infinite loop");
+            }
+        }
+
+        // Claims a bucket for the given key, which is assumed not to be in the table. Caller
+        // is responsible for constructing the value.
+        size_t prepare_insert(KeyType key, uint64_t h)
+        {
+            size_t idx = m_numBuckets ? find_first_non_full(h) : NOT_FOUND;
+
+            // Reusing a deleted bucket doesn't affect the growth budget
+            if (idx == NOT_FOUND || (m_growthLeft == 0 && m_ctrl[idx] == CTRL_EMPTY))
+            {
+                // When a large fraction of the table is tombstones, rehash into a table of the
+                // same size to get rid of them. Otherwise, grow.
+                const bool manyTombstones = m_numEntries * 32 <= m_numBuckets * 25;
+                const size_t n = m_numBuckets == 0 ? MIN_NUM_BUCKETS :
+                    (manyTombstones ? m_numBuckets : m_numBuckets << 1);
+                rehash(n);
+                idx = find_first_non_full(h);
+            }
+
+            m_growthLeft -= m_ctrl[idx] == CTRL_EMPTY;
+            set_ctrl(idx, h2(h));
+            key_at(idx) = key;
+            m_numEntries++;
+
+            return idx;
+        }
+
+        ZetaInline size_t next_full(size_t idx) const
+        {
+            while (idx < m_numBuckets)
+            {
+                const uint32_t full = ~match_empty_or_deleted(idx) & 0xffff;
+                if (full)
+                    return Math::Min(idx + _tzcnt_u32(full), m_numBuckets);
+
+                idx += GROUP_SIZE;
+            }
+
+            return m_numBuckets;
+        }
+
+        void destruct_values()
+        {
+            if constexpr (!std::is_trivially_destructible_v<ValueType>)
+            {
+                for (size_t i = next_full(0); i < m_numBuckets; i = next_full(i + 1))
+                    value_at(i).~ValueType();
+            }
+        }
+
+        // Moves all the entries to a new table with n buckets. Deleted buckets are dropped.
+        void rehash(size_t n)
+        {
+            Assert(Math::IsPow2(n) && n >= MIN_NUM_BUCKETS, "n must be a power of two.");
+            Assert(max_num_entries(n) > m_numEntries, "n is too small.");
+
+            uint8_t* oldMem = reinterpret_cast<uint8_t*>(m_ctrl);
+            uint8_t* oldSlots = m_slots;
+            uint8_t* oldValues = m_values;
+            const size_t oldNumBuckets = m_numBuckets;
+            const size_t numEntries = m_numEntries;
+
+            uint8_t* mem = reinterpret_cast<uint8_t*>(m_allocator.AllocateAligned(allocation_size(n),
+                ALLOCATION_ALIGNMENT));
+            m_ctrl = reinterpret_cast<int8_t*>(mem);
+            m_slots = mem + slots_offset(n);
+            m_values = INLINE_VALUES ? nullptr : mem + values_offset(n);
+            m_numBuckets = n;
+            m_growthLeft = max_num_entries(n) - numEntries;
+            memset(m_ctrl, CTRL_EMPTY, n + GROUP_SIZE);
+
+            for (size_t i = 0; i < oldNumBuckets; i++)
+            {
+                if (reinterpret_cast<int8_t*>(oldMem)[i] < 0)
+                    continue;
+
+                KeyType& oldKey = INLINE_VALUES ? reinterpret_cast<Slot*>(oldSlots)[i].Key :
+                    reinterpret_cast<KeyType*>(oldSlots)[i];
+                ValueType& oldVal = [&]() -> ValueType&
+                    {
+                        if constexpr (INLINE_VALUES)
+                            return reinterpret_cast<Slot*>(oldSlots)[i].Val;
+                        else
+                            return reinterpret_cast<ValueType*>(oldValues)[i];
+                    }();
+
+                const uint64_t h = hash(oldKey);
+                const size_t idx = find_first_non_full(h);
+                set_ctrl(idx, h2(h));
+                key_at(idx) = oldKey;
+                new (&value_at(idx)) ValueType(ZetaMove(oldVal));
+
+                if constexpr (!std::is_trivially_destructible_v<ValueType>)
+                    oldVal.~ValueType();
+            }
+
+            if (oldMem)
+                m_allocator.FreeAligned(oldMem, allocation_size(oldNumBuckets), ALLOCATION_ALIGNMENT);
+        }
+
+        int8_t* m_ctrl = nullptr;
+        uint8_t* m_slots = nullptr;
+        uint8_t* m_values = nullptr;
+        size_t m_numBuckets = 0;
+        size_t m_numEntries = 0;
+        // Number of entries that can be inserted into empty buckets before the table is full
+        size_t m_growthLeft = 0;
+#if defined(ZETA_HAS_NO_UNIQUE_ADDRESS)
+        [[msvc::no_unique_address]] Allocator m_allocator;
+#else
+        Allocator m_allocator;
+#endif
+    };
+}
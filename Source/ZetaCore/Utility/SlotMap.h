@@ -0,0 +1,151 @@
+#pragma once
+
+#include "SmallVector.h"
+#include "Optional.h"
+
+namespace ZetaRay::Util
+{
+    // Generational index into a SlotMap. Remains valid until its element is erased, after
+    // which lookups with it fail rather than returning whatever element reused the slot.
+    struct SlotHandle
+    {
+        static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+
+        ZetaInline bool IsValid() const { return Index != INVALID_INDEX; }
+        ZetaInline bool operator==(const SlotHandle& other) const = default;
+
+        uint32_t Index = INVALID_INDEX;
+        uint32_t Generation = 0;
+    };
+
+    // Array of slots addressed by SlotHandle, where lookup is a bounds check, a generation
+    // comparison and an array access.
+    //
+    //  - Every slot has a generation that is odd while it's occupied and even while it's
+    //    free. Erased slots are pushed onto a free list and reused by later insertions.
+    //  - Elements are never moved due to insertions or erasures of other elements, so handles
+    //    don't need to be updated, but pointers are invalidated when the slot array grows.
+    //  - Not thread-safe
+    template<typename T, Support::AllocatorType Allocator = Support::SystemAllocator>
+    class SlotMap
+    {
+        static_assert(std::is_default_constructible_v<T>, "T is not default-constructible.");
+        static_assert(std::is_move_assignable_v<T>, "T is not move-assignable.");
+
+        static constexpr uint32_t END_OF_FREE_LIST = UINT32_MAX;
+
+        struct Slot
+        {
+            T Val;
+            uint32_t Generation;
+            uint32_t NextFree;
+        };
+
+    public:
+        explicit SlotMap(const Allocator& a = Allocator())
+            : m_slots(a)
+        {}
+
+        template<typename... Args>
+        SlotHandle emplace(Args&&... args)
+        {
+            uint32_t idx = m_freeHead;
+
+            if (idx != END_OF_FREE_LIST)
+            {
+                Slot& slot = m_slots[idx];
+                m_freeHead = slot.NextFree;
+                slot.Val = T(ZetaForward(args)...);
+                slot.Generation++;
+            }
+            else
+            {
+                Check(m_slots.size() < SlotHandle::INVALID_INDEX, "Number of slots exceeded maximum allowed.");
+                idx = (uint32_t)m_slots.size();
+                m_slots.push_back(Slot{ .Val = T(ZetaForward(args)...), .Generation = 1, .NextFree = END_OF_FREE_LIST });
+            }
+
+            m_size++;
+
+            return SlotHandle{ .Index = idx, .Generation = m_slots[idx].Generation };
+        }
+        ZetaInline SlotHandle insert(const T& val) { return emplace(val); }
+        ZetaInline SlotHandle insert(T&& val) { return emplace(ZetaMove(val)); }
+
+        bool erase(SlotHandle h)
+        {
+            if (!contains(h))
+                return false;
+
+            Slot& slot = m_slots[h.Index];
+            slot.Val = T();
+            slot.Generation++;
+            slot.NextFree = m_freeHead;
+            m_freeHead = h.Index;
+            m_size--;
+
+            return true;
+        }
+
+        ZetaInline bool contains(SlotHandle h) const
+        {
+            return h.Index < m_slots.size() && m_slots[h.Index].Generation == h.Generation;
+        }
+        ZetaInline Optional<T*> find(SlotHandle h)
+        {
+            if (contains(h))
+                return &m_slots[h.Index].Val;
+
+            return {};
+        }
+        ZetaInline Optional<const T*> find(SlotHandle h) const
+        {
+            if (contains(h))
+                return &m_slots[h.Index].Val;
+
+            return {};
+        }
+        // Handle must refer to an existing element
+        ZetaInline T& operator[](SlotHandle h)
+        {
+            Assert(contains(h), "Invalid or stale handle (index: %u, generation: %u).", h.Index, h.Generation);
+            return m_slots[h.Index].Val;
+        }
+        ZetaInline const T& operator[](SlotHandle h) const
+        {
+            Assert(contains(h), "Invalid or stale handle (index: %u, generation: %u).", h.Index, h.Generation);
+            return m_slots[h.Index].Val;
+        }
+
+        // Calls f(SlotHandle, T&) for every element in slot order
+        template<typename F>
+        void for_each(F f)
+        {
+            for (uint32_t i = 0; i < (uint32_t)m_slots.size(); i++)
+            {
+                Slot& slot = m_slots[i];
+                if (slot.Generation & 0x1)
+                    f(SlotHandle{ .Index = i, .Generation = slot.Generation }, slot.Val);
+            }
+        }
+
+        ZetaInline size_t size() const { return m_size; }
+        ZetaInline bool empty() const { return m_size == 0; }
+        // Number of slots, including the free ones
+        ZetaInline size_t capacity() const { return m_slots.size(); }
+        ZetaInline void reserve(size_t n) { m_slots.reserve(n); }
+
+        // Generations restart, so handles from before the call must not be used afterwards
+        void clear()
+        {
+            m_slots.clear();
+            m_freeHead = END_OF_FREE_LIST;
+            m_size = 0;
+        }
+
+    private:
+        SmallVector<Slot, Allocator> m_slots;
+        uint32_t m_freeHead = END_OF_FREE_LIST;
+        uint32_t m_size = 0;
+    };
+}
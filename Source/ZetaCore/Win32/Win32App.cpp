@@ -8,6 +8,7 @@
 #include "../Scene/SceneCore.h"
 #include "../Scene/Camera.h"
 #include "../Support/ThreadPool.h"
+#include "../Support/ThreadCachingPool.h"
 #include "../Assets/Font/Font.h"
 #include "../Assets/Font/IconsFontAwesome6.h"
 
@@ -130,7 +131,6 @@ namespace
         inline static constexpr const char* DXC_PATH = "..\\Tools\\dxc\\bin\\x64\\dxc.exe";
         inline static constexpr const char* RENDER_PASS_DIR = "..\\Source\\ZetaRenderPass";
         static constexpr int NUM_BACKGROUND_THREADS = 2;
-        static constexpr int MAX_NUM_TASKS_PER_FRAME = 256;
         static constexpr int CLIPBOARD_LEN = 128;
         static constexpr int FRAME_ALLOCATOR_BLOCK_SIZE = FRAME_ALLOCATOR_MAX_ALLOCATION_SIZE;
 
@@ -140,11 +140,13 @@ namespace
             std::atomic_bool BlockFlag;
         };
 
-        TaskSignal m_registeredTasks[MAX_NUM_TASKS_PER_FRAME];
+        // Indexed by task signal handle, grows on demand to the number of tasks per frame
+        SegmentedArray<TaskSignal> m_registeredTasks;
 
         FrameMemoryContext m_frameMemoryContext;
         Camera m_camera;
         FrameMemory<FRAME_ALLOCATOR_BLOCK_SIZE> m_frameMemory;
+        ThreadCachingPool m_memoryPool;
         ThreadPool m_workerThreadPool;
         ThreadPool m_backgroundThreadPool;
         RendererCore m_renderer;
@@ -643,6 +645,8 @@ namespace ZetaRay::AppImpl
         g_app->m_frameStats.emplace_back("GPU", "VRAM Usage (MB)", memoryInfo.CurrentUsage >> 20);
         g_app->m_frameStats.emplace_back("GPU", "VRAM Budget (MB)", memoryInfo.Budget >> 20);
         g_app->m_frameStats.emplace_back("Frame", "Frame temp memory usage (kb)", tempMemoryUsage >> 10);
+
+        g_app->m_memoryPool.AddFrameStats("Memory Pool");
     }
 
     void Update(TaskSet& sceneTS, TaskSet& sceneRendererTS, size_t tempMemoryUsage)
@@ -1597,7 +1601,7 @@ namespace ZetaRay
 
             // at this point, all worker tasks from previous frame are done (GPU may still 
             // be executing those though)
-            g_app->m_currTaskSignalIdx.store(0, std::memory_order_relaxed);
+            App::ResetTaskSignals();
             const size_t tempMemoryUsed = g_app->m_frameMemory.TotalSize();
 
             // Skip first frame
@@ -1696,22 +1700,39 @@ namespace ZetaRay
             g_app->m_frameMemoryContext, size, alignment);
     }
 
+    void* App::AllocateMemoryPool(size_t size, size_t alignment)
+    {
+        return g_app->m_memoryPool.AllocateAligned(size, alignment);
+    }
+
+    void App::FreeMemoryPool(void* mem, size_t size, size_t alignment)
+    {
+        g_app->m_memoryPool.FreeAligned(mem, size, alignment);
+    }
+
     int App::RegisterTask()
     {
         int idx = g_app->m_currTaskSignalIdx.fetch_add(1, std::memory_order_relaxed);
-        Assert(idx < AppData::MAX_NUM_TASKS_PER_FRAME,
-            "Number of task signals exceeded MAX_NUM_TASKS_PER_FRAME.");
+        g_app->m_registeredTasks.GetOrAlloc(idx);
 
         return idx;
     }
 
+    void App::ResetTaskSignals()
+    {
+        g_app->m_currTaskSignalIdx.store(0, std::memory_order_relaxed);
+    }
+
     void App::TaskFinalizedCallback(int handle, int indegree)
     {
         Assert(indegree > 0, "Redundant call.");
         const int c = g_app->m_currTaskSignalIdx.load(std::memory_order_relaxed);
         Assert(handle < c, "Received handle %d while #handles for current frame is %d.", c);
 
-        g_app->m_registeredTasks[handle].Indegree.store(indegree, std::memory_order_release);
+        // +1 for submission of the task itself, which is signalled by the thread pool
+        // after the task has been enqueued (or parked). This way, the last signal is 
+        // always observed after the task has been handed to the thread pool.
+        g_app->m_registeredTasks[handle].Indegree.store(indegree + 1, std::memory_order_release);
         g_app->m_registeredTasks[handle].BlockFlag.store(true, std::memory_order_release);
     }
 
@@ -1734,17 +1755,25 @@ namespace ZetaRay
     void App::SignalAdjacentTailNodes(Span<int> taskIDs)
     {
         for (auto handle : taskIDs)
+            App::SignalTailNode(handle);
+    }
+
+    bool App::SignalTailNode(int handle)
+    {
+        auto& taskSignal = g_app->m_registeredTasks[handle];
+        const int remaining = taskSignal.Indegree.fetch_sub(1, std::memory_order_acq_rel);
+        Assert(remaining > 0, "Invalid task indegree.");
+
+        // this was the last dependency, unblock the task
+        if (remaining == 1)
         {
-            auto& taskSignal = g_app->m_registeredTasks[handle];
-            const int remaining = taskSignal.Indegree.fetch_sub(1, std::memory_order_acquire);
+            taskSignal.BlockFlag.store(false, std::memory_order_release);
+            taskSignal.BlockFlag.notify_one();
 
-            // this was the last dependency, unblock the task
-            if (remaining == 1)
-            {
-                taskSignal.BlockFlag.store(false, std::memory_order_release);
-                taskSignal.BlockFlag.notify_one();
-            }
+            return true;
         }
+
+        return false;
     }
 
     void App::Submit(Task&& t)
@@ -1784,6 +1813,17 @@ namespace ZetaRay
             success = g_app->m_backgroundThreadPool.TryFlush();
     }
 
+    void App::SetWorkerSchedulingMode(SCHEDULING_MODE mode)
+    {
+        App::FlushWorkerThreadPool();
+        g_app->m_workerThreadPool.SetSchedulingMode(mode);
+    }
+
+    void App::ParallelFor(size_t begin, size_t end, size_t grain, ParallelForFn fn, void* ctx)
+    {
+        g_app->m_workerThreadPool.ParallelFor(begin, end, grain, fn, ctx);
+    }
+
     RendererCore& App::GetRenderer() { return g_app->m_renderer; }
     SceneCore& App::GetScene() { return g_app->m_scene; }
     const Camera& App::GetCamera() { return g_app->m_camera; }
@@ -63,4 +63,40 @@ uint32_t Common::CheckIntrinsicSupport()
         ret |= CPU_Intrinsic::BMI1;
 
     return ret;
-}
\ No newline at end of file
+}
+
+size_t Common::GetPageSize()
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+
+    return info.dwPageSize;
+}
+
+void* Common::ReserveVirtualMemory(size_t size)
+{
+    void* mem = VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_NOACCESS);
+    Check(mem, "VirtualAlloc() for reserving %llu bytes failed with the following error code: %d.", 
+        size, GetLastError());
+
+    return mem;
+}
+
+void Common::CommitVirtualMemory(void* mem, size_t size)
+{
+    void* ret = VirtualAlloc(mem, size, MEM_COMMIT, PAGE_READWRITE);
+    Check(ret, "VirtualAlloc() for committing %llu bytes failed with the following error code: %d.", 
+        size, GetLastError());
+}
+
+void Common::DecommitVirtualMemory(void* mem, size_t size)
+{
+    const bool ret = VirtualFree(mem, size, MEM_DECOMMIT);
+    Check(ret, "VirtualFree() failed with the following error code: %d.", GetLastError());
+}
+
+void Common::ReleaseVirtualMemory(void* mem)
+{
+    const bool ret = VirtualFree(mem, 0, MEM_RELEASE);
+    Check(ret, "VirtualFree() failed with the following error code: %d.", GetLastError());
+}
@@ -1,4 +1,5 @@
 #include "../App/Filesystem.h"
+#include "../Math/Common.h"
 #include "../Support/MemoryArena.h"
 #include "Win32.h"
 
@@ -103,6 +104,52 @@ void Filesystem::WriteToFile(const char* path, uint8_t* data, uint32_t sizeInByt
     CloseHandle(h);
 }
 
+bool Filesystem::WriteToFile(const char* path, Span<MemoryRegion> regions)
+{
+    Assert(path, "path argument was NULL.");
+
+    HANDLE h = CreateFileA(path,
+        GENERIC_WRITE,
+        0,
+        nullptr,
+        CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+        nullptr);
+
+    if (h == INVALID_HANDLE_VALUE)
+        return false;
+
+    for (auto& r : regions)
+    {
+        const uint8_t* curr = reinterpret_cast<const uint8_t*>(r.Data);
+        size_t remaining = r.SizeInBytes;
+
+        // WriteFile() size argument is 32 bits
+        while (remaining)
+        {
+            const DWORD toWrite = (DWORD)Math::Min(remaining, size_t(1) << 30);
+            DWORD numWritten;
+            bool success = WriteFile(h, curr, toWrite, &numWritten, nullptr);
+
+            // E.g. disk is full -- don't leave a partially written file behind
+            if (!success || numWritten != toWrite)
+            {
+                CloseHandle(h);
+                DeleteFileA(path);
+
+                return false;
+            }
+
+            curr += toWrite;
+            remaining -= toWrite;
+        }
+    }
+
+    CloseHandle(h);
+
+    return true;
+}
+
 void Filesystem::RemoveFile(const char* path)
 {
     Assert(path, "path argument was NULL.");
@@ -176,6 +223,13 @@ bool Filesystem::Copy(const char* path, const char* newPath, bool overwrite)
     return true;
 }
 
+bool Filesystem::Rename(const char* path, const char* newPath)
+{
+    Assert(path && newPath, "path argument was NULL.");
+
+    return MoveFileExA(path, newPath, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+}
+
 bool Filesystem::IsDirectory(const char* path)
 {
     Assert(path, "path argument was NULL.");
@@ -192,3 +246,130 @@ bool Filesystem::IsDirectory(const char* path)
 
     return ret & FILE_ATTRIBUTE_DIRECTORY;
 }
+
+uint64_t Filesystem::GetLastWriteTime(const char* path)
+{
+    Assert(path, "path argument was NULL.");
+
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &data))
+        return 0;
+
+    return ((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+}
+
+//--------------------------------------------------------------------------------------
+// MemoryMappedFile
+//--------------------------------------------------------------------------------------
+
+Filesystem::MemoryMappedFile::~MemoryMappedFile()
+{
+    Close();
+}
+
+Filesystem::MemoryMappedFile::MemoryMappedFile(MemoryMappedFile&& other)
+    : m_file(other.m_file),
+    m_mapping(other.m_mapping),
+    m_data(other.m_data),
+    m_size(other.m_size)
+{
+    other.m_file = nullptr;
+    other.m_mapping = nullptr;
+    other.m_data = nullptr;
+    other.m_size = 0;
+}
+
+Filesystem::MemoryMappedFile& Filesystem::MemoryMappedFile::operator=(MemoryMappedFile&& other)
+{
+    if (this == &other)
+        return *this;
+
+    Close();
+
+    m_file = other.m_file;
+    m_mapping = other.m_mapping;
+    m_data = other.m_data;
+    m_size = other.m_size;
+
+    other.m_file = nullptr;
+    other.m_mapping = nullptr;
+    other.m_data = nullptr;
+    other.m_size = 0;
+
+    return *this;
+}
+
+bool Filesystem::MemoryMappedFile::Open(const char* path)
+{
+    Assert(path, "path argument was NULL.");
+    Assert(!m_data, "File is already open.");
+
+    HANDLE h = CreateFileA(path,
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    if (h == INVALID_HANDLE_VALUE)
+    {
+        auto e = GetLastError();
+        Check(e == ERROR_FILE_NOT_FOUND || e == ERROR_PATH_NOT_FOUND,
+            "CreateFile() for path %s failed with the following error code: %d.", path, e);
+
+        return false;
+    }
+
+    LARGE_INTEGER s;
+    bool success = GetFileSizeEx(h, &s);
+    Check(success, "GetFileSizeEx() for path %s failed with the following error code: %d.",
+        path, GetLastError());
+
+    // Empty files can't be mapped
+    if (s.QuadPart == 0)
+    {
+        CloseHandle(h);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(h, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    Check(mapping, "CreateFileMapping() for path %s failed with the following error code: %d.",
+        path, GetLastError());
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+    Check(view, "MapViewOfFile() for path %s failed with the following error code: %d.",
+        path, GetLastError());
+
+    m_file = h;
+    m_mapping = mapping;
+    m_data = reinterpret_cast<uint8_t*>(view);
+    m_size = s.QuadPart;
+
+    return true;
+}
+
+void Filesystem::MemoryMappedFile::Prefetch()
+{
+    if (!m_data)
+        return;
+
+    WIN32_MEMORY_RANGE_ENTRY range{ .VirtualAddress = m_data, .NumberOfBytes = m_size };
+
+    // Only a hint, failure just means pages are read on demand
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+void Filesystem::MemoryMappedFile::Close()
+{
+    if (m_data)
+        UnmapViewOfFile(m_data);
+    if (m_mapping)
+        CloseHandle(m_mapping);
+    if (m_file)
+        CloseHandle(m_file);
+
+    m_file = nullptr;
+    m_mapping = nullptr;
+    m_data = nullptr;
+    m_size = 0;
+}
@@ -69,24 +69,40 @@ namespace Light
 #endif
     }
 
+    // See RT::EmissiveLumenAliasTableEntry for the table layout
     struct AliasTableSample
     {
         static AliasTableSample get(StructuredBuffer<RT::EmissiveLumenAliasTableEntry> g_aliasTable, 
             uint numEmissiveTriangles, inout RNG rng)
         {
+            RT::EmissiveLumenAliasTableEntry header = g_aliasTable[numEmissiveTriangles];
+            const float rcpTotalPower = header.CachedP_Orig;
+            const uint numInstances = asuint(header.CachedP_Alias);
+
+            // Sample an instance
+            uint u0 = rng.UniformUintBounded(numInstances);
+            RT::EmissiveLumenAliasTableEntry s = g_aliasTable[numEmissiveTriangles + 1 + u0];
+
+            if (rng.Uniform() >= s.P_Curr)
+                s = g_aliasTable[numEmissiveTriangles + 1 + s.Alias];
+
+            const uint baseTriOffset = asuint(s.CachedP_Orig);
+            const uint numTris = asuint(s.CachedP_Alias);
+
+            // Sample a triangle from that instance
             AliasTableSample ret;
-            uint u0 = rng.UniformUintBounded(numEmissiveTriangles);
-            RT::EmissiveLumenAliasTableEntry s = g_aliasTable[u0];
+            u0 = baseTriOffset + rng.UniformUintBounded(numTris);
+            s = g_aliasTable[u0];
 
             if (rng.Uniform() < s.P_Curr)
             {
-                ret.pdf = s.CachedP_Orig;
+                ret.pdf = s.CachedP_Orig * rcpTotalPower;
                 ret.idx = u0;
 
                 return ret;
             }
 
-            ret.pdf = s.CachedP_Alias;
+            ret.pdf = s.CachedP_Alias * rcpTotalPower;
             ret.idx = s.Alias;
 
             return ret;
@@ -96,6 +112,14 @@ namespace Light
         float pdf;
     };
 
+    // Probability of AliasTableSample::get() returning given emissive triangle
+    float EmissiveTriPdf(StructuredBuffer<RT::EmissiveLumenAliasTableEntry> g_aliasTable, 
+        uint numEmissiveTriangles, uint emissiveTriIdx)
+    {
+        return g_aliasTable[emissiveTriIdx].CachedP_Orig * 
+            g_aliasTable[numEmissiveTriangles].CachedP_Orig;
+    }
+
     RT::PresampledEmissiveTriangle SamplePresampledSet(uint sampleSetIdx, 
         StructuredBuffer<RT::PresampledEmissiveTriangle> g_sampleSets, 
         uint sampleSetSize, inout RNG rng)
@@ -78,7 +78,8 @@ Reservoir RIS_InitialCandidates(uint2 DTid, float3 pos, float3 normal, float rou
             // Light is backfacing
             if(dot(-wi, lightNormal) > 0)
             {
-                const float lightSourcePdf = g_aliasTable[hitInfo.emissiveTriIdx].CachedP_Orig;
+                const float lightSourcePdf = Light::EmissiveTriPdf(g_aliasTable, 
+                    g_frame.NumEmissiveTriangles, hitInfo.emissiveTriIdx);
                 const float pdf_light = lightSourcePdf * (1.0f / (0.5f * twoArea));
 
                 // solid angle measure to area measure
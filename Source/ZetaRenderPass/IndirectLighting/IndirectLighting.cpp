@@ -112,28 +112,22 @@ void IndirectLighting::InitPSOs()
     auto samplers = App::GetRenderer().GetStaticSamplers();
     RenderPassBase::InitRenderPass("IndirectLighting", flags, samplers);
 
-    constexpr int NumTaskSets = CeilUnsignedIntDiv((int)SHADER::COUNT,
-        TaskSet::MAX_NUM_TASKS);
-    TaskSet ts[NumTaskSets];
-    int i = 0;
+    TaskSet ts;
 
-    for (int t = 0; t < NumTaskSets; t++)
+    for (int i = 0; i < (int)SHADER::COUNT; i++)
     {
-        for (; i < Min(TaskSet::MAX_NUM_TASKS * (t + 1), (int)SHADER::COUNT); i++)
-        {
-            StackStr(buff, n, "IndirectShader_%d", i);
-
-            ts[t].EmplaceTask(buff, [i, this]()
-                {
-                    m_psoLib.CompileComputePSO_MT(i, m_rootSigObj.Get(),
-                        COMPILED_CS[i]);
-                });
-        }
+        StackStr(buff, n, "IndirectShader_%d", i);
 
-        ts[t].Sort();
-        ts[t].Finalize();
-        App::Submit(ZetaMove(ts[t]));
+        ts.EmplaceTask(buff, [i, this]()
+            {
+                m_psoLib.CompileComputePSO_MT(i, m_rootSigObj.Get(),
+                    COMPILED_CS[i]);
+            });
     }
+
+    ts.Sort();
+    ts.Finalize();
+    App::Submit(ZetaMove(ts));
 }
 
 void IndirectLighting::Init(INTEGRATOR method)
@@ -48,7 +48,7 @@ namespace RGI_Util
                     -lightNormal : lightNormal;
 
                 const float lightSourcePdf = numLightSamples > 0 ?
-                    globals.aliasTable[hitInfo.emissiveTriIdx].CachedP_Orig : 
+                    Light::EmissiveTriPdf(globals.aliasTable, numEmissives, hitInfo.emissiveTriIdx) : 
                     0;
                 const float lightPdf = lightSourcePdf * (2.0f / twoArea);
 
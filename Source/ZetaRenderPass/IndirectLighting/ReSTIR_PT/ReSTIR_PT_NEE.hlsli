@@ -132,7 +132,7 @@ namespace RPT_Util
     }
 
     ReSTIR_Util::DirectLightingEstimate NEE_Bsdf(float3 pos, float3 normal, 
-        BSDF::ShadingData surface, int nextBounce, ReSTIR_Util::Globals globals, 
+        BSDF::ShadingData surface, int nextBounce, uint numEmissives, ReSTIR_Util::Globals globals, 
         uint emissiveMapsDescHeapOffset, out BSDF::BSDFSample bsdfSample, 
         out RtRayQuery::Hit_Emissive hitInfo, inout RNG rng)
     {
@@ -174,7 +174,7 @@ namespace RPT_Util
             if(!specular)
             {
                 const float lightSourcePdf = numLightSamples > 0 ?
-                    globals.aliasTable[hitInfo.emissiveTriIdx].CachedP_Orig : 
+                    Light::EmissiveTriPdf(globals.aliasTable, numEmissives, hitInfo.emissiveTriIdx) : 
                     0;
                 lightPdf = twoArea > 0 ? lightSourcePdf * (2.0f / twoArea) : 0;
             }
@@ -234,6 +234,7 @@ namespace RPT_Util
 
         // Deterministic RNG state regardless of USE_PRESAMPLED_SETS
         rng.Uniform3D();
+        rng.Uniform2D();
 #else
         Light::AliasTableSample entry = Light::AliasTableSample::get(globals.aliasTable, 
             numEmissives, rng);
@@ -119,7 +119,7 @@ void EstimateDirectAndUpdateRC(int16 pathVertex, float3 pos, Hit hitInfo,
 
         // BSDF sampling
         DirectLightingEstimate ls_b = RPT_Util::NEE_Bsdf(pos, hitInfo.normal, surface, 
-            nextBounce, globals, g_frame.EmissiveMapsDescHeapOffset, nextBsdfSample, 
+            nextBounce, g_frame.NumEmissiveTriangles, globals, g_frame.EmissiveMapsDescHeapOffset, nextBsdfSample, 
             nextHit, rngReplay);
 
         if(nextHit.HitWasEmissive())
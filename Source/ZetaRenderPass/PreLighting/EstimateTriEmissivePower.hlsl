@@ -8,6 +8,7 @@
 // Root Signature
 //--------------------------------------------------------------------------------------
 
+ConstantBuffer<cbEstimatePower> g_local : register(b0);
 ConstantBuffer<cbFrameConstants> g_frame : register(b1);
 StructuredBuffer<RT::EmissiveTriangle> g_emissvies : register(t0);
 StructuredBuffer<float2> g_halton : register(t2);
@@ -31,11 +32,15 @@ float TriangleArea(float3 vtx0, float3 vtx1, float3 vtx2)
 void main(uint3 DTid : SV_DispatchThreadID, uint3 Gid : SV_GroupID, uint Gidx : SV_GroupIndex)
 {
     const uint wave = Gidx / ESTIMATE_TRI_POWER_WAVE_LEN;
-    const uint triIdx = Gid.x * ESTIMATE_TRI_POWER_NUM_TRIS_PER_GROUP + wave;
+    // Only triangles in [BaseTriOffset, BaseTriOffset + NumTriangles) are processed, results 
+    // are written relative to BaseTriOffset
+    const uint localIdx = Gid.x * ESTIMATE_TRI_POWER_NUM_TRIS_PER_GROUP + wave;
 
-    if (triIdx >= g_frame.NumEmissiveTriangles)
+    if (localIdx >= g_local.NumTriangles)
         return;
 
+    const uint triIdx = g_local.BaseTriOffset + localIdx;
+
     const uint laneIdx = WaveGetLaneIndex();
     const RT::EmissiveTriangle tri = g_emissvies[triIdx];
     uint emissiveTex = tri.GetTex();
@@ -75,5 +80,5 @@ void main(uint3 DTid : SV_DispatchThreadID, uint3 Gid : SV_GroupID, uint Gidx :
     float mcEstimate = pdf > 0 ? Math::Luminance(power) * PI / (pdf * ESTIMATE_TRI_POWER_NUM_SAMPLES_PER_TRI) : 0;
 
     if (laneIdx == 0)
-        g_power[triIdx] = mcEstimate;
+        g_power[localIdx] = mcEstimate;
 }
\ No newline at end of file
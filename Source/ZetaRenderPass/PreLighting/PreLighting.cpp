@@ -9,6 +9,7 @@
 #include <Support/Task.h>
 #include <App/Timer.h>
 #include <App/Log.h>
+#include <algorithm>
 
 using namespace ZetaRay;
 using namespace ZetaRay::Core;
@@ -23,138 +24,125 @@ using namespace ZetaRay::Math;
 
 namespace
 {
-    // Ref: https://www.keithschwarz.com/darts-dice-coins/
-    void BuildAliasTable(MutableSpan<float> probs, MutableSpan<RT::EmissiveLumenAliasTableEntry> table)
-    {
-        const int64_t N = probs.size();
-        const float oneDivN = 1.0f / N;
-        AliasTable_Normalize(probs);
+    using EmissiveInstance = Model::glTF::Asset::EmissiveInstance;
 
-        for (int64_t i = 0; i < N; i++)
-        {
-            table[i].CachedP_Orig = probs[i] * oneDivN;
-#ifndef NDEBUG
-            table[i].Alias = UINT32_MAX;
-#endif
-        }
+    // Builds an alias table over the triangles of one emissive instance and returns the instance 
+    // power. Probabilities are left unnormalized, see RT::EmissiveLumenAliasTableEntry.
+    float BuildInstanceAliasTable(Span<float> triPower, uint32_t baseTriOffset, bool useWorkers,
+        SmallVector<AliasTableEntry>& scratch, MutableSpan<RT::EmissiveLumenAliasTableEntry> table)
+    {
+        double sum = 0.0;
+        for (auto p : triPower)
+            sum += p;
 
-        struct TempAllocator
+        // Never sampled by the top level, but entries should remain valid
+        if (sum == 0.0)
         {
-            void* AllocateAligned(size_t size, size_t alignment)
+            for (size_t i = 0; i < triPower.size(); i++)
             {
-                m_offset += size;
-                Assert(m_offset <= m_sizeInBytes, "bug");
-
-                return m_memPtr;
+                table[i] = RT::EmissiveLumenAliasTableEntry{ .CachedP_Orig = 0.0f,
+                    .CachedP_Alias = 0.0f,
+                    .P_Curr = 1.0f,
+                    .Alias = baseTriOffset + (uint32_t)i };
             }
 
-            ZetaInline void FreeAligned(void* mem, size_t size, size_t alignment)
-            {}
-
-            void* m_memPtr;
-            size_t m_sizeInBytes;
-            size_t m_offset = 0;
-        };
-
-        const size_t sizeInBytes = N * sizeof(uint32_t);
-        const size_t totalSizeInBytes = 2 * sizeInBytes;
-        App::OneTimeFrameAllocatorWithFallback allocator;
-        void* mem = allocator.AllocateAligned(totalSizeInBytes);
-
-        TempAllocator tempAllocator1{
-            .m_memPtr = mem,
-            .m_sizeInBytes = sizeInBytes };
-        TempAllocator tempAllocator2{
-            .m_memPtr = reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(mem) + sizeInBytes),
-            .m_sizeInBytes = sizeInBytes };
-
-        // maintain an index buffer since original ordering of elements must be preserved
-        SmallVector<uint32_t, TempAllocator> larger(tempAllocator1);
-        larger.reserve(N);
+            return 0.0f;
+        }
 
-        SmallVector<uint32_t, TempAllocator> smaller(tempAllocator2);
-        smaller.reserve(N);
+        scratch.resize(triPower.size());
+        AliasTable_BuildPartitioned(triPower, scratch, useWorkers);
 
-        for (int64_t i = 0; i < N; i++)
+        for (size_t i = 0; i < triPower.size(); i++)
         {
-            if (probs[i] < 1.0f)
-                smaller.push_back((uint32_t)i);
-            else
-                larger.push_back((uint32_t)i);
+            const AliasTableEntry& e = scratch[i];
+
+            table[i].CachedP_Orig = triPower[i];
+            table[i].CachedP_Alias = triPower[e.Alias];
+            table[i].P_Curr = e.P_Curr;
+            table[i].Alias = baseTriOffset + e.Alias;
         }
 
-#ifndef NDEBUG
-        int64_t numInsertions = 0;
-#endif
+        return (float)sum;
+    }
 
-        // in each iteration, pick two probabilities such that one is smaller than 1.0 and the other larger 
-        // than 1.0. Use the latter to bring up the former to 1.0.
-        while (!smaller.empty() && !larger.empty())
-        {
-            const uint32_t smallerIdx = smaller.back();
-            smaller.pop_back();
-            const float smallerProb = probs[smallerIdx];
+    // Rebuilds the alias tables of instances [begin, end). "table" starts at the first triangle
+    // of instance "begin".
+    void BuildInstanceAliasTables(Span<EmissiveInstance> instances, size_t begin, size_t end, 
+        Span<float> triPower, MutableSpan<float> instancePower,
+        MutableSpan<RT::EmissiveLumenAliasTableEntry> table)
+    {
+        constexpr size_t INSTANCES_PER_JOB = 32;
+        // Instances with at least this many triangles are built one at a time using all the workers
+        constexpr uint32_t LARGE_INSTANCE_NUM_TRIS = 16 * 1024;
 
-            const uint32_t largerIdx = larger.back();
-            float largerProb = probs[largerIdx];
-            Assert(largerProb >= 1.0f, "should be >= 1.0");
+        const uint32_t tableBase = instances[begin].BaseTriOffset;
 
-            RT::EmissiveLumenAliasTableEntry& e = table[smallerIdx];
-            Assert(e.Alias == uint32_t(-1), "Every element must be inserted exactly one time.");
-            e.Alias = largerIdx;
-            e.P_Curr = smallerProb;
+        auto build = [&instances, &triPower, &instancePower, &table, tableBase](size_t i, 
+            bool useWorkers, SmallVector<AliasTableEntry>& scratch)
+            {
+                const EmissiveInstance& instance = instances[i];
 
-            // = largerProb - (1.0f - smallerProb);
-            largerProb = (smallerProb + largerProb) - 1.0f;
-            probs[largerIdx] = largerProb;
+                instancePower[i] = BuildInstanceAliasTable(
+                    Span(triPower.data() + instance.BaseTriOffset, instance.NumTriangles),
+                    instance.BaseTriOffset,
+                    useWorkers,
+                    scratch,
+                    MutableSpan(table.data() + instance.BaseTriOffset - tableBase, instance.NumTriangles));
+            };
 
-            if (largerProb < 1.0f)
+        App::ParallelFor(begin, end, INSTANCES_PER_JOB, [&instances, &build](size_t b, size_t e)
             {
-                larger.pop_back();
-                smaller.push_back(largerIdx);
-            }
-
-#ifndef NDEBUG
-            numInsertions++;
-#endif
-        }
+                SmallVector<AliasTableEntry> scratch;
 
-        while (!larger.empty())
-        {
-            size_t idx = larger.back();
-            larger.pop_back();
-            //Assert(fabsf(1.0f - probs[idx]) <= 0.1f, "This should be ~1.0.");
+                for (size_t i = b; i < e; i++)
+                {
+                    if (instances[i].NumTriangles < LARGE_INSTANCE_NUM_TRIS)
+                        build(i, false, scratch);
+                }
+            });
 
-            // alias should point to itself
-            table[idx].Alias = (uint32_t)idx;
-            table[idx].P_Curr = 1.0f;
+        SmallVector<AliasTableEntry> scratch;
 
-#ifndef NDEBUG
-            numInsertions++;
-#endif
+        for (size_t i = begin; i < end; i++)
+        {
+            if (instances[i].NumTriangles >= LARGE_INSTANCE_NUM_TRIS)
+                build(i, true, scratch);
         }
+    }
 
-        while (!smaller.empty())
-        {
-            size_t idx = smaller.back();
-            smaller.pop_back();
-            //Assert(fabsf(1.0f - probs[idx]) <= 0.1f, "This should be ~1.0.");
+    // Top level is tiny compared to the triangle tables, so it's always rebuilt in full
+    void BuildTopLevelAliasTable(Span<EmissiveInstance> instances, Span<float> instancePower,
+        RT::EmissiveAliasTableHeader& header, MutableSpan<RT::EmissiveInstanceAliasTableEntry> table)
+    {
+        double totalPower = 0.0;
+        for (auto p : instancePower)
+            totalPower += p;
 
-            // alias should point to itself
-            table[idx].Alias = (uint32_t)idx;
-            table[idx].P_Curr = 1.0f;
+        header.RcpTotalPower = totalPower > 0.0 ? (float)(1.0 / totalPower) : 0.0f;
+        header.NumInstances = (uint32_t)instances.size();
+        header.Unused0 = 0.0f;
+        header.Unused1 = 0;
 
-#ifndef NDEBUG
-            numInsertions++;
-#endif
+        for (size_t i = 0; i < instances.size(); i++)
+        {
+            table[i].BaseTriOffset = instances[i].BaseTriOffset;
+            table[i].NumTriangles = instances[i].NumTriangles;
+            table[i].P_Curr = 1.0f;
+            table[i].Alias = (uint32_t)i;
         }
 
-        Assert(numInsertions == N, "Some elements were not inserted.");
+        if (totalPower == 0.0)
+            return;
 
-        for (int64_t i = 0; i < N; i++)
-            table[i].CachedP_Alias = table[table[i].Alias].CachedP_Orig;
+        SmallVector<AliasTableEntry, App::OneTimeFrameAllocatorWithFallback> aliasTable;
+        aliasTable.resize(instances.size());
+        AliasTable_BuildPartitioned(instancePower, aliasTable);
 
-        allocator.FreeAligned(mem, sizeInBytes);
+        for (size_t i = 0; i < instances.size(); i++)
+        {
+            table[i].P_Curr = aliasTable[i].P_Curr;
+            table[i].Alias = aliasTable[i].Alias;
+        }
     }
 }
 
@@ -265,13 +253,31 @@ void PreLighting::Update()
 
     if (App::GetScene().AreEmissiveMaterialsStale())
     {
+        // Only triangles with modified materials need new estimates
         m_estimatePowerThisFrame = true;
+        uint32_t baseOffset = App::GetScene().StaleEmissiveTriBaseOffset();
+        uint32_t numTris = App::GetScene().NumStaleEmissiveTriangles();
+
+        // Results of the previous estimate haven't been consumed by the alias table yet and are 
+        // about to be overwritten -- recompute them as well
+        if (m_readback.IsInitialized())
+        {
+            const uint32_t end = Max(baseOffset + numTris, m_staleBaseOffset + m_numStaleTris);
+            baseOffset = Min(baseOffset, m_staleBaseOffset);
+            numTris = end - baseOffset;
+        }
+
+        m_staleBaseOffset = baseOffset;
+        m_numStaleTris = numTris;
+        Assert(m_numStaleTris > 0 && m_staleBaseOffset + m_numStaleTris <= m_currNumTris, 
+            "Invalid range of stale emissive triangles.");
+
         const size_t currPowerBuffLen = m_triPower.IsInitialized() ? 
             m_triPower.Desc().Width / sizeof(float) : 0;
 
-        if (currPowerBuffLen < m_currNumTris)
+        if (currPowerBuffLen < m_numStaleTris)
         {
-            const uint32_t sizeInBytes = m_currNumTris * sizeof(float);
+            const uint32_t sizeInBytes = m_numStaleTris * sizeof(float);
 
             // GPU buffer containing power estimates per triangle
             m_triPower = GpuMemory::GetDefaultHeapBuffer("TriPower",
@@ -333,7 +339,7 @@ void PreLighting::Render(CommandList& cmdList)
         Assert(!m_readback.IsMapped(), "readback buffer can't be mapped while in use by the GPU.");
         Assert(m_triPower.IsInitialized(), "Tri emissive power buffer hasn't been initialized.");
 
-        const uint32_t dispatchDimX = CeilUnsignedIntDiv(m_currNumTris, ESTIMATE_TRI_POWER_NUM_TRIS_PER_GROUP);
+        const uint32_t dispatchDimX = CeilUnsignedIntDiv(m_numStaleTris, ESTIMATE_TRI_POWER_NUM_TRIS_PER_GROUP);
         Assert(dispatchDimX <= D3D12_CS_DISPATCH_MAX_THREAD_GROUPS_PER_DIMENSION, "#blocks exceeded maximum allowed.");
 
         computeCmdList.PIXBeginEvent("EstimateTriPower");
@@ -343,6 +349,11 @@ void PreLighting::Render(CommandList& cmdList)
             D3D12_RESOURCE_STATE_COPY_SOURCE,
             D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 
+        cbEstimatePower cb;
+        cb.BaseTriOffset = m_staleBaseOffset;
+        cb.NumTriangles = m_numStaleTris;
+
+        m_rootSig.SetRootConstants(0, sizeof(cb) / sizeof(DWORD), &cb);
         m_rootSig.SetRootSRV(4, m_halton.GpuVA());
         m_rootSig.SetRootUAV(5, m_triPower.GpuVA());
 
@@ -360,7 +371,7 @@ void PreLighting::Render(CommandList& cmdList)
             0,
             m_triPower.Resource(),
             0,
-            m_currNumTris * sizeof(float));
+            m_numStaleTris * sizeof(float));
 
         gpuTimer.EndQuery(computeCmdList, queryIdx);
         computeCmdList.PIXEndEvent();
@@ -480,26 +491,37 @@ void PreLighting::ReloadBuildLVG()
 // EmissiveTriangleAliasTable
 //--------------------------------------------------------------------------------------
 
-void EmissiveTriangleAliasTable::Update(ReadbackHeapBuffer* readback)
+void EmissiveTriangleAliasTable::Update(ReadbackHeapBuffer* readback, uint32_t staleBaseOffset,
+    uint32_t numStaleTris)
 {
     Assert(readback, "Readback buffer was NULL.");
     m_readback = readback;
+    m_staleBaseOffset = staleBaseOffset;
+    m_numStaleTris = numStaleTris;
+    // Readback buffer is about to receive new results, any previously pending fence is stale
+    m_fence = UINT64_MAX;
 
     const size_t currBuffLen = m_aliasTable.IsInitialized() ? 
-        m_aliasTable.Desc().Width / sizeof(float) : 0;
+        m_aliasTable.Desc().Width / sizeof(RT::EmissiveLumenAliasTableEntry) : 0;
     m_currNumTris = (uint32_t)App::GetScene().NumEmissiveTriangles();
     Assert(m_currNumTris, "redundant call.");
 
-    if (currBuffLen < m_currNumTris)
+    // Triangle entries, followed by the header and the top level
+    const size_t numEntries = m_currNumTris + 1 + App::GetScene().NumEmissiveInstances();
+
+    if (currBuffLen < numEntries)
     {
         m_aliasTable = GpuMemory::GetDefaultHeapBuffer("AliasTable",
-            m_currNumTris * sizeof(RT::EmissiveLumenAliasTableEntry),
+            (uint32_t)(numEntries * sizeof(RT::EmissiveLumenAliasTableEntry)),
             D3D12_RESOURCE_STATE_COMMON,
             false);
 
         auto& r = App::GetRenderer().GetSharedShaderResources();
         r.InsertOrAssignDefaultHeapBuffer(
             GlobalResource::EMISSIVE_TRIANGLE_ALIAS_TABLE, m_aliasTable);
+
+        // Previous contents are gone, force a full rebuild
+        m_triPower.clear();
     }
 }
 
@@ -533,41 +555,97 @@ void EmissiveTriangleAliasTable::Render(CommandList& cmdList)
         return;
     }
 
-    // Try to use frame allocator first, if it fails (allocation size exceeded per-frame max),
-    // use malloc instead
-    SmallVector<RT::EmissiveLumenAliasTableEntry, App::OneTimeFrameAllocatorWithFallback> table;
-    table.resize(m_currNumTris);
+    const auto instances = App::GetScene().EmissiveInstances();
+    const size_t numInstances = instances.size();
 
     App::DeltaTimer timer;
     timer.Start();
 
+    // Triangles or instances have changed since the last build
+    if (m_triPower.size() != m_currNumTris || m_instancePower.size() != numInstances)
+    {
+        Assert(m_staleBaseOffset == 0 && m_numStaleTris == m_currNumTris, 
+            "Full rebuild requires power estimates for all triangles.");
+
+        m_triPower.resize(m_currNumTris);
+        m_instancePower.resize(numInstances);
+    }
+
     {
         // Safe to map, related fence has passed
         m_readback->Map();
 
-        float* data = reinterpret_cast<float*>(m_readback->MappedMemory());
-        BuildAliasTable(MutableSpan(data, m_currNumTris), table);
+        const float* data = reinterpret_cast<float*>(m_readback->MappedMemory());
+        memcpy(m_triPower.data() + m_staleBaseOffset, data, m_numStaleTris * sizeof(float));
 
         // Unmapping happens automatically when readback buffer is released
         //m_readback->Unmap();
     }
 
+    // Instances that overlap the stale range. Instances are sorted by base triangle offset 
+    // and, since each one's triangles are contiguous, the affected triangle range follows.
+    const uint32_t staleEnd = m_staleBaseOffset + m_numStaleTris;
+    const EmissiveInstance* first = std::upper_bound(instances.begin(), instances.end(), m_staleBaseOffset,
+        [](uint32_t offset, const EmissiveInstance& e)
+        {
+            return offset < e.BaseTriOffset;
+        }) - 1;
+    const EmissiveInstance* last = std::lower_bound(first, instances.end(), staleEnd,
+        [](const EmissiveInstance& e, uint32_t offset)
+        {
+            return e.BaseTriOffset < offset;
+        });
+
+    const size_t firstInstance = first - instances.begin();
+    const size_t lastInstance = last - instances.begin();
+    const uint32_t triBegin = first->BaseTriOffset;
+    const uint32_t triEnd = (last - 1)->BaseTriOffset + (last - 1)->NumTriangles;
+
+    // Try to use frame allocator first, if it fails (allocation size exceeded per-frame max),
+    // use malloc instead
+    SmallVector<RT::EmissiveLumenAliasTableEntry, App::OneTimeFrameAllocatorWithFallback> triTable;
+    triTable.resize(triEnd - triBegin);
+    BuildInstanceAliasTables(instances, firstInstance, lastInstance, m_triPower, m_instancePower, 
+        triTable);
+
+    RT::EmissiveAliasTableHeader header;
+    SmallVector<RT::EmissiveInstanceAliasTableEntry, App::OneTimeFrameAllocatorWithFallback> topLevel;
+    topLevel.resize(numInstances);
+    BuildTopLevelAliasTable(instances, m_instancePower, header, topLevel);
+
     timer.End();
-    LOG_UI_INFO("Alias table - computation took %u [us].", (uint32_t)timer.DeltaMicro());
+    LOG_UI_INFO("Alias table - rebuilding %u of %u instances took %u [us].", 
+        (uint32_t)(lastInstance - firstInstance), (uint32_t)numInstances, (uint32_t)timer.DeltaMicro());
 
     auto& gpuTimer = renderer.GetGpuTimer();
     const uint32_t queryIdx = gpuTimer.BeginQuery(computeCmdList, "UploadAliasTable");
     computeCmdList.PIXBeginEvent("UploadAliasTable");
 
-    // Schedule a copy
-    const uint32_t sizeInBytes = sizeof(RT::EmissiveLumenAliasTableEntry) * m_currNumTris;
+    // Schedule a copy for the modified triangle range and the top level
+    static_assert(sizeof(RT::EmissiveAliasTableHeader) == sizeof(RT::EmissiveLumenAliasTableEntry));
+    static_assert(sizeof(RT::EmissiveInstanceAliasTableEntry) == sizeof(RT::EmissiveLumenAliasTableEntry));
+
+    const uint32_t triSizeInBytes = sizeof(RT::EmissiveLumenAliasTableEntry) * (uint32_t)triTable.size();
+    const uint32_t topLevelSizeInBytes = sizeof(RT::EmissiveInstanceAliasTableEntry) * (uint32_t)numInstances;
+    const uint32_t headerSizeInBytes = (uint32_t)sizeof(header);
+    const uint32_t sizeInBytes = triSizeInBytes + headerSizeInBytes + topLevelSizeInBytes;
+
     m_aliasTableUpload = GpuMemory::GetUploadHeapBuffer(sizeInBytes);
-    m_aliasTableUpload.Copy(0, sizeInBytes, table.data());
+    m_aliasTableUpload.Copy(0, triSizeInBytes, triTable.data());
+    m_aliasTableUpload.Copy(triSizeInBytes, headerSizeInBytes, &header);
+    m_aliasTableUpload.Copy(triSizeInBytes + headerSizeInBytes, topLevelSizeInBytes, topLevel.data());
+
     computeCmdList.CopyBufferRegion(m_aliasTable.Resource(),
-        0,
+        triBegin * sizeof(RT::EmissiveLumenAliasTableEntry),
         m_aliasTableUpload.Resource(),
         m_aliasTableUpload.Offset(),
-        sizeInBytes);
+        triSizeInBytes);
+
+    computeCmdList.CopyBufferRegion(m_aliasTable.Resource(),
+        m_currNumTris * sizeof(RT::EmissiveLumenAliasTableEntry),
+        m_aliasTableUpload.Resource(),
+        m_aliasTableUpload.Offset() + triSizeInBytes,
+        headerSizeInBytes + topLevelSizeInBytes);
 
     computeCmdList.ResourceBarrier(m_aliasTable.Resource(),
         D3D12_RESOURCE_STATE_COPY_DEST,
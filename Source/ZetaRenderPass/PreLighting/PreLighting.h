@@ -2,6 +2,7 @@
 
 #include "../RenderPass.h"
 #include <Core/GpuMemory.h>
+#include <Utility/SmallVector.h>
 #include "PreLighting_Common.h"
 
 namespace ZetaRay::Core
@@ -50,6 +51,9 @@ namespace ZetaRay::RenderPass
         const Core::GpuMemory::Buffer& GePresampledSets() { return m_sampleSets; }
         const Core::GpuMemory::Buffer& GetLightVoxelGrid() { return m_lvg; }
         Core::GpuMemory::ReadbackHeapBuffer& GetLumenReadbackBuffer() { return m_readback; }
+        // Range of triangles with power estimates in the readback buffer
+        uint32_t GetStaleTriBaseOffset() const { return m_staleBaseOffset; }
+        uint32_t GetNumStaleTris() const { return m_numStaleTris; }
         // Releasing the power buffer and its readback buffer should happen after the alias table 
         // has been calculated. Delegate that to code that does that calculation.
         auto GetReleaseBuffersDlg() { return fastdelegate::MakeDelegate(this, &PreLighting::ReleaseTriPowerBufferAndReadback); };
@@ -63,7 +67,8 @@ namespace ZetaRay::RenderPass
         static constexpr int NUM_UAV = 1;
         static constexpr int NUM_GLOBS = 3;
         static constexpr int NUM_CONSTS = (int)Math::Max(sizeof(cbPresampling) / sizeof(DWORD), 
-            Math::Max(sizeof(cbLVG) / sizeof(DWORD), sizeof(cbCurvature) / sizeof(DWORD)));
+            Math::Max(sizeof(cbLVG) / sizeof(DWORD), Math::Max(sizeof(cbCurvature) / sizeof(DWORD), 
+                sizeof(cbEstimatePower) / sizeof(DWORD))));
         using SHADER = PRE_LIGHTING_SHADER;
 
         inline static constexpr const char* COMPILED_CS[(int)SHADER::COUNT] = {
@@ -82,6 +87,8 @@ namespace ZetaRay::RenderPass
         Core::GpuMemory::Buffer m_sampleSets;
         Core::GpuMemory::Buffer m_lvg;
         uint32_t m_currNumTris = 0;
+        uint32_t m_staleBaseOffset = 0;
+        uint32_t m_numStaleTris = 0;
         uint32_t m_minNumLightsForPresampling = UINT32_MAX;
         uint32_t m_numSampleSets = 0;
         uint32_t m_sampleSetSize = 0;
@@ -113,7 +120,8 @@ namespace ZetaRay::RenderPass
         ZetaInline void SetReleaseBuffersDlg(fastdelegate::FastDelegate0<> dlg) { m_releaseDlg = dlg; }
         ZetaInline bool HasPendingRender() { return m_fence != UINT64_MAX; }
 
-        void Update(Core::GpuMemory::ReadbackHeapBuffer* readback);
+        // Power estimates in the readback buffer are for triangles [staleBaseOffset, staleBaseOffset + numStaleTris)
+        void Update(Core::GpuMemory::ReadbackHeapBuffer* readback, uint32_t staleBaseOffset, uint32_t numStaleTris);
         void SetEmissiveTriPassHandle(Core::RenderNodeHandle& emissiveTriHandle);
         void Render(Core::CommandList& cmdList);
 
@@ -122,7 +130,13 @@ namespace ZetaRay::RenderPass
         Core::GpuMemory::UploadHeapBuffer m_aliasTableUpload;
         Core::GpuMemory::ReadbackHeapBuffer* m_readback = nullptr;
         fastdelegate::FastDelegate0<> m_releaseDlg;
+        // Power of every emissive triangle and instance is kept around so that when materials 
+        // change, only the affected instances along with the top level need to be rebuilt
+        Util::SmallVector<float> m_triPower;
+        Util::SmallVector<float> m_instancePower;
         uint32_t m_currNumTris = 0;
+        uint32_t m_staleBaseOffset = 0;
+        uint32_t m_numStaleTris = 0;
         int m_emissiveTriHandle = -1;
         uint64_t m_fence = UINT64_MAX;
     };
@@ -13,6 +13,12 @@
 
 #define NUM_SAMPLES_PER_VOXEL 64
 
+struct cbEstimatePower
+{
+    uint32_t BaseTriOffset;
+    uint32_t NumTriangles;
+};
+
 struct cbPresampling
 {
     uint32_t NumTotalSamples;
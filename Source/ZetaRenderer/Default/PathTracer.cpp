@@ -140,7 +140,8 @@ void PathTracer::Update(const RenderSettings& settings, Core::RenderGraph& rende
         if (App::GetScene().AreEmissiveMaterialsStale())
         {
             auto& readback = data.PreLightingPass.GetLumenReadbackBuffer();
-            data.EmissiveAliasTable.Update(&readback);
+            data.EmissiveAliasTable.Update(&readback, data.PreLightingPass.GetStaleTriBaseOffset(),
+                data.PreLightingPass.GetNumStaleTris());
             data.EmissiveAliasTable.SetReleaseBuffersDlg(data.PreLightingPass.GetReleaseBuffersDlg());
         }
     }
@@ -9,6 +9,75 @@ using namespace ZetaRay::Support;
 using namespace ZetaRay::Util;
 using namespace ZetaRay::Math;
 
+namespace
+{
+    // Probability of sampling each item, as implied by the table
+    void ImpliedDistribution(Span<AliasTableEntry> table, SmallVector<double>& dist)
+    {
+        const double oneDivN = 1.0 / table.size();
+        dist.resize(table.size(), 0.0);
+
+        for (size_t i = 0; i < table.size(); i++)
+        {
+            REQUIRE(table[i].Alias < table.size());
+            REQUIRE(table[i].P_Curr >= 0.0f);
+            REQUIRE(table[i].P_Curr <= 1.0f);
+
+            dist[i] += table[i].P_Curr * oneDivN;
+            dist[table[i].Alias] += (1.0 - table[i].P_Curr) * oneDivN;
+        }
+    }
+
+    void CheckDistribution(Span<float> weights, Span<AliasTableEntry> table)
+    {
+        double sum = 0.0;
+        for (auto w : weights)
+            sum += w;
+
+        SmallVector<double> dist;
+        ImpliedDistribution(table, dist);
+        const double N = (double)weights.size();
+
+        // Relative error, or for items less likely than 1 / N, error relative to the uniform
+        // distribution
+        double maxError = 0.0;
+        for (size_t i = 0; i < weights.size(); i++)
+        {
+            const double expected = weights[i] / sum;
+            maxError = Max(maxError, fabs(dist[i] - expected) / Max(expected, 1.0 / N));
+        }
+
+        INFO("Number of weights: ", weights.size(), ", max. error: ", maxError);
+        CHECK(maxError < 1e-3);
+    }
+
+    double ChiSquared(Span<float> weights, Span<AliasTableEntry> table, int sampleSize, RNG& rng)
+    {
+        const size_t n = weights.size();
+        const float sum = Math::KahanSum(weights);
+
+        SmallVector<size_t> count;
+        count.resize(n, 0);
+
+        for (int i = 0; i < sampleSize; i++)
+        {
+            float pdf;
+            uint32_t idx = SampleAliasTable(table, rng, pdf);
+            count[idx]++;
+        }
+
+        double chiSquared = 0.0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            double expected = weights[i] / sum * sampleSize;
+            double diff = count[i] - expected;
+            chiSquared += expected == 0 ? 0 : (diff * diff) / expected;
+        }
+
+        return chiSquared;
+    }
+}
+
 TEST_SUITE("AliasTable")
 {
     TEST_CASE("Normalize")
@@ -119,4 +188,98 @@ TEST_SUITE("AliasTable")
         INFO("Test statistic: ", chiSquared, ", critical value: ", criticalValue);
         CHECK(chiSquared <= criticalValue);
     }
+
+    TEST_CASE("PartitionedMatchesDistribution")
+    {
+        RNG rng(17);
+
+        // Sizes that are smaller than, equal to and cross the block boundaries
+        for (uint32_t n : { 1u, 2u, 7u, 1000u, 16u * 1024u, 100'003u })
+        {
+            // 0: uniform, 1: heavy-tailed, 2: mostly zero, 3: constant, 4: one dominant weight
+            for (int dist = 0; dist < 5; dist++)
+            {
+                SmallVector<float> vals;
+                vals.resize(n);
+
+                for (uint32_t i = 0; i < n; i++)
+                {
+                    const float u = rng.Uniform();
+
+                    switch (dist)
+                    {
+                    case 0:
+                        vals[i] = u * 100.0f;
+                        break;
+                    case 1:
+                        vals[i] = 1.0f / Max(u * u * u, 1e-6f);
+                        break;
+                    case 2:
+                        vals[i] = u < 0.9f ? 0.0f : u;
+                        break;
+                    case 3:
+                        vals[i] = 3.0f;
+                        break;
+                    default:
+                        vals[i] = i == n / 2 ? 1e4f : u;
+                        break;
+                    }
+                }
+
+                // Make sure not all weights are zero
+                vals[0] = Max(vals[0], 0.5f);
+
+                SmallVector<AliasTableEntry> table;
+                table.resize(n);
+                AliasTable_BuildPartitioned(vals, table, false);
+                CheckDistribution(vals, table);
+
+                // Same density for the returned samples
+                const float sum = Math::KahanSum(vals);
+
+                for (int i = 0; i < 100; i++)
+                {
+                    float pdf;
+                    uint32_t idx = SampleAliasTable(table, rng, pdf);
+
+                    CHECK(idx < n);
+                    CHECK(fabsf(pdf - vals[idx] / sum) <= 1e-5f * (vals[idx] / sum) + 1e-9f);
+                }
+            }
+        }
+    }
+
+    TEST_CASE("PartitionedChiSquared")
+    {
+        RNG rng(5);
+
+        const int n = 64;
+        SmallVector<float> vals;
+        vals.resize(n);
+
+        for (int i = 0; i < n; i++)
+            vals[i] = (float)rng.UniformUintBounded(1000);
+
+        vals[0] = Max(vals[0], 1.0f);
+
+        SmallVector<AliasTableEntry> table;
+        table.resize(n);
+        AliasTable_BuildPartitioned(vals, table, false);
+
+        SmallVector<float> valsCopy = vals;
+        SmallVector<AliasTableEntry> refTable;
+        refTable.resize(n);
+        AliasTable_Build(valsCopy, refTable);
+
+        // Corresponding to alpha = 0.01 and dof = n - 1 = 63
+        const double criticalValue = 92.01;
+        const int sampleSize = 200'000;
+
+        const double chiSquared = ChiSquared(vals, table, sampleSize, rng);
+        const double chiSquaredRef = ChiSquared(vals, refTable, sampleSize, rng);
+
+        INFO("Test statistic: ", chiSquared, " (reference: ", chiSquaredRef, "), critical value: ", criticalValue);
+        CHECK(chiSquared <= criticalValue);
+        CHECK(chiSquaredRef <= criticalValue);
+    }
 };
\ No newline at end of file
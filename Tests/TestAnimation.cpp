@@ -0,0 +1,177 @@
+#include <Scene/Animation.h>
+#include <Math/Quaternion.h>
+#include <Utility/RNG.h>
+#include <doctest/doctest.h>
+
+using namespace ZetaRay;
+using namespace ZetaRay::Math;
+using namespace ZetaRay::Scene;
+using namespace ZetaRay::Scene::Internal;
+using namespace ZetaRay::Util;
+
+namespace
+{
+    static constexpr uint32_t MAX_NUM_KEYFRAMES = 16;
+
+    struct Track
+    {
+        Keyframe Keyframes[MAX_NUM_KEYFRAMES];
+        uint32_t NumKeyframes;
+        float T0;
+        bool Loop;
+    };
+
+    float4 RandomRotation(RNG& rng)
+    {
+        const float3 axis = float3(rng.Uniform() * 2 - 1, rng.Uniform() * 2 - 1, rng.Uniform() * 2 - 1);
+        const float theta = rng.Uniform() * TWO_PI - PI;
+        float4 q(axis * sinf(0.5f * theta), cosf(0.5f * theta));
+
+        return storeFloat4(normalize(loadFloat4(q)));
+    }
+
+    Track RandomTrack(RNG& rng)
+    {
+        Track track;
+        track.T0 = rng.Uniform() * 2.0f;
+        track.Loop = rng.UniformUintBounded(2);
+        float time = rng.Uniform();
+
+        track.NumKeyframes = 2 + rng.UniformUintBounded(MAX_NUM_KEYFRAMES - 1);
+
+        for (uint32_t i = 0; i < track.NumKeyframes; i++)
+        {
+            Keyframe& k = track.Keyframes[i];
+            k.Time = time;
+            k.Transform.Translation = float3(rng.Uniform() * 10, rng.Uniform() * 10, rng.Uniform() * 10);
+            k.Transform.Scale = float3(0.5f + rng.Uniform(), 0.5f + rng.Uniform(), 0.5f + rng.Uniform());
+            k.Transform.Rotation = RandomRotation(rng);
+
+            time += 0.05f + rng.Uniform();
+        }
+
+        return track;
+    }
+
+    // Scalar evaluation with binary search
+    AffineTransformation Reference(const Track& track, float t)
+    {
+        const Keyframe* keys = track.Keyframes;
+        const uint32_t n = track.NumKeyframes;
+        const float tFirst = keys[0].Time;
+        const float tLast = keys[n - 1].Time;
+        t -= track.T0;
+
+        if (t <= tFirst)
+            return keys[0].Transform;
+        if (t >= tLast && !track.Loop)
+            return keys[n - 1].Transform;
+        if (t >= tLast)
+            t = tFirst + fmodf(t - tFirst, tLast - tFirst);
+
+        uint32_t k = 0;
+        while (k + 2 < n && keys[k + 1].Time <= t)
+            k++;
+
+        const float u = Min((t - keys[k].Time) / (keys[k + 1].Time - keys[k].Time), 1.0f);
+        AffineTransformation a = keys[k].Transform;
+        AffineTransformation b = keys[k + 1].Transform;
+
+        AffineTransformation res;
+        res.Translation = storeFloat3(lerp(loadFloat3(a.Translation), loadFloat3(b.Translation), u));
+        res.Scale = storeFloat3(lerp(loadFloat3(a.Scale), loadFloat3(b.Scale), u));
+        res.Rotation = storeFloat4(slerp(loadFloat4(a.Rotation), loadFloat4(b.Rotation), u));
+
+        return res;
+    }
+
+    void CheckEqual(const AffineTransformation& a, const AffineTransformation& b)
+    {
+        constexpr float EPS = 1e-3f;
+
+        CHECK(fabsf(a.Translation.x - b.Translation.x) < EPS);
+        CHECK(fabsf(a.Translation.y - b.Translation.y) < EPS);
+        CHECK(fabsf(a.Translation.z - b.Translation.z) < EPS);
+        CHECK(fabsf(a.Scale.x - b.Scale.x) < EPS);
+        CHECK(fabsf(a.Scale.y - b.Scale.y) < EPS);
+        CHECK(fabsf(a.Scale.z - b.Scale.z) < EPS);
+
+        // q and -q are the same rotation
+        const float d = a.Rotation.x * b.Rotation.x + a.Rotation.y * b.Rotation.y +
+            a.Rotation.z * b.Rotation.z + a.Rotation.w * b.Rotation.w;
+        CHECK(fabsf(d) > 1.0f - EPS);
+    }
+}
+
+TEST_SUITE("Animation")
+{
+    TEST_CASE("MatchesReference")
+    {
+        // Not a multiple of the number of lanes
+        constexpr uint32_t NUM_TRACKS = 45;
+        RNG rng(31);
+
+        SmallVector<Track> tracks;
+        AnimationTracks animations;
+
+        for (uint32_t i = 0; i < NUM_TRACKS; i++)
+        {
+            tracks.push_back(RandomTrack(rng));
+            const Track& track = tracks.back();
+            CHECK(animations.Add(Span(track.Keyframes, track.NumKeyframes), track.T0, track.Loop) == i);
+        }
+
+        SmallVector<AffineTransformation> results;
+        results.resize(NUM_TRACKS);
+
+        // Mostly small steps forward, with occasional jumps in both directions to exercise
+        // cursor reset and binary search
+        float t = 0.0f;
+
+        for (int step = 0; step < 300; step++)
+        {
+            if (step % 50 == 49)
+                t = rng.Uniform() * 30.0f;
+            else
+                t += rng.Uniform() * 0.1f;
+
+            // Evaluate in two parts, same as concurrent evaluation of disjoint ranges
+            const uint32_t mid = 19;
+            animations.Evaluate(t, 0, mid, results);
+            animations.Evaluate(t, mid, NUM_TRACKS, MutableSpan(results.data() + mid, NUM_TRACKS - mid));
+
+            for (uint32_t i = 0; i < NUM_TRACKS; i++)
+                CheckEqual(results[i], Reference(tracks[i], t));
+        }
+    }
+
+    TEST_CASE("Endpoints")
+    {
+        Keyframe keys[2];
+        keys[0].Time = 1.0f;
+        keys[0].Transform = AffineTransformation::GetIdentity();
+        keys[1].Time = 2.0f;
+        keys[1].Transform.Translation = float3(2.0f, 4.0f, 6.0f);
+        keys[1].Transform.Scale = float3(3.0f, 3.0f, 3.0f);
+        keys[1].Transform.Rotation = float4(0.0f, 0.0f, 0.0f, -1.0f);
+
+        AnimationTracks animations;
+        animations.Add(keys, 0.0f, false);
+        animations.Add(keys, 0.0f, true);
+
+        AffineTransformation results[2];
+
+        animations.Evaluate(0.5f, 0, 2, results);
+        CheckEqual(results[0], keys[0].Transform);
+        CheckEqual(results[1], keys[0].Transform);
+
+        animations.Evaluate(1.5f, 0, 2, results);
+        CHECK(fabsf(results[0].Translation.x - 1.0f) < 1e-5f);
+        CHECK(fabsf(results[0].Scale.y - 2.0f) < 1e-5f);
+
+        // Non-looping animation holds the last keyframe, looping one wraps around
+        animations.Evaluate(2.25f, 0, 2, results);
+        CheckEqual(results[0], keys[1].Transform);
+        CHECK(fabsf(results[1].Translation.z - 1.5f) < 1e-5f);
+    }
+}
@@ -0,0 +1,73 @@
+#include <Math/BVH.h>
+#include <Scene/SceneCommon.h>
+#include <Utility/SmallVector.h>
+#include <doctest/doctest.h>
+
+using namespace ZetaRay;
+using namespace ZetaRay::Math;
+using namespace ZetaRay::Util;
+
+namespace
+{
+    // Unit box centered at (x, 0, z)
+    AABB Box(float x, float z)
+    {
+        return AABB(float3(x, 0.0f, z), float3(1.0f, 1.0f, 1.0f));
+    }
+
+    // Casts a ray straight down through (x, z)
+    uint64_t CastDown(BVH& bvh, float x, float z)
+    {
+        Ray r(float3(x, 10.0f, z), float3(0.0f, -1.0f, 0.0f));
+        return bvh.CastRay(r);
+    }
+}
+
+TEST_SUITE("BVH")
+{
+    TEST_CASE("ReplayAfterRebuild")
+    {
+        // 8 x 8 grid of boxes with a gap of 1 between neighbors
+        SmallVector<BVH::BVHInput> instances;
+        for (int r = 0; r < 8; r++)
+        {
+            for (int c = 0; c < 8; c++)
+            {
+                instances.push_back(BVH::BVHInput{ .BoundingBox = Box(3.0f * c, 3.0f * r),
+                    .InstanceID = uint64_t(1 + r * 8 + c) });
+            }
+        }
+
+        BVH bvh;
+        bvh.Build(instances, BVH::BUILD_METHOD::LONGEST_AXIS);
+        bvh.StartRebuild(false);
+        CHECK(bvh.IsRebuilding());
+
+        // Same instance is updated twice while the rebuild is in progress, e.g. an animated 
+        // instance over several frames
+        BVH::BVHUpdateInput u0{ .OldBox = Box(9.0f, 9.0f), .NewBox = Box(9.0f, 9.5f), .InstanceID = 28 };
+        bvh.Update(Span<BVH::BVHUpdateInput>(&u0, 1));
+        BVH::BVHUpdateInput u1{ .OldBox = Box(9.0f, 9.5f), .NewBox = Box(9.0f, 10.5f), .InstanceID = 28 };
+        bvh.Update(Span<BVH::BVHUpdateInput>(&u1, 1));
+
+        // Updated, then removed
+        BVH::BVHUpdateInput u2{ .OldBox = Box(15.0f, 15.0f), .NewBox = Box(15.0f, 16.5f), .InstanceID = 46 };
+        bvh.Update(Span<BVH::BVHUpdateInput>(&u2, 1));
+        bvh.Remove(46, Box(15.0f, 16.5f));
+
+        bvh.FinishRebuild();
+        CHECK(!bvh.IsRebuilding());
+
+        CHECK(CastDown(bvh, 9.0f, 10.5f) == 28);
+        CHECK(CastDown(bvh, 9.0f, 9.0f) == Scene::INVALID_INSTANCE);
+        CHECK(CastDown(bvh, 15.0f, 15.0f) == Scene::INVALID_INSTANCE);
+        CHECK(CastDown(bvh, 15.0f, 16.5f) == Scene::INVALID_INSTANCE);
+        CHECK(CastDown(bvh, 3.0f, 0.0f) == 2);
+
+        // Replayed box is what the new tree has
+        BVH::BVHUpdateInput u3{ .OldBox = Box(9.0f, 10.5f), .NewBox = Box(9.0f, 9.5f), .InstanceID = 28 };
+        bvh.Update(Span<BVH::BVHUpdateInput>(&u3, 1));
+        CHECK(CastDown(bvh, 9.0f, 9.0f) == 28);
+        CHECK(CastDown(bvh, 9.0f, 10.8f) == Scene::INVALID_INSTANCE);
+    }
+};
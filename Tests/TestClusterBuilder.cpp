@@ -0,0 +1,170 @@
+#include <Model/ClusterBuilder.h>
+#include <Model/MeshOptimizer.h>
+#include <Math/MatrixFuncs.h>
+#include <Utility/SmallVector.h>
+#include <doctest/doctest.h>
+
+using namespace ZetaRay;
+using namespace ZetaRay::Core;
+using namespace ZetaRay::Math;
+using namespace ZetaRay::Model;
+using namespace ZetaRay::Util;
+
+namespace
+{
+    // Grid of n x n quads on the xz plane facing +y
+    void CreateGrid(uint32_t n, SmallVector<Vertex>& vertices, SmallVector<uint32_t>& indices)
+    {
+        for (uint32_t y = 0; y <= n; y++)
+        {
+            for (uint32_t x = 0; x <= n; x++)
+            {
+                Vertex v{};
+                v.Position = float3(float(x), 0.0f, float(y));
+                v.Normal = oct32(0.0f, 1.0f, 0.0f);
+                v.Tangent = oct32(1.0f, 0.0f, 0.0f);
+                vertices.push_back(v);
+            }
+        }
+
+        for (uint32_t y = 0; y < n; y++)
+        {
+            for (uint32_t x = 0; x < n; x++)
+            {
+                const uint32_t base = y * (n + 1) + x;
+                const uint32_t quad[6] = { base, base + n + 1, base + 1, base + 1, base + n + 1, base + n + 2 };
+                indices.append_range(quad, quad + 6);
+            }
+        }
+
+        MeshOptimizer::OptimizeVertexCache(indices, (uint32_t)vertices.size());
+    }
+
+    SmallVector<MeshCluster> Build(Span<Vertex> vertices, Span<uint32_t> indices, bool buildCones)
+    {
+        SmallVector<MeshCluster> clusters;
+        clusters.resize(ClusterBuilder::MaxNumClusters((uint32_t)indices.size() / 3));
+        const uint32_t n = ClusterBuilder::Build(vertices, indices, buildCones, clusters);
+        clusters.resize(n);
+
+        return clusters;
+    }
+
+    float4x4a ViewToWorld(const float3& pos, const float3& focus)
+    {
+        v_float4x4 vWorldToView = lookAtLH(float4a(pos, 1.0f), float4a(focus, 1.0f), float4a(0.0f, 0.0f, 1.0f, 0.0f));
+        return store(inverseSRT(vWorldToView));
+    }
+}
+
+TEST_SUITE("ClusterBuilder")
+{
+    TEST_CASE("Partition")
+    {
+        SmallVector<Vertex> vertices;
+        SmallVector<uint32_t> indices;
+        CreateGrid(32, vertices, indices);
+
+        const uint32_t numTris = (uint32_t)indices.size() / 3;
+        auto clusters = Build(vertices, indices, true);
+        CHECK(clusters.size() <= ClusterBuilder::MaxNumClusters(numTris));
+        // Locality after cache optimization should give mostly full clusters
+        CHECK(clusters.size() <= 2 * numTris / ClusterBuilder::MAX_TRIANGLES + 1);
+
+        uint32_t nextTri = 0;
+        SmallVector<uint8_t> seen;
+        seen.resize(vertices.size(), 0);
+
+        for (auto& c : clusters)
+        {
+            // Contiguous and in order
+            CHECK(c.BaseTriOffset == nextTri);
+            CHECK(c.NumTriangles > 0);
+            CHECK(c.NumTriangles <= ClusterBuilder::MAX_TRIANGLES);
+            CHECK(c.NumVertices <= ClusterBuilder::MAX_VERTICES);
+            nextTri += c.NumTriangles;
+
+            uint32_t numUnique = 0;
+            memset(seen.data(), 0, seen.size());
+
+            for (uint32_t i = c.BaseTriOffset * 3; i < (c.BaseTriOffset + c.NumTriangles) * 3; i++)
+            {
+                const float3 p = vertices[indices[i]].Position;
+                const float3 d = p - c.BoundingBox.Center;
+
+                CHECK(fabsf(d.x) <= c.BoundingBox.Extents.x);
+                CHECK(fabsf(d.y) <= c.BoundingBox.Extents.y);
+                CHECK(fabsf(d.z) <= c.BoundingBox.Extents.z);
+                CHECK((p - c.Center).length() <= c.Radius * 1.0001f);
+
+                numUnique += !seen[indices[i]];
+                seen[indices[i]] = 1;
+            }
+
+            CHECK(c.NumVertices == numUnique);
+        }
+
+        CHECK(nextTri == numTris);
+    }
+
+    TEST_CASE("NormalCone")
+    {
+        SmallVector<Vertex> vertices;
+        SmallVector<uint32_t> indices;
+        CreateGrid(16, vertices, indices);
+
+        auto clusters = Build(vertices, indices, true);
+        auto noCones = Build(vertices, indices, false);
+
+        for (auto& c : clusters)
+        {
+            CHECK(c.ConeAxis.y > 0.99f);
+            CHECK(!ClusterBuilder::IsBackfacing(c, float3(8.0f, 5.0f, 8.0f)));
+            CHECK(ClusterBuilder::IsBackfacing(c, float3(8.0f, -5.0f, 8.0f)));
+            // Grazing angle from the front side
+            CHECK(!ClusterBuilder::IsBackfacing(c, float3(100.0f, 0.1f, 8.0f)));
+        }
+
+        for (auto& c : noCones)
+            CHECK(!ClusterBuilder::IsBackfacing(c, float3(8.0f, -5.0f, 8.0f)));
+    }
+
+    TEST_CASE("Cull")
+    {
+        SmallVector<Vertex> vertices;
+        SmallVector<uint32_t> indices;
+        CreateGrid(64, vertices, indices);
+
+        auto clusters = Build(vertices, indices, true);
+        const ViewFrustum frustum(0.5f, 1.0f, 0.1f, 100.0f);
+        const float4x3 I = float4x3(store(identity()));
+        SmallVector<uint32_t> visible;
+        visible.resize(clusters.size());
+
+        // Looking down at a corner of the grid
+        {
+            const uint32_t numVisible = ClusterBuilder::Cull(clusters, frustum, 
+                ViewToWorld(float3(8.0f, 10.0f, 8.0f), float3(8.0f, 0.0f, 8.0f)), I, visible);
+
+            CHECK(numVisible > 0);
+            CHECK(numVisible < clusters.size());
+        }
+
+        // Same, but from below
+        {
+            const uint32_t numVisible = ClusterBuilder::Cull(clusters, frustum, 
+                ViewToWorld(float3(8.0f, -10.0f, 8.0f), float3(8.0f, 0.0f, 8.0f)), I, visible);
+
+            CHECK(numVisible == 0);
+        }
+
+        // Mirrored instance is visible from below
+        {
+            const float4x3 mirror = float4x3(store(scale(1.0f, -1.0f, 1.0f)));
+            const uint32_t numVisible = ClusterBuilder::Cull(clusters, frustum, 
+                ViewToWorld(float3(8.0f, -10.0f, 8.0f), float3(8.0f, 0.0f, 8.0f)), mirror, visible);
+
+            CHECK(numVisible > 0);
+        }
+    }
+}
@@ -1,7 +1,11 @@
 #include <Utility/SmallVector.h>
 #include <Utility/HashTable.h>
+#include <Utility/FlatHashTable.h>
+#include <Utility/SlotMap.h>
+#include <Math/Matrix.h>
 #include <App/App.h>
 #include <Support/MemoryArena.h>
+#include <Support/SegmentedArray.h>
 #include <doctest/doctest.h>
 
 using namespace ZetaRay::Util;
@@ -396,4 +400,218 @@ TEST_SUITE("HashTable")
 
         CHECK(i == 2);
     }
-};
\ No newline at end of file
+};
+TEST_SUITE("FlatHashTable")
+{
+    TEST_CASE("Basic")
+    {
+        FlatHashTable<int> table;
+
+        CHECK(table.empty());
+        CHECK(!table.find(1));
+        CHECK(table.bucket_count() == 0);
+
+        CHECK(table.try_emplace(0, 100));
+        CHECK(!table.try_emplace(0, 200));
+        CHECK(table.bucket_count() == 16);
+
+        for (int i = 1; i < 100; i++)
+            table[i] = 100 + i;
+
+        CHECK(table.size() == 100);
+
+        bool valid = true;
+        for (int i = 0; i < 100; i++)
+            valid = valid && (*table.find(i).value() == 100 + i);
+
+        CHECK(valid);
+
+        table.insert_or_assign(0, 200);
+        CHECK(table.size() == 100);
+        CHECK(*table.find(0).value() == 200);
+
+        for (int i = 0; i < 100; i += 2)
+            CHECK(table.erase(i) == 1);
+
+        CHECK(table.erase(0) == 0);
+        CHECK(table.size() == 50);
+        CHECK(!table.find(0));
+        CHECK(*table.find(1).value() == 101);
+    }
+
+    TEST_CASE("Churn")
+    {
+        FlatHashTable<int> table;
+        table.resize(64, true);
+        const size_t bucketCount = table.bucket_count();
+
+        // Repeatedly erasing and inserting shouldn't grow the table
+        for (int i = 0; i < 10000; i++)
+        {
+            table[i] = i;
+
+            if (i >= 64)
+                CHECK(table.erase(i - 64) == 1);
+        }
+
+        CHECK(table.size() == 64);
+        CHECK(table.bucket_count() == bucketCount);
+    }
+
+    TEST_CASE("Iterator")
+    {
+        FlatHashTable<float4x3> table;
+        int i = 0;
+
+        for (auto it = table.begin_it(); it < table.end_it(); it = table.next_it(it))
+            i++;
+
+        CHECK(i == 0);
+
+        for (uint64_t k = 1; k <= 40; k++)
+            table[k].m[0].x = (float)k;
+
+        table.erase(20);
+        uint64_t sum = 0;
+
+        for (auto it = table.begin_it(); it < table.end_it(); it = table.next_it(it))
+        {
+            CHECK(it->Val.m[0].x == (float)it->Key);
+            sum += it->Key;
+        }
+
+        CHECK(sum == 40 * 41 / 2 - 20);
+    }
+};
+
+TEST_SUITE("SlotMap")
+{
+    TEST_CASE("Basic")
+    {
+        SlotMap<int> map;
+
+        CHECK(map.empty());
+        CHECK(!map.contains(SlotHandle()));
+
+        SmallVector<SlotHandle> handles;
+        for (int i = 0; i < 100; i++)
+            handles.push_back(map.insert(100 + i));
+
+        CHECK(map.size() == 100);
+
+        bool valid = true;
+        for (int i = 0; i < 100; i++)
+            valid = valid && (map[handles[i]] == 100 + i);
+
+        CHECK(valid);
+
+        for (int i = 0; i < 100; i += 2)
+            CHECK(map.erase(handles[i]));
+
+        CHECK(!map.erase(handles[0]));
+        CHECK(map.size() == 50);
+        CHECK(!map.find(handles[0]));
+        CHECK(*map.find(handles[1]).value() == 101);
+
+        int sum = 0;
+        map.for_each([&sum](SlotHandle, int& v)
+            {
+                sum += v;
+            });
+
+        // 101 + 103 + ... + 199
+        CHECK(sum == 50 * 150);
+    }
+
+    TEST_CASE("Reuse")
+    {
+        SlotMap<int> map;
+        const SlotHandle h0 = map.insert(1);
+        map.insert(2);
+        map.erase(h0);
+
+        // Freed slot is reused, but the stale handle doesn't refer to the new element
+        const SlotHandle h1 = map.insert(3);
+        CHECK(h1.Index == h0.Index);
+        CHECK(h1.Generation != h0.Generation);
+        CHECK(!map.contains(h0));
+        CHECK(map[h1] == 3);
+        CHECK(map.capacity() == 2);
+    }
+};
+
+TEST_SUITE("MemoryArena")
+{
+    TEST_CASE("Basic")
+    {
+        MemoryArena ma(32);
+        SmallVector<int, ArenaAllocator> vec(ma);
+
+        // Grows past the first block, pointers remain stable
+        for (int i = 0; i < 100000; i++)
+            vec.push_back(i);
+
+        bool valid = true;
+        for (int i = 0; i < 100000; i++)
+            valid = valid && (vec[i] == i);
+
+        CHECK(valid);
+
+        void* mem = ma.AllocateAligned(100, 256);
+        CHECK((reinterpret_cast<uintptr_t>(mem) & 255) == 0);
+    }
+
+    TEST_CASE("Rewind")
+    {
+        MemoryArena ma;
+        ma.AllocateAligned(64);
+
+        const auto marker = ma.GetMarker();
+        void* mem1 = ma.AllocateAligned(128);
+        ma.AllocateAligned(MemoryArena::LARGE_ALLOC_SIZE * 2);
+        CHECK(ma.TotalSize() >= MemoryArena::LARGE_ALLOC_SIZE * 2);
+
+        ma.RewindTo(marker);
+        CHECK(ma.TotalSize() < MemoryArena::LARGE_ALLOC_SIZE);
+
+        // Memory after the marker is reused
+        void* mem2 = ma.AllocateAligned(128);
+        CHECK(mem1 == mem2);
+
+        {
+            ScopedArenaMarker scoped(ma);
+            ma.AllocateAligned(1000);
+        }
+
+        CHECK(ma.GetMarker().Offset == marker.Offset + 128);
+
+        ma.Reset();
+        CHECK(ma.GetMarker().Offset == 0);
+    }
+};
+
+TEST_SUITE("SegmentedArray")
+{
+    TEST_CASE("Basic")
+    {
+        SegmentedArray<int, 4> arr;
+        int* first = &arr.GetOrAlloc(0);
+
+        // Crosses several segment boundaries, earlier elements don't move
+        for (uint32_t i = 0; i < 1000; i++)
+            arr.GetOrAlloc(i) = (int)i;
+
+        CHECK(first == &arr[0]);
+
+        bool valid = true;
+        for (uint32_t i = 0; i < 1000; i++)
+            valid = valid && (arr[i] == (int)i);
+
+        CHECK(valid);
+
+        // Segments can be allocated out of order
+        SegmentedArray<int, 4> sparse;
+        sparse.GetOrAlloc(100000) = 7;
+        CHECK(sparse[100000] == 7);
+    }
+};
@@ -0,0 +1,222 @@
+#include <Scene/LightTree.h>
+#include <RayTracing/RtCommon.h>
+#include <Utility/RNG.h>
+#include <doctest/doctest.h>
+
+using namespace ZetaRay;
+using namespace ZetaRay::Scene;
+using namespace ZetaRay::Util;
+using namespace ZetaRay::Math;
+
+namespace
+{
+    float3 RandomPoint(RNG& rng, float scale)
+    {
+        return float3(rng.Uniform() - 0.5f, rng.Uniform() - 0.5f, rng.Uniform() - 0.5f) * scale;
+    }
+
+    void RandomTriangles(RNG& rng, uint32_t n, SmallVector<RT::EmissiveTriangle>& tris,
+        SmallVector<float>& power)
+    {
+        tris.resize(n);
+        power.resize(n);
+
+        for (uint32_t i = 0; i < n; i++)
+        {
+            const float3 v0 = RandomPoint(rng, 100.0f);
+            const float3 v1 = v0 + RandomPoint(rng, 2.0f);
+            const float3 v2 = v0 + RandomPoint(rng, 2.0f);
+            const uint32_t rgb = rng.UniformUintBounded(1u << 24);
+
+            tris[i] = RT::EmissiveTriangle(v0, v1, v2, float2(0.0f), float2(0.0f), float2(0.0f),
+                rgb, 0, half(1.0f + rng.Uniform() * 10.0f), i, rng.Uniform() < 0.5f);
+            power[i] = LightTree::EstimatePower(tris[i]);
+        }
+    }
+
+    bool Contains(const LightTree::Node& parent, const LightTree::Node& child)
+    {
+        const float eps = 1e-4f;
+
+        return parent.BoxMin.x <= child.BoxMin.x + eps && parent.BoxMin.y <= child.BoxMin.y + eps &&
+            parent.BoxMin.z <= child.BoxMin.z + eps && parent.BoxMax.x >= child.BoxMax.x - eps &&
+            parent.BoxMax.y >= child.BoxMax.y - eps && parent.BoxMax.z >= child.BoxMax.z - eps;
+    }
+
+    // Whether the node's cone of emission directions contains the given direction. Cones
+    // are only approximately merged, so a parent's cone doesn't necessarily contain its
+    // children's, but it must contain the normal of every triangle below it.
+    bool ConeContains(const LightTree::Node& node, const float3& n)
+    {
+        if (node.CosTheta_o == -1.0f)
+            return true;
+
+        const float theta_d = acosf(Min(Max(node.Axis.dot(n), -1.0f), 1.0f));
+        return theta_d <= acosf(node.CosTheta_o) + 1e-3f;
+    }
+
+    void CheckInvariants(const LightTree& tree, Span<RT::EmissiveTriangle> tris)
+    {
+        auto nodes = tree.Nodes();
+        SmallVector<int> seen;
+        seen.resize(tris.size(), 0);
+
+        for (size_t i = 0; i < nodes.size(); i++)
+        {
+            const LightTree::Node& node = nodes[i];
+
+            if (node.IsLeaf())
+            {
+                REQUIRE(node.Count > 0);
+                REQUIRE(node.Count <= LightTree::MAX_NUM_TRIS_PER_LEAF);
+
+                for (uint32_t t = node.Base; t < node.Base + node.Count; t++)
+                {
+                    const uint32_t triIdx = tree.TriIndices()[t];
+                    seen[triIdx]++;
+
+                    RT::EmissiveTriangle tri = tris[triIdx];
+                    __m128 v0, v1, v2;
+                    tri.LoadVertices(v0, v1, v2);
+                    float3 n = storeFloat3(_mm_sub_ps(v1, v0)).cross(storeFloat3(_mm_sub_ps(v2, v0)));
+                    n.normalize();
+
+                    for (int curr = (int)i; curr != -1; curr = nodes[curr].Parent)
+                        CHECK(ConeContains(nodes[curr], n));
+                }
+
+                continue;
+            }
+
+            const LightTree::Node& left = nodes[i + 1];
+            const LightTree::Node& right = nodes[node.RightChild];
+            REQUIRE(left.Parent == (int)i);
+            REQUIRE(right.Parent == (int)i);
+
+            CHECK(Contains(node, left));
+            CHECK(Contains(node, right));
+            CHECK(fabsf(node.Power - (left.Power + right.Power)) <= 1e-4f * node.Power);
+        }
+
+        // Every triangle appears in exactly one leaf
+        for (size_t t = 0; t < tris.size(); t++)
+            CHECK(seen[t] == 1);
+    }
+}
+
+TEST_SUITE("LightTree")
+{
+    TEST_CASE("Invariants")
+    {
+        RNG rng(3);
+
+        for (uint32_t n : { 1u, 2u, 5u, 100u, 10'000u })
+        {
+            SmallVector<RT::EmissiveTriangle> tris;
+            SmallVector<float> power;
+            RandomTriangles(rng, n, tris, power);
+
+            LightTree tree;
+            tree.Build(tris, power, false);
+
+            INFO("Number of triangles: ", n);
+            REQUIRE(tree.IsBuilt());
+            CheckInvariants(tree, tris);
+        }
+    }
+
+    TEST_CASE("PdfMatchesSampling")
+    {
+        RNG rng(11);
+        const uint32_t n = 2000;
+
+        SmallVector<RT::EmissiveTriangle> tris;
+        SmallVector<float> power;
+        RandomTriangles(rng, n, tris, power);
+
+        LightTree tree;
+        tree.Build(tris, power, false);
+
+        for (int i = 0; i < 10; i++)
+        {
+            const float3 pos = RandomPoint(rng, 150.0f);
+            float3 normal = RandomPoint(rng, 1.0f);
+            normal.normalize();
+
+            // Pdf over all the triangles must integrate to one
+            double sum = 0.0;
+
+            for (uint32_t t = 0; t < n; t++)
+                sum += tree.Pdf(pos, normal, t);
+
+            INFO("Sum of pdfs: ", sum);
+            CHECK(fabs(sum - 1.0) < 1e-3);
+
+            for (int j = 0; j < 100; j++)
+            {
+                const LightTree::Sample s = tree.SampleLight(pos, normal, rng.Uniform());
+                REQUIRE(s.TriIdx < n);
+
+                const float pdf = tree.Pdf(pos, normal, s.TriIdx);
+                INFO("Sampled pdf: ", s.Pdf, ", evaluated pdf: ", pdf);
+                CHECK(fabsf(s.Pdf - pdf) <= 1e-4f * pdf);
+            }
+        }
+    }
+
+    TEST_CASE("RefitMatchesBounds")
+    {
+        RNG rng(7);
+        const uint32_t n = 5000;
+
+        SmallVector<RT::EmissiveTriangle> tris;
+        SmallVector<float> power;
+        RandomTriangles(rng, n, tris, power);
+
+        LightTree tree;
+        tree.Build(tris, power, false);
+
+        // Move a contiguous range of triangles, similar to an emissive instance
+        const uint32_t begin = 1000;
+        const uint32_t end = 1500;
+        const float3 offset(20.0f, -5.0f, 3.0f);
+
+        for (uint32_t t = begin; t < end; t++)
+        {
+            __m128 v0, v1, v2;
+            tris[t].LoadVertices(v0, v1, v2);
+            const __m128 vOffset = loadFloat3(const_cast<float3&>(offset));
+            tris[t].StoreVertices(_mm_add_ps(v0, vOffset), _mm_add_ps(v1, vOffset),
+                _mm_add_ps(v2, vOffset));
+        }
+
+        tree.Refit(tris, begin, end);
+        CheckInvariants(tree, tris);
+
+        // Every leaf must bound its (possibly moved) triangles
+        auto nodes = tree.Nodes();
+
+        for (auto& node : nodes)
+        {
+            if (!node.IsLeaf())
+                continue;
+
+            for (uint32_t i = node.Base; i < node.Base + node.Count; i++)
+            {
+                __m128 v0, v1, v2;
+                tris[tree.TriIndices()[i]].LoadVertices(v0, v1, v2);
+
+                for (__m128 v : { v0, v1, v2 })
+                {
+                    const float3 p = storeFloat3(v);
+                    CHECK(p.x >= node.BoxMin.x - 1e-4f);
+                    CHECK(p.y >= node.BoxMin.y - 1e-4f);
+                    CHECK(p.z >= node.BoxMin.z - 1e-4f);
+                    CHECK(p.x <= node.BoxMax.x + 1e-4f);
+                    CHECK(p.y <= node.BoxMax.y + 1e-4f);
+                    CHECK(p.z <= node.BoxMax.z + 1e-4f);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,154 @@
+#include <Support/ThreadCachingPool.h>
+#include <Utility/RNG.h>
+#include <doctest/doctest.h>
+#include <string.h>
+#include <thread>
+
+using namespace ZetaRay::Support;
+using namespace ZetaRay::Util;
+
+namespace
+{
+    struct Allocation
+    {
+        uint64_t* Mem;
+        size_t Size;
+        size_t Alignment;
+        uint64_t Tag;
+    };
+
+    // Fills the allocation with a tag so that overlapping allocations can be detected
+    void Fill(const Allocation& a)
+    {
+        for (size_t i = 0; i < a.Size / sizeof(uint64_t); i++)
+            a.Mem[i] = a.Tag;
+    }
+
+    bool Verify(const Allocation& a)
+    {
+        for (size_t i = 0; i < a.Size / sizeof(uint64_t); i++)
+        {
+            if (a.Mem[i] != a.Tag)
+                return false;
+        }
+
+        return true;
+    }
+}
+
+TEST_SUITE("ThreadCachingPool")
+{
+    TEST_CASE("Alignment")
+    {
+        const int prevThreadIdx = g_threadIdx;
+        g_threadIdx = 0;
+
+        ThreadCachingPool pool;
+
+        for (size_t alignment : { 16llu, 32llu, 64llu, 128llu, 256llu, 512llu })
+        {
+            for (size_t size : { 16llu, 100llu, 1000llu, 4000llu })
+            {
+                void* mem = pool.AllocateAligned(size, alignment);
+                CHECK((reinterpret_cast<uintptr_t>(mem) & (alignment - 1)) == 0);
+                memset(mem, 0xff, size);
+                pool.FreeAligned(mem, size, alignment);
+            }
+        }
+
+        g_threadIdx = prevThreadIdx;
+    }
+
+    TEST_CASE("Reuse")
+    {
+        const int prevThreadIdx = g_threadIdx;
+        g_threadIdx = 0;
+
+        ThreadCachingPool pool;
+
+        void* a = pool.AllocateAligned(24);
+        pool.FreeAligned(a, 24);
+        void* b = pool.AllocateAligned(30);
+
+        // Same size class, most recently freed chunk is returned first
+        CHECK(a == b);
+        pool.FreeAligned(b, 30);
+
+        const auto stats = pool.GetStats(MemoryPool::GetPoolIndexFromSize(24));
+        CHECK(stats.ChunkSize == 32);
+        CHECK(stats.NumAllocs == 2);
+        CHECK(stats.NumFrees == 2);
+        CHECK(stats.NumBatchFetches == 1);
+
+        g_threadIdx = prevThreadIdx;
+    }
+
+    TEST_CASE("MultiThreaded")
+    {
+        constexpr int NUM_THREADS = 4;
+        constexpr int NUM_OPS = 20000;
+
+        ThreadCachingPool pool;
+        std::atomic_int numErrors = 0;
+
+        // Allocations made by thread i are freed by thread (i + 1) % NUM_THREADS
+        SmallVector<Allocation> handoff[NUM_THREADS];
+        std::atomic_bool allocated[NUM_THREADS] = {};
+
+        auto work = [&](int t)
+            {
+                // Last thread doesn't have a cache and goes through the central pool
+                g_threadIdx = t == NUM_THREADS - 1 ? -1 : t + 1;
+                RNG rng(t);
+                SmallVector<Allocation> live;
+
+                for (int op = 0; op < NUM_OPS; op++)
+                {
+                    if (live.size() < 256 && (rng.UniformUint() & 1))
+                    {
+                        Allocation a{ .Size = 8 + rng.UniformUintBounded(1000),
+                            .Alignment = rng.UniformUintBounded(4) == 0 ? 64llu : 16llu,
+                            .Tag = ((uint64_t)t << 32) | op };
+                        a.Mem = reinterpret_cast<uint64_t*>(pool.AllocateAligned(a.Size, a.Alignment));
+                        Fill(a);
+                        live.push_back(a);
+                    }
+                    else if (!live.empty())
+                    {
+                        const Allocation a = live.back();
+                        live.pop_back();
+                        numErrors += !Verify(a);
+                        pool.FreeAligned(a.Mem, a.Size, a.Alignment);
+                    }
+                }
+
+                handoff[t] = ZetaMove(live);
+                allocated[t].store(true, std::memory_order_release);
+
+                const int src = (t + NUM_THREADS - 1) % NUM_THREADS;
+                while (!allocated[src].load(std::memory_order_acquire))
+                    std::this_thread::yield();
+
+                for (auto& a : handoff[src])
+                {
+                    numErrors += !Verify(a);
+                    pool.FreeAligned(a.Mem, a.Size, a.Alignment);
+                }
+            };
+
+        std::thread threads[NUM_THREADS];
+        for (int t = 0; t < NUM_THREADS; t++)
+            threads[t] = std::thread(work, t);
+
+        for (int t = 0; t < NUM_THREADS; t++)
+            threads[t].join();
+
+        CHECK(numErrors == 0);
+
+        for (size_t c = 0; c < ThreadCachingPool::NUM_SIZE_CLASSES; c++)
+        {
+            const auto stats = pool.GetStats(c);
+            CHECK(stats.NumAllocs == stats.NumFrees);
+        }
+    }
+}
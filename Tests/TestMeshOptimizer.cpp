@@ -0,0 +1,128 @@
+#include <Model/MeshOptimizer.h>
+#include <Utility/RNG.h>
+#include <doctest/doctest.h>
+#include <algorithm>
+
+using namespace ZetaRay;
+using namespace ZetaRay::Core;
+using namespace ZetaRay::Math;
+using namespace ZetaRay::Model;
+using namespace ZetaRay::Util;
+
+namespace
+{
+    // Grid of n x n quads where every quad has its own four vertices, in random triangle order
+    void CreateUnweldedGrid(uint32_t n, SmallVector<Vertex>& vertices, SmallVector<uint32_t>& indices)
+    {
+        for (uint32_t y = 0; y < n; y++)
+        {
+            for (uint32_t x = 0; x < n; x++)
+            {
+                const uint32_t base = (uint32_t)vertices.size();
+
+                for (uint32_t c = 0; c < 4; c++)
+                {
+                    Vertex v{};
+                    v.Position = float3(float(x + (c & 1)), 0.0f, float(y + (c >> 1)));
+                    v.TexUV = float2(v.Position.x / n, v.Position.z / n);
+                    v.Normal = oct32(0.0f, 1.0f, 0.0f);
+                    v.Tangent = oct32(1.0f, 0.0f, 0.0f);
+                    vertices.push_back(v);
+                }
+
+                const uint32_t quad[6] = { base, base + 2, base + 1, base + 1, base + 2, base + 3 };
+                indices.append_range(quad, quad + 6);
+            }
+        }
+
+        RNG rng(n);
+        const uint32_t numTris = (uint32_t)indices.size() / 3;
+
+        for (uint32_t t = numTris - 1; t > 0; t--)
+        {
+            const uint32_t other = rng.UniformUintBounded(t + 1);
+
+            for (int j = 0; j < 3; j++)
+                std::swap(indices[t * 3 + j], indices[other * 3 + j]);
+        }
+    }
+
+    struct Triangle
+    {
+        float3 V0;
+        float3 V1;
+        float3 V2;
+    };
+
+    // Triangles as position triples starting from the smallest vertex, so that winding is preserved
+    SmallVector<Triangle> GetTriangles(Span<Vertex> vertices, Span<uint32_t> indices)
+    {
+        SmallVector<Triangle> tris;
+
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            float3 p[3] = { vertices[indices[i]].Position, vertices[indices[i + 1]].Position,
+                vertices[indices[i + 2]].Position };
+
+            auto less = [](const float3& a, const float3& b) { return a.x < b.x || (a.x == b.x && a.z < b.z); };
+            int first = less(p[1], p[0]) ? 1 : 0;
+            first = less(p[2], p[first]) ? 2 : first;
+
+            tris.push_back(Triangle{ p[first], p[(first + 1) % 3], p[(first + 2) % 3] });
+        }
+
+        std::sort(tris.begin(), tris.end(), [](const Triangle& a, const Triangle& b)
+            {
+                return memcmp(&a, &b, sizeof(Triangle)) < 0;
+            });
+
+        return tris;
+    }
+}
+
+TEST_SUITE("MeshOptimizer")
+{
+    TEST_CASE("Weld")
+    {
+        SmallVector<Vertex> vertices;
+        SmallVector<uint32_t> indices;
+        CreateUnweldedGrid(8, vertices, indices);
+
+        const uint32_t numVertices = MeshOptimizer::WeldVertices(vertices, indices);
+        CHECK(numVertices == 9 * 9);
+
+        for (auto idx : indices)
+            CHECK(idx < numVertices);
+    }
+
+    TEST_CASE("Optimize")
+    {
+        SmallVector<Vertex> vertices;
+        SmallVector<uint32_t> indices;
+        CreateUnweldedGrid(64, vertices, indices);
+
+        const auto trisBefore = GetTriangles(vertices, indices);
+        const auto stats = MeshOptimizer::Optimize(vertices, indices);
+
+        CHECK(stats.NumVerticesBefore == 64 * 64 * 4);
+        CHECK(stats.NumVerticesAfter == 65 * 65);
+        CHECK(stats.NumTriangles == 64 * 64 * 2);
+        // Random order has close to the worst-case ACMR of 3 with duplicated vertices
+        CHECK(stats.ACMRBefore() > 1.9f);
+        CHECK(stats.ACMRAfter() < 0.8f);
+
+        // Vertices are in order of first use
+        uint32_t maxIdx = 0;
+
+        for (auto idx : indices)
+        {
+            CHECK(idx <= maxIdx + 1);
+            maxIdx = std::max(maxIdx, idx);
+        }
+
+        // Same triangles with the same winding
+        const auto trisAfter = GetTriangles(Span(vertices.data(), stats.NumVerticesAfter), indices);
+        CHECK(trisBefore.size() == trisAfter.size());
+        CHECK(memcmp(trisBefore.data(), trisAfter.data(), trisBefore.size() * sizeof(Triangle)) == 0);
+    }
+}
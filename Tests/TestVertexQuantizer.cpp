@@ -0,0 +1,57 @@
+#include <Model/VertexQuantizer.h>
+#include <Utility/RNG.h>
+#include <Utility/SmallVector.h>
+#include <doctest/doctest.h>
+
+using namespace ZetaRay;
+using namespace ZetaRay::Core;
+using namespace ZetaRay::Math;
+using namespace ZetaRay::Model;
+using namespace ZetaRay::Util;
+
+TEST_SUITE("VertexQuantizer")
+{
+    TEST_CASE("RoundTrip")
+    {
+        RNG rng(17);
+        SmallVector<Vertex> vertices;
+
+        for (int i = 0; i < 1000; i++)
+        {
+            Vertex v{};
+            v.Position = float3(rng.Uniform() * 20.0f - 10.0f, rng.Uniform() * 2.0f + 5.0f, -3.0f);
+            v.TexUV = float2(rng.Uniform(), rng.Uniform() * 4.0f);
+            v.Normal = oct32(0.0f, 0.0f, 1.0f);
+            v.Tangent = oct32(1.0f, 0.0f, 0.0f);
+            vertices.push_back(v);
+        }
+
+        const AABB bounds = VertexQuantizer::ComputeBounds(vertices);
+        CHECK(bounds.Extents.z == 0.0f);
+
+        SmallVector<CompactVertex> compact;
+        compact.resize(vertices.size());
+        VertexQuantizer::Encode(vertices, bounds, compact);
+
+        SmallVector<Vertex> decoded;
+        decoded.resize(vertices.size());
+        VertexQuantizer::Decode(compact, bounds, decoded);
+
+        const auto err = VertexQuantizer::MeasureError(vertices, decoded, bounds);
+
+        // Half a quantization step along the largest dimension
+        const float maxDim = 2.0f * Max(Max(bounds.Extents.x, bounds.Extents.y), bounds.Extents.z);
+        CHECK(err.MaxPositionError <= 0.5f * maxDim / 65535.0f * 1.01f);
+        CHECK(err.MaxRelativePositionError <= 1e-5f);
+        // Half precision has 11 significant bits, UVs are in [0, 4]
+        CHECK(err.MaxTexUVError <= 4.0f / 2048.0f);
+
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            // Degenerate dimension is exact
+            CHECK(decoded[i].Position.z == -3.0f);
+            CHECK(memcmp(&decoded[i].Normal, &vertices[i].Normal, sizeof(oct32)) == 0);
+            CHECK(memcmp(&decoded[i].Tangent, &vertices[i].Tangent, sizeof(oct32)) == 0);
+        }
+    }
+}
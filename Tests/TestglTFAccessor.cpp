@@ -0,0 +1,135 @@
+#include <Model/glTFAccessor.h>
+#include <Utility/RNG.h>
+#include <doctest/doctest.h>
+
+using namespace ZetaRay;
+using namespace ZetaRay::Core;
+using namespace ZetaRay::Math;
+using namespace ZetaRay::Model::glTF;
+using namespace ZetaRay::Util;
+
+namespace
+{
+    // Interleaved layout with 4-byte aligned elements, as required for vertex attributes
+    struct QuantizedVertex
+    {
+        int16_t Position[3];
+        int8_t Normal[3];
+        uint8_t Pad[3];
+        uint16_t TexUV[2];
+    };
+
+    static_assert(sizeof(QuantizedVertex) == 16);
+}
+
+TEST_SUITE("glTFAccessor")
+{
+    TEST_CASE("Attributes")
+    {
+        // Not a multiple of eight, so that both batched and per-element paths are used
+        constexpr uint32_t N = 45;
+        SmallVector<QuantizedVertex> src;
+        src.resize(N);
+        RNG rng(17);
+
+        for (auto& v : src)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                v.Position[c] = (int16_t)(rng.UniformUintBounded(UINT16_MAX + 1) - 32768);
+                v.Normal[c] = (int8_t)(rng.UniformUintBounded(256) - 128);
+            }
+
+            memset(v.Pad, 0, sizeof(v.Pad));
+            v.TexUV[0] = (uint16_t)rng.UniformUintBounded(UINT16_MAX + 1);
+            v.TexUV[1] = (uint16_t)rng.UniformUintBounded(UINT16_MAX + 1);
+        }
+
+        const uint8_t* base = reinterpret_cast<const uint8_t*>(src.data());
+        const size_t size = src.size() * sizeof(QuantizedVertex);
+
+        SmallVector<Vertex> vertices;
+        vertices.resize(N);
+
+        // Unnormalized positions (KHR_mesh_quantization)
+        Accessor::Stream positions{ .Data = base + offsetof(QuantizedVertex, Position),
+            .Count = N,
+            .Stride = sizeof(QuantizedVertex),
+            .Type = Accessor::COMPONENT_TYPE::INT16,
+            .Normalized = false,
+            .SizeInBytes = size - offsetof(QuantizedVertex, Position) };
+        Accessor::DecodePositions(positions, vertices);
+
+        Accessor::Stream normals{ .Data = base + offsetof(QuantizedVertex, Normal),
+            .Count = N,
+            .Stride = sizeof(QuantizedVertex),
+            .Type = Accessor::COMPONENT_TYPE::INT8,
+            .Normalized = true,
+            .SizeInBytes = size - offsetof(QuantizedVertex, Normal) };
+        Accessor::DecodeNormals(normals, vertices);
+
+        Accessor::Stream texCoords{ .Data = base + offsetof(QuantizedVertex, TexUV),
+            .Count = N,
+            .Stride = sizeof(QuantizedVertex),
+            .Type = Accessor::COMPONENT_TYPE::UINT16,
+            .Normalized = true,
+            .SizeInBytes = size - offsetof(QuantizedVertex, TexUV) };
+        Accessor::DecodeTexCoords(texCoords, vertices);
+
+        for (uint32_t i = 0; i < N; i++)
+        {
+            const QuantizedVertex& q = src[i];
+            const Vertex& v = vertices[i];
+
+            CHECK(v.Position.x == float(q.Position[0]));
+            CHECK(v.Position.y == float(q.Position[1]));
+            CHECK(v.Position.z == -float(q.Position[2]));
+
+            // Both -128 and -127 map to -1
+            float n[3];
+            for (int c = 0; c < 3; c++)
+                n[c] = Max(q.Normal[c] / 127.0f, -1.0f);
+
+            const oct32 expected(n[0], n[1], -n[2]);
+            CHECK(v.Normal.v.x == expected.v.x);
+            CHECK(v.Normal.v.y == expected.v.y);
+
+            CHECK(v.TexUV.x == q.TexUV[0] / 65535.0f);
+            CHECK(v.TexUV.y == q.TexUV[1] / 65535.0f);
+        }
+    }
+
+    TEST_CASE("Indices")
+    {
+        // Eight triangles at a time, plus a remainder
+        constexpr uint32_t NUM_TRIS = 8 * 3 + 5;
+        SmallVector<uint16_t> src;
+        src.resize(NUM_TRIS * 3);
+
+        for (uint32_t i = 0; i < src.size(); i++)
+            src[i] = (uint16_t)(i * 7 + 60000);
+
+        Accessor::Stream stream{ .Data = reinterpret_cast<const uint8_t*>(src.data()),
+            .Count = src.size(),
+            .Stride = sizeof(uint16_t),
+            .Type = Accessor::COMPONENT_TYPE::UINT16,
+            .SizeInBytes = src.size() * sizeof(uint16_t) };
+
+        SmallVector<uint32_t> indices;
+        indices.resize(src.size());
+        Accessor::DecodeIndices(stream, indices, true);
+
+        for (uint32_t t = 0; t < NUM_TRIS; t++)
+        {
+            CHECK(indices[t * 3] == src[t * 3]);
+            CHECK(indices[t * 3 + 1] == src[t * 3 + 2]);
+            CHECK(indices[t * 3 + 2] == src[t * 3 + 1]);
+        }
+
+        // Flipping again restores the original order
+        Accessor::FlipWinding(indices);
+
+        for (uint32_t i = 0; i < src.size(); i++)
+            CHECK(indices[i] == src[i]);
+    }
+}
@@ -0,0 +1,79 @@
+#include "Benchmark.h"
+#include <Math/Sampling.h>
+#include <Utility/RNG.h>
+#include <Utility/SmallVector.h>
+#include <string.h>
+
+using namespace ZetaRay;
+using namespace ZetaRay::App;
+using namespace ZetaRay::Math;
+using namespace ZetaRay::Util;
+
+// Compares alias table construction with the serial worklists (AliasTable_Build()) against
+// the partitioned builder, both on the calling thread and on the worker threads. Weights
+// mimic emissive triangle power -- most triangles are dim, a few are very bright. Meant for
+// release builds -- round-off in AliasTable_Build() trips its debug assertions at these sizes.
+namespace
+{
+    static constexpr int NUM_RUNS = 10;
+
+    void FillWeights(MutableSpan<float> weights)
+    {
+        RNG rng(weights.size());
+
+        for (auto& w : weights)
+        {
+            const float u = Max(rng.Uniform(), 1e-2f);
+            w = 1.0f / (u * u);
+        }
+    }
+
+    template<typename F>
+    double Time(F&& build)
+    {
+        DeltaTimer timer;
+        timer.Start();
+
+        for (int i = 0; i < NUM_RUNS; i++)
+            build();
+
+        timer.End();
+
+        return timer.DeltaMilli() / NUM_RUNS;
+    }
+}
+
+void Benchmark::AliasTable()
+{
+    printf("Average of %d runs, times in ms\n", NUM_RUNS);
+    printf("%-12s %12s %18s %18s\n", "Weights", "Serial", "Partitioned (1T)", "Partitioned");
+
+    for (uint32_t n : { 10'000u, 100'000u, 1'000'000u, 4'000'000u })
+    {
+        SmallVector<float> weights;
+        weights.resize(n);
+        FillWeights(weights);
+
+        // AliasTable_Build() modifies the weights
+        SmallVector<float> scratch;
+        scratch.resize(n);
+        SmallVector<AliasTableEntry> table;
+        table.resize(n);
+
+        const double serial = Time([&]()
+            {
+                memcpy(scratch.data(), weights.data(), n * sizeof(float));
+
+                // Entries are expected to be default-initialized
+                for (auto& e : table)
+                    e = AliasTableEntry();
+
+                AliasTable_Build(scratch, table);
+            });
+        const double partitioned1T = Time([&]() { AliasTable_BuildPartitioned(weights, table, false); });
+        const double partitioned = Time([&]() { AliasTable_BuildPartitioned(weights, table); });
+
+        printf("%-12u %12.3f %18.3f %18.3f (%.2fx)\n", n, serial, partitioned1T, partitioned,
+            serial / partitioned);
+    }
+}
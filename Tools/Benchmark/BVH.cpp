@@ -0,0 +1,486 @@
+#include "Benchmark.h"
+#include <Math/WideBVH.h>
+#include <Math/CollisionFuncs.h>
+#include <Math/MatrixFuncs.h>
+#include <Utility/RNG.h>
+#include <Utility/SmallVector.h>
+#include <cgltf/cgltf.h>
+#include <math.h>
+
+using namespace ZetaRay;
+using namespace ZetaRay::App;
+using namespace ZetaRay::Math;
+using namespace ZetaRay::Util;
+
+namespace
+{
+    static constexpr int NUM_RUNS = 5;
+    static constexpr int NUM_FRUSTUM_QUERIES = 200;
+    static constexpr int NUM_RAYS = 200'000;
+    // glTF scenes are replicated on a grid until there are at least this many instances
+    static constexpr size_t MIN_NUM_GLTF_INSTANCES = 100'000;
+
+    using InstanceList = SmallVector<BVH::BVHInput>;
+
+    enum class DISTRIBUTION
+    {
+        // Instance centers are uniformly distributed in a box
+        UNIFORM,
+        // Instances are grouped in a few dense clusters with a wide range of sizes
+        CLUSTERED
+    };
+
+    void GenerateInstances(DISTRIBUTION d, size_t n, InstanceList& instances)
+    {
+        RNG rng(0x5eed);
+        instances.resize(n);
+
+        constexpr int NUM_CLUSTERS = 64;
+        float3 clusterCenters[NUM_CLUSTERS];
+
+        for (int c = 0; c < NUM_CLUSTERS; c++)
+        {
+            clusterCenters[c] = float3(rng.Uniform() * 2000.0f - 1000.0f,
+                rng.Uniform() * 200.0f,
+                rng.Uniform() * 2000.0f - 1000.0f);
+        }
+
+        for (size_t i = 0; i < n; i++)
+        {
+            float3 center;
+            float3 extents;
+
+            if (d == DISTRIBUTION::UNIFORM)
+            {
+                center = float3(rng.Uniform() * 2000.0f - 1000.0f,
+                    rng.Uniform() * 200.0f,
+                    rng.Uniform() * 2000.0f - 1000.0f);
+                extents = float3(0.5f + rng.Uniform() * 2.0f,
+                    0.5f + rng.Uniform() * 2.0f,
+                    0.5f + rng.Uniform() * 2.0f);
+            }
+            else
+            {
+                const float3& c = clusterCenters[rng.UniformUintBounded(NUM_CLUSTERS)];
+                const float r = 40.0f * rng.Uniform() * rng.Uniform();
+                center = float3(c.x + r * (rng.Uniform() * 2.0f - 1.0f),
+                    c.y + r * (rng.Uniform() * 2.0f - 1.0f),
+                    c.z + r * (rng.Uniform() * 2.0f - 1.0f));
+                // Mostly small props with the occasional large object
+                const float s = rng.Uniform() < 0.02f ? 30.0f : 0.2f + rng.Uniform();
+                extents = float3(s * (0.5f + rng.Uniform()),
+                    s * (0.5f + rng.Uniform()),
+                    s * (0.5f + rng.Uniform()));
+            }
+
+            instances[i].BoundingBox = AABB(center, extents);
+            instances[i].InstanceID = i;
+        }
+    }
+
+    // Returns world-space AABB of every mesh primitive in the given glTF scene. Only the
+    // JSON is parsed -- bounds come from min/max of the POSITION accessors.
+    bool LoadGltfInstances(const char* path, InstanceList& instances)
+    {
+        cgltf_options options = {};
+        cgltf_data* data = nullptr;
+
+        if (cgltf_parse_file(&options, path, &data) != cgltf_result_success)
+        {
+            printf("Failed to parse %s\n", path);
+            return false;
+        }
+
+        for (size_t n = 0; n < data->nodes_count; n++)
+        {
+            const cgltf_node& node = data->nodes[n];
+            if (!node.mesh)
+                continue;
+
+            // Column-major
+            float M[16];
+            cgltf_node_transform_world(&node, M);
+
+            for (size_t p = 0; p < node.mesh->primitives_count; p++)
+            {
+                const cgltf_primitive& prim = node.mesh->primitives[p];
+
+                for (size_t a = 0; a < prim.attributes_count; a++)
+                {
+                    const cgltf_accessor* accessor = prim.attributes[a].data;
+                    if (prim.attributes[a].type != cgltf_attribute_type_position ||
+                        !accessor->has_min || !accessor->has_max)
+                    {
+                        continue;
+                    }
+
+                    const float3 c = float3(0.5f * (accessor->max[0] + accessor->min[0]),
+                        0.5f * (accessor->max[1] + accessor->min[1]),
+                        0.5f * (accessor->max[2] + accessor->min[2]));
+                    const float3 e = float3(0.5f * (accessor->max[0] - accessor->min[0]),
+                        0.5f * (accessor->max[1] - accessor->min[1]),
+                        0.5f * (accessor->max[2] - accessor->min[2]));
+
+                    // Ref: J. Arvo, "Transforming Axis-Aligned Bounding Boxes," Graphics Gems, 1990.
+                    float center[3];
+                    float extents[3];
+
+                    for (int i = 0; i < 3; i++)
+                    {
+                        center[i] = M[12 + i] + M[i] * c.x + M[4 + i] * c.y + M[8 + i] * c.z;
+                        extents[i] = fabsf(M[i]) * e.x + fabsf(M[4 + i]) * e.y + fabsf(M[8 + i]) * e.z;
+                    }
+
+                    instances.push_back(BVH::BVHInput{
+                        .BoundingBox = AABB(float3(center[0], center[1], center[2]),
+                            float3(extents[0], extents[1], extents[2])),
+                        .InstanceID = instances.size() });
+
+                    break;
+                }
+            }
+        }
+
+        cgltf_free(data);
+
+        if (instances.empty())
+        {
+            printf("%s doesn't contain any meshes with position bounds.\n", path);
+            return false;
+        }
+
+        // Replicate the scene on an XZ grid to get a realistic large instance count
+        const size_t numOriginal = instances.size();
+        const int gridDim = (int)ceilf(sqrtf((float)MIN_NUM_GLTF_INSTANCES / numOriginal));
+
+        if (gridDim > 1)
+        {
+            v_AABB vSceneBox(instances[0].BoundingBox);
+            for (size_t i = 1; i < numOriginal; i++)
+                vSceneBox = unionAABB(vSceneBox, v_AABB(instances[i].BoundingBox));
+
+            const AABB sceneBox = store(vSceneBox);
+            const float spacingX = 2.2f * sceneBox.Extents.x;
+            const float spacingZ = 2.2f * sceneBox.Extents.z;
+            instances.reserve(numOriginal * gridDim * gridDim);
+
+            for (int gz = 0; gz < gridDim; gz++)
+            {
+                for (int gx = 0; gx < gridDim; gx++)
+                {
+                    if (gx == 0 && gz == 0)
+                        continue;
+
+                    for (size_t i = 0; i < numOriginal; i++)
+                    {
+                        BVH::BVHInput copy = instances[i];
+                        copy.BoundingBox.Center.x += gx * spacingX;
+                        copy.BoundingBox.Center.z += gz * spacingZ;
+                        copy.InstanceID = instances.size();
+
+                        instances.push_back(copy);
+                    }
+                }
+            }
+        }
+
+        return true;
+    }
+
+    void Run(const char* setName, Span<BVH::BVHInput> instances)
+    {
+        struct Config
+        {
+            const char* Name;
+            BVH::BUILD_METHOD Method;
+            uint32_t NumBins;
+        };
+
+        static constexpr Config CONFIGS[] = {
+            { "Longest axis (6 bins)", BVH::BUILD_METHOD::LONGEST_AXIS, 6 },
+            { "All axes, 16 bins", BVH::BUILD_METHOD::ALL_AXES_PARALLEL, 16 },
+            { "All axes, 32 bins", BVH::BUILD_METHOD::ALL_AXES_PARALLEL, 32 }
+        };
+
+        for (auto& config : CONFIGS)
+        {
+            double totalMs = 0.0;
+            float sahCost = 0.0f;
+
+            for (int run = 0; run < NUM_RUNS; run++)
+            {
+                BVH bvh;
+
+                DeltaTimer timer;
+                timer.Start();
+
+                bvh.Build(instances, config.Method, config.NumBins);
+
+                timer.End();
+                totalMs += timer.DeltaMilli();
+                sahCost = bvh.SAHCost();
+            }
+
+            printf("%-16s %10llu %-24s %12.3f %12.2f\n", setName, instances.size(), config.Name,
+                totalMs / NUM_RUNS, sahCost);
+        }
+    }
+    struct TraversalInputs
+    {
+        SmallVector<float4x4a> ViewToWorld;
+        SmallVector<Ray> Rays;
+    };
+
+    void GenerateTraversalInputs(const AABB& worldBox, TraversalInputs& inputs)
+    {
+        RNG rng(0xc0ffee);
+        const float3 minCorner = worldBox.Center - worldBox.Extents;
+        const float3 size = worldBox.Extents * 2.0f;
+
+        auto pointInBox = [&]()
+            {
+                return float3(minCorner.x + rng.Uniform() * size.x,
+                    minCorner.y + rng.Uniform() * size.y,
+                    minCorner.z + rng.Uniform() * size.z);
+            };
+
+        // Cameras are placed randomly inside the scene, looking in a random horizontal direction
+        inputs.ViewToWorld.resize(NUM_FRUSTUM_QUERIES);
+
+        for (int i = 0; i < NUM_FRUSTUM_QUERIES; i++)
+        {
+            const float3 pos = pointInBox();
+            const v_float4x4 vM = mul(rotateY(rng.Uniform() * TWO_PI), translate(pos.x, pos.y, pos.z));
+            inputs.ViewToWorld[i] = store(vM);
+        }
+
+        // Incoherent rays -- random origin inside the scene and uniformly distributed direction
+        inputs.Rays.resize(NUM_RAYS);
+
+        for (int i = 0; i < NUM_RAYS; i++)
+        {
+            const float cosTheta = 1.0f - 2.0f * rng.Uniform();
+            const float sinTheta = sqrtf(Math::Max(0.0f, 1.0f - cosTheta * cosTheta));
+            const float phi = rng.Uniform() * TWO_PI;
+            const float3 dir(sinTheta * cosf(phi), cosTheta, sinTheta * sinf(phi));
+
+            inputs.Rays[i] = Ray(pointInBox(), dir);
+        }
+    }
+
+    template<typename Tree>
+    void RunTraversal(const char* setName, const char* layout, Tree& tree, 
+        const TraversalInputs& inputs, Span<uint64_t> referenceHits)
+    {
+        // Keep the number of visible instances well below the frame allocator's block size
+        const ViewFrustum frustum(0.25f * PI, 16.0f / 9.0f, 0.1f, 150.0f);
+        SmallVector<uint64_t, App::FrameAllocator> visible;
+        visible.reserve(16 * 1024);
+        size_t totalVisible = 0;
+
+        DeltaTimer timer;
+        timer.Start();
+
+        for (auto& viewToWorld : inputs.ViewToWorld)
+        {
+            visible.clear();
+            tree.DoFrustumCulling(frustum, viewToWorld, visible);
+            totalVisible += visible.size();
+        }
+
+        timer.End();
+        const double frustumMicro = timer.DeltaMicro() / NUM_FRUSTUM_QUERIES;
+
+        // Results of the binary BVH are used as reference
+        const bool isReference = referenceHits.size() == 0;
+        SmallVector<uint64_t> hits;
+        hits.resize(NUM_RAYS);
+
+        timer.Start();
+
+        for (int i = 0; i < NUM_RAYS; i++)
+        {
+            Ray r = inputs.Rays[i];
+            hits[i] = tree.CastRay(r);
+        }
+
+        timer.End();
+        const double mraysPerSec = NUM_RAYS / timer.DeltaMicro();
+
+        int mismatches = 0;
+        if (!isReference)
+        {
+            for (int i = 0; i < NUM_RAYS; i++)
+                mismatches += hits[i] != referenceHits[i];
+        }
+
+        printf("%-16s %-8s %14.2f %12zu %12.2f %12d\n", setName, layout, frustumMicro,
+            totalVisible / NUM_FRUSTUM_QUERIES, mraysPerSec, mismatches);
+    }
+
+    void RunTraversal(const char* setName, Span<BVH::BVHInput> instances)
+    {
+        BVH bvh;
+        bvh.Build(instances);
+
+        BVH4 bvh4;
+        bvh4.Build(bvh);
+
+        BVH8 bvh8;
+        bvh8.Build(bvh);
+
+        TraversalInputs inputs;
+        GenerateTraversalInputs(bvh.GetWorldAABB(), inputs);
+
+        SmallVector<uint64_t> referenceHits;
+        referenceHits.resize(NUM_RAYS);
+
+        for (int i = 0; i < NUM_RAYS; i++)
+        {
+            Ray r = inputs.Rays[i];
+            referenceHits[i] = bvh.CastRay(r);
+        }
+
+        RunTraversal(setName, "Binary", bvh, inputs, Span<uint64_t>(nullptr, 0));
+        RunTraversal(setName, "BVH4", bvh4, inputs, referenceHits);
+        RunTraversal(setName, "BVH8", bvh8, inputs, referenceHits);
+    }
+    void RunRayBatches(const char* setName, Span<BVH::BVHInput> instances)
+    {
+        BVH bvh;
+        bvh.Build(instances);
+
+        const AABB worldBox = bvh.GetWorldAABB();
+        RNG rng(0xbeef);
+
+        // Pinhole camera at the edge of the scene looking toward its center, one ray per pixel
+        constexpr int WIDTH = 1280;
+        constexpr int HEIGHT = 720;
+        const float3 eye = worldBox.Center - float3(0.0f, 0.0f, worldBox.Extents.z) + 
+            float3(0.0f, 0.25f * worldBox.Extents.y, 0.0f);
+        const float tanHalfFOV = tanf(0.25f * PI);
+        const float aspectRatio = (float)WIDTH / HEIGHT;
+
+        SmallVector<Ray> cameraRays;
+        cameraRays.resize(WIDTH * HEIGHT);
+
+        for (int y = 0; y < HEIGHT; y++)
+        {
+            for (int x = 0; x < WIDTH; x++)
+            {
+                float3 dir(((x + 0.5f) / WIDTH * 2.0f - 1.0f) * tanHalfFOV * aspectRatio,
+                    (1.0f - (y + 0.5f) / HEIGHT * 2.0f) * tanHalfFOV,
+                    1.0f);
+                dir.normalize();
+
+                cameraRays[y * WIDTH + x] = Ray(eye, dir);
+            }
+        }
+
+        TraversalInputs inputs;
+        GenerateTraversalInputs(worldBox, inputs);
+
+        SmallVector<uint64_t> hits;
+        hits.resize(cameraRays.size());
+
+        auto report = [setName](const char* rayType, const char* method, size_t numRays, 
+            double microSec)
+            {
+                printf("%-16s %-12s %-24s %12.2f\n", setName, rayType, method, numRays / microSec);
+            };
+
+        for (int t = 0; t < 2; t++)
+        {
+            const char* rayType = t == 0 ? "Camera" : "Incoherent";
+            Span<Ray> rays = t == 0 ? Span<Ray>(cameraRays) : Span<Ray>(inputs.Rays);
+            MutableSpan<uint64_t> out(hits.data(), rays.size());
+
+            DeltaTimer timer;
+            timer.Start();
+
+            for (size_t i = 0; i < rays.size(); i++)
+            {
+                Ray r = rays[i];
+                out[i] = bvh.CastRay(r);
+            }
+
+            timer.End();
+            report(rayType, "CastRay", rays.size(), timer.DeltaMicro());
+
+            timer.Start();
+            bvh.CastRays(rays, out, false);
+            timer.End();
+            report(rayType, "CastRays", rays.size(), timer.DeltaMicro());
+
+            timer.Start();
+            bvh.CastRays(rays, out, true);
+            timer.End();
+            report(rayType, "CastRays (parallel)", rays.size(), timer.DeltaMicro());
+        }
+    }
+}
+
+void Benchmark::BVHBuild()
+{
+    printf("%d threads, average of %d runs\n", App::GetNumWorkerThreads(), NUM_RUNS);
+    printf("%-16s %10s %-24s %12s %12s\n", "Instances", "Count", "Builder", "Build (ms)", "SAH cost");
+
+    InstanceList instances;
+
+    for (size_t n : { 10'000llu, 100'000llu, 500'000llu })
+    {
+        GenerateInstances(DISTRIBUTION::UNIFORM, n, instances);
+        Run("Uniform", instances);
+    }
+
+    for (size_t n : { 100'000llu, 500'000llu })
+    {
+        GenerateInstances(DISTRIBUTION::CLUSTERED, n, instances);
+        Run("Clustered", instances);
+    }
+
+    // Optional path to a glTF scene
+    const char* path = Benchmark::GetArg(0);
+
+    if (path)
+    {
+        instances.clear();
+
+        if (LoadGltfInstances(path, instances))
+            Run("glTF", instances);
+    }
+    else
+        printf("(Pass a path to a glTF file to also benchmark glTF-derived instances)\n");
+}
+
+void Benchmark::BVHTraversal()
+{
+    printf("%d frustum queries, %d incoherent rays\n", NUM_FRUSTUM_QUERIES, NUM_RAYS);
+    printf("%-16s %-8s %14s %12s %12s %12s\n", "Instances", "Layout", "Frustum (us)", "Visible",
+        "Mrays/s", "Mismatches");
+
+    InstanceList instances;
+
+    for (size_t n : { 100'000llu, 500'000llu })
+    {
+        GenerateInstances(DISTRIBUTION::UNIFORM, n, instances);
+        RunTraversal("Uniform", instances);
+    }
+
+    GenerateInstances(DISTRIBUTION::CLUSTERED, 100'000, instances);
+    RunTraversal("Clustered", instances);
+}
+
+void Benchmark::BVHRays()
+{
+    printf("%d threads\n", App::GetNumWorkerThreads());
+    printf("%-16s %-12s %-24s %12s\n", "Instances", "Rays", "Method", "Mrays/s");
+
+    InstanceList instances;
+
+    GenerateInstances(DISTRIBUTION::UNIFORM, 500'000, instances);
+    RunRayBatches("Uniform", instances);
+
+    GenerateInstances(DISTRIBUTION::CLUSTERED, 500'000, instances);
+    RunRayBatches("Clustered", instances);
+}
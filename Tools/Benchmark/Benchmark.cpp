@@ -0,0 +1,95 @@
+#include "Benchmark.h"
+#include <App/App.h>
+#include <Win32/Win32.h>
+#include <string.h>
+
+using namespace ZetaRay;
+
+// Indicates to hybrid graphics systems to prefer the discrete part by default
+extern "C"
+{
+    __declspec(dllexport) DWORD NvOptimusEnablement = 0x00000001;
+    __declspec(dllexport) int AmdPowerXpressRequestHighPerformance = 1;
+
+    _declspec(dllexport) extern const UINT D3D12SDKVersion = 615;
+    _declspec(dllexport) extern const char8_t* D3D12SDKPath = u8".\\D3D12\\";
+}
+
+namespace
+{
+    struct BenchmarkEntry
+    {
+        const char* Name;
+        void (*Run)();
+    };
+
+    static constexpr BenchmarkEntry BENCHMARKS[] = {
+        { "TaskGraph", &Benchmark::TaskGraph },
+        { "ParallelFor", &Benchmark::ParallelFor },
+        { "BVHBuild", &Benchmark::BVHBuild },
+        { "BVHTraversal", &Benchmark::BVHTraversal },
+        { "BVHRays", &Benchmark::BVHRays },
+        { "MemoryPool", &Benchmark::MemoryPool },
+        { "HashTable", &Benchmark::HashTable },
+        { "glTFLoad", &Benchmark::glTFLoad },
+        { "VertexQuantization", &Benchmark::VertexQuantization },
+        { "SceneHandles", &Benchmark::SceneHandles },
+        { "AliasTable", &Benchmark::AliasTable },
+        { "LightTree", &Benchmark::LightTree },
+        { "MeshInstancePacking", &Benchmark::MeshInstancePacking }
+    };
+
+    int g_argc = 0;
+    char** g_argv = nullptr;
+
+    void ReportUsage()
+    {
+        printf("Usage: Benchmark [name [args...]]\nAvailable benchmarks:\n");
+
+        for (auto& b : BENCHMARKS)
+            printf("  %s\n", b.Name);
+    }
+}
+
+const char* Benchmark::GetArg(int i)
+{
+    // argv[0] is the executable and argv[1] the benchmark name
+    return i + 2 < g_argc ? g_argv[i + 2] : nullptr;
+}
+
+int main(int argc, char* argv[])
+{
+    g_argc = argc;
+    g_argv = argv;
+
+    const char* name = argc > 1 ? argv[1] : nullptr;
+    bool found = name == nullptr;
+
+    for (auto& b : BENCHMARKS)
+    {
+        if (name && strcmp(name, b.Name) == 0)
+            found = true;
+    }
+
+    if (!found)
+    {
+        ReportUsage();
+        return 0;
+    }
+
+    App::InitBasic();
+
+    for (auto& b : BENCHMARKS)
+    {
+        if (name && strcmp(name, b.Name) != 0)
+            continue;
+
+        printf("\n[%s]\n", b.Name);
+        b.Run();
+    }
+
+    App::FlushWorkerThreadPool();
+    App::ShutdownBasic();
+
+    return 0;
+}
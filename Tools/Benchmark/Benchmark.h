@@ -0,0 +1,40 @@
+#pragma once
+
+#include <App/Timer.h>
+#include <stdio.h>
+
+namespace ZetaRay::Benchmark
+{
+    // Each benchmark prints its results to stdout
+    void TaskGraph();
+    void ParallelFor();
+    void BVHBuild();
+    void BVHTraversal();
+    void BVHRays();
+    void MemoryPool();
+    void HashTable();
+    void glTFLoad();
+    void VertexQuantization();
+    void SceneHandles();
+    void AliasTable();
+    void LightTree();
+    void MeshInstancePacking();
+
+    // Returns the i'th command-line argument following the benchmark name or null if 
+    // there isn't one
+    const char* GetArg(int i);
+
+    // Busy waits for the given number of microseconds to simulate work
+    ZetaInline void Spin(double microSec)
+    {
+        App::DeltaTimer timer;
+        timer.Start();
+
+        while (true)
+        {
+            timer.End();
+            if (timer.DeltaMicro() >= microSec)
+                break;
+        }
+    }
+}
@@ -0,0 +1,136 @@
+#include "Benchmark.h"
+#include <Math/MatrixFuncs.h>
+#include <Utility/FlatHashTable.h>
+#include <Utility/HashTable.h>
+#include <Utility/RNG.h>
+#include <Utility/SmallVector.h>
+#include <Utility/Span.h>
+#include <xxHash/xxhash.h>
+
+using namespace ZetaRay;
+using namespace ZetaRay::App;
+using namespace ZetaRay::Math;
+using namespace ZetaRay::Util;
+
+namespace
+{
+    static constexpr int NUM_LOOKUPS = 4'000'000;
+    static constexpr int NUM_CHURN_OPS = 1'000'000;
+    static constexpr int NUM_RUNS = 5;
+
+    // Same size as SceneCore::TreePos
+    struct SmallValue
+    {
+        uint32_t Level;
+        uint32_t Offset;
+    };
+
+    // Instance IDs are hashes of instance names
+    ZetaInline uint64_t InstanceID(uint32_t i)
+    {
+        return XXH3_64bits(&i, sizeof(i));
+    }
+
+    struct Result
+    {
+        double LookupMs;
+        double ChurnMs;
+        uint64_t Checksum;
+    };
+
+    // Lookup: mostly hits, with one in four lookups for a key that isn't in the table.
+    // Churn: erases an existing key and inserts a new one, similar to instances being
+    // removed and added over time.
+    template<typename Table, typename Value>
+    Result Run(Span<uint64_t> keys, Span<uint32_t> queries)
+    {
+        Result ret{ .LookupMs = 0, .ChurnMs = 0, .Checksum = 0 };
+
+        for (int r = 0; r < NUM_RUNS; r++)
+        {
+            SmallVector<uint64_t> liveKeys;
+            liveKeys.append_range(keys.begin(), keys.end());
+
+            Table table;
+            table.resize(keys.size(), true);
+
+            for (auto k : keys)
+                table.insert_or_assign(k, Value{});
+
+            DeltaTimer timer;
+            timer.Start();
+
+            for (auto q : queries)
+            {
+                const uint64_t key = liveKeys[q >> 2] ^ (q & 0x3 ? 0 : 1);
+                ret.Checksum += (bool)table.find(key);
+            }
+
+            timer.End();
+            ret.LookupMs += timer.DeltaMilli();
+
+            timer.Start();
+
+            uint32_t nextID = (uint32_t)keys.size();
+
+            for (int i = 0; i < NUM_CHURN_OPS; i++)
+            {
+                const uint32_t idx = queries[i] >> 2;
+                table.erase(liveKeys[idx]);
+
+                liveKeys[idx] = InstanceID(nextID++);
+                table.insert_or_assign(liveKeys[idx], Value{});
+            }
+
+            timer.End();
+            ret.ChurnMs += timer.DeltaMilli();
+            ret.Checksum += table.size();
+        }
+
+        ret.LookupMs /= NUM_RUNS;
+        ret.ChurnMs /= NUM_RUNS;
+
+        return ret;
+    }
+
+    template<typename Value>
+    void RunAll(const char* valueName, Span<uint64_t> keys, Span<uint32_t> queries)
+    {
+        const Result base = Run<Util::HashTable<Value>, Value>(keys, queries);
+        const Result flat = Run<Util::FlatHashTable<Value>, Value>(keys, queries);
+
+        printf("%-10zu %-10s %-16s %12.3f %12.3f\n", keys.size(), valueName, "HashTable",
+            base.LookupMs, base.ChurnMs);
+        printf("%-10zu %-10s %-16s %12.3f %12.3f (%.2fx, %.2fx)\n", keys.size(), valueName, "FlatHashTable",
+            flat.LookupMs, flat.ChurnMs, base.LookupMs / flat.LookupMs, base.ChurnMs / flat.ChurnMs);
+
+        if (base.Checksum != flat.Checksum)
+            printf("Warning: results don't match.\n");
+    }
+}
+
+void Benchmark::HashTable()
+{
+    printf("%d lookups, %d erase/insert pairs, average of %d runs\n", NUM_LOOKUPS, NUM_CHURN_OPS, NUM_RUNS);
+    printf("%-10s %-10s %-16s %12s %12s\n", "Keys", "Value", "Table", "Lookup (ms)", "Churn (ms)");
+
+    for (uint32_t numKeys : { 1'000u, 10'000u, 100'000u, 1'000'000u })
+    {
+        SmallVector<uint64_t> keys;
+        keys.resize(numKeys);
+
+        for (uint32_t i = 0; i < numKeys; i++)
+            keys[i] = InstanceID(i);
+
+        // Lower two bits select between hit and miss, rest is index of the key
+        SmallVector<uint32_t> queries;
+        queries.resize(NUM_LOOKUPS);
+        RNG rng(numKeys);
+
+        for (int i = 0; i < NUM_LOOKUPS; i++)
+            queries[i] = (rng.UniformUintBounded(numKeys) << 2) | (rng.UniformUint() & 0x3);
+
+        RunAll<SmallValue>("8 B", keys, queries);
+        RunAll<float4x3>("48 B", keys, queries);
+    }
+}
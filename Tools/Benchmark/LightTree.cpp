@@ -0,0 +1,99 @@
+#include "Benchmark.h"
+#include <Scene/LightTree.h>
+#include <RayTracing/RtCommon.h>
+#include <Utility/RNG.h>
+
+using namespace ZetaRay;
+using namespace ZetaRay::App;
+using namespace ZetaRay::Math;
+using namespace ZetaRay::Util;
+
+// Light tree build time on the calling thread vs. the worker threads, along with the
+// time it takes to refit after 1% of triangles (one contiguous range, similar to an
+// emissive instance) have moved. Triangles are small and scattered in a large box, with
+// sizes and power spanning a few orders of magnitude.
+namespace
+{
+    static constexpr int NUM_RUNS = 5;
+
+    float3 RandomPoint(RNG& rng, float scale)
+    {
+        return float3(rng.Uniform() - 0.5f, rng.Uniform() - 0.5f, rng.Uniform() - 0.5f) * scale;
+    }
+
+    void FillTriangles(MutableSpan<RT::EmissiveTriangle> tris, MutableSpan<float> power)
+    {
+        RNG rng(tris.size());
+
+        for (size_t i = 0; i < tris.size(); i++)
+        {
+            const float3 v0 = RandomPoint(rng, 1000.0f);
+            const float size = 0.1f + rng.Uniform() * 5.0f;
+            const float3 v1 = v0 + RandomPoint(rng, size);
+            const float3 v2 = v0 + RandomPoint(rng, size);
+            const float u = Max(rng.Uniform(), 1e-2f);
+
+            tris[i] = RT::EmissiveTriangle(v0, v1, v2, float2(0.0f), float2(0.0f), float2(0.0f),
+                rng.UniformUintBounded(1u << 24), 0, half(1.0f / u), (uint32_t)i);
+            power[i] = Scene::LightTree::EstimatePower(tris[i]);
+        }
+    }
+
+    void Translate(MutableSpan<RT::EmissiveTriangle> tris, uint32_t begin, uint32_t end, float3 offset)
+    {
+        const __m128 vOffset = loadFloat3(offset);
+
+        for (uint32_t i = begin; i < end; i++)
+        {
+            __m128 v0, v1, v2;
+            tris[i].LoadVertices(v0, v1, v2);
+            tris[i].StoreVertices(_mm_add_ps(v0, vOffset), _mm_add_ps(v1, vOffset),
+                _mm_add_ps(v2, vOffset));
+        }
+    }
+
+    template<typename F>
+    double Time(F&& fn)
+    {
+        DeltaTimer timer;
+        timer.Start();
+
+        for (int i = 0; i < NUM_RUNS; i++)
+            fn(i);
+
+        timer.End();
+
+        return timer.DeltaMilli() / NUM_RUNS;
+    }
+}
+
+void Benchmark::LightTree()
+{
+    printf("Average of %d runs, times in ms\n", NUM_RUNS);
+    printf("%-12s %12s %12s %12s %12s\n", "Triangles", "Nodes", "Build (1T)", "Build", "Refit (1%)");
+
+    for (uint32_t n : { 10'000u, 100'000u, 1'000'000u })
+    {
+        SmallVector<RT::EmissiveTriangle> tris;
+        tris.resize(n);
+        SmallVector<float> power;
+        power.resize(n);
+        FillTriangles(tris, power);
+
+        Scene::LightTree tree;
+        const double serial = Time([&](int) { tree.Build(tris, power, false); });
+        const double parallel = Time([&](int) { tree.Build(tris, power); });
+
+        const uint32_t numMoved = Max(n / 100, 1u);
+        const uint32_t begin = n / 2;
+        const double refit = Time([&](int i)
+            {
+                // Alternate direction so that triangles don't drift away
+                Translate(tris, begin, begin + numMoved, float3(i & 1 ? -1.0f : 1.0f, 0.5f, 0.0f));
+                tree.Refit(tris, begin, begin + numMoved);
+            });
+
+        printf("%-12u %12u %12.3f %12.3f (%.2fx) %10.3f\n", n, (uint32_t)tree.Nodes().size(),
+            serial, parallel, serial / parallel, refit);
+    }
+}
@@ -0,0 +1,152 @@
+#include "Benchmark.h"
+#include <Support/ThreadCachingPool.h>
+#include <Utility/RNG.h>
+#include <Utility/SmallVector.h>
+#include <string.h>
+
+using namespace ZetaRay;
+using namespace ZetaRay::App;
+using namespace ZetaRay::Support;
+using namespace ZetaRay::Util;
+
+namespace
+{
+    static constexpr int NUM_OPS_PER_TASK = 500'000;
+    // Number of allocations that each task keeps alive at any time
+    static constexpr int NUM_LIVE = 512;
+    static constexpr int NUM_RUNS = 5;
+
+    struct Malloc
+    {
+        ZetaInline void* Allocate(size_t size) { return malloc(size); }
+        ZetaInline void Free(void* mem, size_t size) { free(mem); }
+    };
+
+    // Existing MemoryPool isn't thread-safe, so sharing it requires a lock
+    struct LockedMemoryPool
+    {
+        LockedMemoryPool() { Pool.Init(); }
+
+        ZetaInline void* Allocate(size_t size)
+        {
+            AcquireSRWLockExclusive(&Lock);
+            void* mem = Pool.AllocateAligned(size);
+            ReleaseSRWLockExclusive(&Lock);
+
+            return mem;
+        }
+
+        ZetaInline void Free(void* mem, size_t size)
+        {
+            AcquireSRWLockExclusive(&Lock);
+            Pool.FreeAligned(mem, size);
+            ReleaseSRWLockExclusive(&Lock);
+        }
+
+        MemoryPool Pool;
+        SRWLOCK Lock = SRWLOCK_INIT;
+    };
+
+    struct CachingPool
+    {
+        ZetaInline void* Allocate(size_t size) { return Pool.AllocateAligned(size); }
+        ZetaInline void Free(void* mem, size_t size) { Pool.FreeAligned(mem, size); }
+
+        ThreadCachingPool Pool;
+    };
+
+    // Mostly small sizes with the occasional larger one
+    ZetaInline size_t RandomSize(RNG& rng)
+    {
+        const float u = rng.Uniform();
+        return u < 0.7f ? 8 + rng.UniformUintBounded(56) :
+            (u < 0.95f ? 64 + rng.UniformUintBounded(448) : 512 + rng.UniformUintBounded(3584));
+    }
+
+    // Every task keeps NUM_LIVE allocations alive and repeatedly frees a random one and
+    // replaces it with a new allocation of random size
+    template<typename Allocator>
+    void Churn(Allocator& allocator, uint32_t seed)
+    {
+        void* ptrs[NUM_LIVE];
+        size_t sizes[NUM_LIVE];
+        RNG rng(seed);
+
+        for (int i = 0; i < NUM_LIVE; i++)
+        {
+            sizes[i] = RandomSize(rng);
+            ptrs[i] = allocator.Allocate(sizes[i]);
+            memset(ptrs[i], 0, Math::Min(sizes[i], (size_t)16));
+        }
+
+        for (int op = 0; op < NUM_OPS_PER_TASK; op++)
+        {
+            const int i = rng.UniformUintBounded(NUM_LIVE);
+            allocator.Free(ptrs[i], sizes[i]);
+
+            sizes[i] = RandomSize(rng);
+            ptrs[i] = allocator.Allocate(sizes[i]);
+            memset(ptrs[i], 0, Math::Min(sizes[i], (size_t)16));
+        }
+
+        for (int i = 0; i < NUM_LIVE; i++)
+            allocator.Free(ptrs[i], sizes[i]);
+    }
+
+    template<typename Allocator>
+    double Run(Allocator& allocator, int numTasks)
+    {
+        double total = 0.0;
+
+        for (int r = 0; r < NUM_RUNS; r++)
+        {
+            DeltaTimer timer;
+            timer.Start();
+
+            App::ParallelFor(0, numTasks, 1, [&allocator, r](size_t begin, size_t end)
+                {
+                    for (size_t t = begin; t < end; t++)
+                        Churn(allocator, (uint32_t)(r * 1000 + t));
+                });
+
+            timer.End();
+            total += timer.DeltaMilli();
+        }
+
+        return total / NUM_RUNS;
+    }
+}
+
+void Benchmark::MemoryPool()
+{
+    printf("%d threads, %d alloc/free pairs per task, average of %d runs\n",
+        App::GetNumWorkerThreads(), NUM_OPS_PER_TASK, NUM_RUNS);
+    printf("%-8s %-24s %12s %14s\n", "Tasks", "Allocator", "Time (ms)", "Mops/s");
+
+    const int maxNumTasks = App::GetNumWorkerThreads() + 1;
+
+    for (int numTasks : { 1, 4, maxNumTasks })
+    {
+        if (numTasks > maxNumTasks)
+            continue;
+
+        auto report = [numTasks](const char* name, double ms)
+            {
+                const double mops = (double)numTasks * NUM_OPS_PER_TASK / (ms * 1000.0);
+                printf("%-8d %-24s %12.3f %14.2f\n", numTasks, name, ms, mops);
+            };
+
+        Malloc m;
+        report("malloc", Run(m, numTasks));
+
+        LockedMemoryPool lockedPool;
+        report("MemoryPool + lock", Run(lockedPool, numTasks));
+
+        CachingPool cachingPool;
+        report("ThreadCachingPool", Run(cachingPool, numTasks));
+
+        const auto stats = cachingPool.Pool.GetStats(2);
+        printf("%-8s (32 B class: %llu batch fetches, %llu releases, %llu kb reserved)\n", "",
+            stats.NumBatchFetches, stats.NumBatchReleases, stats.ReservedBytes >> 10);
+    }
+}
@@ -0,0 +1,237 @@
+#include "Benchmark.h"
+#include <App/App.h>
+#include <Math/Color.h>
+#include <Math/MatrixFuncs.h>
+#include <RayTracing/RtAccelerationStructure.h>
+#include <Scene/SceneCore.h>
+#include <Utility/RNG.h>
+#include <Utility/SmallVector.h>
+#include <Utility/Span.h>
+
+using namespace ZetaRay;
+using namespace ZetaRay::App;
+using namespace ZetaRay::Math;
+using namespace ZetaRay::Model;
+using namespace ZetaRay::Scene;
+using namespace ZetaRay::Util;
+
+// Packing of RT::MeshInstance for every instance in the scene graph with
+// RT::PackMeshInstances() (as called by TLAS::RebuildFrameMeshInstanceData()) vs. walking the
+// levels serially, static then dynamic. TLAS needs a D3D device, so only the mesh and material
+// fields read by TLAS::FillMeshInstanceData() are mirrored here. Packing happens once, when
+// the scene is first loaded.
+namespace
+{
+    static constexpr int NUM_RUNS = 20;
+    static constexpr uint32_t NUM_LEVELS = 4;
+
+    struct Mesh
+    {
+        uint32_t VtxOffset;
+        uint32_t IdxOffset;
+        uint32_t MatIdx;
+    };
+
+    struct Material
+    {
+        uint32_t BaseColorFactor;
+        uint16_t BaseColorTex;
+        float AlphaCutoff;
+    };
+
+    struct TreeLevel
+    {
+        SmallVector<uint64_t> IDs;
+        SmallVector<uint64_t> MeshIDs;
+        SmallVector<uint8_t> RtFlags;
+        SmallVector<float4x3> ToWorlds;
+        SmallVector<float4x3> PrevToWorlds;
+    };
+
+    struct SceneGraph
+    {
+        TreeLevel Levels[NUM_LEVELS];
+        SmallVector<Mesh> Meshes;
+        SmallVector<Material> Materials;
+        uint32_t NumStatic = 0;
+        uint32_t NumDynamic = 0;
+    };
+
+    float4x3 RandomTransform(RNG& rng)
+    {
+        float3 s(0.5f + rng.Uniform(), 0.5f + rng.Uniform(), 0.5f + rng.Uniform());
+        float4 q(rng.Uniform() - 0.5f, rng.Uniform() - 0.5f, rng.Uniform() - 0.5f, rng.Uniform() - 0.5f);
+        q.normalize();
+        float3 t((rng.Uniform() - 0.5f) * 1000.0f, (rng.Uniform() - 0.5f) * 1000.0f,
+            (rng.Uniform() - 0.5f) * 1000.0f);
+
+        return float4x3(store(affineTransformation(s, q, t)));
+    }
+
+    void Build(uint32_t numInstances, SceneGraph& scene)
+    {
+        RNG rng(numInstances);
+
+        const uint32_t numMaterials = Max(numInstances / 32, 1u);
+        const uint32_t numMeshes = Max(numInstances / 4, 1u);
+
+        for (uint32_t m = 0; m < numMaterials; m++)
+        {
+            scene.Materials.push_back(Material{ .BaseColorFactor = rng.UniformUint(),
+                .BaseColorTex = (uint16_t)m,
+                .AlphaCutoff = 0.5f });
+        }
+
+        for (uint32_t m = 0; m < numMeshes; m++)
+        {
+            scene.Meshes.push_back(Mesh{ .VtxOffset = m * 1024,
+                .IdxOffset = m * 3072,
+                .MatIdx = rng.UniformUintBounded(numMaterials) });
+        }
+
+        // Half of the instances are at the first level and the rest are split among the
+        // others. One in ten instances is dynamic and a few have no mesh.
+        for (uint32_t i = 0; i < numInstances; i++)
+        {
+            const uint32_t level = i < numInstances / 2 ? 0 : 1 + rng.UniformUintBounded(NUM_LEVELS - 1);
+            TreeLevel& l = scene.Levels[level];
+            const float u = rng.Uniform();
+            const bool hasMesh = u < 0.1f || u >= 0.12f;
+            const RT_MESH_MODE mode = u < 0.1f ? RT_MESH_MODE::DYNAMIC_NO_REBUILD : RT_MESH_MODE::STATIC;
+            const float4x3 M = RandomTransform(rng);
+
+            l.IDs.push_back(i);
+            l.MeshIDs.push_back(hasMesh ? rng.UniformUintBounded(numMeshes) : Scene::INVALID_MESH);
+            l.RtFlags.push_back(RT_Flags::Encode(mode, RT_AS_SUBGROUP::NON_EMISSIVE, 0, 0, true));
+            l.ToWorlds.push_back(M);
+            l.PrevToWorlds.push_back(M);
+
+            scene.NumStatic += hasMesh && mode == RT_MESH_MODE::STATIC;
+            scene.NumDynamic += hasMesh && mode == RT_MESH_MODE::DYNAMIC_NO_REBUILD;
+        }
+    }
+
+    // Equivalent of TLAS::FillMeshInstanceData()
+    void Fill(const SceneGraph& scene, uint32_t level, uint32_t i, bool staticMesh,
+        RT::MeshInstance& dst)
+    {
+        const TreeLevel& l = scene.Levels[level];
+        const Mesh& mesh = scene.Meshes[l.MeshIDs[i]];
+        const Material& mat = scene.Materials[mesh.MatIdx];
+
+        float4a t;
+        float4a r;
+        float4a s;
+        decomposeSRT(load4x3(l.ToWorlds[i]), s, r, t);
+
+        dst.MatIdx = (uint16_t)mesh.MatIdx;
+        dst.BaseVtxOffset = mesh.VtxOffset;
+        dst.BaseIdxOffset = mesh.IdxOffset;
+        dst.Rotation = unorm4::FromNormalized(r);
+        dst.Scale = half3(s);
+        dst.Translation = float3(t.x, t.y, t.z);
+        dst.BaseEmissiveTriOffset = UINT32_MAX;
+        dst.BaseColorTex = mat.BaseColorTex;
+        dst.AlphaFactor_Cutoff = Float2ToRG8(float2(float((mat.BaseColorFactor >> 24) & 0xff) / 255.0f,
+            mat.AlphaCutoff));
+
+        if (!staticMesh)
+        {
+            float4a t_prev;
+            float4a r_prev;
+            float4a s_prev;
+            decomposeSRT(load4x3(l.PrevToWorlds[i]), s_prev, r_prev, t_prev);
+
+            dst.PrevRotation = unorm4::FromNormalized(r_prev);
+            dst.PrevScale = half3(s_prev);
+            dst.dTranslation = half3(t - t_prev);
+        }
+        else
+        {
+            dst.PrevRotation = dst.Rotation;
+            dst.PrevScale = dst.Scale;
+            dst.dTranslation = half3(0, 0, 0);
+        }
+    }
+
+    // Reference -- two passes over the levels on the calling thread
+    void PackSerial(const SceneGraph& scene, MutableSpan<RT::MeshInstance> out,
+        MutableSpan<uint64_t> ids)
+    {
+        uint32_t curr = 0;
+
+        for (RT_MESH_MODE mode : { RT_MESH_MODE::STATIC, RT_MESH_MODE::DYNAMIC_NO_REBUILD })
+        {
+            for (uint32_t level = 0; level < NUM_LEVELS; level++)
+            {
+                const TreeLevel& l = scene.Levels[level];
+
+                for (uint32_t i = 0; i < (uint32_t)l.RtFlags.size(); i++)
+                {
+                    if (l.MeshIDs[i] == Scene::INVALID_MESH ||
+                        RT_Flags::Decode(l.RtFlags[i]).MeshMode != mode)
+                    {
+                        continue;
+                    }
+
+                    Fill(scene, level, i, mode == RT_MESH_MODE::STATIC, out[curr]);
+                    ids[curr++] = l.IDs[i];
+                }
+            }
+        }
+    }
+
+    template<typename F>
+    double Time(F&& fn)
+    {
+        DeltaTimer timer;
+        timer.Start();
+
+        for (int r = 0; r < NUM_RUNS; r++)
+            fn();
+
+        timer.End();
+
+        return timer.DeltaMilli() / NUM_RUNS;
+    }
+}
+
+void Benchmark::MeshInstancePacking()
+{
+    printf("Average of %d runs, times in ms\n", NUM_RUNS);
+    printf("%-10s %12s %20s\n", "Instances", "Serial", "PackMeshInstances");
+
+    for (uint32_t numInstances : { 10'000u, 100'000u })
+    {
+        SceneGraph scene;
+        Build(numInstances, scene);
+
+        const uint32_t numPacked = scene.NumStatic + scene.NumDynamic;
+        SmallVector<RT::MeshInstance> instances;
+        instances.resize(numPacked);
+        SmallVector<uint64_t> ids;
+        ids.resize(numPacked);
+
+        SmallVector<RT::MeshInstanceLevel> levels;
+
+        for (const TreeLevel& l : scene.Levels)
+        {
+            levels.push_back(RT::MeshInstanceLevel{
+                .IDs = l.IDs,
+                .MeshIDs = l.MeshIDs,
+                .RtFlags = l.RtFlags });
+        }
+
+        const double serial = Time([&]() { PackSerial(scene, instances, ids); });
+        const double parallel = Time([&]()
+            {
+                RT::PackMeshInstances(levels, scene.NumStatic, instances, ids,
+                    [&scene](uint32_t level, uint32_t idx, bool staticMesh, RT::MeshInstance& instance)
+                    {
+                        Fill(scene, level, idx, staticMesh, instance);
+                    });
+            });
+
+        printf("%-10u %12.3f %12.3f (%.2fx)\n", numInstances, serial, parallel, serial / parallel);
+    }
+}
@@ -0,0 +1,144 @@
+#include "Benchmark.h"
+#include <Support/Task.h>
+#include <Math/Common.h>
+#include <Utility/RNG.h>
+#include <Utility/SmallVector.h>
+
+using namespace ZetaRay;
+using namespace ZetaRay::App;
+using namespace ZetaRay::Support;
+using namespace ZetaRay::Util;
+using namespace ZetaRay::Math;
+
+namespace
+{
+    static constexpr size_t NUM_ITEMS = 20000;
+    static constexpr int NUM_RUNS = 20;
+
+    enum class WORKLOAD
+    {
+        // Every item takes the same amount of work
+        UNIFORM,
+        // Cost increases sharply towards the end of the range
+        SKEWED,
+        // Most items are cheap, a random few are very expensive
+        HEAVY_TAIL
+    };
+
+    void FillCosts(WORKLOAD w, MutableSpan<float> costUs)
+    {
+        RNG rng(0x5eed);
+
+        for (size_t i = 0; i < costUs.size(); i++)
+        {
+            const float t = (float)i / costUs.size();
+
+            switch (w)
+            {
+            case WORKLOAD::UNIFORM:
+                costUs[i] = 1.0f;
+                break;
+            case WORKLOAD::SKEWED:
+                costUs[i] = 0.25f + 8.0f * t * t * t * t;
+                break;
+            case WORKLOAD::HEAVY_TAIL:
+                costUs[i] = rng.Uniform() < 0.01f ? 60.0f : 0.4f;
+                break;
+            }
+        }
+    }
+
+    void ProcessItems(Span<float> costUs, size_t begin, size_t end)
+    {
+        double total = 0.0;
+        for (size_t i = begin; i < end; i++)
+            total += costUs[i];
+
+        Benchmark::Spin(total);
+    }
+
+    // Previous approach: range is split once into (at most) as many equal chunks 
+    // as there are threads, each one a separate task
+    double RunFixedSplit(Span<float> costUs)
+    {
+        const int numThreads = App::GetNumWorkerThreads();
+        size_t offsets[MAX_NUM_THREADS];
+        size_t sizes[MAX_NUM_THREADS];
+        const size_t numChunks = SubdivideRangeWithMin(costUs.size(), numThreads, offsets, sizes, 64);
+
+        DeltaTimer timer;
+        timer.Start();
+
+        TaskSet ts;
+
+        for (size_t i = 0; i < numChunks; i++)
+        {
+            ts.EmplaceTask("FixedSplit", [costUs, offset = offsets[i], size = sizes[i]]()
+                {
+                    ProcessItems(costUs, offset, offset + size);
+                });
+        }
+
+        ts.Sort();
+        ts.Finalize();
+        App::Submit(ZetaMove(ts));
+        App::FlushWorkerThreadPool();
+
+        timer.End();
+
+        return timer.DeltaMilli();
+    }
+
+    double RunParallelFor(Span<float> costUs, size_t grain)
+    {
+        DeltaTimer timer;
+        timer.Start();
+
+        App::ParallelFor(0, costUs.size(), grain, [costUs](size_t begin, size_t end)
+            {
+                ProcessItems(costUs, begin, end);
+            });
+
+        timer.End();
+
+        return timer.DeltaMilli();
+    }
+}
+
+void Benchmark::ParallelFor()
+{
+    const char* workloadNames[] = { "Uniform", "Skewed", "HeavyTail" };
+    const WORKLOAD workloads[] = { WORKLOAD::UNIFORM, WORKLOAD::SKEWED, WORKLOAD::HEAVY_TAIL };
+    const size_t grains[] = { 16, 64, 256 };
+
+    SmallVector<float> costUs;
+    costUs.resize(NUM_ITEMS);
+
+    printf("%d threads, %llu items, average of %d runs\n", App::GetNumWorkerThreads(),
+        NUM_ITEMS, NUM_RUNS);
+    printf("%-10s %-22s %10s\n", "Workload", "Scheduler", "Time (ms)");
+
+    for (int w = 0; w < 3; w++)
+    {
+        FillCosts(workloads[w], costUs);
+
+        double total = 0.0;
+        for (int r = 0; r < NUM_RUNS; r++)
+        {
+            App::ResetTaskSignals();
+            total += RunFixedSplit(costUs);
+        }
+
+        printf("%-10s %-22s %10.3f\n", workloadNames[w], "Queue (fixed split)", total / NUM_RUNS);
+
+        for (int g = 0; g < 3; g++)
+        {
+            total = 0.0;
+            for (int r = 0; r < NUM_RUNS; r++)
+                total += RunParallelFor(costUs, grains[g]);
+
+            StackStr(name, n, "ParallelFor (grain %llu)", grains[g]);
+            printf("%-10s %-22s %10.3f\n", workloadNames[w], name, total / NUM_RUNS);
+        }
+    }
+}
@@ -0,0 +1,274 @@
+#include "Benchmark.h"
+#include <Math/CollisionTypes.h>
+#include <Math/MatrixFuncs.h>
+#include <Utility/FlatHashTable.h>
+#include <Utility/HashTable.h>
+#include <Utility/RNG.h>
+#include <Utility/SlotMap.h>
+#include <Utility/SmallVector.h>
+#include <xxHash/xxhash.h>
+
+using namespace ZetaRay;
+using namespace ZetaRay::App;
+using namespace ZetaRay::Math;
+using namespace ZetaRay::Util;
+
+// Compares per-frame scene lookups with hashed 64-bit IDs (instance ID -> tree position, mesh ID
+// -> mesh and material ID -> material, each a hash table probe) against generational handles
+// that index directly into slot arrays. Data layout mirrors SceneCore's tree levels.
+namespace
+{
+    static constexpr int NUM_FRAMES = 50;
+    static constexpr uint32_t NUM_LEVELS = 4;
+    static constexpr uint32_t TRIS_PER_EMISSIVE = 32;
+
+    struct TreePos
+    {
+        uint32_t Level;
+        uint32_t Offset;
+    };
+
+    // Same fields that are read by TLAS::FillMeshInstanceData()
+    struct Mesh
+    {
+        uint32_t VtxOffset;
+        uint32_t IdxOffset;
+        uint32_t MatID;
+        SlotHandle MatHandle;
+        AABB Box;
+    };
+
+    struct Material
+    {
+        uint32_t BaseColorFactor;
+        uint32_t BaseColorTex;
+        float AlphaCutoff;
+        uint32_t GpuBufferIdx;
+    };
+
+    struct MeshInstance
+    {
+        uint32_t BaseVtxOffset;
+        uint32_t BaseIdxOffset;
+        uint32_t MatIdx;
+        uint32_t BaseColorTex;
+        float3 Translation;
+        float AlphaFactor_Cutoff;
+    };
+
+    struct TreeLevel
+    {
+        SmallVector<uint64_t> IDs;
+        SmallVector<float4x3> ToWorlds;
+        SmallVector<uint64_t> MeshIDs;
+        SmallVector<SlotHandle> MeshHandles;
+        SmallVector<uint32_t> RtInstanceIDs;
+    };
+
+    struct Scene
+    {
+        TreeLevel Levels[NUM_LEVELS];
+
+        // Hashed IDs
+        FlatHashTable<TreePos> IDtoTreePos;
+        HashTable<Mesh> Meshes;
+        HashTable<Material, uint32_t> Materials;
+
+        // Handles
+        SlotMap<TreePos> TreePositions;
+        SlotMap<Mesh> MeshSlots;
+        SlotMap<Material> MaterialSlots;
+
+        // Emissive instances and their triangles
+        SmallVector<uint64_t> EmissiveIDs;
+        SmallVector<SlotHandle> EmissiveHandles;
+        SmallVector<float3> TriVertices;
+    };
+
+    void Build(uint32_t numInstances, uint32_t numMeshes, uint32_t numMaterials, Scene& scene)
+    {
+        RNG rng(numInstances);
+
+        SmallVector<SlotHandle> matHandles;
+        scene.Materials.resize(numMaterials, true);
+
+        for (uint32_t m = 0; m < numMaterials; m++)
+        {
+            const Material mat{ .BaseColorFactor = rng.UniformUint(),
+                .BaseColorTex = m,
+                .AlphaCutoff = 0.5f,
+                .GpuBufferIdx = m };
+
+            scene.Materials.insert_or_assign((uint32_t)XXH3_64bits(&m, sizeof(m)), mat);
+            matHandles.push_back(scene.MaterialSlots.insert(mat));
+        }
+
+        SmallVector<uint64_t> meshIDs;
+        SmallVector<SlotHandle> meshHandles;
+        scene.Meshes.resize(numMeshes, true);
+
+        for (uint32_t m = 0; m < numMeshes; m++)
+        {
+            const uint32_t matIdx = rng.UniformUintBounded(numMaterials);
+            const Mesh mesh{ .VtxOffset = m * 1024,
+                .IdxOffset = m * 3072,
+                .MatID = (uint32_t)XXH3_64bits(&matIdx, sizeof(matIdx)),
+                .MatHandle = matHandles[matIdx] };
+
+            const uint64_t id = XXH3_64bits_withSeed(&m, sizeof(m), 1);
+            scene.Meshes.insert_or_assign(id, mesh);
+            meshIDs.push_back(id);
+            meshHandles.push_back(scene.MeshSlots.insert(mesh));
+        }
+
+        // Half of the instances are at the first level and the rest are split among the others
+        scene.IDtoTreePos.resize(numInstances, true);
+        const float4x3 I = float4x3(store(identity()));
+
+        for (uint32_t i = 0; i < numInstances; i++)
+        {
+            const uint32_t level = i < numInstances / 2 ? 0 : 1 + rng.UniformUintBounded(NUM_LEVELS - 1);
+            TreeLevel& l = scene.Levels[level];
+            const TreePos pos{ .Level = level, .Offset = (uint32_t)l.IDs.size() };
+            const uint64_t id = XXH3_64bits_withSeed(&i, sizeof(i), 2);
+            const uint32_t mesh = rng.UniformUintBounded(numMeshes);
+
+            l.IDs.push_back(id);
+            l.ToWorlds.push_back(I);
+            l.MeshIDs.push_back(meshIDs[mesh]);
+            l.MeshHandles.push_back(meshHandles[mesh]);
+            l.RtInstanceIDs.push_back(i);
+
+            scene.IDtoTreePos.insert_or_assign(id, pos);
+            const SlotHandle h = scene.TreePositions.insert(pos);
+
+            // One in eight instances is emissive
+            if ((i & 0x7) == 0)
+            {
+                scene.EmissiveIDs.push_back(id);
+                scene.EmissiveHandles.push_back(h);
+            }
+        }
+
+        scene.TriVertices.resize(scene.EmissiveIDs.size() * TRIS_PER_EMISSIVE * 3);
+
+        for (auto& v : scene.TriVertices)
+            v = float3(rng.Uniform(), rng.Uniform(), rng.Uniform());
+    }
+
+    ZetaInline void Fill(const Mesh& mesh, const Material& mat, const float4x3& M, MeshInstance& dst)
+    {
+        dst.BaseVtxOffset = mesh.VtxOffset;
+        dst.BaseIdxOffset = mesh.IdxOffset;
+        dst.MatIdx = mat.GpuBufferIdx;
+        dst.BaseColorTex = mat.BaseColorTex;
+        dst.Translation = M.m[3];
+        dst.AlphaFactor_Cutoff = float((mat.BaseColorFactor >> 24) & 0xff) / 255.0f * mat.AlphaCutoff;
+    }
+
+    // Equivalent of TLAS::RebuildFrameMeshInstanceData()
+    template<bool Handles>
+    double InstanceFill(const Scene& scene, SmallVector<MeshInstance>& out)
+    {
+        DeltaTimer timer;
+        timer.Start();
+
+        for (int f = 0; f < NUM_FRAMES; f++)
+        {
+            uint32_t curr = 0;
+
+            for (const TreeLevel& l : scene.Levels)
+            {
+                for (size_t i = 0; i < l.IDs.size(); i++)
+                {
+                    if constexpr (Handles)
+                    {
+                        const Mesh& mesh = *scene.MeshSlots.find(l.MeshHandles[i]).value();
+                        const Material& mat = *scene.MaterialSlots.find(mesh.MatHandle).value();
+                        Fill(mesh, mat, l.ToWorlds[i], out[curr++]);
+                    }
+                    else
+                    {
+                        const Mesh& mesh = *scene.Meshes.find(l.MeshIDs[i]).value();
+                        const Material& mat = *scene.Materials.find(mesh.MatID).value();
+                        Fill(mesh, mat, l.ToWorlds[i], out[curr++]);
+                    }
+                }
+            }
+        }
+
+        timer.End();
+
+        return timer.DeltaMilli() / NUM_FRAMES;
+    }
+
+    // Equivalent of SceneCore::UpdateEmissivePositions() when every emissive instance has moved
+    template<bool Handles>
+    double EmissiveUpdate(const Scene& scene, SmallVector<float3>& out)
+    {
+        DeltaTimer timer;
+        timer.Start();
+
+        for (int f = 0; f < NUM_FRAMES; f++)
+        {
+            for (size_t e = 0; e < scene.EmissiveIDs.size(); e++)
+            {
+                TreePos p;
+
+                if constexpr (Handles)
+                    p = scene.TreePositions[scene.EmissiveHandles[e]];
+                else
+                    p = *scene.IDtoTreePos.find(scene.EmissiveIDs[e]).value();
+
+                const TreeLevel& l = scene.Levels[p.Level];
+                const v_float4x4 vW = load4x3(l.ToWorlds[p.Offset]);
+                const uint32_t rtInstanceID = l.RtInstanceIDs[p.Offset];
+                const size_t base = e * TRIS_PER_EMISSIVE * 3;
+
+                for (size_t v = base; v < base + TRIS_PER_EMISSIVE * 3; v++)
+                {
+                    float3 pos = scene.TriVertices[v];
+                    __m128 vV = loadFloat3(pos);
+                    vV = _mm_insert_ps(vV, _mm_set1_ps(1.0f), 0x30);
+                    vV = mul(vW, vV);
+                    out[v] = storeFloat3(vV);
+                    out[v].x += (float)rtInstanceID;
+                }
+            }
+        }
+
+        timer.End();
+
+        return timer.DeltaMilli() / NUM_FRAMES;
+    }
+}
+
+void Benchmark::SceneHandles()
+{
+    printf("Average of %d frames, times in ms per frame\n", NUM_FRAMES);
+    printf("%-10s %-10s %-10s %16s %16s\n", "Instances", "Meshes", "Scheme", "Instance fill", "Emissive update");
+
+    for (uint32_t numInstances : { 1'000u, 10'000u, 100'000u, 1'000'000u })
+    {
+        const uint32_t numMeshes = Max(numInstances / 4, 1u);
+        const uint32_t numMaterials = Max(numMeshes / 8, 1u);
+
+        Scene scene;
+        Build(numInstances, numMeshes, numMaterials, scene);
+
+        SmallVector<MeshInstance> instances;
+        instances.resize(numInstances);
+        SmallVector<float3> vertices;
+        vertices.resize(scene.TriVertices.size());
+
+        const double fillHashed = InstanceFill<false>(scene, instances);
+        const double fillHandles = InstanceFill<true>(scene, instances);
+        const double emissiveHashed = EmissiveUpdate<false>(scene, vertices);
+        const double emissiveHandles = EmissiveUpdate<true>(scene, vertices);
+
+        printf("%-10u %-10u %-10s %16.3f %16.3f\n", numInstances, numMeshes, "Hashed IDs",
+            fillHashed, emissiveHashed);
+        printf("%-10u %-10u %-10s %16.3f %16.3f (%.2fx, %.2fx)\n", numInstances, numMeshes, "Handles",
+            fillHandles, emissiveHandles, fillHashed / fillHandles, emissiveHashed / emissiveHandles);
+    }
+}
@@ -0,0 +1,197 @@
+#include "Benchmark.h"
+#include <Support/Task.h>
+#include <Utility/RNG.h>
+#include <atomic>
+
+using namespace ZetaRay;
+using namespace ZetaRay::App;
+using namespace ZetaRay::Support;
+using namespace ZetaRay::Util;
+
+namespace
+{
+    // A frame consists of NUM_TASK_SETS TaskSets that are chained one after the other
+    // (every leaf of a TaskSet is connected to every root of the next one).
+    static constexpr int NUM_TASK_SETS = 8;
+    static constexpr int TASKS_PER_SET = 16;
+    static constexpr int NUM_WARMUP_FRAMES = 10;
+    static constexpr int NUM_FRAMES = 200;
+    // Work per task is uniformly distributed in [MIN_WORK_US, MAX_WORK_US]
+    static constexpr double MIN_WORK_US = 20.0;
+    static constexpr double MAX_WORK_US = 120.0;
+
+    enum class DAG_SHAPE
+    {
+        // Every TaskSet contains 4 independent chains of 4 tasks
+        DEEP,
+        // Every TaskSet is a fork-join: one root, 14 independent tasks and one sink
+        WIDE
+    };
+
+    struct FrameContext
+    {
+        double WorkUs[NUM_TASK_SETS][TASKS_PER_SET];
+        std::atomic<double> BusyUs;
+    };
+
+    struct Result
+    {
+        double FrameMs;
+        double CriticalPathMs;
+        double IdlePct;
+    };
+
+    // Longest path through a TaskSet, computed from the known shape of the graph
+    double CriticalPath(DAG_SHAPE shape, const double* work)
+    {
+        if (shape == DAG_SHAPE::DEEP)
+        {
+            double longest = 0.0;
+
+            for (int c = 0; c < 4; c++)
+            {
+                double chain = 0.0;
+                for (int i = 0; i < 4; i++)
+                    chain += work[c * 4 + i];
+
+                longest = Math::Max(longest, chain);
+            }
+
+            return longest;
+        }
+
+        double longest = 0.0;
+        for (int i = 1; i < TASKS_PER_SET - 1; i++)
+            longest = Math::Max(longest, work[i]);
+
+        return work[0] + longest + work[TASKS_PER_SET - 1];
+    }
+
+    void BuildTaskSet(DAG_SHAPE shape, TaskSet& ts, FrameContext& ctx, int tsIdx)
+    {
+        TaskSet::TaskHandle handles[TASKS_PER_SET];
+
+        for (int i = 0; i < TASKS_PER_SET; i++)
+        {
+            double* work = &ctx.WorkUs[tsIdx][i];
+            std::atomic<double>* busy = &ctx.BusyUs;
+
+            handles[i] = ts.EmplaceTask("Synthetic", [work, busy]()
+                {
+                    Benchmark::Spin(*work);
+
+                    busy->fetch_add(*work, std::memory_order_relaxed);
+                });
+        }
+
+        if (shape == DAG_SHAPE::DEEP)
+        {
+            for (int c = 0; c < 4; c++)
+            {
+                for (int i = 0; i < 3; i++)
+                    ts.AddOutgoingEdge(handles[c * 4 + i], handles[c * 4 + i + 1]);
+            }
+        }
+        else
+        {
+            for (int i = 1; i < TASKS_PER_SET - 1; i++)
+            {
+                ts.AddOutgoingEdge(handles[0], handles[i]);
+                ts.AddOutgoingEdge(handles[i], handles[TASKS_PER_SET - 1]);
+            }
+        }
+
+        ts.Sort();
+    }
+
+    Result RunFrames(DAG_SHAPE shape, SCHEDULING_MODE mode)
+    {
+        App::SetWorkerSchedulingMode(mode);
+
+        RNG rng(0x1234);
+        FrameContext* ctx = new FrameContext;
+        const int numThreads = App::GetNumWorkerThreads();
+
+        double totalFrameMs = 0.0;
+        double totalCriticalPathMs = 0.0;
+        double totalIdle = 0.0;
+
+        for (int frame = 0; frame < NUM_WARMUP_FRAMES + NUM_FRAMES; frame++)
+        {
+            double criticalPathUs = 0.0;
+
+            for (int t = 0; t < NUM_TASK_SETS; t++)
+            {
+                for (int i = 0; i < TASKS_PER_SET; i++)
+                    ctx->WorkUs[t][i] = MIN_WORK_US + rng.Uniform() * (MAX_WORK_US - MIN_WORK_US);
+
+                criticalPathUs += CriticalPath(shape, ctx->WorkUs[t]);
+            }
+
+            ctx->BusyUs.store(0.0, std::memory_order_relaxed);
+
+            // Signals are released once per frame, same as the main loop
+            App::ResetTaskSignals();
+
+            DeltaTimer timer;
+            timer.Start();
+
+            {
+                TaskSet ts[NUM_TASK_SETS];
+
+                for (int t = 0; t < NUM_TASK_SETS; t++)
+                    BuildTaskSet(shape, ts[t], *ctx, t);
+
+                for (int t = 0; t < NUM_TASK_SETS - 1; t++)
+                    ts[t].ConnectTo(ts[t + 1]);
+
+                for (int t = 0; t < NUM_TASK_SETS; t++)
+                    ts[t].Finalize();
+
+                for (int t = 0; t < NUM_TASK_SETS; t++)
+                    App::Submit(ZetaMove(ts[t]));
+            }
+
+            App::FlushWorkerThreadPool();
+            timer.End();
+
+            if (frame < NUM_WARMUP_FRAMES)
+                continue;
+
+            const double frameUs = timer.DeltaMicro();
+            totalFrameMs += frameUs / 1000.0;
+            totalCriticalPathMs += criticalPathUs / 1000.0;
+            totalIdle += 1.0 - ctx->BusyUs.load(std::memory_order_relaxed) / (frameUs * numThreads);
+        }
+
+        delete ctx;
+
+        return Result{ .FrameMs = totalFrameMs / NUM_FRAMES,
+            .CriticalPathMs = totalCriticalPathMs / NUM_FRAMES,
+            .IdlePct = 100.0 * totalIdle / NUM_FRAMES };
+    }
+}
+
+void Benchmark::TaskGraph()
+{
+    const char* shapeNames[] = { "Deep", "Wide" };
+    const char* modeNames[] = { "Blocking", "DependencyReady" };
+    const DAG_SHAPE shapes[] = { DAG_SHAPE::DEEP, DAG_SHAPE::WIDE };
+    const SCHEDULING_MODE modes[] = { SCHEDULING_MODE::BLOCKING, SCHEDULING_MODE::DEPENDENCY_READY };
+
+    printf("%d threads, %d TaskSets x %d tasks per frame, %d frames\n", App::GetNumWorkerThreads(),
+        NUM_TASK_SETS, TASKS_PER_SET, NUM_FRAMES);
+    printf("%-6s %-16s %12s %18s %10s\n", "DAG", "Mode", "Frame (ms)", "Critical path (ms)", "Idle (%)");
+
+    for (int s = 0; s < 2; s++)
+    {
+        for (int m = 0; m < 2; m++)
+        {
+            Result r = RunFrames(shapes[s], modes[m]);
+            printf("%-6s %-16s %12.3f %18.3f %10.1f\n", shapeNames[s], modeNames[m], r.FrameMs,
+                r.CriticalPathMs, r.IdlePct);
+        }
+    }
+
+    App::SetWorkerSchedulingMode(SCHEDULING_MODE::DEPENDENCY_READY);
+}
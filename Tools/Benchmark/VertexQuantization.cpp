@@ -0,0 +1,114 @@
+#include "Benchmark.h"
+#include <Model/glTF.h>
+#include <Model/glTFCache.h>
+#include <Model/VertexQuantizer.h>
+#include <Utility/SmallVector.h>
+#include <xxHash/xxhash.h>
+
+using namespace ZetaRay;
+using namespace ZetaRay::App;
+using namespace ZetaRay::Core;
+using namespace ZetaRay::Math;
+using namespace ZetaRay::Model;
+using namespace ZetaRay::Util;
+
+namespace
+{
+    static constexpr int NUM_RUNS = 5;
+}
+
+void Benchmark::VertexQuantization()
+{
+    const char* arg = Benchmark::GetArg(0);
+
+    if (!arg)
+    {
+        printf("(Pass a path to a glTF file, e.g. Assets/CornellBox/cornell.gltf, to run this benchmark)\n");
+        return;
+    }
+
+    // Process the scene with full-precision vertices and read them back from its cache file
+    Filesystem::Path path(arg);
+    const uint32_t sceneID = XXH3_64_To_32(XXH3_64bits(path.GetView().data(), path.Length()));
+    glTF::Bake(path);
+
+    Filesystem::MemoryMappedFile file;
+    glTF::Cache::SceneData data;
+
+    if (!glTF::Cache::Open(path, sceneID, glTF::Cache::GetFlags(glTF::Options()), file, data))
+    {
+        printf("Opening the cache file failed.\n");
+        return;
+    }
+
+    const size_t numMeshes = data.Meshes.size();
+    const size_t numVertices = data.Vertices.size();
+
+    SmallVector<AABB> bounds;
+    bounds.resize(numMeshes);
+    SmallVector<CompactVertex> compact;
+    compact.resize(numVertices);
+    SmallVector<Vertex> decoded;
+    decoded.resize(numVertices);
+
+    for (size_t i = 0; i < numMeshes; i++)
+    {
+        const auto& mesh = data.Meshes[i];
+        bounds[i] = VertexQuantizer::ComputeBounds(Span(data.Vertices.data() + mesh.BaseVtxOffset, 
+            mesh.NumVertices));
+    }
+
+    double encodeMs = 0;
+    double decodeMs = 0;
+
+    for (int r = 0; r < NUM_RUNS; r++)
+    {
+        DeltaTimer timer;
+        timer.Start();
+
+        for (size_t i = 0; i < numMeshes; i++)
+        {
+            const auto& mesh = data.Meshes[i];
+            VertexQuantizer::Encode(Span(data.Vertices.data() + mesh.BaseVtxOffset, mesh.NumVertices), bounds[i],
+                MutableSpan(compact.data() + mesh.BaseVtxOffset, mesh.NumVertices));
+        }
+
+        timer.End();
+        encodeMs += timer.DeltaMilli();
+        timer.Start();
+
+        for (size_t i = 0; i < numMeshes; i++)
+        {
+            const auto& mesh = data.Meshes[i];
+            VertexQuantizer::Decode(Span(compact.data() + mesh.BaseVtxOffset, mesh.NumVertices), bounds[i],
+                MutableSpan(decoded.data() + mesh.BaseVtxOffset, mesh.NumVertices));
+        }
+
+        timer.End();
+        decodeMs += timer.DeltaMilli();
+    }
+
+    encodeMs /= NUM_RUNS;
+    decodeMs /= NUM_RUNS;
+
+    VertexQuantizer::Error err;
+
+    for (size_t i = 0; i < numMeshes; i++)
+    {
+        const auto& mesh = data.Meshes[i];
+        err.Merge(VertexQuantizer::MeasureError(Span(data.Vertices.data() + mesh.BaseVtxOffset, mesh.NumVertices),
+            Span(decoded.data() + mesh.BaseVtxOffset, mesh.NumVertices), bounds[i]));
+    }
+
+    const double fullKB = numVertices * sizeof(Vertex) / 1024.0;
+    const double compactKB = numVertices * sizeof(CompactVertex) / 1024.0;
+
+    printf("%zu meshes, %zu vertices\n", numMeshes, numVertices);
+    printf("%-28s %12.1f\n", "Vertex (KB)", fullKB);
+    printf("%-28s %12.1f (-%.1f%%)\n", "CompactVertex (KB)", compactKB, 100.0 * (1.0 - compactKB / fullKB));
+    printf("%-28s %12g\n", "Max position error", err.MaxPositionError);
+    printf("%-28s %12g\n", "Max relative position error", err.MaxRelativePositionError);
+    printf("%-28s %12g\n", "Max UV error", err.MaxTexUVError);
+    printf("%-28s %12.3f (%.1f M vertices/s)\n", "Encode (ms)", encodeMs, numVertices / (encodeMs * 1000.0));
+    printf("%-28s %12.3f (%.1f M vertices/s)\n", "Decode (ms)", decodeMs, numVertices / (decodeMs * 1000.0));
+}
@@ -0,0 +1,105 @@
+#include "Benchmark.h"
+#include <Model/glTF.h>
+#include <Model/glTFCache.h>
+#include <Utility/SmallVector.h>
+#include <Utility/Utility.h>
+#include <xxHash/xxhash.h>
+
+using namespace ZetaRay;
+using namespace ZetaRay::App;
+using namespace ZetaRay::Model;
+using namespace ZetaRay::Util;
+
+namespace
+{
+    static constexpr int NUM_RUNS = 3;
+
+    // Copies every section out of the mapping, same as what adding it to the scene does
+    template<typename T>
+    ZetaInline size_t Copy(MutableSpan<T> section, SmallVector<T>& dst)
+    {
+        dst.clear();
+        dst.append_range(section.begin(), section.end(), true);
+
+        return dst.size();
+    }
+}
+
+void Benchmark::glTFLoad()
+{
+    const char* arg = Benchmark::GetArg(0);
+
+    if (!arg)
+    {
+        printf("(Pass a path to a glTF file to run this benchmark)\n");
+        return;
+    }
+
+    Filesystem::Path path(arg);
+    const uint32_t sceneID = XXH3_64_To_32(XXH3_64bits(path.GetView().data(), path.Length()));
+
+    // Parse the glTF file and convert it to scene data. Scene isn't touched, which excludes
+    // texture loading and GPU uploads -- those are the same for both paths.
+    double glTFMs = 0;
+
+    for (int r = 0; r < NUM_RUNS; r++)
+    {
+        DeltaTimer timer;
+        timer.Start();
+
+        glTF::Bake(path, glTF::Options(), false);
+
+        timer.End();
+        glTFMs += timer.DeltaMilli();
+    }
+
+    DeltaTimer timer;
+    timer.Start();
+
+    glTF::Bake(path);
+
+    timer.End();
+    const double bakeMs = timer.DeltaMilli();
+
+    // Validate and map the cache file, then copy scene data out of it
+    double cacheMs = 0;
+    size_t checksum = 0;
+
+    for (int r = 0; r < NUM_RUNS; r++)
+    {
+        SmallVector<Core::Vertex> vertices;
+        SmallVector<uint32_t> indices;
+        SmallVector<glTF::Asset::Mesh> meshes;
+        SmallVector<glTF::Asset::InstanceDesc> instances;
+        SmallVector<RT::EmissiveTriangle> emissiveTris;
+
+        timer.Start();
+
+        Filesystem::MemoryMappedFile file;
+        glTF::Cache::SceneData data;
+
+        if (!glTF::Cache::Open(path, sceneID, glTF::Cache::GetFlags(glTF::Options()), file, data))
+        {
+            printf("Opening the cache file failed.\n");
+            return;
+        }
+
+        checksum += Copy(data.Vertices, vertices);
+        checksum += Copy(data.Indices, indices);
+        checksum += Copy(data.Meshes, meshes);
+        checksum += Copy(data.Instances, instances);
+        checksum += Copy(data.EmissiveTris, emissiveTris);
+
+        timer.End();
+        cacheMs += timer.DeltaMilli();
+    }
+
+    glTFMs /= NUM_RUNS;
+    cacheMs /= NUM_RUNS;
+
+    printf("%-24s %12s\n", "Path", "Time (ms)");
+    printf("%-24s %12.3f\n", "glTF (parse + process)", glTFMs);
+    printf("%-24s %12.3f\n", "Bake (process + write)", bakeMs);
+    printf("%-24s %12.3f (%.2fx)\n", "Cache (map + copy)", cacheMs, glTFMs / cacheMs);
+    printf("(checksum: %zu)\n", checksum);
+}